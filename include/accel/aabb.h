@@ -0,0 +1,69 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+namespace pathtracer
+{
+/// <summary>
+/// Axis-aligned bounding box. A default constructed box is empty (min = +inf,
+/// max = -inf), so growing it by anything yields exactly that thing.
+/// </summary>
+struct Aabb
+{
+    glm::vec3 min{std::numeric_limits<float>::infinity()};
+    glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+    auto Grow(const glm::vec3& point) -> void
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    auto Grow(const Aabb& other) -> void
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    auto IsEmpty() const -> bool
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    auto Centroid() const -> glm::vec3
+    {
+        return (min + max) * 0.5f;
+    }
+
+    auto Extent() const -> glm::vec3
+    {
+        return max - min;
+    }
+
+    /// <summary>
+    /// Surface area, 0 for an empty box. The SAH only ever uses ratios of
+    /// areas, so the factor of 2 is kept for readability, not correctness.
+    /// </summary>
+    auto SurfaceArea() const -> float
+    {
+        if (IsEmpty())
+            return 0.0f;
+        const glm::vec3 e = Extent();
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    /// <summary>
+    /// Bounds of a sphere.
+    /// </summary>
+    static auto FromSphere(const glm::vec3& center, float radius) -> Aabb
+    {
+        return {center - radius, center + radius};
+    }
+};
+
+} // namespace pathtracer
+
+#endif // AABB_H
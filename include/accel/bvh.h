@@ -0,0 +1,395 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "accel/aabb.h"
+#include "ray/ray.h"
+#include "utils/aligned_allocator.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Parameters of the binned SAH build. The two costs only matter relative to
+/// each other: how expensive one ray-box test is compared to one
+/// ray-primitive test.
+/// </summary>
+struct BvhBuildOptions
+{
+    /// <summary>
+    /// Largest binCount Bvh::Build() accepts.
+    /// </summary>
+    static constexpr uint32_t MAX_BIN_COUNT = 1024;
+
+    /// <summary>
+    /// Number of candidate split planes per axis is binCount - 1.
+    /// </summary>
+    uint32_t binCount = 16;
+
+    /// <summary>
+    /// Nodes with more primitives than this are always split. Smaller nodes
+    /// become leaves whenever the SAH says splitting does not pay off.
+    /// </summary>
+    uint32_t maxLeafSize = 8;
+
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+
+    /// <summary>
+    /// Threads used for the build when no pool is passed to Bvh::Build(). 0
+    /// uses every hardware thread, 1 builds serially on the caller.
+    /// </summary>
+    uint32_t threadCount = 0;
+
+    /// <summary>
+    /// Bvh::Update() rebuilds the tree once refitting has raised its SAH
+    /// cost above this multiple of the cost right after the last build.
+    /// Values of 1 or less rebuild on every update.
+    /// </summary>
+    float maxSahDegradation = 1.5f;
+
+    /// <summary>
+    /// Whether Bvh::Build() accepts these options: 2 to MAX_BIN_COUNT bins,
+    /// leaves of at least one primitive, finite non-negative costs and a
+    /// degradation limit that is a number.
+    /// </summary>
+    auto IsValid() const -> bool
+    {
+        return binCount >= 2 && binCount <= MAX_BIN_COUNT &&
+               maxLeafSize >= 1 && std::isfinite(traversalCost) &&
+               traversalCost >= 0.0f && std::isfinite(intersectionCost) &&
+               intersectionCost >= 0.0f && !std::isnan(maxSahDegradation);
+    }
+};
+
+/// <summary>
+/// A node of the binary tree, 32 bytes so that two share a cache line.
+/// Nodes are stored in depth-first order: an interior node (primCount == 0)
+/// is directly followed by its first child, and offset is the index of its
+/// second child. A leaf references primCount entries of
+/// Bvh::GetPrimIndices() starting at offset.
+/// </summary>
+struct alignas(32) BvhNode
+{
+    Aabb bounds;
+    uint32_t offset = 0;
+    uint32_t primCount = 0;
+
+    auto IsLeaf() const -> bool
+    {
+        return primCount > 0;
+    }
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+/// <summary>
+/// Summary of a build, for comparing builders and settings.
+/// </summary>
+struct BvhStats
+{
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t maxDepth = 0;
+    uint32_t maxLeafPrims = 0;
+
+    /// <summary>
+    /// Expected cost of tracing a random ray that hits the root, in units of
+    /// BvhBuildOptions costs. Lower is better; only comparable between
+    /// builds over the same primitives.
+    /// </summary>
+    float sahCost = 0.0f;
+
+    double buildMs = 0.0;
+
+    /// <summary>
+    /// Refits since the last build, and the duration of the latest one.
+    /// </summary>
+    uint32_t refitCount = 0;
+    double refitMs = 0.0;
+};
+
+/// <summary>
+/// Factor 1 + 2 * gamma(3) by which slab tests widen the distance at which
+/// a ray leaves a box (Ize 2013, "Robust BVH Ray Traversal"), and the
+/// closest hit distance a box is culled against. Without it, rounding can
+/// make a ray through a box's edge or corner miss the box, and with it a
+/// triangle whose vertex lies there.
+/// </summary>
+constexpr float SLAB_EXIT_SCALE =
+    1.0f + 2.0f * (3.0f * 0x1p-24f) / (1.0f - 3.0f * 0x1p-24f);
+
+/// <summary>
+/// Reciprocal ray direction for the slab tests. Infinite components, from
+/// axis-parallel directions, are clamped to the largest finite float, so a
+/// ray lying exactly in the plane of a box face computes 0 rather than
+/// 0 * inf = NaN for that slab and is counted as inside it.
+/// </summary>
+inline auto SlabInverseDirection(const glm::vec3& direction) -> glm::vec3
+{
+    constexpr float MAX = std::numeric_limits<float>::max();
+    const glm::vec3 inv = 1.0f / direction;
+    return {std::copysign(std::min(std::abs(inv.x), MAX), inv.x),
+            std::copysign(std::min(std::abs(inv.y), MAX), inv.y),
+            std::copysign(std::min(std::abs(inv.z), MAX), inv.z)};
+}
+
+/// <summary>
+/// Ray against box slab test. invDir is 1 / direction per component. Returns
+/// the distance at which the ray enters the box, or +inf if it misses it or
+/// only enters it beyond tMax. Conservative, see SLAB_EXIT_SCALE.
+/// </summary>
+inline auto IntersectAabb(const glm::vec3& origin, const glm::vec3& invDir,
+                          const Aabb& box, float tMax) -> float
+{
+    const glm::vec3 t0 = (box.min - origin) * invDir;
+    const glm::vec3 t1 = (box.max - origin) * invDir;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+
+    const float tEnter = std::max(std::max(tNear.x, tNear.y),
+                                  std::max(tNear.z, 0.0f));
+    const float tExit =
+        std::min(std::min(std::min(tFar.x, tFar.y), tFar.z), tMax) *
+        SLAB_EXIT_SCALE;
+
+    return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+/// <summary>
+/// Bounding volume hierarchy over arbitrary primitives, which the BVH only
+/// knows by their bounding boxes and indices. Built top-down with a binned
+/// surface area heuristic, so tracing a ray costs O(log n) box tests rather
+/// than O(n) primitive tests. Large builds run in parallel: the top levels
+/// split each node with all threads, the subtrees below them are built as
+/// independent tasks.
+/// </summary>
+class Bvh
+{
+  public:
+    /// <summary>
+    /// Node storage, starting on a cache line.
+    /// </summary>
+    using NodeArray =
+        std::vector<BvhNode, utils::AlignedAllocator<BvhNode, 64>>;
+
+    Bvh() = default;
+
+    /// <summary>
+    /// Builds the hierarchy over primitives 0 .. primBounds.size() - 1,
+    /// replacing the previous one. The tree has the same shape and SAH cost
+    /// whatever the number of threads.
+    /// </summary>
+    /// <param name="pool">Pool to build with. If null, a pool of
+    /// options.threadCount threads is started and joined for this build
+    /// alone, so callers that build repeatedly pass one of their
+    /// own.</param>
+    /// <exception cref="std::invalid_argument">If the options are
+    /// invalid, e.g. fewer than 2 bins.</exception>
+    auto Build(std::span<const Aabb> primBounds,
+               const BvhBuildOptions& options = {}, TaskPool* pool = nullptr)
+        -> void;
+
+    /// <summary>
+    /// Recomputes the bounds of every node bottom-up after primitives moved,
+    /// keeping the topology of the tree. Far cheaper than Build(), but the
+    /// tree degrades as primitives drift away from where it was built for;
+    /// the updated SAH cost is in GetStats().
+    /// </summary>
+    /// <param name="primBounds">New bounds of the primitives the tree was
+    /// built over.</param>
+    /// <param name="pool">Pool to refit with. If null, a pool of
+    /// BvhBuildOptions::threadCount threads is started and joined for
+    /// this refit alone if the tree is large, so callers that refit every
+    /// frame pass one of their own.</param>
+    /// <exception cref="std::invalid_argument">If the number of primitives
+    /// changed.</exception>
+    auto Refit(std::span<const Aabb> primBounds, TaskPool* pool = nullptr)
+        -> void;
+
+    /// <summary>
+    /// Refits the tree, then rebuilds it with the options of the last build
+    /// if GetSahDegradation() has crossed
+    /// BvhBuildOptions::maxSahDegradation. Returns whether it rebuilt.
+    /// </summary>
+    auto Update(std::span<const Aabb> primBounds, TaskPool* pool = nullptr)
+        -> bool;
+
+    /// <summary>
+    /// Adopts a finished tree in place of a build, e.g. one read back from
+    /// a scene cache. nodes, primIndices and stats must be what GetNodes(),
+    /// GetPrimIndices() and GetStats() returned for a tree built with
+    /// options; it counts as freshly built for GetSahDegradation().
+    /// </summary>
+    auto Assign(NodeArray nodes, std::vector<uint32_t> primIndices,
+                const BvhBuildOptions& options, const BvhStats& stats)
+        -> void;
+
+    /// <summary>
+    /// Whether the tree is safe to traverse and refit over primCount
+    /// primitives: every node is reached exactly once from the root, right
+    /// children lie after their left siblings, leaves reference ranges of
+    /// GetPrimIndices(), every index is below primCount and no path is
+    /// deeper than traversal allows. Build() always makes such a tree; a
+    /// tree from Assign() is checked with this first.
+    /// </summary>
+    auto IsValid(uint32_t primCount) const -> bool;
+
+    auto Clear() -> void;
+
+    auto IsEmpty() const noexcept -> bool
+    {
+        return m_nodes.empty();
+    }
+
+    auto GetNodes() const noexcept -> const NodeArray&
+    {
+        return m_nodes;
+    }
+
+    /// <summary>
+    /// Primitive indices in leaf order. Leaves reference ranges of this.
+    /// </summary>
+    auto GetPrimIndices() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_primIndices;
+    }
+
+    /// <summary>
+    /// Options of the last build, which Update() rebuilds with.
+    /// </summary>
+    auto GetOptions() const noexcept -> const BvhBuildOptions&
+    {
+        return m_options;
+    }
+
+    auto GetBounds() const -> Aabb
+    {
+        return m_nodes.empty() ? Aabb{} : m_nodes[ROOT].bounds;
+    }
+
+    auto GetStats() const noexcept -> const BvhStats&
+    {
+        return m_stats;
+    }
+
+    /// <summary>
+    /// SAH cost of the current tree (see BvhStats::sahCost).
+    /// </summary>
+    auto ComputeSahCost() const -> float;
+
+    /// <summary>
+    /// Current SAH cost relative to the cost right after the last build,
+    /// i.e. 1 for a fresh tree and growing as refits degrade it.
+    /// </summary>
+    auto GetSahDegradation() const noexcept -> float
+    {
+        return m_builtSahCost > 0.0f ? m_stats.sahCost / m_builtSahCost
+                                     : 1.0f;
+    }
+
+    /// <summary>
+    /// Finds the closest intersection along r. Calls
+    /// intersect(primIdx, tMax) -> bool for every primitive in a leaf the
+    /// ray reaches; it must return true and lower tMax when it finds a
+    /// closer hit. Children are visited near to far so tMax shrinks early
+    /// and culls the rest of the tree.
+    /// </summary>
+    template <typename IntersectFn>
+    auto Intersect(const ray& r, float& tMax, IntersectFn&& intersect) const
+        -> bool;
+
+  private:
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t MAX_STACK_DEPTH = 64;
+
+    NodeArray m_nodes;
+    std::vector<uint32_t> m_primIndices;
+    BvhBuildOptions m_options;
+    BvhStats m_stats;
+    float m_builtSahCost = 0.0f;
+};
+
+template <typename IntersectFn>
+auto Bvh::Intersect(const ray& r, float& tMax, IntersectFn&& intersect) const
+    -> bool
+{
+    if (m_nodes.empty())
+        return false;
+
+    const glm::vec3& origin = r.origin();
+    const glm::vec3 invDir = SlabInverseDirection(r.direction());
+
+    if (IntersectAabb(origin, invDir, m_nodes[ROOT].bounds, tMax) ==
+        std::numeric_limits<float>::infinity())
+    {
+        return false;
+    }
+
+    bool hit = false;
+    uint32_t stack[MAX_STACK_DEPTH];
+    uint32_t stackSize = 0;
+    uint32_t nodeIdx = ROOT;
+    while (true)
+    {
+        const BvhNode& node = m_nodes[nodeIdx];
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = 0; i < node.primCount; ++i)
+            {
+                hit |= intersect(m_primIndices[node.offset + i], tMax);
+            }
+        }
+        else
+        {
+            float tLeft = IntersectAabb(origin, invDir,
+                                        m_nodes[nodeIdx + 1].bounds, tMax);
+            float tRight = IntersectAabb(origin, invDir,
+                                         m_nodes[node.offset].bounds, tMax);
+            uint32_t nearChild = nodeIdx + 1;
+            uint32_t farChild = node.offset;
+            if (tRight < tLeft)
+            {
+                std::swap(tLeft, tRight);
+                std::swap(nearChild, farChild);
+            }
+
+            if (tLeft != std::numeric_limits<float>::infinity())
+            {
+                // Visit the nearer child now, come back for the other one
+                if (tRight != std::numeric_limits<float>::infinity())
+                    stack[stackSize++] = farChild;
+                nodeIdx = nearChild;
+                continue;
+            }
+        }
+
+        // Pop until we find a node that is still in front of the closest hit
+        bool found = false;
+        while (stackSize > 0)
+        {
+            nodeIdx = stack[--stackSize];
+            if (IntersectAabb(origin, invDir, m_nodes[nodeIdx].bounds,
+                              tMax) != std::numeric_limits<float>::infinity())
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return hit;
+    }
+}
+
+} // namespace pathtracer
+
+#endif // BVH_H
@@ -0,0 +1,396 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "ray/ray.h"
+#include "utils/aligned_allocator.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// A node with up to N children whose bounds are stored as structure of
+/// arrays, so one SIMD slab test covers all of them. A child with
+/// primCount == 0 is the interior node at index child; otherwise it is a
+/// leaf referencing primCount entries of WideBvh::GetPrimIndices() starting
+/// at child. Unused slots have an empty box at +inf that every ray misses.
+/// </summary>
+template <size_t N> struct alignas(64) WideBvhNode
+{
+    float minX[N];
+    float minY[N];
+    float minZ[N];
+    float maxX[N];
+    float maxY[N];
+    float maxZ[N];
+    uint32_t child[N];
+    uint32_t primCount[N];
+
+    auto GetChildBounds(size_t i) const -> Aabb
+    {
+        return {{minX[i], minY[i], minZ[i]}, {maxX[i], maxY[i], maxZ[i]}};
+    }
+
+    auto SetChildBounds(size_t i, const Aabb& bounds) -> void
+    {
+        minX[i] = bounds.min.x;
+        minY[i] = bounds.min.y;
+        minZ[i] = bounds.min.z;
+        maxX[i] = bounds.max.x;
+        maxY[i] = bounds.max.y;
+        maxZ[i] = bounds.max.z;
+    }
+};
+
+/// <summary>
+/// Ray against all N child boxes of a node at once, written branch-free so
+/// the loops compile to SIMD. Same test as IntersectAabb(): tEnter[i] is the
+/// distance at which the ray enters child i, or +inf if it misses it.
+/// </summary>
+template <size_t N>
+inline auto IntersectChildren(const WideBvhNode<N>& node,
+                              const glm::vec3& origin,
+                              const glm::vec3& invDir, float tMax,
+                              float (&tEnter)[N]) -> void
+{
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < N; ++i)
+    {
+        const float tx0 = (node.minX[i] - origin.x) * invDir.x;
+        const float tx1 = (node.maxX[i] - origin.x) * invDir.x;
+        const float ty0 = (node.minY[i] - origin.y) * invDir.y;
+        const float ty1 = (node.maxY[i] - origin.y) * invDir.y;
+        const float tz0 = (node.minZ[i] - origin.z) * invDir.z;
+        const float tz1 = (node.maxZ[i] - origin.z) * invDir.z;
+
+        const float tIn = std::max(
+            std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+            std::max(std::min(tz0, tz1), 0.0f));
+        const float tOut =
+            std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                     std::min(std::max(tz0, tz1), tMax)) *
+            SLAB_EXIT_SCALE;
+        tEnter[i] = tIn <= tOut ? tIn : INF;
+    }
+}
+
+/// <summary>
+/// N-wide BVH collapsed from a binary Bvh. Every node tests all of its
+/// children with one SIMD slab test, so a ray takes about log2(N) times
+/// fewer traversal steps and cache misses than in the binary tree, which
+/// pays off most for incoherent rays.
+/// </summary>
+template <size_t N> class WideBvh
+{
+    static_assert(N == 4 || N == 8, "Wide BVHs are 4 or 8 wide");
+
+  public:
+    using Node = WideBvhNode<N>;
+    using NodeArray = std::vector<Node, utils::AlignedAllocator<Node, 64>>;
+
+    static constexpr size_t WIDTH = N;
+
+    WideBvh() = default;
+
+    /// <summary>
+    /// Collapses bvh into this tree, replacing the previous one. Each node
+    /// takes the children of its binary counterpart and repeatedly replaces
+    /// the interior child with the largest surface area by that child's two
+    /// children until it has N. Leaves and primitive indices are kept.
+    /// </summary>
+    auto Build(const Bvh& bvh) -> void;
+
+    /// <summary>
+    /// Adopts a finished tree in place of a build, e.g. one read back from
+    /// a scene cache: what GetNodes() and GetPrimIndices() returned.
+    /// </summary>
+    auto Assign(NodeArray nodes, std::vector<uint32_t> primIndices) -> void;
+
+    /// <summary>
+    /// Whether the tree is safe to traverse: every node is reached exactly
+    /// once from the root through children with higher indices, unused
+    /// slots are the empty boxes Build() leaves, no path is deeper than
+    /// traversal allows and isValidLeaf(first, count) -> bool holds for
+    /// every leaf. Primitive indices are not checked, see Bvh::IsValid().
+    /// </summary>
+    template <typename LeafFn>
+    auto IsValid(LeafFn&& isValidLeaf) const -> bool;
+
+    auto Clear() -> void;
+
+    auto IsEmpty() const noexcept -> bool
+    {
+        return m_nodes.empty();
+    }
+
+    auto GetNodes() const noexcept -> const NodeArray&
+    {
+        return m_nodes;
+    }
+
+    /// <summary>
+    /// Primitive indices in leaf order. Leaves reference ranges of this.
+    /// </summary>
+    auto GetPrimIndices() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_primIndices;
+    }
+
+    /// <summary>
+    /// Finds the closest intersection along r, with the same contract as
+    /// Bvh::Intersect(). Hit children are visited nearest first.
+    /// </summary>
+    template <typename IntersectFn>
+    auto Intersect(const ray& r, float& tMax, IntersectFn&& intersect) const
+        -> bool;
+
+    /// <summary>
+    /// Like Intersect(), but hands whole leaves to
+    /// leafFn(uint32_t first, uint32_t count, float& tMax) -> bool, so that
+    /// kernels can test several primitives per call. first and count are the
+    /// leaf's range of GetPrimIndices(), or whatever RemapLeaves() made of
+    /// it.
+    /// </summary>
+    template <typename LeafFn>
+    auto IntersectLeaves(const ray& r, float& tMax, LeafFn&& leafFn) const
+        -> bool;
+
+    /// <summary>
+    /// Any-hit counterpart of IntersectLeaves(), for shadow rays: whether
+    /// leafFn(uint32_t first, uint32_t count, float tMax) -> bool reports a
+    /// hit before tMax in any leaf the ray reaches. Returns at the first
+    /// such leaf, and children are not sorted, since no closer hit has to
+    /// be found.
+    /// </summary>
+    template <typename LeafFn>
+    auto IsOccluded(const ray& r, float tMax, LeafFn&& leafFn) const
+        -> bool;
+
+    /// <summary>
+    /// Replaces the first index of every leaf by remap(first, count), e.g.
+    /// to point leaves at primitives packed in leaf order instead of at
+    /// GetPrimIndices(). Afterwards only IntersectLeaves() is meaningful.
+    /// </summary>
+    template <typename RemapFn> auto RemapLeaves(RemapFn&& remap) -> void
+    {
+        for (Node& node : m_nodes)
+        {
+            for (uint32_t i = 0; i < N; ++i)
+            {
+                if (node.primCount[i] > 0)
+                    node.child[i] = remap(node.child[i], node.primCount[i]);
+            }
+        }
+    }
+
+  private:
+    static constexpr uint32_t ROOT = 0;
+
+    /// <summary>
+    /// A wide node is never deeper than its binary counterpart, whose depth
+    /// is capped at 64, and each level leaves at most N - 1 children on the
+    /// stack.
+    /// </summary>
+    static constexpr uint32_t MAX_STACK_SIZE = 64 * N;
+
+    NodeArray m_nodes;
+    std::vector<uint32_t> m_primIndices;
+};
+
+using Bvh4 = WideBvh<4>;
+using Bvh8 = WideBvh<8>;
+
+extern template class WideBvh<4>;
+extern template class WideBvh<8>;
+
+template <size_t N>
+template <typename IntersectFn>
+auto WideBvh<N>::Intersect(const ray& r, float& tMax,
+                           IntersectFn&& intersect) const -> bool
+{
+    return IntersectLeaves(
+        r, tMax,
+        [&](uint32_t first, uint32_t count, float& tClosest) -> bool
+        {
+            bool hit = false;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                hit |= intersect(m_primIndices[first + i], tClosest);
+            }
+            return hit;
+        });
+}
+
+template <size_t N>
+template <typename LeafFn>
+auto WideBvh<N>::IsOccluded(const ray& r, float tMax, LeafFn&& leafFn) const
+    -> bool
+{
+    if (m_nodes.empty())
+        return false;
+
+    const glm::vec3& origin = r.origin();
+    const glm::vec3 invDir = SlabInverseDirection(r.direction());
+
+    // Only interior children wait on the stack, leaves are tested at once
+    uint32_t stack[MAX_STACK_SIZE];
+    uint32_t stackSize = 0;
+
+    uint32_t nodeIdx = ROOT;
+    while (true)
+    {
+        const Node& node = m_nodes[nodeIdx];
+        float tEnter[N];
+        IntersectChildren(node, origin, invDir, tMax, tEnter);
+
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (tEnter[i] == std::numeric_limits<float>::infinity())
+                continue;
+            if (node.primCount[i] == 0)
+                stack[stackSize++] = node.child[i];
+            else if (leafFn(node.child[i], node.primCount[i], tMax))
+                return true;
+        }
+
+        if (stackSize == 0)
+            return false;
+        nodeIdx = stack[--stackSize];
+    }
+}
+
+template <size_t N>
+template <typename LeafFn>
+auto WideBvh<N>::IsValid(LeafFn&& isValidLeaf) const -> bool
+{
+    if (m_nodes.empty())
+        return true;
+
+    struct Entry
+    {
+        uint32_t nodeIdx;
+        uint32_t depth;
+    };
+    const auto nodeCount = static_cast<uint32_t>(m_nodes.size());
+    std::vector<bool> reached(nodeCount, false);
+    std::vector<Entry> work{{ROOT, 1}};
+    uint32_t reachedCount = 0;
+    while (!work.empty())
+    {
+        const Entry entry = work.back();
+        work.pop_back();
+        if (reached[entry.nodeIdx])
+            return false;
+        reached[entry.nodeIdx] = true;
+        ++reachedCount;
+
+        const Node& node = m_nodes[entry.nodeIdx];
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (node.primCount[i] > 0)
+            {
+                if (!isValidLeaf(node.child[i], node.primCount[i]))
+                    return false;
+                continue;
+            }
+
+            // Interior children always come after their parent, so child
+            // 0 marks an unused slot
+            if (node.child[i] == ROOT)
+            {
+                constexpr float INF = std::numeric_limits<float>::infinity();
+                if (node.minX[i] != INF || node.maxX[i] != INF)
+                    return false;
+                continue;
+            }
+            if (entry.depth >= MAX_STACK_SIZE / N ||
+                node.child[i] <= entry.nodeIdx || node.child[i] >= nodeCount)
+            {
+                return false;
+            }
+            work.push_back({node.child[i], entry.depth + 1});
+        }
+    }
+    return reachedCount == nodeCount;
+}
+
+template <size_t N>
+template <typename LeafFn>
+auto WideBvh<N>::IntersectLeaves(const ray& r, float& tMax,
+                                 LeafFn&& leafFn) const -> bool
+{
+    if (m_nodes.empty())
+        return false;
+
+    const glm::vec3& origin = r.origin();
+    const glm::vec3 invDir = SlabInverseDirection(r.direction());
+
+    // Children that still have to be visited, with the distance at which
+    // the ray enters them. Kept sorted far to near within each node's
+    // batch, so the nearest child is always on top.
+    struct StackEntry
+    {
+        uint32_t child;
+        uint32_t primCount;
+        float tEnter;
+    };
+    StackEntry stack[MAX_STACK_SIZE];
+    uint32_t stackSize = 0;
+
+    bool hit = false;
+    uint32_t nodeIdx = ROOT;
+    while (true)
+    {
+        const Node& node = m_nodes[nodeIdx];
+        float tEnter[N];
+        IntersectChildren(node, origin, invDir, tMax, tEnter);
+
+        const uint32_t batch = stackSize;
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (tEnter[i] == std::numeric_limits<float>::infinity())
+                continue;
+
+            // Insertion sort, N is small
+            uint32_t pos = stackSize++;
+            while (pos > batch && stack[pos - 1].tEnter < tEnter[i])
+            {
+                stack[pos] = stack[pos - 1];
+                --pos;
+            }
+            stack[pos] = {node.child[i], node.primCount[i], tEnter[i]};
+        }
+
+        // Pop until we find an interior node that is still in front of the
+        // closest hit, intersecting leaves on the way
+        bool found = false;
+        while (stackSize > 0)
+        {
+            const StackEntry entry = stack[--stackSize];
+            if (entry.tEnter > tMax * SLAB_EXIT_SCALE)
+                continue;
+
+            if (entry.primCount == 0)
+            {
+                nodeIdx = entry.child;
+                found = true;
+                break;
+            }
+            hit |= leafFn(entry.child, entry.primCount, tMax);
+        }
+        if (!found)
+            return hit;
+    }
+}
+
+} // namespace pathtracer
+
+#endif // WIDE_BVH_H
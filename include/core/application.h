@@ -3,6 +3,7 @@
 
 #include "platform/windows_fwd.h"
 #include "scene/camera.h"
+#include "scene/scene.h"
 
 #include <chrono>
 #include <glm/glm.hpp>
@@ -18,6 +19,22 @@ class Renderer;
 
 namespace pathtracer
 {
+/// <summary>
+/// Which path tracer draws the window's image.
+/// </summary>
+enum class RendererKind
+{
+    /// <summary>
+    /// compute.hlsl on the GPU.
+    /// </summary>
+    Compute,
+
+    /// <summary>
+    /// The portable CpuPathtracer, uploaded through a FramebufferPresenter.
+    /// </summary>
+    Cpu,
+};
+
 class Application
 {
   public:
@@ -31,7 +48,8 @@ class Application
     /// <para>- Handle cleanup on exit</para>
     /// <para>- Propagate exceptions with meaningful messages</para>
     /// </summary>
-    Application(const UINT width = 960, const UINT height = 540,
+    Application(const RendererKind rendererKind = RendererKind::Compute,
+                const UINT width = 960, const UINT height = 540,
                 LPCTSTR window_title = TEXT("DX12 Path Tracer"));
     ~Application();
 
@@ -45,6 +63,7 @@ class Application
     /// <para></para>
     /// Main loop structure:
     /// <para>- Process Windows messages</para>
+    /// <para>- Wait for messages while the image has converged</para>
     /// <para>- Update scene/camera</para>
     /// <para>- Render frame</para>
     /// <para>- Present to swap chain</para>
@@ -92,17 +111,21 @@ class Application
     std::unique_ptr<Window> m_window;
     std::unique_ptr<DX12Device> m_device;
     std::unique_ptr<Renderer> m_renderer;
+    RendererKind m_rendererKind;
     bool m_isRunning = false;
     UINT m_width = 0;
     UINT m_height = 0;
     LPCTSTR m_title;
     std::unique_ptr<Camera> m_camera;
+    std::unique_ptr<Scene> m_scene;
     float m_aspectRatio;
     static constexpr float m_NEAR_PLANE = 0.1f;
     static constexpr float m_FAR_PLANE = 1000.0f;
     static constexpr float m_CAMERA_FOV = glm::radians(60.0f);
     static constexpr float m_ROTATE_SPEED = 0.005f; // radians per pixel
     static constexpr float m_ZOOM_SENSITIVITY = 0.5f;
+    // Relative error at which the CPU path tracer stops sampling a pixel
+    static constexpr float m_ADAPTIVE_THRESHOLD = 0.01f;
 
     // Performance tracking
     std::chrono::high_resolution_clock::time_point m_lastFrameTime;
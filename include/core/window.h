@@ -33,6 +33,12 @@ class Window
     /// <returns>false if WM_QUIT received, true otherwise</returns>
     auto ProcessMessages() -> bool;
 
+    /// <summary>
+    /// Blocks until the window has messages to process, without using the
+    /// CPU while it waits.
+    /// </summary>
+    auto WaitForMessages() const -> void;
+
     /// <summary>
     /// Returns the window handle for DX12 swap chain creation.
     /// </summary>
@@ -0,0 +1,168 @@
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Progressive accumulation storage: a float32 running sum of radiance and a
+/// sample count per pixel. Renderers add one (or more) samples per pixel each
+/// frame and display the mean, so a static view keeps converging instead of
+/// throwing away the work of previous frames.
+/// <para></para>
+/// Each pixel also keeps the sum of its squared sample luminances, from
+/// which GetRelativeError() estimates how far the mean still is from
+/// converged, to steer adaptive sampling.
+/// <para></para>
+/// Pixels are independent, so different threads may add samples to different
+/// pixels concurrently.
+/// </summary>
+class AccumulationBuffer
+{
+  public:
+    AccumulationBuffer() = default;
+
+    AccumulationBuffer(uint32_t width, uint32_t height)
+    {
+        Resize(width, height);
+    }
+
+    /// <summary>
+    /// Resizes the buffer. This always resets the accumulated samples.
+    /// </summary>
+    auto Resize(uint32_t width, uint32_t height) -> void;
+
+    /// <summary>
+    /// Discards all accumulated samples. Call when the camera or the scene
+    /// changes.
+    /// </summary>
+    auto Reset() -> void;
+
+    /// <summary>
+    /// Adds a radiance sample to pixel (x, y) and returns the new mean.
+    /// </summary>
+    auto AddSample(uint32_t x, uint32_t y, const glm::vec3& radiance)
+        -> glm::vec3
+    {
+        const size_t idx = Index(x, y);
+        const float luminance = Luminance(radiance);
+        m_sum[idx] += radiance;
+        m_luminanceSqSum[idx] += luminance * luminance;
+        return m_sum[idx] / static_cast<float>(++m_sampleCount[idx]);
+    }
+
+    /// <summary>
+    /// Returns the mean radiance of pixel (x, y), or black if the pixel has
+    /// no samples yet.
+    /// </summary>
+    auto Resolve(uint32_t x, uint32_t y) const -> glm::vec3
+    {
+        const size_t idx = Index(x, y);
+        return m_sampleCount[idx] > 0
+                   ? m_sum[idx] / static_cast<float>(m_sampleCount[idx])
+                   : glm::vec3{0.0f};
+    }
+
+    auto GetSum(uint32_t x, uint32_t y) const -> const glm::vec3&
+    {
+        return m_sum[Index(x, y)];
+    }
+
+    auto GetSampleCount(uint32_t x, uint32_t y) const -> uint32_t
+    {
+        return m_sampleCount[Index(x, y)];
+    }
+
+    /// <summary>
+    /// Returns pointers to the first radiance sum and sample count of row
+    /// y, for passes over whole rows.
+    /// </summary>
+    auto GetSumRow(uint32_t y) const noexcept -> const glm::vec3*
+    {
+        return m_sum.data() + static_cast<size_t>(y) * m_width;
+    }
+
+    auto GetSampleCountRow(uint32_t y) const noexcept -> const uint32_t*
+    {
+        return m_sampleCount.data() + static_cast<size_t>(y) * m_width;
+    }
+
+    auto GetLuminanceSqSum(uint32_t x, uint32_t y) const -> float
+    {
+        return m_luminanceSqSum[Index(x, y)];
+    }
+
+    /// <summary>
+    /// Replaces the samples of pixel (x, y), e.g. with those of a surface
+    /// reprojected from another view, or with none.
+    /// </summary>
+    auto SetPixel(uint32_t x, uint32_t y, const glm::vec3& sum,
+                  float luminanceSqSum, uint32_t sampleCount) -> void
+    {
+        const size_t idx = Index(x, y);
+        m_sum[idx] = sum;
+        m_luminanceSqSum[idx] = luminanceSqSum;
+        m_sampleCount[idx] = sampleCount;
+    }
+
+    /// <summary>
+    /// Estimated relative error of the mean of pixel (x, y): the standard
+    /// error of its sample luminances over their mean. Dark pixels are
+    /// measured against a floor of MIN_LUMINANCE instead, so noise that
+    /// would not be visible does not keep them from converging. Pixels
+    /// with fewer than 2 samples have no estimate and return infinity.
+    /// </summary>
+    auto GetRelativeError(uint32_t x, uint32_t y) const -> float;
+
+    auto GetWidth() const noexcept -> uint32_t
+    {
+        return m_width;
+    }
+
+    auto GetHeight() const noexcept -> uint32_t
+    {
+        return m_height;
+    }
+
+    /// <summary>
+    /// Number of times Reset() (or Resize()) has been called. Lets callers
+    /// detect that history they hold on to has been invalidated.
+    /// </summary>
+    auto GetResetCount() const noexcept -> uint64_t
+    {
+        return m_resetCount;
+    }
+
+    /// <summary>
+    /// Mean luminance below which GetRelativeError() measures the error
+    /// against this floor instead.
+    /// </summary>
+    static constexpr float MIN_LUMINANCE = 1.0f / 64.0f;
+
+  private:
+    static auto Luminance(const glm::vec3& c) -> float
+    {
+        return glm::dot(c, glm::vec3{0.2126f, 0.7152f, 0.0722f});
+    }
+
+    auto Index(uint32_t x, uint32_t y) const -> size_t
+    {
+        return static_cast<size_t>(y) * m_width + x;
+    }
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint64_t m_resetCount = 0;
+    std::vector<glm::vec3> m_sum;
+    std::vector<float> m_luminanceSqSum;
+    std::vector<uint32_t> m_sampleCount;
+};
+
+} // namespace pathtracer
+
+#endif // ACCUMULATION_BUFFER_H
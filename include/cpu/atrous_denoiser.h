@@ -0,0 +1,118 @@
+#pragma once
+
+#include "cpu/accumulation_buffer.h"
+#include "cpu/feature_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/tile_scheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Strength of AtrousDenoiser's filter. The phis are squared distances at
+/// which a neighbour's weight falls to 1/e: larger values blur across
+/// stronger differences.
+/// </summary>
+struct DenoiserSettings
+{
+    /// <summary>
+    /// Filter passes. Pass i spaces its 5x5 taps 2^i pixels apart, so 5
+    /// passes reach 62 pixels in each direction.
+    /// </summary>
+    uint32_t iterations = 5;
+
+    /// <summary>
+    /// For the illumination; halved every pass, as the noise the filter
+    /// has already removed no longer needs to be bridged.
+    /// </summary>
+    float colorPhi = 1.0f;
+    float normalPhi = 0.1f;
+
+    /// <summary>
+    /// For the relative difference in depth per pixel of tap spacing.
+    /// </summary>
+    float depthPhi = 0.1f;
+};
+
+/// <summary>
+/// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010) over the
+/// mean radiance of an AccumulationBuffer, guided by the albedo, normal and
+/// depth of a FeatureBuffer. The radiance is divided by the albedo first
+/// and multiplied back after filtering, so material edges and textures stay
+/// sharp while the illumination is smoothed. Each pass is a 5x5 B3-spline
+/// blur whose taps are weighted down where the illumination, normal or
+/// depth differ from the center pixel's.
+/// <para></para>
+/// The image is held as planes of floats. Every pass runs on the tiles of a
+/// TileScheduler, and for each tap a straight loop over the pixels of a
+/// tile row, which the compiler vectorizes like the packet types.
+/// </summary>
+class AtrousDenoiser
+{
+  public:
+    AtrousDenoiser() = default;
+
+    auto SetSettings(const DenoiserSettings& settings) noexcept -> void
+    {
+        m_settings = settings;
+    }
+
+    auto GetSettings() const noexcept -> const DenoiserSettings&
+    {
+        return m_settings;
+    }
+
+    /// <summary>
+    /// Writes the filtered mean radiance of accumulation into framebuffer.
+    /// All three must be the same size. Blocks until every pass is done.
+    /// </summary>
+    auto Denoise(const AccumulationBuffer& accumulation,
+                 const FeatureBuffer& features, Framebuffer& framebuffer,
+                 TileScheduler& scheduler) -> void;
+
+    /// <summary>
+    /// Wall time of the last Denoise() in milliseconds.
+    /// </summary>
+    auto GetLastRunMs() const noexcept -> double
+    {
+        return m_lastRunMs;
+    }
+
+  private:
+    struct Vec3Planes
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+    };
+
+    auto Resize(uint32_t width, uint32_t height, uint32_t threadCount,
+                uint32_t tileSize) -> void;
+
+    /// <summary>
+    /// Runs the pass with taps step pixels apart on the rows of tile, from
+    /// src into dst, with the accumulators of render thread threadIdx.
+    /// </summary>
+    auto FilterTile(const Tile& tile, uint32_t step, float colorPhi,
+                    const Vec3Planes& src, Vec3Planes& dst,
+                    uint32_t threadIdx) -> void;
+
+    DenoiserSettings m_settings;
+    double m_lastRunMs = 0.0;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+
+    // Illumination, filtered back and forth between the two
+    Vec3Planes m_illumination[2];
+
+    Vec3Planes m_albedo;
+    Vec3Planes m_normal;
+    std::vector<float> m_depth;
+
+    // Per render thread: weight and r, g, b sums of a tile row
+    std::vector<std::vector<float>> m_rowSums;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "cpu/framebuffer.h"
+#include "cpu/tile_scheduler.h"
+#include "interfaces/frame_renderer_interface.h"
+#include "rendering/frame_gpu_data.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// CPU emulation of the compute.hlsl kernel. Runs CSMain once per pixel with
+/// the same constant buffers, UAV layout and arithmetic as the GPU, so the
+/// kernel's behaviour (including progressive accumulation) can be checked
+/// and profiled on machines without a DX12 device.
+/// <para></para>
+/// Scheduler tiles run the 8x8 thread groups of the GPU dispatch that start
+/// inside them.
+/// </summary>
+class ComputeKernelEmulator : public IFrameRenderer
+{
+  public:
+    /// <summary>
+    /// Matches [numthreads(8, 8, 1)] in compute.hlsl.
+    /// </summary>
+    static constexpr uint32_t THREAD_GROUP_SIZE = 8;
+
+    /// <summary>
+    /// Constructs the emulator.
+    /// </summary>
+    /// <param name="width">The initial width of the output texture.</param>
+    /// <param name="height">The initial height of the output texture.</param>
+    /// <param name="threadCount">Number of CPU threads, 0 uses every
+    /// hardware thread.</param>
+    ComputeKernelEmulator(uint32_t width, uint32_t height,
+                          uint32_t threadCount = 0);
+
+    /// <summary>
+    /// Uploads the camera and frame constants and dispatches the kernel over
+    /// the whole framebuffer, which plays the role of OutputTexture (u0).
+    /// Like the kernel, it renders the built-in test scene and only looks at
+    /// the change flags of scene.
+    /// </summary>
+    auto Render(Framebuffer& framebuffer, const Camera& camera,
+                const uint32_t frameIdx, const Scene& scene) -> void override;
+
+    /// <summary>
+    /// Recreates the accumulation texture for the new size.
+    /// </summary>
+    auto Resize(const uint32_t width, const uint32_t height) -> void override;
+
+    auto GetName() const -> const char* override
+    {
+        return "Compute Kernel Emulator";
+    }
+
+    /// <summary>
+    /// Sets resetAccumulation in the next frame's constants.
+    /// </summary>
+    auto ResetAccumulation() -> void override
+    {
+        m_resetPending = true;
+    }
+
+    auto GetScheduler() noexcept -> TileScheduler&
+    {
+        return m_scheduler;
+    }
+
+  private:
+    /// <summary>
+    /// Port of CSMain. DTid is SV_DispatchThreadID.
+    /// </summary>
+    auto CSMain(const glm::uvec2& DTid, Framebuffer& outputTexture) -> void;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    TileScheduler m_scheduler;
+
+    // cbuffer CameraData (b0) and cbuffer FrameData (b1)
+    CameraGPUData m_cameraData{};
+    FrameGPUData m_frameData{};
+    uint32_t m_frameCounter = 0;
+    bool m_resetPending = true;
+
+    // AccumulationTexture (u1): rgb = running sum, a = sample count
+    std::vector<glm::vec4> m_accumulationTexture;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,766 @@
+#pragma once
+
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "cpu/accumulation_buffer.h"
+#include "cpu/atrous_denoiser.h"
+#include "cpu/feature_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/instance_bvh.h"
+#include "cpu/light_sampler.h"
+#include "cpu/path_queue.h"
+#include "cpu/ray_sorter.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "cpu/tile_scheduler.h"
+#include "interfaces/frame_renderer_interface.h"
+#include "interfaces/sampler_interface.h"
+#include "ray/ray.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// How CpuPathtracer computes the radiance of a pixel sample.
+/// </summary>
+enum class Integrator
+{
+    /// <summary>
+    /// Primary rays only, shaded by normal and tinted by albedo, as
+    /// compute.hlsl does.
+    /// </summary>
+    Preview,
+
+    /// <summary>
+    /// Path tracing over diffuse surfaces that finds emitters only when a
+    /// cosine-sampled bounce happens to hit one.
+    /// </summary>
+    Naive,
+
+    /// <summary>
+    /// Path tracing that also samples a point on a light with a shadow ray
+    /// at every bounce (next-event estimation) and weights light and bounce
+    /// samples that reach an emitter by the power heuristic.
+    /// </summary>
+    NextEvent,
+};
+
+/// <summary>
+/// How CpuPathtracer schedules the work of the path tracing integrators.
+/// Both trace the same paths with the same samples and produce the same
+/// image.
+/// </summary>
+enum class ExecutionMode
+{
+    /// <summary>
+    /// Each pixel's path is traced to its end before the next pixel's.
+    /// </summary>
+    PerPath,
+
+    /// <summary>
+    /// The paths of a whole tile advance together one bounce at a time
+    /// through queues of path states: generate, then shade, shadow and
+    /// extend until every path ended, then accumulate. Finished paths are
+    /// compacted out after each bounce, so each stage runs one tight loop
+    /// over the live paths only.
+    /// </summary>
+    Wavefront,
+};
+
+/// <summary>
+/// Rays the last CpuPathtracer::Render() traced, by path depth: rays[0]
+/// are the camera rays, rays[d] the bounce rays that extended paths to
+/// depth d, and shadowRays[d] the rays towards lights from vertices at
+/// depth d.
+/// </summary>
+struct PathDepthStats
+{
+    std::vector<uint64_t> rays;
+    std::vector<uint64_t> shadowRays;
+};
+
+class CpuPathtracer : public IFrameRenderer
+{
+  public:
+    /// <summary>
+    /// Number of horizontally adjacent pixels whose primary rays are traced
+    /// together as one RayPacket. 8 lanes fill an AVX2 register.
+    /// </summary>
+    static constexpr size_t PACKET_WIDTH = 8;
+
+    /// <summary>
+    /// Scenes with at most this many spheres are traced by testing whole
+    /// packets against every sphere; larger ones trace each ray through a
+    /// BVH8 over the spheres.
+    /// </summary>
+    static constexpr uint32_t PACKET_SPHERE_LIMIT = 8;
+
+    /// <summary>
+    /// Bounces after the primary hit that the path tracing integrators
+    /// follow at most by default. Russian roulette ends most paths long
+    /// before.
+    /// </summary>
+    static constexpr uint32_t DEFAULT_MAX_BOUNCES = 16;
+
+    /// <summary>
+    /// Bounces every path takes by default before Russian roulette may end
+    /// it.
+    /// </summary>
+    static constexpr uint32_t DEFAULT_ROULETTE_DEPTH = 3;
+
+    /// <summary>
+    /// Samples every pixel takes by default before adaptive sampling may
+    /// consider it converged; fewer give too rough a variance estimate.
+    /// </summary>
+    static constexpr uint32_t DEFAULT_ADAPTIVE_MIN_SAMPLES = 16;
+
+    /// <summary>
+    /// Samples of reprojected history a pixel keeps at most by default, so
+    /// that history blurred by reprojection is soon outweighed by samples
+    /// of the new view.
+    /// </summary>
+    static constexpr uint32_t DEFAULT_MAX_HISTORY = 32;
+
+    /// <summary>
+    /// With ray sorting on, a wavefront bounce is sorted while at least
+    /// 1/WAVEFRONT_SORT_DIVISOR of its tile's pixels still have a live path;
+    /// the few paths left after that are not worth a sort.
+    /// </summary>
+    static constexpr uint32_t WAVEFRONT_SORT_DIVISOR = 4;
+
+    /// <summary>
+    /// Constructs a CPU-based path tracer. This implementation is intended for
+    /// testing and debugging purposes, providing a reference implementation of
+    /// a path tracing algorithm. It has no dependency on DX12 and can be
+    /// presented in a window through a FramebufferPresenter or run headless.
+    /// </summary>
+    /// <param name="width">The initial width of the framebuffer.</param>
+    /// <param name="height">The initial height of the framebuffer.</param>
+    /// <param name="threadCount">Number of render threads, 0 uses every
+    /// hardware thread.</param>
+    /// <param name="tileSize">Edge length of a scheduler tile in
+    /// pixels.</param>
+    CpuPathtracer(uint32_t width, uint32_t height, uint32_t threadCount = 0,
+                  uint32_t tileSize = TileScheduler::DEFAULT_TILE_SIZE);
+    ~CpuPathtracer() = default;
+
+    /// <summary>
+    /// Renders the scene using the path tracing algorithm. This method should
+    /// be called every frame to update the framebuffer with the latest image.
+    /// Each call adds one jittered sample per pixel to the accumulation buffer
+    /// (only to the pixels that have not converged yet with adaptive
+    /// sampling) and writes the running mean; the accumulation is reset
+    /// first if the camera is dirty, the scene has changes or
+    /// ResetAccumulation() was called; with temporal reprojection on, a
+    /// moved camera reprojects it instead. Moved spheres or mesh vertices
+    /// refit the affected BVHs, added or removed primitives rebuild them.
+    /// Moved instances refit only the top-level BVH over the instances.
+    /// </summary>
+    /// <param name="framebuffer">The framebuffer to write the image to.</param>
+    /// <param name="camera">The camera defining the view for the current
+    /// frame.</param>
+    /// <param name="frameIdx">The index of the current frame.</param>
+    /// <param name="scene">The scene to render.</param>
+    auto Render(Framebuffer& framebuffer, const Camera& camera,
+                const uint32_t frameIdx, const Scene& scene) -> void override;
+
+    /// <summary>
+    /// Resizes internal resources to match the new width and height of the
+    /// output image.
+    /// </summary>
+    auto Resize(const uint32_t width, const uint32_t height) -> void override;
+
+    /// <summary>
+    /// Returns the name of the path tracer for display in the UI.
+    /// </summary>
+    auto GetName() const -> const char* override
+    {
+        return "CPU Path Tracer";
+    }
+
+    /// <summary>
+    /// Discards all accumulated samples before the next frame.
+    /// </summary>
+    auto ResetAccumulation() -> void override
+    {
+        m_resetPending = true;
+    }
+
+    /// <summary>
+    /// Whether adaptive sampling found every pixel converged in the last
+    /// frame, so further frames would not change the image until the
+    /// camera, the scene or the settings change. Always false with adaptive
+    /// sampling off.
+    /// </summary>
+    auto IsConverged() const -> bool override
+    {
+        return m_converged && !m_resetPending;
+    }
+
+    /// <summary>
+    /// Turns on adaptive sampling: pixels with at least minSamples samples
+    /// whose AccumulationBuffer::GetRelativeError() is at most threshold
+    /// get no further samples and keep their mean. A threshold of 0, the
+    /// default, samples every pixel every frame. Accumulated samples stay
+    /// valid.
+    /// </summary>
+    auto SetAdaptiveSampling(
+        float threshold,
+        uint32_t minSamples = DEFAULT_ADAPTIVE_MIN_SAMPLES) noexcept -> void
+    {
+        m_adaptiveThreshold = threshold;
+        m_adaptiveMinSamples = std::max(minSamples, 2u);
+        m_converged = false;
+    }
+
+    auto GetAdaptiveThreshold() const noexcept -> float
+    {
+        return m_adaptiveThreshold;
+    }
+
+    auto GetAdaptiveMinSamples() const noexcept -> uint32_t
+    {
+        return m_adaptiveMinSamples;
+    }
+
+    /// <summary>
+    /// Returns how many pixels still needed samples after the last frame;
+    /// with adaptive sampling off, every pixel.
+    /// </summary>
+    auto GetUnconvergedPixelCount() const noexcept -> uint64_t
+    {
+        return m_unconvergedPixels;
+    }
+
+    /// <summary>
+    /// Whether Render() also accumulates the albedo, normal and depth of
+    /// primary hits and writes the accumulation through the denoiser
+    /// rather than as is, off by default. The accumulated radiance itself
+    /// stays unfiltered. The denoiser's passes run on the scheduler after
+    /// the frame's tiles, so its thread statistics then describe the last
+    /// pass.
+    /// </summary>
+    auto SetDenoising(bool enabled) noexcept -> void
+    {
+        m_denoising = enabled;
+    }
+
+    auto GetDenoising() const noexcept -> bool
+    {
+        return m_denoising;
+    }
+
+    /// <summary>
+    /// Returns the denoiser, e.g. to change its settings or to read how
+    /// long the last frame's denoising took.
+    /// </summary>
+    auto GetDenoiser() noexcept -> AtrousDenoiser&
+    {
+        return m_denoiser;
+    }
+
+    auto GetDenoiser() const noexcept -> const AtrousDenoiser&
+    {
+        return m_denoiser;
+    }
+
+    auto GetFeatures() const noexcept -> const FeatureBuffer&
+    {
+        return m_features;
+    }
+
+    /// <summary>
+    /// Whether a moved camera keeps the accumulated samples, off by
+    /// default. Each pixel's samples are moved to where their surface
+    /// appears in the new view, nearest surface first; surfaces behind the
+    /// camera or facing away from it and the background are dropped. The
+    /// first new sample of a pixel must then hit the same surface, by depth
+    /// and normal, or its history is discarded as disoccluded. History
+    /// counts as at most maxHistory samples. Like denoising, this
+    /// accumulates the albedo, normal and depth of primary hits. Scene
+    /// changes still restart the accumulation.
+    /// </summary>
+    auto SetTemporalReprojection(
+        bool enabled, uint32_t maxHistory = DEFAULT_MAX_HISTORY) noexcept
+        -> void
+    {
+        m_reprojection = enabled;
+        m_maxHistory = std::max(maxHistory, 1u);
+    }
+
+    auto GetTemporalReprojection() const noexcept -> bool
+    {
+        return m_reprojection;
+    }
+
+    auto GetMaxHistory() const noexcept -> uint32_t
+    {
+        return m_maxHistory;
+    }
+
+    /// <summary>
+    /// Selects the integrator; accumulation restarts with the next frame.
+    /// </summary>
+    auto SetIntegrator(Integrator integrator) -> void
+    {
+        m_integrator = integrator;
+        m_resetPending = true;
+    }
+
+    auto GetIntegrator() const noexcept -> Integrator
+    {
+        return m_integrator;
+    }
+
+    /// <summary>
+    /// Sets the number of bounces paths follow after the primary hit;
+    /// accumulation restarts with the next frame.
+    /// </summary>
+    auto SetMaxBounces(uint32_t maxBounces) -> void
+    {
+        m_maxBounces = maxBounces;
+        m_resetPending = true;
+    }
+
+    auto GetMaxBounces() const noexcept -> uint32_t
+    {
+        return m_maxBounces;
+    }
+
+    /// <summary>
+    /// Sets the number of bounces after which each further bounce survives
+    /// with a probability that follows the path's throughput, and
+    /// survivors are weighted up to stay unbiased. A depth of at least
+    /// GetMaxBounces() disables the roulette. Accumulation restarts with
+    /// the next frame.
+    /// </summary>
+    auto SetRouletteDepth(uint32_t depth) -> void
+    {
+        m_rouletteDepth = depth;
+        m_resetPending = true;
+    }
+
+    auto GetRouletteDepth() const noexcept -> uint32_t
+    {
+        return m_rouletteDepth;
+    }
+
+    /// <summary>
+    /// Selects how paths are scheduled, ExecutionMode::PerPath by default.
+    /// The preview integrator traces no paths and ignores the mode.
+    /// </summary>
+    auto SetExecutionMode(ExecutionMode mode) -> void
+    {
+        m_executionMode = mode;
+    }
+
+    auto GetExecutionMode() const noexcept -> ExecutionMode
+    {
+        return m_executionMode;
+    }
+
+    /// <summary>
+    /// Whether the wavefront mode traces each bounce's rays in the order of
+    /// a RaySorter rather than in pixel order, off by default. Bounces with
+    /// fewer live paths than the tile's pixels / WAVEFRONT_SORT_DIVISOR stay
+    /// unsorted. The per-path mode ignores it. The image does not change.
+    /// </summary>
+    auto SetRaySorting(bool enabled) noexcept -> void
+    {
+        m_raySorting = enabled;
+    }
+
+    auto GetRaySorting() const noexcept -> bool
+    {
+        return m_raySorting;
+    }
+
+    /// <summary>
+    /// Replaces the sampler the pixel positions and path decisions are drawn
+    /// from, IndependentSampler by default; accumulation restarts with the
+    /// next frame.
+    /// </summary>
+    /// <exception cref="std::invalid_argument">sampler is null.</exception>
+    auto SetSampler(std::shared_ptr<const ISampler> sampler) -> void;
+
+    auto GetSampler() const noexcept -> const ISampler&
+    {
+        return *m_sampler;
+    }
+
+    /// <summary>
+    /// Returns the rays of the last frame by path depth.
+    /// </summary>
+    auto GetDepthStats() const noexcept -> const PathDepthStats&
+    {
+        return m_depthStats;
+    }
+
+    auto GetAccumulation() const noexcept -> const AccumulationBuffer&
+    {
+        return m_accumulation;
+    }
+
+    /// <summary>
+    /// Returns the tile scheduler, e.g. to change the tile size or to read
+    /// per-thread busy/idle times of the last frame.
+    /// </summary>
+    auto GetScheduler() noexcept -> TileScheduler&
+    {
+        return m_scheduler;
+    }
+
+    auto GetScheduler() const noexcept -> const TileScheduler&
+    {
+        return m_scheduler;
+    }
+
+  private:
+    /// <summary>
+    /// Closest hit of a ray with anything in the scene.
+    /// </summary>
+    struct SurfaceHit
+    {
+        float t = 0.0f;
+        glm::vec3 position{0.0f};
+
+        /// <summary>
+        /// Unit geometric normal: outwards for spheres, facing the ray for
+        /// triangles, which have no outside.
+        /// </summary>
+        glm::vec3 normal{0.0f};
+        uint32_t material = 0;
+
+        /// <summary>
+        /// The primitive's light in m_lights, LightSampler::NO_LIGHT if it
+        /// does not emit.
+        /// </summary>
+        uint32_t light = LightSampler::NO_LIGHT;
+    };
+
+    /// <summary>
+    /// Stand-ins for an instance index in hits: a sphere, or one of the
+    /// scene's loose triangles.
+    /// </summary>
+    static constexpr uint32_t NO_HIT = UINT32_MAX;
+    static constexpr uint32_t LOOSE_TRIANGLES = NO_HIT - 1;
+
+    /// <summary>
+    /// A path between two vertices: the ray to its next vertex, its
+    /// throughput and radiance so far, and where the last bounce left from
+    /// and the density it was drawn with, to weigh emitters it reaches
+    /// against light sampling.
+    /// </summary>
+    struct PathState
+    {
+        ray r;
+        color beta{1.0f};
+        color radiance{0.0f};
+        glm::vec3 previous{0.0f};
+        float bsdfPdf = 0.0f;
+    };
+
+    /// <summary>
+    /// A shadow ray shading asks for: contribution is added to the path's
+    /// radiance if nothing blocks r before tMax. A tMax of 0 asks for none.
+    /// </summary>
+    struct ShadowRequest
+    {
+        ray r;
+        float tMax = 0.0f;
+        color contribution{0.0f};
+    };
+
+    /// <summary>
+    /// What the primary ray of a pixel sample hit, for the FeatureBuffer.
+    /// </summary>
+    struct PixelFeatures
+    {
+        color albedo{1.0f};
+        glm::vec3 normal{0.0f};
+        float depth = 0.0f;
+    };
+
+    /// <summary>
+    /// A render thread's queues for wavefront tiles, kept across frames,
+    /// and the radiance and features of each pixel of its current tile.
+    /// </summary>
+    struct WavefrontQueues
+    {
+        PathQueue paths;
+        ShadowQueue shadows;
+        RaySorter sorter;
+        std::vector<uint8_t> active;
+        std::vector<uint8_t> sampled; // Per pixel of the tile
+        std::vector<color> radiance;
+        std::vector<PixelFeatures> features;
+    };
+
+    /// <summary>
+    /// Largest difference between a reprojected pixel's depth and that of
+    /// its first new sample, relative to the depth, and smallest cosine
+    /// between their normals, for the history to be kept.
+    /// </summary>
+    static constexpr float HISTORY_DEPTH_TOLERANCE = 0.05f;
+    static constexpr float HISTORY_NORMAL_TOLERANCE = 0.9f;
+
+    // Key of a pixel no history is reprojected to, see ReprojectHistory()
+    static constexpr uint64_t NO_HISTORY = UINT64_MAX;
+
+    /// <summary>
+    /// Sampler dimensions: the position inside the pixel, then for every
+    /// bounce a point on a light, the bounce direction, the choice of light
+    /// and the roulette decision.
+    /// </summary>
+    static constexpr uint32_t PIXEL_DIMENSION = 0;
+    static constexpr uint32_t FIRST_BOUNCE_DIMENSION = 2;
+    static constexpr uint32_t BOUNCE_DIMENSIONS = 6;
+    static constexpr uint32_t LIGHT_POINT_DIMENSION = 0;
+    static constexpr uint32_t DIRECTION_DIMENSION = 2;
+    static constexpr uint32_t LIGHT_CHOICE_DIMENSION = 4;
+    static constexpr uint32_t ROULETTE_DIMENSION = 5;
+
+    /// <summary>
+    /// One render thread's ray counters by depth, see PathDepthStats.
+    /// </summary>
+    struct DepthCounters
+    {
+        uint64_t* rays;
+        uint64_t* shadowRays;
+    };
+
+    /// <summary>
+    /// Maps a position in the image, in pixels, to the camera plane at
+    /// distance 1, in units of camera.right and camera.up.
+    /// </summary>
+    auto ToCameraPlane(const CameraGPUData& camera, glm::vec2 position) const
+        -> glm::vec2;
+
+    /// <summary>
+    /// Generates a primary ray through a position inside pixel (x, y) drawn
+    /// from the sampler for the pixel's sample index, so successive samples
+    /// anti-alias the image as they accumulate. gradient receives the
+    /// vertical sky gradient for the ray.
+    /// </summary>
+    auto GeneratePrimaryRay(const CameraGPUData& camera, uint32_t x, uint32_t y,
+                            uint32_t sampleIdx, float& gradient) const -> ray;
+
+    /// <summary>
+    /// Traces the primary rays of the pixels in [x0, x1) of row y as a
+    /// single ray packet. For pixel x0 + i, rays[i] receives its ray,
+    /// gradient[i] its sky gradient, and hits[i] where it hits the scene if
+    /// found[i]. x1 - x0 must not exceed PACKET_WIDTH.
+    /// </summary>
+    auto IntersectPrimary(const CameraGPUData& camera, const Scene& scene,
+                          uint32_t x0, uint32_t x1, uint32_t y, ray* rays,
+                          float* gradient, SurfaceHit* hits,
+                          bool* found) const -> void;
+
+    /// <summary>
+    /// Traces one sample for each pixel in [x0, x1) of row y as a single ray
+    /// packet and writes the radiance of pixel x0 + i to radiance[i] if
+    /// sample[i], and what its primary ray hit to features[i] if features
+    /// is not null. Pixels without a sample still trace their primary ray
+    /// with the packet, but no path. x1 - x0 must not exceed PACKET_WIDTH.
+    /// </summary>
+    auto TracePacket(const CameraGPUData& camera, const Scene& scene,
+                     uint32_t x0, uint32_t x1, uint32_t y, const bool* sample,
+                     glm::vec3* radiance, DepthCounters counters,
+                     PixelFeatures* features) const -> void;
+
+    /// <summary>
+    /// Whether the features of primary hits are accumulated, for the
+    /// denoiser or for temporal reprojection.
+    /// </summary>
+    auto RecordsFeatures() const noexcept -> bool
+    {
+        return m_denoising || m_reprojection;
+    }
+
+    /// <summary>
+    /// Adds a sample to pixel (x, y) and returns its new mean. With
+    /// features, adds them to the FeatureBuffer too, after discarding the
+    /// pixel's reprojected history if the sample does not see the same
+    /// surface.
+    /// </summary>
+    auto AddPixelSample(uint32_t x, uint32_t y, const color& radiance,
+                        const PixelFeatures* features) -> glm::vec3;
+
+    /// <summary>
+    /// Moves the accumulated samples and features of the view of camera
+    /// previous to where their surfaces appear from camera current, see
+    /// SetTemporalReprojection().
+    /// </summary>
+    auto ReprojectHistory(const CameraGPUData& previous,
+                          const CameraGPUData& current) -> void;
+
+    /// <summary>
+    /// Whether pixel (x, y) gets a sample this frame: always with adaptive
+    /// sampling off, else until it has enough samples and its estimated
+    /// error is below the threshold, and always while its reprojected
+    /// history awaits a sample to check it against.
+    /// </summary>
+    auto NeedsSample(uint32_t x, uint32_t y) const -> bool
+    {
+        return m_adaptiveThreshold <= 0.0f ||
+               m_historyPending[static_cast<size_t>(y) * m_width + x] ||
+               m_accumulation.GetSampleCount(x, y) < m_adaptiveMinSamples ||
+               m_accumulation.GetRelativeError(x, y) > m_adaptiveThreshold;
+    }
+
+    /// <summary>
+    /// Renders one sample for each pixel of tile that NeedsSample() in
+    /// wavefront mode and adds it to the accumulation, with the queues of
+    /// render thread threadIdx. Returns how many pixels of the tile still
+    /// need samples afterwards.
+    /// </summary>
+    auto RenderTileWavefront(const CameraGPUData& camera, const Scene& scene,
+                             const Tile& tile, uint32_t threadIdx,
+                             DepthCounters counters,
+                             Framebuffer& framebuffer) -> uint64_t;
+
+    /// <summary>
+    /// The albedo, normal and distance of a primary hit, or those of the
+    /// background if hit is null.
+    /// </summary>
+    auto GetPixelFeatures(const Scene& scene, const SurfaceHit* hit) const
+        -> PixelFeatures;
+
+    /// <summary>
+    /// Finds the closest hit of r with 0 < t < tMax.
+    /// </summary>
+    auto Intersect(const Scene& scene, const ray& r, float tMax,
+                   SurfaceHit& hit) const -> bool;
+
+    /// <summary>
+    /// Whether anything blocks r before tMax. Stops at the first hit found
+    /// rather than the closest, and resolves nothing about it.
+    /// </summary>
+    auto IsOccluded(const Scene& scene, const ray& r, float tMax) const
+        -> bool;
+
+    /// <summary>
+    /// Fills in hit for primitive primIdx of instance inst (or NO_HIT for a
+    /// sphere, LOOSE_TRIANGLES for a loose triangle) hit by r at position.
+    /// </summary>
+    auto ResolveHit(const Scene& scene, const ray& r, uint32_t primIdx,
+                    uint32_t inst, const glm::vec3& position,
+                    SurfaceHit& hit) const -> void;
+
+    /// <summary>
+    /// Shades the vertex at depth depth of path, sample sampleIdx of pixel
+    /// (x, y), where path.r hits hit, or escapes if hit is null: adds what
+    /// the vertex emits, asks for a shadow ray towards a light in shadow,
+    /// and turns path into the bounce to the next vertex. Returns false if
+    /// the path ends here instead.
+    /// </summary>
+    auto ShadeVertex(const Scene& scene, const SurfaceHit* hit, uint32_t x,
+                     uint32_t y, uint32_t sampleIdx, uint32_t depth,
+                     PathState& path, ShadowRequest& shadow) const -> bool;
+
+    /// <summary>
+    /// Radiance arriving along the camera ray r of sample sampleIdx of
+    /// pixel (x, y) with the selected path tracing integrator. primaryHit
+    /// is where r hits the scene, null if it escapes.
+    /// </summary>
+    auto TracePath(const Scene& scene, const ray& r,
+                   const SurfaceHit* primaryHit, uint32_t x, uint32_t y,
+                   uint32_t sampleIdx, DepthCounters counters) const
+        -> color;
+
+    /// <summary>
+    /// Bring the acceleration structures up to date with the scene's change
+    /// flags. newScene forces a rebuild.
+    /// </summary>
+    auto UpdateSphereBvh(const Scene& scene, bool newScene) -> void;
+    auto UpdateMeshBvhs(const Scene& scene, bool newScene) -> void;
+    auto UpdateInstanceBvh(const Scene& scene, bool newScene) -> void;
+
+    /// <summary>
+    /// Collects the emitters again if the scene changed in any way.
+    /// </summary>
+    auto UpdateLights(const Scene& scene, bool newScene) -> void;
+
+    auto GetMeshBvh(size_t meshIdx) const -> const MeshBvh8&
+    {
+        return m_attachedMeshBvhs[meshIdx] ? *m_attachedMeshBvhs[meshIdx]
+                                           : m_meshBvhs[meshIdx];
+    }
+
+    uint32_t m_width;
+    uint32_t m_height;
+    TileScheduler m_scheduler;
+    AccumulationBuffer m_accumulation;
+    FeatureBuffer m_features;
+    AtrousDenoiser m_denoiser;
+    bool m_denoising = false;
+
+    // Temporal reprojection: the camera of the last frame, the buffers the
+    // history is reprojected from, the distance and index of the surface
+    // reprojected to each pixel, and which pixels have history not yet
+    // checked
+    bool m_reprojection = false;
+    uint32_t m_maxHistory = DEFAULT_MAX_HISTORY;
+    CameraGPUData m_previousCamera{};
+    bool m_hasPreviousCamera = false;
+    AccumulationBuffer m_historyAccumulation;
+    FeatureBuffer m_historyFeatures;
+    std::vector<uint64_t> m_historyNearest;
+    std::vector<uint8_t> m_historyPending;
+    bool m_resetPending = false;
+    Integrator m_integrator = Integrator::Preview;
+    uint32_t m_maxBounces = DEFAULT_MAX_BOUNCES;
+    uint32_t m_rouletteDepth = DEFAULT_ROULETTE_DEPTH;
+    std::shared_ptr<const ISampler> m_sampler;
+    ExecutionMode m_executionMode = ExecutionMode::PerPath;
+    bool m_raySorting = false;
+    float m_adaptiveThreshold = 0.0f;
+    uint32_t m_adaptiveMinSamples = DEFAULT_ADAPTIVE_MIN_SAMPLES;
+    uint64_t m_unconvergedPixels = 0;
+    bool m_converged = false;
+    std::vector<WavefrontQueues> m_wavefronts; // One per render thread
+
+    // Ray counters of every render thread followed by its count of
+    // unconverged pixels, each thread's on its own cache lines, and their
+    // sums over the last frame
+    std::vector<uint64_t> m_threadRayCounts;
+    size_t m_threadRayCountStride = 0;
+    PathDepthStats m_depthStats;
+
+    const Scene* m_scene = nullptr; // Scene the BVHs were built for
+
+    // Refit or rebuilt from the binary tree, traced through the BVH8
+    Bvh m_sphereBvh;
+    Bvh8 m_sphereBvh8;
+
+    // One per scene mesh: the BVH the scene attached to it if any, else
+    // one built here, and the mesh revisions they match
+    std::vector<MeshBvh8> m_meshBvhs;
+    std::vector<std::shared_ptr<const MeshBvh8>> m_attachedMeshBvhs;
+    std::vector<uint32_t> m_meshRevisions;
+
+    // Two-level structure over the meshes: the scene's instances, then an
+    // identity instance for every mesh that has none, each with the
+    // material index that overrides its mesh's or Scene::NO_MATERIAL
+    std::vector<BottomLevelGeometry> m_bottomLevels;
+    std::vector<uint32_t> m_instanceMeshes;
+    std::vector<glm::mat4> m_instanceTransforms;
+    std::vector<uint32_t> m_instanceMaterials;
+    InstanceBvh m_instanceBvh;
+
+    // The scene's loose triangles as a mesh, triangle i using vertices
+    // 3i to 3i + 2
+    TriangleMesh m_looseTriangles;
+    MeshBvh8 m_looseTriangleBvh;
+
+    LightSampler m_lights;
+};
+
+} // namespace pathtracer
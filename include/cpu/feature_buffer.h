@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Auxiliary images for denoising, accumulated like AccumulationBuffer:
+/// per pixel, the means over its samples of the albedo, the geometric
+/// normal and the distance of what the primary ray hit. Rays that hit
+/// nothing add a white albedo, a zero normal and a depth of 0, so
+/// background and geometry never look alike to an edge-stopping filter.
+/// <para></para>
+/// Pixels are independent, so different threads may add samples to
+/// different pixels concurrently.
+/// </summary>
+class FeatureBuffer
+{
+  public:
+    FeatureBuffer() = default;
+
+    FeatureBuffer(uint32_t width, uint32_t height)
+    {
+        Resize(width, height);
+    }
+
+    /// <summary>
+    /// Resizes the buffer. This always resets the accumulated samples.
+    /// </summary>
+    auto Resize(uint32_t width, uint32_t height) -> void;
+
+    /// <summary>
+    /// Discards all accumulated samples, along with the radiance they
+    /// belong to.
+    /// </summary>
+    auto Reset() -> void;
+
+    auto AddSample(uint32_t x, uint32_t y, const glm::vec3& albedo,
+                   const glm::vec3& normal, float depth) -> void
+    {
+        const size_t idx = Index(x, y);
+        m_albedoSum[idx] += albedo;
+        m_normalSum[idx] += normal;
+        m_depthSum[idx] += depth;
+        ++m_sampleCount[idx];
+    }
+
+    /// <summary>
+    /// Returns the mean albedo of pixel (x, y), white without samples.
+    /// </summary>
+    auto GetAlbedo(uint32_t x, uint32_t y) const -> glm::vec3
+    {
+        const size_t idx = Index(x, y);
+        return m_sampleCount[idx] > 0
+                   ? m_albedoSum[idx] / static_cast<float>(m_sampleCount[idx])
+                   : glm::vec3{1.0f};
+    }
+
+    /// <summary>
+    /// Returns the mean normal of pixel (x, y), which is shorter than unit
+    /// length where the pixel covers an edge.
+    /// </summary>
+    auto GetNormal(uint32_t x, uint32_t y) const -> glm::vec3
+    {
+        const size_t idx = Index(x, y);
+        return m_sampleCount[idx] > 0
+                   ? m_normalSum[idx] / static_cast<float>(m_sampleCount[idx])
+                   : glm::vec3{0.0f};
+    }
+
+    auto GetDepth(uint32_t x, uint32_t y) const -> float
+    {
+        const size_t idx = Index(x, y);
+        return m_sampleCount[idx] > 0
+                   ? m_depthSum[idx] / static_cast<float>(m_sampleCount[idx])
+                   : 0.0f;
+    }
+
+    auto GetSampleCount(uint32_t x, uint32_t y) const -> uint32_t
+    {
+        return m_sampleCount[Index(x, y)];
+    }
+
+    /// <summary>
+    /// Replaces the samples of pixel (x, y) with sampleCount samples of the
+    /// given means, or with none.
+    /// </summary>
+    auto SetPixel(uint32_t x, uint32_t y, const glm::vec3& albedo,
+                  const glm::vec3& normal, float depth, uint32_t sampleCount)
+        -> void
+    {
+        const size_t idx = Index(x, y);
+        const float n = static_cast<float>(sampleCount);
+        m_albedoSum[idx] = albedo * n;
+        m_normalSum[idx] = normal * n;
+        m_depthSum[idx] = depth * n;
+        m_sampleCount[idx] = sampleCount;
+    }
+
+    auto GetWidth() const noexcept -> uint32_t
+    {
+        return m_width;
+    }
+
+    auto GetHeight() const noexcept -> uint32_t
+    {
+        return m_height;
+    }
+
+  private:
+    auto Index(uint32_t x, uint32_t y) const -> size_t
+    {
+        return static_cast<size_t>(y) * m_width + x;
+    }
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<glm::vec3> m_albedoSum;
+    std::vector<glm::vec3> m_normalSum;
+    std::vector<float> m_depthSum;
+    std::vector<uint32_t> m_sampleCount;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,85 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// A CPU-side image that the portable render core writes into. Pixels are
+/// stored row-major as linear float RGBA, which matches the 16-bit float back
+/// buffers used by the DX12 front end, so a presenter only has to pack and
+/// upload them.
+/// </summary>
+class Framebuffer
+{
+  public:
+    Framebuffer() = default;
+
+    Framebuffer(uint32_t width, uint32_t height)
+    {
+        Resize(width, height);
+    }
+
+    /// <summary>
+    /// Resizes the framebuffer. Existing pixel contents are discarded and
+    /// every pixel is reset to transparent black.
+    /// </summary>
+    auto Resize(uint32_t width, uint32_t height) -> void
+    {
+        m_width = width;
+        m_height = height;
+        m_pixels.assign(static_cast<size_t>(width) * height, glm::vec4{0.0f});
+    }
+
+    auto GetWidth() const noexcept -> uint32_t
+    {
+        return m_width;
+    }
+
+    auto GetHeight() const noexcept -> uint32_t
+    {
+        return m_height;
+    }
+
+    auto At(uint32_t x, uint32_t y) noexcept -> glm::vec4&
+    {
+        return m_pixels[static_cast<size_t>(y) * m_width + x];
+    }
+
+    auto At(uint32_t x, uint32_t y) const noexcept -> const glm::vec4&
+    {
+        return m_pixels[static_cast<size_t>(y) * m_width + x];
+    }
+
+    /// <summary>
+    /// Returns a pointer to the first pixel of row y.
+    /// </summary>
+    auto GetRow(uint32_t y) noexcept -> glm::vec4*
+    {
+        return m_pixels.data() + static_cast<size_t>(y) * m_width;
+    }
+
+    auto GetRow(uint32_t y) const noexcept -> const glm::vec4*
+    {
+        return m_pixels.data() + static_cast<size_t>(y) * m_width;
+    }
+
+    auto GetPixels() const noexcept -> const std::vector<glm::vec4>&
+    {
+        return m_pixels;
+    }
+
+  private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<glm::vec4> m_pixels;
+};
+
+} // namespace pathtracer
+
+#endif // FRAMEBUFFER_H
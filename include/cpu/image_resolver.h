@@ -0,0 +1,112 @@
+#pragma once
+
+#include "cpu/accumulation_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/tile_scheduler.h"
+
+#include <cstdint>
+#include <span>
+
+namespace pathtracer
+{
+/// <summary>
+/// Curve that maps exposed linear radiance into [0, 1] before display.
+/// </summary>
+enum class Tonemap
+{
+    /// <summary>
+    /// Clamp only; radiance above 1 clips.
+    /// </summary>
+    None,
+
+    /// <summary>
+    /// c / (1 + c) per channel.
+    /// </summary>
+    Reinhard,
+
+    /// <summary>
+    /// Narkowicz's fit of the ACES filmic curve.
+    /// </summary>
+    Aces,
+};
+
+/// <summary>
+/// Byte order of a packed 8-bit pixel in memory: RGBA for image files,
+/// BGRA for most window back buffers. Alpha is always 255.
+/// </summary>
+enum class PixelFormat
+{
+    Rgba8,
+    Bgra8,
+};
+
+struct ResolveSettings
+{
+    /// <summary>
+    /// In stops: radiance is scaled by 2^exposure before the tonemap.
+    /// </summary>
+    float exposure = 0.0f;
+    Tonemap tonemap = Tonemap::None;
+
+    /// <summary>
+    /// Adds up to one 8-bit step of noise before rounding, which hides the
+    /// banding of smooth gradients; without it, values round to nearest.
+    /// </summary>
+    bool dither = true;
+    PixelFormat format = PixelFormat::Rgba8;
+};
+
+/// <summary>
+/// Turns linear radiance into display-ready 8-bit pixels in one pass:
+/// divide by the sample count, expose, tonemap, encode with the sRGB
+/// transfer function, dither and pack. The sRGB curve is a table built at
+/// compile time and interpolated linearly, so no pow() runs per pixel.
+/// <para></para>
+/// Each tile row is one straight loop over its pixels with every setting
+/// hoisted out of it, which the compiler vectorizes like the packet types.
+/// The rows run on the tiles of a TileScheduler.
+/// </summary>
+class ImageResolver
+{
+  public:
+    ImageResolver() = default;
+
+    auto SetSettings(const ResolveSettings& settings) noexcept -> void
+    {
+        m_settings = settings;
+    }
+
+    auto GetSettings() const noexcept -> const ResolveSettings&
+    {
+        return m_settings;
+    }
+
+    /// <summary>
+    /// Resolves the mean radiance of accumulation into pixels, one packed
+    /// pixel per element in row-major order. Pixels without samples come
+    /// out black. Blocks until every row is done.
+    /// </summary>
+    auto Resolve(const AccumulationBuffer& accumulation,
+                 std::span<uint32_t> pixels, TileScheduler& scheduler) -> void;
+
+    /// <summary>
+    /// Resolves a framebuffer that already holds mean radiance, e.g. the
+    /// denoiser's output.
+    /// </summary>
+    auto Resolve(const Framebuffer& framebuffer, std::span<uint32_t> pixels,
+                 TileScheduler& scheduler) -> void;
+
+    /// <summary>
+    /// Wall time of the last Resolve() in milliseconds.
+    /// </summary>
+    auto GetLastRunMs() const noexcept -> double
+    {
+        return m_lastRunMs;
+    }
+
+  private:
+    ResolveSettings m_settings;
+    double m_lastRunMs = 0.0;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Affine transform stored as the top three rows of a 4x4 matrix, 48 bytes
+/// instead of 64.
+/// </summary>
+struct AffineTransform
+{
+    glm::vec4 rows[3] = {{1.0f, 0.0f, 0.0f, 0.0f},
+                         {0.0f, 1.0f, 0.0f, 0.0f},
+                         {0.0f, 0.0f, 1.0f, 0.0f}};
+
+    /// <summary>
+    /// Drops the bottom row of m, which must be (0, 0, 0, 1).
+    /// </summary>
+    static auto FromMatrix(const glm::mat4& m) -> AffineTransform
+    {
+        AffineTransform result;
+        for (int row = 0; row < 3; ++row)
+        {
+            result.rows[row] = {m[0][row], m[1][row], m[2][row], m[3][row]};
+        }
+        return result;
+    }
+
+    /// <summary>
+    /// The inverse transform. The linear part must be invertible.
+    /// </summary>
+    auto Inverse() const -> AffineTransform;
+
+    auto TransformPoint(const glm::vec3& p) const -> glm::vec3
+    {
+        return TransformVector(p) + glm::vec3{rows[0].w, rows[1].w, rows[2].w};
+    }
+
+    auto TransformVector(const glm::vec3& v) const -> glm::vec3
+    {
+        return {rows[0].x * v.x + rows[0].y * v.y + rows[0].z * v.z,
+                rows[1].x * v.x + rows[1].y * v.y + rows[1].z * v.z,
+                rows[2].x * v.x + rows[2].y * v.y + rows[2].z * v.z};
+    }
+
+    /// <summary>
+    /// Multiplies v by the transpose of the linear part. Called on the
+    /// inverse transform, this carries normals, which transform by the
+    /// inverse transpose, the same way the transform carries points.
+    /// </summary>
+    auto TransformNormal(const glm::vec3& v) const -> glm::vec3
+    {
+        return {rows[0].x * v.x + rows[1].x * v.y + rows[2].x * v.z,
+                rows[0].y * v.x + rows[1].y * v.y + rows[2].y * v.z,
+                rows[0].z * v.x + rows[1].z * v.y + rows[2].z * v.z};
+    }
+
+    /// <summary>
+    /// Tightest box around the transformed corners of box (Arvo's method).
+    /// An empty box stays empty.
+    /// </summary>
+    auto TransformBounds(const Aabb& box) const -> Aabb;
+};
+
+/// <summary>
+/// Geometry an InstanceBvh places instances of: a mesh and the bottom-level
+/// tree over it, both owned elsewhere and shared by every instance.
+/// </summary>
+struct BottomLevelGeometry
+{
+    const TriangleMesh* mesh = nullptr;
+    const MeshBvh8* bvh = nullptr;
+};
+
+/// <summary>
+/// Top level of a two-level acceleration structure: a BVH8 over instances,
+/// each a bottom-level geometry placed by an object-to-world transform.
+/// Only a transform and the geometry index are stored per instance, so
+/// memory grows with the number of unique meshes, not with the number of
+/// instances. Rays are carried into object space with the cached inverse
+/// transform and traced through the shared bottom-level tree.
+/// </summary>
+class InstanceBvh
+{
+  public:
+    InstanceBvh() = default;
+
+    /// <summary>
+    /// Builds the tree over instance i placing geometries[instanceGeometry[i]]
+    /// with transforms[i], replacing the previous one.
+    /// </summary>
+    /// <exception cref="std::invalid_argument">If the spans differ in
+    /// length or an instance references a geometry that does not
+    /// exist.</exception>
+    auto Build(std::span<const BottomLevelGeometry> geometries,
+               std::span<const uint32_t> instanceGeometry,
+               std::span<const glm::mat4> transforms,
+               TaskPool* pool = nullptr) -> void;
+
+    /// <summary>
+    /// Follows new transforms of the same instances, or bottom-level trees
+    /// whose bounds changed, by refitting the top level (or rebuilding it
+    /// as Bvh::Update() decides). The bottom level is not touched.
+    /// </summary>
+    /// <exception cref="std::invalid_argument">If the number of instances
+    /// changed.</exception>
+    auto Update(std::span<const BottomLevelGeometry> geometries,
+                std::span<const glm::mat4> transforms,
+                TaskPool* pool = nullptr) -> void;
+
+    auto Clear() -> void;
+
+    auto IsEmpty() const noexcept -> bool
+    {
+        return m_wide.IsEmpty();
+    }
+
+    auto GetInstanceCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_geometry.size());
+    }
+
+    auto GetGeometry(uint32_t instanceIdx) const -> uint32_t
+    {
+        return m_geometry[instanceIdx];
+    }
+
+    auto GetWorldToObject(uint32_t instanceIdx) const -> const AffineTransform&
+    {
+        return m_worldToObject[instanceIdx];
+    }
+
+    auto GetBvh() const noexcept -> const Bvh&
+    {
+        return m_bvh;
+    }
+
+    /// <summary>
+    /// Bytes of the top level that traversal touches: wide nodes, instance
+    /// indices, inverse transforms and geometry indices.
+    /// </summary>
+    auto GetTraversalBytes() const noexcept -> size_t;
+
+    /// <summary>
+    /// Finds the closest triangle of any instance hit by r with
+    /// 0 < t < tMax. hit.triIdx is the triangle of the instance's mesh and
+    /// t is measured along r, as object-space rays keep the parametrization
+    /// of world-space ones. geometries must be what the tree was built
+    /// over.
+    /// </summary>
+    auto Intersect(const ray& r,
+                   std::span<const BottomLevelGeometry> geometries,
+                   float tMax, TriangleHit& hit, uint32_t& instanceIdx) const
+        -> bool
+    {
+        float tClosest = tMax;
+        return m_wide.IntersectLeaves(
+            r, tClosest,
+            [&](uint32_t first, uint32_t count, float& tLeaf) -> bool
+            {
+                bool leafHit = false;
+                for (uint32_t i = first; i < first + count; ++i)
+                {
+                    const uint32_t inst = m_wide.GetPrimIndices()[i];
+                    const AffineTransform& toObject = m_worldToObject[inst];
+                    const BottomLevelGeometry& geometry =
+                        geometries[m_geometry[inst]];
+                    const ray objectRay{toObject.TransformPoint(r.origin()),
+                                        toObject.TransformVector(
+                                            r.direction())};
+                    if (geometry.bvh->Intersect(objectRay, *geometry.mesh,
+                                                tLeaf, hit))
+                    {
+                        tLeaf = hit.t;
+                        instanceIdx = inst;
+                        leafHit = true;
+                    }
+                }
+                return leafHit;
+            });
+    }
+
+    /// <summary>
+    /// Whether any instance is hit by r with 0 < t < tMax, for shadow rays.
+    /// Stops at the first hit, without finding the closest one.
+    /// </summary>
+    auto IsOccluded(const ray& r,
+                    std::span<const BottomLevelGeometry> geometries,
+                    float tMax) const -> bool
+    {
+        return m_wide.IsOccluded(
+            r, tMax,
+            [&](uint32_t first, uint32_t count, float tLeaf) -> bool
+            {
+                for (uint32_t i = first; i < first + count; ++i)
+                {
+                    const uint32_t inst = m_wide.GetPrimIndices()[i];
+                    const AffineTransform& toObject = m_worldToObject[inst];
+                    const BottomLevelGeometry& geometry =
+                        geometries[m_geometry[inst]];
+                    const ray objectRay{toObject.TransformPoint(r.origin()),
+                                        toObject.TransformVector(
+                                            r.direction())};
+                    if (geometry.bvh->IsOccluded(objectRay, *geometry.mesh,
+                                                 tLeaf))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            });
+    }
+
+  private:
+    /// <summary>
+    /// Caches the inverse transforms and returns the world-space bounds of
+    /// every instance.
+    /// </summary>
+    auto PlaceInstances(std::span<const BottomLevelGeometry> geometries,
+                        std::span<const glm::mat4> transforms)
+        -> std::vector<Aabb>;
+
+    Bvh m_bvh;
+    Bvh8 m_wide;
+    std::vector<uint32_t> m_geometry;
+    std::vector<AffineTransform> m_worldToObject;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "cpu/sphere_buffer.h"
+#include "ray/ray.h"
+#include "ray/ray_packet.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// sphereIdx of the IntersectSpheres() functions when no sphere is hit.
+/// </summary>
+constexpr uint32_t NO_SPHERE_HIT = std::numeric_limits<uint32_t>::max();
+
+/// <summary>
+/// CPU port of intersectSphere() from compute.hlsl, taking the squared
+/// radius as stored in a SphereBuffer. Returns the nearest positive hit
+/// distance in t.
+/// <para></para>
+/// Every other sphere kernel performs exactly these operations in this
+/// order, so they all produce bit-identical hit distances and can replace
+/// each other freely.
+/// </summary>
+inline auto IntersectSphereRadiusSq(const ray& r, const glm::vec3& center,
+                                    float radiusSq, float& t) -> bool
+{
+    t = 0.0f;
+
+    // Origin to center vector
+    const glm::vec3 oc = r.origin() - center;
+
+    // Quadratic coefficients
+    const float a = glm::dot(r.direction(), r.direction());
+    const float h = glm::dot(r.direction(), oc);
+    const float c = glm::dot(oc, oc) - radiusSq;
+    const float discriminant = h * h - a * c;
+
+    if (discriminant < 0.0f)
+        return false;
+
+    const float sqrtd = glm::sqrt(discriminant);
+
+    // Find the nearest root that lies in the acceptable range.
+    float root = (-h - sqrtd) / a;
+    if (root <= 0.0f)
+    {
+        root = (-h + sqrtd) / a;
+        if (root <= 0.0f)
+            return false;
+    }
+
+    t = root;
+    return true;
+}
+
+/// <summary>
+/// CPU port of intersectSphere() from compute.hlsl. Returns the nearest
+/// positive hit distance in t.
+/// </summary>
+inline auto IntersectSphere(const ray& r, const glm::vec3& center,
+                            float radius, float& t) -> bool
+{
+    return IntersectSphereRadiusSq(r, center, radius * radius, t);
+}
+
+/// <summary>
+/// N rays against one sphere: packet version of IntersectSphereRadiusSq().
+/// Lane i's t is identical to tracing get(i) on its own. Returns the lanes
+/// that are active and hit; t is 0 in every other lane.
+/// </summary>
+template <size_t N>
+auto IntersectSphereRadiusSq(const RayPacket<N>& r, const glm::vec3& center,
+                             float radiusSq, FloatPacket<N>& t)
+    -> PacketMask<N>
+{
+    const Vec3Packet<N>& o = r.origin();
+    const Vec3Packet<N>& d = r.direction();
+    const PacketMask<N>& active = r.active();
+
+    PacketMask<N> hit;
+    for (size_t i = 0; i < N; ++i)
+    {
+        const float ocx = o.x[i] - center.x;
+        const float ocy = o.y[i] - center.y;
+        const float ocz = o.z[i] - center.z;
+
+        const float a = d.x[i] * d.x[i] + d.y[i] * d.y[i] + d.z[i] * d.z[i];
+        const float h = d.x[i] * ocx + d.y[i] * ocy + d.z[i] * ocz;
+        const float c = ocx * ocx + ocy * ocy + ocz * ocz - radiusSq;
+        const float discriminant = h * h - a * c;
+
+        // Both roots are computed for every lane and selected afterwards;
+        // whatever a missed or inactive lane produces is masked out below
+        const float sqrtd = std::sqrt(std::max(discriminant, 0.0f));
+        const float nearRoot = (-h - sqrtd) / a;
+        const float farRoot = (-h + sqrtd) / a;
+        const float root = nearRoot <= 0.0f ? farRoot : nearRoot;
+
+        // Bitwise rather than logical and, short-circuiting would branch
+        const int32_t ok = active.lanes[i] &
+                           -static_cast<int32_t>(discriminant >= 0.0f) &
+                           -static_cast<int32_t>(root > 0.0f);
+        t[i] = ok != 0 ? root : 0.0f;
+        hit.lanes[i] = ok;
+    }
+    return hit;
+}
+
+/// <summary>
+/// N rays against one sphere, see IntersectSphereRadiusSq().
+/// </summary>
+template <size_t N>
+auto IntersectSphere(const RayPacket<N>& r, const glm::vec3& center,
+                     float radius, FloatPacket<N>& t) -> PacketMask<N>
+{
+    return IntersectSphereRadiusSq(r, center, radius * radius, t);
+}
+
+/// <summary>
+/// N rays against sphere idx of a SphereBuffer.
+/// </summary>
+template <size_t N>
+auto IntersectSphere(const RayPacket<N>& r, const SphereBuffer& spheres,
+                     uint32_t idx, FloatPacket<N>& t) -> PacketMask<N>
+{
+    return IntersectSphereRadiusSq(r, spheres.GetCenter(idx),
+                                   spheres.GetRadiusSq(idx), t);
+}
+
+/// <summary>
+/// One ray against every sphere in the buffer, SphereBuffer::BLOCK_SIZE
+/// spheres per SIMD iteration. Finds the closest hit with 0 < t < tMax and
+/// returns its distance in t and its index in sphereIdx; on equal distances
+/// the lower index wins, as in the scalar version. On a miss t is tMax and
+/// sphereIdx is NO_SPHERE_HIT.
+/// </summary>
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres, float tMax,
+                      float& t, uint32_t& sphereIdx) -> bool;
+
+/// <summary>
+/// Scalar reference for IntersectSpheres(): calls IntersectSphereRadiusSq()
+/// for one sphere after another. Returns bit-identical results.
+/// </summary>
+auto IntersectSpheresScalar(const ray& r, const SphereBuffer& spheres,
+                            float tMax, float& t, uint32_t& sphereIdx)
+    -> bool;
+
+/// <summary>
+/// One ray against the spheres of a buffer through a BVH built over their
+/// bounds (see BuildSphereBvh()). Same results as IntersectSpheres(), except
+/// that ties between equally distant spheres may resolve differently.
+/// </summary>
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool;
+
+/// <summary>
+/// The same through a 4 or 8-wide BVH collapsed from the binary one.
+/// </summary>
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh4& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool;
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh8& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool;
+
+/// <summary>
+/// Whether r hits any sphere of the buffer with 0 < t < tMax, for shadow
+/// rays: the blocked kernel of IntersectSpheres(), returning at the first
+/// block with a hit instead of finding the closest one.
+/// </summary>
+auto IsOccluded(const ray& r, const SphereBuffer& spheres, float tMax)
+    -> bool;
+
+/// <summary>
+/// The same through a BVH8 over the spheres' bounds, stopping at the first
+/// sphere hit.
+/// </summary>
+auto IsOccluded(const ray& r, const SphereBuffer& spheres, const Bvh8& bvh,
+                float tMax) -> bool;
+
+/// <summary>
+/// Bounding box of every sphere in the buffer, in index order.
+/// </summary>
+auto ComputeSphereBounds(const SphereBuffer& spheres) -> std::vector<Aabb>;
+
+/// <summary>
+/// Builds bvh over the bounds of every sphere in the buffer, in parallel on
+/// pool if one is given (see Bvh::Build()).
+/// </summary>
+auto BuildSphereBvh(const SphereBuffer& spheres, Bvh& bvh,
+                    const BvhBuildOptions& options = {},
+                    TaskPool* pool = nullptr) -> void;
+
+} // namespace pathtracer
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "scene/scene.h"
+#include "utils/color.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// A point chosen on a light as seen from a shading point.
+/// </summary>
+struct LightSample
+{
+    glm::vec3 position;
+
+    /// <summary>
+    /// Unit vector from the shading point towards position.
+    /// </summary>
+    glm::vec3 direction;
+    float distance = 0.0f;
+    color emission{0.0f};
+
+    /// <summary>
+    /// Solid angle density at the shading point of drawing this direction,
+    /// including the probability of choosing the light.
+    /// </summary>
+    float pdf = 0.0f;
+};
+
+/// <summary>
+/// Every emissive primitive of a scene as a light for next-event
+/// estimation: spheres, loose triangles, and the triangles of every
+/// instance of an emissive mesh in world space. A light is chosen with
+/// probability proportional to its power, then a point on it: spheres by
+/// the cone of directions they subtend, triangles uniformly by area.
+/// </summary>
+class LightSampler
+{
+  public:
+    static constexpr uint32_t NO_LIGHT = UINT32_MAX;
+
+    LightSampler() = default;
+
+    /// <summary>
+    /// Collects the lights of scene. The meshes are taken as instances:
+    /// instance i places mesh instanceMeshes[i] with instanceTransforms[i],
+    /// its material overridden by instanceMaterials[i] unless that is
+    /// Scene::NO_MATERIAL.
+    /// </summary>
+    auto Build(const Scene& scene, std::span<const uint32_t> instanceMeshes,
+               std::span<const glm::mat4> instanceTransforms,
+               std::span<const uint32_t> instanceMaterials) -> void;
+
+    auto Clear() -> void;
+
+    auto IsEmpty() const noexcept -> bool
+    {
+        return m_lights.empty();
+    }
+
+    auto GetLightCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_lights.size());
+    }
+
+    /// <summary>
+    /// Chooses a light with u0 and a point on it with u1 and u2, all
+    /// uniform in [0, 1). Returns false if the light offers nothing to
+    /// origin, e.g. a triangle seen edge-on or a sphere around it.
+    /// </summary>
+    auto Sample(const glm::vec3& origin, float u0, float u1, float u2,
+                LightSample& sample) const -> bool;
+
+    /// <summary>
+    /// The pdf Sample() would have given for reaching position, with
+    /// geometric normal normal, on light from origin.
+    /// </summary>
+    auto Pdf(uint32_t light, const glm::vec3& origin,
+             const glm::vec3& position, const glm::vec3& normal) const
+        -> float;
+
+    /// <summary>
+    /// The light of sphere sphereIdx, or NO_LIGHT if it does not emit.
+    /// </summary>
+    auto GetSphereLight(uint32_t sphereIdx) const -> uint32_t
+    {
+        return m_sphereLights[sphereIdx];
+    }
+
+    /// <summary>
+    /// The light of loose triangle triangleIdx, or NO_LIGHT.
+    /// </summary>
+    auto GetTriangleLight(uint32_t triangleIdx) const -> uint32_t
+    {
+        return m_triangleLights[triangleIdx];
+    }
+
+    /// <summary>
+    /// The light of triangle triangleIdx of instance instanceIdx, or
+    /// NO_LIGHT.
+    /// </summary>
+    auto GetInstanceLight(uint32_t instanceIdx, uint32_t triangleIdx) const
+        -> uint32_t
+    {
+        const uint32_t first = m_instanceFirstLights[instanceIdx];
+        return first == NO_LIGHT ? NO_LIGHT : first + triangleIdx;
+    }
+
+  private:
+    enum class LightKind : uint32_t
+    {
+        Sphere,
+        Triangle,
+    };
+
+    /// <summary>
+    /// A sphere (center v0, radius in v1.x) or a world-space triangle.
+    /// </summary>
+    struct Light
+    {
+        LightKind kind;
+        glm::vec3 v0;
+        glm::vec3 v1;
+        glm::vec3 v2;
+        color emission;
+        float area;
+    };
+
+    auto AddLight(const Light& light) -> uint32_t;
+
+    /// <summary>
+    /// Solid angle density of a point on light seen from origin, without
+    /// the probability of choosing the light.
+    /// </summary>
+    auto PointPdf(const Light& light, const glm::vec3& origin,
+                  const glm::vec3& position, const glm::vec3& normal) const
+        -> float;
+
+    std::vector<Light> m_lights;
+
+    // Choice probability of each light and the running sum of the
+    // probabilities before it, for choosing by binary search
+    std::vector<float> m_probabilities;
+    std::vector<float> m_cdf;
+
+    std::vector<uint32_t> m_sphereLights;
+    std::vector<uint32_t> m_triangleLights;
+    std::vector<uint32_t> m_instanceFirstLights;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "utils/color.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// States of the paths a wavefront renderer advances together, one array
+/// per field, so every stage streams through just the fields it needs.
+/// Path i occupies index i of every array; the first count entries are
+/// live, the arrays only ever grow.
+/// </summary>
+struct PathQueue
+{
+    // Ray the next extension traces
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> directions;
+
+    std::vector<color> betas;
+    std::vector<color> radiances;
+
+    // Where the last bounce left from and the density it was drawn with
+    std::vector<glm::vec3> previous;
+    std::vector<float> bsdfPdfs;
+
+    /// <summary>
+    /// Index of the path's pixel in the batch.
+    /// </summary>
+    std::vector<uint32_t> pixels;
+
+    // Closest hit the last extension found, if found is not 0
+    std::vector<uint8_t> found;
+    std::vector<glm::vec3> hitPositions;
+    std::vector<glm::vec3> hitNormals;
+    std::vector<uint32_t> hitMaterials;
+    std::vector<uint32_t> hitLights;
+
+    size_t count = 0;
+
+    /// <summary>
+    /// Grows the arrays to hold at least capacity paths.
+    /// </summary>
+    auto Reserve(size_t capacity) -> void;
+
+    /// <summary>
+    /// Copies path from to index to, to close gaps left by finished paths.
+    /// </summary>
+    auto Move(size_t from, size_t to) -> void;
+};
+
+/// <summary>
+/// Shadow rays of a wavefront, one array per field, each adding its
+/// contribution to the radiance of path paths[i] if nothing blocks it.
+/// </summary>
+struct ShadowQueue
+{
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> directions;
+    std::vector<float> tMax;
+    std::vector<color> contributions;
+    std::vector<uint32_t> paths;
+
+    size_t count = 0;
+
+    /// <summary>
+    /// Grows the arrays to hold at least capacity rays.
+    /// </summary>
+    auto Reserve(size_t capacity) -> void;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Orders a batch of rays so that rays traced one after another start
+/// close together and head the same way, and so visit the same BVH nodes
+/// while they are still in cache. Diffuse bounces leave in random
+/// directions, so a batch in pixel order traverses incoherently.
+/// <para></para>
+/// Each ray is keyed by its direction octant, then by the Morton code of its
+/// origin quantized within the bounds of the batch's origins, and the keys
+/// are radix sorted, in parallel if a TaskPool is given. Sorting costs a few
+/// passes over the batch; batches smaller than GetMinBatch() are left
+/// alone, as traversal of few rays gains less than the sort costs.
+/// </summary>
+class RaySorter
+{
+  public:
+    /// <summary>
+    /// Bits of a key: 3 for the octant above 9 per axis of the origin.
+    /// </summary>
+    static constexpr uint32_t KEY_BITS = 30;
+
+    /// <summary>
+    /// Smallest batch sorted by default. The "ray-sorting" benchmark finds
+    /// where sorting starts to pay off.
+    /// </summary>
+    static constexpr size_t DEFAULT_MIN_BATCH = 2048;
+
+    explicit RaySorter(size_t minBatch = DEFAULT_MIN_BATCH)
+        : m_minBatch(minBatch)
+    {
+    }
+
+    /// <summary>
+    /// Computes the order in which to trace the rays (origins[i],
+    /// directions[i]), available from GetOrder(). Returns false without
+    /// sorting if the batch is smaller than GetMinBatch(); the rays are
+    /// then best traced as they are.
+    /// </summary>
+    auto Sort(std::span<const glm::vec3> origins,
+              std::span<const glm::vec3> directions, TaskPool* pool = nullptr)
+        -> bool;
+
+    /// <summary>
+    /// Indices of the rays of the last sorted batch, in trace order.
+    /// </summary>
+    auto GetOrder() const noexcept -> std::span<const uint32_t>
+    {
+        return {m_order.data(), m_count};
+    }
+
+    auto SetMinBatch(size_t minBatch) noexcept -> void
+    {
+        m_minBatch = minBatch;
+    }
+
+    auto GetMinBatch() const noexcept -> size_t
+    {
+        return m_minBatch;
+    }
+
+  private:
+    size_t m_minBatch;
+    size_t m_count = 0;
+
+    // Keys and ray indices, sorted back and forth between the buffers
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_keyScratch;
+    std::vector<uint32_t> m_orderScratch;
+
+    // Digit counts of each chunk, then where its next key of a digit goes
+    std::vector<uint32_t> m_histograms;
+
+    // Bounds of each chunk's origins, lower then upper
+    std::vector<glm::vec3> m_chunkBounds;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "interfaces/sampler_interface.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace pathtracer
+{
+/// <summary>
+/// Uncorrelated random numbers, hashed from the address. With seed 0 the
+/// first two dimensions are the sub-pixel jitter compute.hlsl draws, bit
+/// for bit.
+/// </summary>
+class IndependentSampler : public ISampler
+{
+  public:
+    /// <summary>
+    /// Samplers of every kind draw other, independent numbers for each
+    /// seed.
+    /// </summary>
+    explicit IndependentSampler(uint32_t seed = 0) : m_seed(seed)
+    {
+    }
+
+    auto Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> float override;
+
+    auto GetName() const -> const char* override
+    {
+        return "independent";
+    }
+
+  private:
+    uint32_t m_seed;
+};
+
+/// <summary>
+/// Jittered strata: each run of samplesPerPixel samples of a pixel puts
+/// one sample in each of samplesPerPixel intervals of every dimension, and
+/// Get2D() into the cells of a near-square grid. Strata are shuffled
+/// independently per pixel, dimension and run, so the dimensions do not
+/// correlate. Best when the pixel takes a multiple of samplesPerPixel
+/// samples.
+/// </summary>
+class StratifiedSampler : public ISampler
+{
+  public:
+    /// <exception cref="std::invalid_argument">samplesPerPixel is
+    /// 0.</exception>
+    explicit StratifiedSampler(uint32_t samplesPerPixel, uint32_t seed = 0);
+
+    auto Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> float override;
+    auto Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> glm::vec2 override;
+
+    auto GetName() const -> const char* override
+    {
+        return "stratified";
+    }
+
+    auto GetSamplesPerPixel() const noexcept -> uint32_t
+    {
+        return m_samplesPerPixel;
+    }
+
+  private:
+    uint32_t m_seed;
+    uint32_t m_samplesPerPixel;
+    uint32_t m_gridWidth;
+    uint32_t m_gridHeight;
+};
+
+/// <summary>
+/// The first two dimensions of the Sobol sequence, a (0, 2)-sequence, with
+/// hash-based Owen scrambling (Burley 2020). Every pair of dimensions gets
+/// its own shuffle of the sample order and its own scramble, per pixel, so
+/// pairs stay well stratified on their own and independent of each other,
+/// and any prefix of a pixel's samples is well distributed.
+/// </summary>
+class SobolSampler : public ISampler
+{
+  public:
+    explicit SobolSampler(uint32_t seed = 0) : m_seed(seed)
+    {
+    }
+
+    auto Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> float override;
+    auto Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> glm::vec2 override;
+
+    auto GetName() const -> const char* override
+    {
+        return "sobol";
+    }
+
+  private:
+    uint32_t m_seed;
+};
+
+/// <summary>
+/// Spatiotemporal blue noise: a tiled void-and-cluster mask, so the error
+/// of neighbouring pixels cancels when the image is viewed or filtered,
+/// advanced by the golden ratio (pairs by the R2 sequence) every sample so
+/// each pixel's samples also cover [0, 1) evenly over time. Dimensions read
+/// the mask at different toroidal offsets.
+/// </summary>
+class BlueNoiseSampler : public ISampler
+{
+  public:
+    /// <summary>
+    /// Edge length of the mask in pixels.
+    /// </summary>
+    static constexpr uint32_t MASK_SIZE = 64;
+
+    /// <summary>
+    /// Builds the mask on first use; later samplers share it and differ
+    /// only in the offsets seed gives each dimension.
+    /// </summary>
+    explicit BlueNoiseSampler(uint32_t seed = 0);
+
+    auto Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> float override;
+    auto Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+               uint32_t dimension) const -> glm::vec2 override;
+
+    auto GetName() const -> const char* override
+    {
+        return "blue-noise";
+    }
+
+  private:
+    /// <summary>
+    /// Rank of the mask texel dimension reads for pixel (x, y), in the top
+    /// bits of a 32-bit fraction.
+    /// </summary>
+    auto GetMask(uint32_t x, uint32_t y, uint32_t dimension) const
+        -> uint32_t;
+
+    uint32_t m_seed;
+    const uint16_t* m_ranks;
+};
+
+} // namespace pathtracer
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utils/color.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace pathtracer
+{
+constexpr float PI = glm::pi<float>();
+constexpr float INV_PI = glm::one_over_pi<float>();
+
+/// <summary>
+/// Completes the unit vector n to an orthonormal basis (t, b, n) without
+/// branching on its direction (Duff et al. 2017).
+/// </summary>
+inline auto BuildBasis(const glm::vec3& n, glm::vec3& t, glm::vec3& b) -> void
+{
+    const float sign = std::copysign(1.0f, n.z);
+    const float a = -1.0f / (sign + n.z);
+    const float c = n.x * n.y * a;
+    t = {1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x};
+    b = {c, sign + n.y * n.y * a, -n.y};
+}
+
+/// <summary>
+/// Direction about the unit normal n with density cos(theta) / pi, from two
+/// uniform numbers in [0, 1).
+/// </summary>
+inline auto SampleCosineHemisphere(const glm::vec3& n, float u0, float u1)
+    -> glm::vec3
+{
+    glm::vec3 t;
+    glm::vec3 b;
+    BuildBasis(n, t, b);
+    const float r = std::sqrt(u0);
+    const float phi = 2.0f * PI * u1;
+    const float z = std::sqrt(std::max(0.0f, 1.0f - u0));
+    return t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * z;
+}
+
+/// <summary>
+/// Veach's power heuristic with exponent 2: the weight of a sample drawn
+/// with density pdf when another strategy could have drawn it with
+/// otherPdf.
+/// </summary>
+inline auto PowerHeuristic(float pdf, float otherPdf) -> float
+{
+    const float a = pdf * pdf;
+    const float b = otherPdf * otherPdf;
+    return a > 0.0f ? a / (a + b) : 0.0f;
+}
+
+/// <summary>
+/// Rec. 709 luminance.
+/// </summary>
+inline auto Luminance(const color& c) -> float
+{
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,105 @@
+#ifndef SPHERE_BUFFER_H
+#define SPHERE_BUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Structure-of-arrays sphere storage: center x, y, z and radius squared in
+/// four separate arrays, which is the layout the SIMD intersection kernels
+/// stream through. A sphere costs 16 bytes, so particle-like scenes with
+/// millions of spheres are limited by memory bandwidth rather than by
+/// arithmetic.
+/// <para></para>
+/// The arrays are padded to a multiple of BLOCK_SIZE with spheres that can
+/// never be hit, so kernels always process whole blocks without a remainder
+/// loop. GetCount() is the number of real spheres, GetPaddedCount() the
+/// length of the arrays.
+/// </summary>
+class SphereBuffer
+{
+  public:
+    /// <summary>
+    /// Number of spheres a SIMD kernel tests per iteration. The padded
+    /// array length is always a multiple of this.
+    /// </summary>
+    static constexpr uint32_t BLOCK_SIZE = 8;
+
+    SphereBuffer() = default;
+
+    /// <summary>
+    /// Appends a sphere and returns its index.
+    /// </summary>
+    auto Add(const glm::vec3& center, float radius) -> uint32_t;
+
+    /// <summary>
+    /// Moves or resizes sphere idx in place.
+    /// </summary>
+    auto Set(uint32_t idx, const glm::vec3& center, float radius) -> void;
+
+    /// <summary>
+    /// Removes sphere idx by moving the last sphere into its place, so the
+    /// arrays stay dense. Returns the index the last sphere came from.
+    /// </summary>
+    auto SwapRemove(uint32_t idx) -> uint32_t;
+
+    /// <summary>
+    /// Reserves room for count spheres.
+    /// </summary>
+    auto Reserve(uint32_t count) -> void;
+
+    auto Clear() -> void;
+
+    auto GetCenter(uint32_t idx) const -> glm::vec3
+    {
+        return {m_centerX[idx], m_centerY[idx], m_centerZ[idx]};
+    }
+
+    auto GetRadiusSq(uint32_t idx) const -> float
+    {
+        return m_radiusSq[idx];
+    }
+
+    auto GetCount() const noexcept -> uint32_t
+    {
+        return m_count;
+    }
+
+    auto GetPaddedCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_radiusSq.size());
+    }
+
+    auto GetCenterX() const noexcept -> const float*
+    {
+        return m_centerX.data();
+    }
+    auto GetCenterY() const noexcept -> const float*
+    {
+        return m_centerY.data();
+    }
+    auto GetCenterZ() const noexcept -> const float*
+    {
+        return m_centerZ.data();
+    }
+    auto GetRadiusSq() const noexcept -> const float*
+    {
+        return m_radiusSq.data();
+    }
+
+  private:
+    uint32_t m_count = 0;
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_radiusSq;
+};
+
+} // namespace pathtracer
+
+#endif // SPHERE_BUFFER_H
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// A persistent pool of worker threads. ParallelFor() runs one-dimensional
+/// data-parallel loops on it, e.g. BVH construction and refitting; the
+/// TileScheduler runs its work-stealing tile loop on one through
+/// RunOnAllThreads(), so a renderer needs a single set of threads for both.
+/// <para></para>
+/// ParallelFor() hands out indices one at a time from a shared atomic
+/// counter, so tasks of very different cost balance automatically; callers
+/// keep each index coarse enough (thousands of elements) that the counter
+/// is not contended.
+/// <para></para>
+/// The calling thread participates as thread 0. The task function must not
+/// call back into the same pool.
+/// </summary>
+class TaskPool
+{
+  public:
+    using TaskFunction =
+        std::function<void(uint32_t index, uint32_t threadIdx)>;
+    using ThreadFunction = std::function<void(uint32_t threadIdx)>;
+
+    /// <summary>
+    /// Creates the pool and starts its worker threads.
+    /// </summary>
+    /// <param name="threadCount">Total number of threads including the
+    /// calling thread. 0 uses every hardware thread.</param>
+    explicit TaskPool(uint32_t threadCount = 0);
+    ~TaskPool();
+
+    // Disable copy/move, worker threads hold a pointer to this
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /// <summary>
+    /// Blocks until fn has been called once for every index in
+    /// [0, count). Exceptions thrown by fn are rethrown here after all
+    /// threads have stopped.
+    /// </summary>
+    auto ParallelFor(uint32_t count, const TaskFunction& fn) -> void;
+
+    /// <summary>
+    /// Calls fn once on every thread of the pool and blocks until all of
+    /// them have returned. The first exception thrown is rethrown here;
+    /// from then on IsCancelled() is true, so that the other threads can
+    /// give up early.
+    /// </summary>
+    auto RunOnAllThreads(const ThreadFunction& fn) -> void;
+
+    /// <summary>
+    /// Whether a thread of the current RunOnAllThreads() or ParallelFor()
+    /// has thrown.
+    /// </summary>
+    auto IsCancelled() const noexcept -> bool
+    {
+        return m_cancelled.load(std::memory_order_relaxed);
+    }
+
+    auto GetThreadCount() const noexcept -> uint32_t
+    {
+        return m_threadCount;
+    }
+
+  private:
+    auto WorkerLoop(uint32_t threadIdx) -> void;
+    auto Execute(uint32_t threadIdx) -> void;
+
+    uint32_t m_threadCount;
+    std::vector<std::thread> m_workers;
+
+    // State of the job currently being executed
+    const ThreadFunction* m_function = nullptr;
+    std::exception_ptr m_exception;
+    std::atomic<bool> m_cancelled{false};
+
+    // Worker wake-up and completion signalling
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobStart;
+    std::condition_variable m_jobDone;
+    uint64_t m_generation = 0;
+    uint32_t m_activeWorkers = 0;
+    bool m_shutdown = false;
+};
+
+} // namespace pathtracer
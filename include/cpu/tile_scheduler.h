@@ -0,0 +1,140 @@
+#pragma once
+
+#include "cpu/task_pool.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// A rectangular region of the image, [x0, x1) x [y0, y1) in pixels.
+/// </summary>
+struct Tile
+{
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+};
+
+/// <summary>
+/// Per-thread timings of the most recent TileScheduler::Run() call. Busy time
+/// is spent inside the tile function, idle time is everything else between
+/// the start and the end of the run (waking up, stealing, waiting for the
+/// slowest thread to finish).
+/// </summary>
+struct ThreadStats
+{
+    double busyMs = 0.0;
+    double idleMs = 0.0;
+    uint32_t tilesExecuted = 0;
+    uint32_t tilesStolen = 0;
+};
+
+/// <summary>
+/// Splits a frame into square tiles and executes them on a persistent
+/// TaskPool.
+/// <para></para>
+/// Every thread owns a deque of tiles. Tiles are handed out in contiguous
+/// runs so neighbouring tiles (and their cache lines) stay on one thread; a
+/// thread that runs out of work steals from the far end of another thread's
+/// deque. This keeps all cores busy even when tile costs differ by orders of
+/// magnitude, e.g. sky tiles next to tiles with heavy geometry.
+/// <para></para>
+/// The calling thread participates as thread 0. The tile function must not
+/// call back into the same scheduler or its pool.
+/// </summary>
+class TileScheduler
+{
+  public:
+    using TileFunction =
+        std::function<void(const Tile& tile, uint32_t threadIdx)>;
+
+    static constexpr uint32_t DEFAULT_TILE_SIZE = 32;
+
+    /// <summary>
+    /// Creates the scheduler and starts its worker threads.
+    /// </summary>
+    /// <param name="threadCount">Total number of threads including the
+    /// calling thread. 0 uses every hardware thread.</param>
+    /// <param name="tileSize">Width and height of a tile in pixels.</param>
+    explicit TileScheduler(uint32_t threadCount = 0,
+                           uint32_t tileSize = DEFAULT_TILE_SIZE);
+
+    // Disable copy/move, worker threads hold a pointer to this
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    /// <summary>
+    /// Splits a width x height image into tiles and blocks until fn has been
+    /// called once for every tile. Exceptions thrown by fn are rethrown here
+    /// after all threads have stopped.
+    /// </summary>
+    auto Run(uint32_t width, uint32_t height, const TileFunction& fn) -> void;
+
+    auto SetTileSize(uint32_t tileSize) -> void;
+
+    auto GetTileSize() const noexcept -> uint32_t
+    {
+        return m_tileSize;
+    }
+
+    auto GetThreadCount() const noexcept -> uint32_t
+    {
+        return m_pool.GetThreadCount();
+    }
+
+    /// <summary>
+    /// The threads tiles run on, for other parallel work between runs, e.g.
+    /// BVH builds, so that it does not need threads of its own.
+    /// </summary>
+    auto GetPool() noexcept -> TaskPool&
+    {
+        return m_pool;
+    }
+
+    /// <summary>
+    /// Returns one entry per thread with the timings of the last Run().
+    /// </summary>
+    auto GetThreadStats() const noexcept -> const std::vector<ThreadStats>&
+    {
+        return m_stats;
+    }
+
+    /// <summary>
+    /// Wall time of the last Run() in milliseconds.
+    /// </summary>
+    auto GetLastRunMs() const noexcept -> double
+    {
+        return m_lastRunMs;
+    }
+
+  private:
+    struct alignas(64) WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> tiles;
+    };
+
+    auto Execute(uint32_t threadIdx, const TileFunction& fn) -> void;
+    auto PopLocal(uint32_t threadIdx, uint32_t& tileIdx) -> bool;
+    auto Steal(uint32_t thiefIdx, uint32_t& tileIdx) -> bool;
+
+    // Last destroyed, so no worker outlives the queues
+    TaskPool m_pool;
+    uint32_t m_tileSize;
+
+    std::unique_ptr<WorkQueue[]> m_queues;
+    std::vector<ThreadStats> m_stats;
+    double m_lastRunMs = 0.0;
+
+    // Tiles of the run currently being executed
+    std::vector<Tile> m_tiles;
+};
+
+} // namespace pathtracer
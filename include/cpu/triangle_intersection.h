@@ -0,0 +1,468 @@
+#pragma once
+
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+#include "utils/aligned_allocator.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Per-ray constants of the watertight ray/triangle test of Woop, Benthin
+/// and Wald (2013). The test translates vertices to the ray origin and
+/// shears them so the ray runs along +z; kz is the axis in which the
+/// direction is largest, kx and ky the other two, swapped to keep the
+/// winding. Edges shared by two triangles then get identical edge function
+/// values in both, so no ray slips through the gap between them.
+/// </summary>
+struct WatertightRay
+{
+    explicit WatertightRay(const ray& r) : origin(r.origin())
+    {
+        const glm::vec3& d = r.direction();
+        const glm::vec3 a = glm::abs(d);
+        kz = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        if (d[kz] < 0.0f)
+            std::swap(kx, ky);
+
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1.0f / d[kz];
+    }
+
+    glm::vec3 origin;
+    int kx;
+    int ky;
+    int kz;
+    float sx;
+    float sy;
+    float sz;
+};
+
+/// <summary>
+/// Closest triangle hit. u and v are the barycentric weights of the second
+/// and third vertex.
+/// </summary>
+struct TriangleHit
+{
+    float t = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+    uint32_t triIdx = std::numeric_limits<uint32_t>::max();
+};
+
+/// <summary>
+/// Edge functions of a triangle whose vertices were translated to the ray
+/// origin and sheared, recomputed in double precision. Only needed when
+/// one of them came out exactly 0 in float, where rounding could otherwise
+/// break watertightness.
+/// </summary>
+inline auto WatertightEdgesDouble(float ax, float ay, float bx, float by,
+                                  float cx, float cy, float& u, float& v,
+                                  float& w) -> void
+{
+    u = static_cast<float>(static_cast<double>(cx) * by -
+                           static_cast<double>(cy) * bx);
+    v = static_cast<float>(static_cast<double>(ax) * cy -
+                           static_cast<double>(ay) * cx);
+    w = static_cast<float>(static_cast<double>(bx) * ay -
+                           static_cast<double>(by) * ax);
+}
+
+/// <summary>
+/// One ray against one triangle. Returns true for a hit with
+/// 0 < t < tMax and fills in hit, leaving triIdx alone.
+/// <para></para>
+/// IntersectTriangleGroup() performs exactly these operations in this
+/// order, so both produce bit-identical results.
+/// </summary>
+inline auto IntersectTriangle(const WatertightRay& r, const glm::vec3& v0,
+                              const glm::vec3& v1, const glm::vec3& v2,
+                              float tMax, TriangleHit& hit) -> bool
+{
+    // Vertices relative to the ray origin
+    const glm::vec3 a = v0 - r.origin;
+    const glm::vec3 b = v1 - r.origin;
+    const glm::vec3 c = v2 - r.origin;
+
+    // Shear so the ray runs along +z
+    const float ax = a[r.kx] - r.sx * a[r.kz];
+    const float ay = a[r.ky] - r.sy * a[r.kz];
+    const float bx = b[r.kx] - r.sx * b[r.kz];
+    const float by = b[r.ky] - r.sy * b[r.kz];
+    const float cx = c[r.kx] - r.sx * c[r.kz];
+    const float cy = c[r.ky] - r.sy * c[r.kz];
+
+    // Scaled barycentrics
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if (u == 0.0f || v == 0.0f || w == 0.0f)
+        WatertightEdgesDouble(ax, ay, bx, by, cx, cy, u, v, w);
+
+    // The ray passes inside (or on an edge) if all three agree in sign
+    const bool inside = (u >= 0.0f && v >= 0.0f && w >= 0.0f) ||
+                        (u <= 0.0f && v <= 0.0f && w <= 0.0f);
+    const float det = u + v + w;
+    const float scaledT =
+        u * (r.sz * a[r.kz]) + v * (r.sz * b[r.kz]) + w * (r.sz * c[r.kz]);
+    const float t = scaledT / det;
+    if (!inside || det == 0.0f || !(t > 0.0f) || !(t < tMax))
+        return false;
+
+    hit.t = t;
+    hit.u = v / det;
+    hit.v = w / det;
+    return true;
+}
+
+/// <summary>
+/// N triangles packed for IntersectTriangleGroup(): the vertex coordinates
+/// of all triangles as structure of arrays, so each step of the test runs
+/// on all N at once. Unused lanes hold NaN vertices that never hit.
+/// </summary>
+template <size_t N> struct alignas(32) TriangleGroup
+{
+    float v0x[N];
+    float v0y[N];
+    float v0z[N];
+    float v1x[N];
+    float v1y[N];
+    float v1z[N];
+    float v2x[N];
+    float v2y[N];
+    float v2z[N];
+    uint32_t triIdx[N];
+
+    /// <summary>
+    /// Gathers count (at most N) triangles of mesh, given by index, from
+    /// the mesh's shared vertex arrays.
+    /// </summary>
+    static auto Pack(const TriangleMesh& mesh, const uint32_t* tris,
+                     uint32_t count) -> TriangleGroup
+    {
+        constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+        const float* px = mesh.GetPositionX();
+        const float* py = mesh.GetPositionY();
+        const float* pz = mesh.GetPositionZ();
+        const uint32_t* indices = mesh.GetIndices();
+
+        TriangleGroup group;
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (i >= count)
+            {
+                group.v0x[i] = group.v0y[i] = group.v0z[i] = NaN;
+                group.v1x[i] = group.v1y[i] = group.v1z[i] = NaN;
+                group.v2x[i] = group.v2y[i] = group.v2z[i] = NaN;
+                group.triIdx[i] = std::numeric_limits<uint32_t>::max();
+                continue;
+            }
+
+            const uint32_t* tri = indices + static_cast<size_t>(tris[i]) * 3;
+            group.v0x[i] = px[tri[0]];
+            group.v0y[i] = py[tri[0]];
+            group.v0z[i] = pz[tri[0]];
+            group.v1x[i] = px[tri[1]];
+            group.v1y[i] = py[tri[1]];
+            group.v1z[i] = pz[tri[1]];
+            group.v2x[i] = px[tri[2]];
+            group.v2y[i] = py[tri[2]];
+            group.v2z[i] = pz[tri[2]];
+            group.triIdx[i] = tris[i];
+        }
+        return group;
+    }
+};
+
+/// <summary>
+/// One ray against the N triangles of a group: the same test as
+/// IntersectTriangle(), written as branch-free loops over the lanes so they
+/// compile to SIMD. Returns true if some triangle is hit with 0 < t < tMax
+/// and fills in hit with the closest one; ties go to the lower lane.
+/// </summary>
+template <size_t N>
+auto IntersectTriangleGroup(const WatertightRay& r,
+                            const TriangleGroup<N>& group, float tMax,
+                            TriangleHit& hit) -> bool
+{
+    // Pick the coordinate arrays in sheared order once per group
+    const float* v0[3] = {group.v0x, group.v0y, group.v0z};
+    const float* v1[3] = {group.v1x, group.v1y, group.v1z};
+    const float* v2[3] = {group.v2x, group.v2y, group.v2z};
+    const float ox = r.origin[r.kx];
+    const float oy = r.origin[r.ky];
+    const float oz = r.origin[r.kz];
+
+    float ax[N], ay[N], az[N];
+    float bx[N], by[N], bz[N];
+    float cx[N], cy[N], cz[N];
+    float u[N], v[N], w[N];
+    int32_t anyZero = 0;
+    for (size_t i = 0; i < N; ++i)
+    {
+        az[i] = v0[r.kz][i] - oz;
+        bz[i] = v1[r.kz][i] - oz;
+        cz[i] = v2[r.kz][i] - oz;
+        ax[i] = (v0[r.kx][i] - ox) - r.sx * az[i];
+        ay[i] = (v0[r.ky][i] - oy) - r.sy * az[i];
+        bx[i] = (v1[r.kx][i] - ox) - r.sx * bz[i];
+        by[i] = (v1[r.ky][i] - oy) - r.sy * bz[i];
+        cx[i] = (v2[r.kx][i] - ox) - r.sx * cz[i];
+        cy[i] = (v2[r.ky][i] - oy) - r.sy * cz[i];
+
+        u[i] = cx[i] * by[i] - cy[i] * bx[i];
+        v[i] = ax[i] * cy[i] - ay[i] * cx[i];
+        w[i] = bx[i] * ay[i] - by[i] * ax[i];
+        anyZero |= static_cast<int32_t>(u[i] == 0.0f) |
+                   static_cast<int32_t>(v[i] == 0.0f) |
+                   static_cast<int32_t>(w[i] == 0.0f);
+    }
+
+    // Rays through a vertex or along an edge: redo those lanes in double
+    if (anyZero != 0)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (u[i] == 0.0f || v[i] == 0.0f || w[i] == 0.0f)
+            {
+                WatertightEdgesDouble(ax[i], ay[i], bx[i], by[i], cx[i],
+                                      cy[i], u[i], v[i], w[i]);
+            }
+        }
+    }
+
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    float t[N];
+    float det[N];
+    for (size_t i = 0; i < N; ++i)
+    {
+        const bool inside = (u[i] >= 0.0f && v[i] >= 0.0f && w[i] >= 0.0f) ||
+                            (u[i] <= 0.0f && v[i] <= 0.0f && w[i] <= 0.0f);
+        det[i] = u[i] + v[i] + w[i];
+        const float scaledT = u[i] * (r.sz * az[i]) + v[i] * (r.sz * bz[i]) +
+                              w[i] * (r.sz * cz[i]);
+        const float tLane = scaledT / det[i];
+        const bool valid =
+            inside & (det[i] != 0.0f) & (tLane > 0.0f) & (tLane < tMax);
+        t[i] = valid ? tLane : INF;
+    }
+
+    size_t best = 0;
+    for (size_t i = 1; i < N; ++i)
+    {
+        best = t[i] < t[best] ? i : best;
+    }
+    if (t[best] == INF)
+        return false;
+
+    hit.t = t[best];
+    hit.u = v[best] / det[best];
+    hit.v = w[best] / det[best];
+    hit.triIdx = group.triIdx[best];
+    return true;
+}
+
+/// <summary>
+/// How the leaves of a MeshBvh store their triangles.
+/// </summary>
+enum class TriangleLeafLayout
+{
+    /// <summary>
+    /// Leaves reference triangle indices, and every visit gathers the
+    /// vertices from the mesh's shared arrays. No copy of the geometry.
+    /// </summary>
+    Indexed,
+
+    /// <summary>
+    /// Every leaf is one TriangleGroup prepared at build time, so a visit
+    /// is a few contiguous loads, at the cost of storing each triangle's
+    /// vertices again.
+    /// </summary>
+    Packed,
+};
+
+/// <summary>
+/// Bounding box of every triangle of the mesh, in index order.
+/// </summary>
+auto ComputeTriangleBounds(const TriangleMesh& mesh) -> std::vector<Aabb>;
+
+/// <summary>
+/// N-wide BVH over the triangles of one mesh whose leaves hold at most N
+/// triangles, so each leaf is a single call to IntersectTriangleGroup().
+/// </summary>
+template <size_t N> class MeshBvh
+{
+  public:
+    using Group = TriangleGroup<N>;
+    using GroupArray = std::vector<Group, utils::AlignedAllocator<Group, 64>>;
+
+    MeshBvh() = default;
+
+    /// <summary>
+    /// Builds the tree over mesh, replacing the previous one. Leaves are
+    /// capped at N triangles whatever options.maxLeafSize says.
+    /// </summary>
+    auto Build(const TriangleMesh& mesh,
+               TriangleLeafLayout layout = TriangleLeafLayout::Packed,
+               const BvhBuildOptions& options = {}, TaskPool* pool = nullptr)
+        -> void;
+
+    /// <summary>
+    /// Follows vertices that moved since the last Build() or Update(); the
+    /// triangles themselves must be the same. Refits or rebuilds as
+    /// Bvh::Update() decides, then collapses and packs again.
+    /// </summary>
+    auto Update(const TriangleMesh& mesh, TaskPool* pool = nullptr) -> void;
+
+    /// <summary>
+    /// Adopts a finished tree in place of a build, e.g. one read back from
+    /// a scene cache: the parts GetBvh(), GetWideBvh() and GetGroups()
+    /// returned for a tree with the given layout.
+    /// </summary>
+    auto Assign(Bvh bvh, WideBvh<N> wide, GroupArray groups,
+                TriangleLeafLayout layout) -> void;
+
+    /// <summary>
+    /// Whether every part of the tree is consistent with a mesh of
+    /// triangleCount triangles and safe to traverse, e.g. after Assign()
+    /// from a file (see Bvh::IsValid()).
+    /// </summary>
+    auto IsValid(uint32_t triangleCount) const -> bool;
+
+    auto Clear() -> void;
+
+    auto IsEmpty() const noexcept -> bool
+    {
+        return m_wide.IsEmpty();
+    }
+
+    auto GetLayout() const noexcept -> TriangleLeafLayout
+    {
+        return m_layout;
+    }
+
+    auto GetBvh() const noexcept -> const Bvh&
+    {
+        return m_bvh;
+    }
+
+    auto GetWideBvh() const noexcept -> const WideBvh<N>&
+    {
+        return m_wide;
+    }
+
+    /// <summary>
+    /// The packed leaves in leaf order; empty for the indexed layout.
+    /// </summary>
+    auto GetGroups() const noexcept -> const GroupArray&
+    {
+        return m_groups;
+    }
+
+    /// <summary>
+    /// Bytes of wide nodes plus leaf data that traversal touches.
+    /// </summary>
+    auto GetTraversalBytes() const noexcept -> size_t;
+
+    /// <summary>
+    /// Finds the closest triangle of mesh, which must be the mesh the tree
+    /// was built over, hit by r with 0 < t < tMax.
+    /// </summary>
+    auto Intersect(const ray& r, const TriangleMesh& mesh, float tMax,
+                   TriangleHit& hit) const -> bool
+    {
+        const WatertightRay wr(r);
+        float tClosest = tMax;
+        return m_wide.IntersectLeaves(
+            r, tClosest,
+            [&](uint32_t first, uint32_t count, float& tLeaf) -> bool
+            {
+                const bool leafHit =
+                    m_layout == TriangleLeafLayout::Packed
+                        ? IntersectTriangleGroup(wr, m_groups[first], tLeaf,
+                                                 hit)
+                        : IntersectTriangleGroup(
+                              wr,
+                              Group::Pack(mesh,
+                                          m_wide.GetPrimIndices().data() +
+                                              first,
+                                          count),
+                              tLeaf, hit);
+                if (leafHit)
+                    tLeaf = hit.t;
+                return leafHit;
+            });
+    }
+
+    /// <summary>
+    /// Whether any triangle of mesh is hit by r with 0 < t < tMax. Stops at
+    /// the first one found, so which one is unspecified.
+    /// </summary>
+    auto IsOccluded(const ray& r, const TriangleMesh& mesh, float tMax) const
+        -> bool
+    {
+        const WatertightRay wr(r);
+        TriangleHit hit;
+        return m_wide.IsOccluded(
+            r, tMax,
+            [&](uint32_t first, uint32_t count, float tLeaf) -> bool
+            {
+                return m_layout == TriangleLeafLayout::Packed
+                           ? IntersectTriangleGroup(wr, m_groups[first],
+                                                    tLeaf, hit)
+                           : IntersectTriangleGroup(
+                                 wr,
+                                 Group::Pack(mesh,
+                                             m_wide.GetPrimIndices().data() +
+                                                 first,
+                                             count),
+                                 tLeaf, hit);
+            });
+    }
+
+  private:
+    /// <summary>
+    /// Collapses m_bvh into m_wide and packs the leaves if needed.
+    /// </summary>
+    auto Finish(const TriangleMesh& mesh) -> void;
+
+    Bvh m_bvh;
+    WideBvh<N> m_wide;
+    GroupArray m_groups;
+    TriangleLeafLayout m_layout = TriangleLeafLayout::Packed;
+};
+
+using MeshBvh4 = MeshBvh<4>;
+using MeshBvh8 = MeshBvh<8>;
+
+extern template class MeshBvh<4>;
+extern template class MeshBvh<8>;
+
+/// <summary>
+/// Scalar reference: one ray through a binary BVH over the mesh (see
+/// ComputeTriangleBounds()), one IntersectTriangle() per triangle. Same
+/// results as MeshBvh::Intersect(), except that ties between equally
+/// distant triangles may resolve differently.
+/// </summary>
+auto IntersectTriangles(const ray& r, const TriangleMesh& mesh,
+                        const Bvh& bvh, float tMax, TriangleHit& hit)
+    -> bool;
+
+} // namespace pathtracer
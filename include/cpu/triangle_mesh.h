@@ -0,0 +1,122 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Indexed triangle mesh. Vertex positions are stored as structure of
+/// arrays (x, y and z in separate arrays) and shared by all triangles that
+/// use them; each triangle is three consecutive entries of the index array.
+/// </summary>
+class TriangleMesh
+{
+  public:
+    TriangleMesh() = default;
+
+    /// <summary>
+    /// Appends a vertex and returns its index.
+    /// </summary>
+    auto AddVertex(const glm::vec3& position) -> uint32_t;
+
+    /// <summary>
+    /// Appends a triangle over three existing vertices and returns its
+    /// index. Throws std::invalid_argument if a vertex index is invalid.
+    /// </summary>
+    auto AddTriangle(uint32_t i0, uint32_t i1, uint32_t i2) -> uint32_t;
+
+    /// <summary>
+    /// Moves vertex idx. Every triangle using it moves along.
+    /// </summary>
+    auto SetVertex(uint32_t idx, const glm::vec3& position) -> void
+    {
+        m_positionX[idx] = position.x;
+        m_positionY[idx] = position.y;
+        m_positionZ[idx] = position.z;
+    }
+
+    auto Reserve(uint32_t vertexCount, uint32_t triangleCount) -> void;
+
+    /// <summary>
+    /// Resizes to vertexCount vertices and triangleCount triangles, for bulk
+    /// writers such as the importers that fill the arrays in place through
+    /// the mutable pointers below. New entries are zero. Unlike
+    /// AddTriangle(), nothing checks the indices written that way.
+    /// </summary>
+    auto Resize(uint32_t vertexCount, uint32_t triangleCount) -> void;
+
+    auto Clear() -> void;
+
+    auto GetVertex(uint32_t idx) const -> glm::vec3
+    {
+        return {m_positionX[idx], m_positionY[idx], m_positionZ[idx]};
+    }
+
+    /// <summary>
+    /// Vertex indices of triangle idx.
+    /// </summary>
+    auto GetTriangle(uint32_t idx) const -> glm::uvec3
+    {
+        const uint32_t* i = &m_indices[static_cast<size_t>(idx) * 3];
+        return {i[0], i[1], i[2]};
+    }
+
+    auto GetVertexCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_positionX.size());
+    }
+
+    auto GetTriangleCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_indices.size() / 3);
+    }
+
+    auto GetPositionX() const noexcept -> const float*
+    {
+        return m_positionX.data();
+    }
+    auto GetPositionY() const noexcept -> const float*
+    {
+        return m_positionY.data();
+    }
+    auto GetPositionZ() const noexcept -> const float*
+    {
+        return m_positionZ.data();
+    }
+    auto GetIndices() const noexcept -> const uint32_t*
+    {
+        return m_indices.data();
+    }
+
+    auto GetPositionX() noexcept -> float*
+    {
+        return m_positionX.data();
+    }
+    auto GetPositionY() noexcept -> float*
+    {
+        return m_positionY.data();
+    }
+    auto GetPositionZ() noexcept -> float*
+    {
+        return m_positionZ.data();
+    }
+    auto GetIndices() noexcept -> uint32_t*
+    {
+        return m_indices.data();
+    }
+
+  private:
+    std::vector<float> m_positionX;
+    std::vector<float> m_positionY;
+    std::vector<float> m_positionZ;
+    std::vector<uint32_t> m_indices;
+};
+
+} // namespace pathtracer
+
+#endif // TRIANGLE_MESH_H
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+namespace pathtracer
+{
+class Camera;
+class Framebuffer;
+class Scene;
+
+/// <summary>
+/// Portable render entry point. Implementations write the image for a frame
+/// into a CPU framebuffer and have no dependency on DX12 or Win32, so they can
+/// run headless (e.g. from pathtracer_cli) or be presented by the DX12 front
+/// end through a FramebufferPresenter.
+/// </summary>
+class IFrameRenderer
+{
+  public:
+    IFrameRenderer() = default;
+    virtual ~IFrameRenderer() = default;
+
+    /// <summary>
+    /// Renders the scene into the framebuffer. This method should be called
+    /// every frame to update the framebuffer with the latest image.
+    /// </summary>
+    /// <param name="framebuffer">The framebuffer to write the image to. Must
+    /// match the size passed to the last call to Resize().</param>
+    /// <param name="camera">The camera defining the view for the current
+    /// frame.</param>
+    /// <param name="frameIdx">The index of the current frame.</param>
+    /// <param name="scene">The scene to render. Accumulation restarts when
+    /// it reports changes.</param>
+    virtual auto Render(Framebuffer& framebuffer, const Camera& camera,
+                        const uint32_t frameIdx, const Scene& scene)
+        -> void = 0;
+
+    /// <summary>
+    /// Resizes internal resources to match the new width and height of the
+    /// output image.
+    /// </summary>
+    virtual auto Resize(const uint32_t width, const uint32_t height)
+        -> void = 0;
+
+    /// <summary>
+    /// Returns the name of the renderer for display in the UI.
+    /// </summary>
+    virtual auto GetName() const -> const char* = 0;
+
+    /// <summary>
+    /// Discards all progressively accumulated samples. Renderers reset
+    /// automatically when Camera::IsDirty() is set or the scene has changes;
+    /// call this when something else that affects the image changes.
+    /// </summary>
+    virtual auto ResetAccumulation() -> void {}
+
+    /// <summary>
+    /// Whether the accumulated image has converged, so that rendering more
+    /// frames would not change it while Camera::IsDirty() is false and the
+    /// scene has no changes. Callers may then stop rendering until either
+    /// changes. Renderers that cannot tell always return false.
+    /// </summary>
+    virtual auto IsConverged() const -> bool
+    {
+        return false;
+    }
+};
+
+} // namespace pathtracer
@@ -24,12 +24,13 @@ class IPathTracer
     /// <param name="camera">The camera defining the view for the current
     /// frame.</param>
     /// <param name="frameIdx">The index of the current frame.</param>
+    /// <param name="scene">The scene to render. Accumulation restarts when
+    /// it reports changes.</param>
     virtual auto Render(ID3D12GraphicsCommandList* commandList,
                         ID3D12Resource* renderTarget,
                         D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle,
-                        const Camera& camera, const UINT frameIdx
-                        // const Scene& scene
-                        ) -> void = 0;
+                        const Camera& camera, const UINT frameIdx,
+                        const Scene& scene) -> void = 0;
 
     /// <summary>
     /// Resizes internal resources to match the new width and height of the
@@ -43,8 +44,23 @@ class IPathTracer
     /// </summary>
     virtual auto GetName() const -> const char* = 0;
 
-    // TODO: add method to reset accumulation when camera moves or scene changes
-    // virtual auto ResetAccumulation() -> void {}
+    /// <summary>
+    /// Discards all progressively accumulated samples. Path tracers reset
+    /// automatically when Camera::IsDirty() is set or the scene has changes;
+    /// call this when something else that affects the image changes.
+    /// </summary>
+    virtual auto ResetAccumulation() -> void {}
+
+    /// <summary>
+    /// Whether the accumulated image has converged, so that rendering more
+    /// frames would not change it while Camera::IsDirty() is false and the
+    /// scene has no changes. Path tracers that cannot tell always return
+    /// false.
+    /// </summary>
+    virtual auto IsConverged() const -> bool
+    {
+        return false;
+    }
 };
 
 } // namespace pathtracer
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace pathtracer
+{
+/// <summary>
+/// Source of the numbers a renderer turns into pixel positions, light
+/// points and bounce directions. A sample is addressed by its pixel, its
+/// index among the pixel's samples and a dimension, and every value is a
+/// pure function of that address, so any thread can compute any sample
+/// without shared state and a frame renders the same on any thread count.
+/// <para></para>
+/// Get2D() draws two dimensions as one point, which samplers may stratify
+/// jointly, so its values need not match Get1D() for either dimension. A
+/// caller takes each dimension from one of them only, and starts pairs at
+/// even dimensions.
+/// </summary>
+class ISampler
+{
+  public:
+    ISampler() = default;
+    virtual ~ISampler() = default;
+
+    /// <summary>
+    /// Returns dimension dimension of sample sampleIdx of pixel (x, y), in
+    /// [0, 1).
+    /// </summary>
+    virtual auto Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                       uint32_t dimension) const -> float = 0;
+
+    /// <summary>
+    /// Returns a point for dimensions dimension and dimension + 1 of sample
+    /// sampleIdx of pixel (x, y), in [0, 1)^2.
+    /// </summary>
+    virtual auto Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                       uint32_t dimension) const -> glm::vec2
+    {
+        return {Get1D(x, y, sampleIdx, dimension),
+                Get1D(x, y, sampleIdx, dimension + 1)};
+    }
+
+    /// <summary>
+    /// Returns the name of the sampler for display.
+    /// </summary>
+    virtual auto GetName() const -> const char* = 0;
+};
+
+} // namespace pathtracer
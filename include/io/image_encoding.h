@@ -0,0 +1,82 @@
+#ifndef IMAGE_ENCODING_H
+#define IMAGE_ENCODING_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace pathtracer
+{
+class TaskPool;
+
+enum class ImageFormat
+{
+    /// <summary>
+    /// Binary (P6) PPM of 8-bit sRGB pixels.
+    /// </summary>
+    Ppm,
+
+    /// <summary>
+    /// 8-bit sRGB RGB PNG. Needs stb (USE_STB).
+    /// </summary>
+    Png,
+
+    /// <summary>
+    /// Scanline OpenEXR of half-float linear RGB, ZIP-compressed in blocks
+    /// of 16 scanlines with stb, uncompressed without.
+    /// </summary>
+    Exr,
+};
+
+/// <summary>
+/// The format of path by its extension: .ppm, .png or .exr, in any case.
+/// Throws std::invalid_argument for any other extension.
+/// </summary>
+auto GetImageFormat(const std::filesystem::path& path) -> ImageFormat;
+
+/// <summary>
+/// Whether EncodePng() is available, i.e. the core was built with stb.
+/// </summary>
+auto IsPngSupported() noexcept -> bool;
+
+/// <summary>
+/// Whether the format takes linear radiance, as opposed to resolved RGBA8
+/// pixels (see ImageResolver).
+/// </summary>
+constexpr auto IsLinearFormat(ImageFormat format) noexcept -> bool
+{
+    return format == ImageFormat::Exr;
+}
+
+/// <summary>
+/// Encodes width x height RGBA8 pixels, row-major, into a PPM file's
+/// bytes. Alpha is dropped.
+/// </summary>
+auto EncodePpm(uint32_t width, uint32_t height,
+               std::span<const uint32_t> pixels) -> std::vector<uint8_t>;
+
+/// <summary>
+/// Encodes RGBA8 pixels into a PNG file's bytes, dropping alpha. The image
+/// is filtered and deflated in independent blocks of scanlines on the
+/// threads of pool, which are then joined into the single zlib stream PNG
+/// requires. Throws std::runtime_error without stb.
+/// </summary>
+auto EncodePng(uint32_t width, uint32_t height,
+               std::span<const uint32_t> pixels, TaskPool& pool)
+    -> std::vector<uint8_t>;
+
+/// <summary>
+/// Encodes linear RGB (alpha is dropped) into an OpenEXR file's bytes,
+/// with every block of scanlines converted to half floats and compressed
+/// on the threads of pool.
+/// </summary>
+auto EncodeExr(uint32_t width, uint32_t height,
+               std::span<const glm::vec4> pixels, TaskPool& pool)
+    -> std::vector<uint8_t>;
+
+} // namespace pathtracer
+
+#endif // IMAGE_ENCODING_H
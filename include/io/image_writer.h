@@ -0,0 +1,148 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "cpu/task_pool.h"
+#include "io/image_encoding.h"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Encodes and writes images on a thread of its own, so that saving frames
+/// of a batch render never holds up the threads tracing the next one.
+/// <para></para>
+/// Every submitted image is a snapshot the writer owns, moved in by the
+/// caller, so the framebuffer may change right after submitting. Snapshots
+/// wait in a queue of bounded length, which bounds the memory they take;
+/// Submit() waits for room in it, while TrySubmit() drops the image
+/// instead. The writer thread encodes one image at a time, with PNG and
+/// EXR compression spread over the threads of its own TaskPool.
+/// <para></para>
+/// Files are written under a temporary name and then renamed, so a reader
+/// never sees a partial image. Errors surface from the next Flush().
+/// </summary>
+class AsyncImageWriter
+{
+  public:
+    static constexpr uint32_t DEFAULT_QUEUE_CAPACITY = 4;
+
+    /// <summary>
+    /// Starts the writer thread.
+    /// </summary>
+    /// <param name="threadCount">Threads encoding an image, including the
+    /// writer thread. 0 uses every hardware thread.</param>
+    /// <param name="queueCapacity">Most images waiting to be written, not
+    /// counting the one being written.</param>
+    explicit AsyncImageWriter(uint32_t threadCount = 0,
+                              uint32_t queueCapacity = DEFAULT_QUEUE_CAPACITY);
+
+    /// <summary>
+    /// Writes every image still queued, then stops the writer thread.
+    /// Errors not collected by Flush() are lost.
+    /// </summary>
+    ~AsyncImageWriter();
+
+    // Disable copy/move, the writer thread holds a pointer to this
+    AsyncImageWriter(const AsyncImageWriter&) = delete;
+    AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+    /// <summary>
+    /// Queues resolved RGBA8 pixels (see ImageResolver) for a .ppm or .png
+    /// file, waiting while the queue is full. The format comes from the
+    /// extension of path; std::invalid_argument is thrown here, not on the
+    /// writer thread, if it is unknown, does not take 8-bit pixels or if
+    /// pixels does not hold width x height pixels, and std::runtime_error
+    /// for PNG without stb.
+    /// </summary>
+    auto Submit(const std::filesystem::path& path, uint32_t width,
+                uint32_t height, std::vector<uint32_t> pixels) -> void;
+
+    /// <summary>
+    /// Queues linear radiance, e.g. a copy of a Framebuffer, for an .exr
+    /// file, waiting while the queue is full.
+    /// </summary>
+    auto Submit(const std::filesystem::path& path, uint32_t width,
+                uint32_t height, std::vector<glm::vec4> radiance) -> void;
+
+    /// <summary>
+    /// As Submit(), but drops the image and returns false if the queue is
+    /// full rather than wait.
+    /// </summary>
+    auto TrySubmit(const std::filesystem::path& path, uint32_t width,
+                   uint32_t height, std::vector<uint32_t> pixels) -> bool;
+
+    auto TrySubmit(const std::filesystem::path& path, uint32_t width,
+                   uint32_t height, std::vector<glm::vec4> radiance) -> bool;
+
+    /// <summary>
+    /// Blocks until every submitted image is written, then rethrows the
+    /// first error the writer ran into since the last Flush(), if any.
+    /// </summary>
+    auto Flush() -> void;
+
+    auto GetWrittenCount() const -> uint64_t;
+
+    /// <summary>
+    /// Images TrySubmit() dropped because the queue was full.
+    /// </summary>
+    auto GetDroppedCount() const -> uint64_t;
+
+    /// <summary>
+    /// Time to encode and write the last image, in milliseconds.
+    /// </summary>
+    auto GetLastWriteMs() const -> double;
+
+  private:
+    struct Job
+    {
+        std::filesystem::path path;
+        ImageFormat format = ImageFormat::Ppm;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        // One of the two, by format
+        std::vector<uint32_t> pixels;
+        std::vector<glm::vec4> radiance;
+    };
+
+    static auto MakeJob(const std::filesystem::path& path, uint32_t width,
+                        uint32_t height, size_t pixelCount, bool linear)
+        -> Job;
+
+    auto Enqueue(Job&& job, bool wait) -> bool;
+    auto WriterLoop() -> void;
+    auto Write(const Job& job) -> void;
+
+    uint32_t m_capacity;
+
+    // The writer thread is thread 0 of the pool
+    TaskPool m_pool;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_jobDone;
+    std::deque<Job> m_queue;
+    bool m_writing = false;
+    bool m_shutdown = false;
+    std::exception_ptr m_error;
+    uint64_t m_writtenCount = 0;
+    uint64_t m_droppedCount = 0;
+    double m_lastWriteMs = 0.0;
+
+    // Last, so it starts after everything it uses
+    std::thread m_thread;
+};
+
+} // namespace pathtracer
+
+#endif // IMAGE_WRITER_H
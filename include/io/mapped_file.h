@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace pathtracer
+{
+/// <summary>
+/// A whole file mapped read-only into memory. Pages are read from disk (or
+/// the page cache) on first touch, so several threads parsing different
+/// parts of the file read it in parallel and nothing is copied into an
+/// intermediate buffer.
+/// </summary>
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+
+    /// <summary>
+    /// Maps the file at path. Throws std::runtime_error if it cannot be
+    /// opened or mapped. Empty files map to an empty view.
+    /// </summary>
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Disable copy, the mapping is owned
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    auto GetData() const noexcept -> const char*
+    {
+        return m_data;
+    }
+
+    auto GetSize() const noexcept -> size_t
+    {
+        return m_size;
+    }
+
+    auto GetView() const noexcept -> std::string_view
+    {
+        return {m_data, m_size};
+    }
+
+  private:
+    auto Unmap() noexcept -> void;
+
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // namespace pathtracer
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,60 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include "cpu/triangle_mesh.h"
+
+#include <filesystem>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Loads the triangles of a Wavefront OBJ file. Only vertex positions
+/// ("v") and faces ("f") are read; polygons are split into triangle fans
+/// and negative (relative) indices are resolved. Normals, texture
+/// coordinates, groups and materials are skipped.
+/// <para></para>
+/// The file is memory-mapped and cut at line boundaries into chunks that
+/// are parsed in parallel: a first pass counts the vertices, triangles and
+/// lines of every chunk, a prefix sum over the counts gives each chunk its
+/// place in the mesh, and a second pass parses straight into it.
+/// <para></para>
+/// Throws std::runtime_error with the line number if the file cannot be
+/// read or is malformed.
+/// </summary>
+/// <param name="pool">Threads to parse on. nullptr creates a pool over
+/// every hardware thread for files large enough to benefit.</param>
+auto LoadObj(const std::filesystem::path& path, TaskPool* pool = nullptr)
+    -> TriangleMesh;
+
+/// <summary>
+/// Loads the triangles of a binary (either byte order) PLY file: x, y and
+/// z of the "vertex" element and the "vertex_indices" list of the "face"
+/// element, with polygons split into triangle fans. ASCII PLY is not
+/// supported.
+/// <para></para>
+/// The file is memory-mapped and records are decoded in parallel straight
+/// from the mapping into the mesh. When every face is a triangle, face
+/// records have a fixed size and are addressed directly; otherwise one
+/// sequential pass over the face sizes finds where each chunk of faces
+/// starts and how many triangles it yields.
+/// <para></para>
+/// Throws std::runtime_error if the file cannot be read, is malformed or
+/// uses an unsupported layout.
+/// </summary>
+/// <param name="pool">Threads to decode on. nullptr creates a pool over
+/// every hardware thread for files large enough to benefit.</param>
+auto LoadPly(const std::filesystem::path& path, TaskPool* pool = nullptr)
+    -> TriangleMesh;
+
+/// <summary>
+/// Loads an .obj or .ply file, chosen by extension. Throws
+/// std::invalid_argument for any other extension.
+/// </summary>
+auto LoadMesh(const std::filesystem::path& path, TaskPool* pool = nullptr)
+    -> TriangleMesh;
+
+} // namespace pathtracer
+
+#endif // MESH_IMPORT_H
@@ -0,0 +1,68 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include "scene/scene.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace pathtracer
+{
+class TaskPool;
+
+/// <summary>
+/// Layout version of scene cache files. Caches of any other version are
+/// stale and get rebuilt.
+/// </summary>
+constexpr uint32_t SCENE_CACHE_VERSION = 1;
+
+/// <summary>
+/// 64-bit hash of the contents of the files, in order. Not cryptographic;
+/// it tells whether source assets changed. Large files are hashed in
+/// parallel chunks.
+/// </summary>
+/// <param name="pool">Threads to hash on. nullptr creates a pool over
+/// every hardware thread for files large enough to benefit.</param>
+auto HashFiles(std::span<const std::filesystem::path> files,
+               TaskPool* pool = nullptr) -> uint64_t;
+
+/// <summary>
+/// Writes the scene to a binary cache file: its structure-of-arrays
+/// geometry, materials and instances, and for every mesh its finished
+/// MeshBvh8 (the attached one, or one built here). Every array starts on a
+/// 64-byte boundary, so loading it is a memory copy, not a parse.
+/// <para></para>
+/// The cache is keyed by HashFiles(sources), the assets the scene was made
+/// from, plus their sizes and modification times. It is written to a
+/// temporary file that then replaces cachePath, so a reader never sees a
+/// partial cache. Throws std::runtime_error if it cannot be written.
+/// </summary>
+auto SaveSceneCache(const std::filesystem::path& cachePath,
+                    const Scene& scene,
+                    std::span<const std::filesystem::path> sources,
+                    TaskPool* pool = nullptr) -> void;
+
+/// <summary>
+/// Reads a scene written by SaveSceneCache(), with the cached BVHs attached
+/// to its meshes (Scene::SetMeshBvh()), or returns std::nullopt if there is
+/// no valid cache for the current contents of sources, including when one
+/// of them is missing.
+/// <para></para>
+/// The file is mapped and its arrays copied out into the scene; loose
+/// spheres and triangles are added back one by one. What the cache saves
+/// is parsing the sources and building the BVHs, not the copies.
+/// <para></para>
+/// Sources whose size and modification time still match the cache are not
+/// read at all. Otherwise they are hashed; if the contents turn out to be
+/// unchanged, e.g. after a checkout touched them, the cache is used and its
+/// recorded times are updated once the file is unmapped.
+/// </summary>
+auto LoadSceneCache(const std::filesystem::path& cachePath,
+                    std::span<const std::filesystem::path> sources,
+                    TaskPool* pool = nullptr) -> std::optional<Scene>;
+
+} // namespace pathtracer
+
+#endif // SCENE_CACHE_H
@@ -0,0 +1,241 @@
+#ifndef RAY_PACKET_H_
+#define RAY_PACKET_H_
+
+#include "ray/ray.h"
+
+#include <glm/glm.hpp>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/// NOTE TO SELF:
+/// Packets are plain fixed-width arrays in structure-of-arrays layout, and
+/// every operation is a straight loop over the lanes with no early exits. The
+/// compiler turns each loop into one vector instruction per component (4 lanes
+/// on SSE, 8 on AVX2, 16 on AVX-512 or 2x AVX2), so no intrinsics are needed
+/// and the same code runs everywhere. Inactive lanes are computed anyway and
+/// masked out at the end, which is cheaper than branching per lane.
+
+/// <summary>
+/// N floats, aligned so a whole packet fits in one vector register (or one
+/// cache line for N = 16).
+/// </summary>
+template <size_t N> struct alignas(N * sizeof(float)) FloatPacket
+{
+    float v[N];
+
+    auto operator[](size_t i) -> float&
+    {
+        return v[i];
+    }
+    auto operator[](size_t i) const -> const float&
+    {
+        return v[i];
+    }
+
+    static auto broadcast(float s) -> FloatPacket
+    {
+        FloatPacket p;
+        for (size_t i = 0; i < N; ++i)
+            p.v[i] = s;
+        return p;
+    }
+};
+
+/// <summary>
+/// N three-component vectors, one FloatPacket per component.
+/// </summary>
+template <size_t N> struct Vec3Packet
+{
+    FloatPacket<N> x;
+    FloatPacket<N> y;
+    FloatPacket<N> z;
+
+    auto get(size_t lane) const -> glm::vec3
+    {
+        return {x[lane], y[lane], z[lane]};
+    }
+
+    auto set(size_t lane, const glm::vec3& value) -> void
+    {
+        x[lane] = value.x;
+        y[lane] = value.y;
+        z[lane] = value.z;
+    }
+};
+
+/// <summary>
+/// Per-lane active mask. Lanes are all-ones (active) or zero (inactive) so
+/// masks combine with plain bitwise operations in vector registers.
+/// </summary>
+template <size_t N> struct alignas(N * sizeof(int32_t)) PacketMask
+{
+    int32_t lanes[N];
+
+    static auto all() -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = -1;
+        return m;
+    }
+
+    static auto none() -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = 0;
+        return m;
+    }
+
+    /// <summary>
+    /// Mask with the first count lanes active, e.g. for the ragged end of a
+    /// row of pixels.
+    /// </summary>
+    static auto first(size_t count) -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = i < count ? -1 : 0;
+        return m;
+    }
+
+    auto test(size_t lane) const -> bool
+    {
+        return lanes[lane] != 0;
+    }
+
+    auto set(size_t lane, bool active) -> void
+    {
+        lanes[lane] = active ? -1 : 0;
+    }
+
+    /// <summary>
+    /// One bit per lane, lane 0 in the least significant bit.
+    /// </summary>
+    auto bits() const -> uint32_t
+    {
+        uint32_t b = 0;
+        for (size_t i = 0; i < N; ++i)
+            b |= static_cast<uint32_t>(lanes[i] & 1) << i;
+        return b;
+    }
+
+    auto any() const -> bool
+    {
+        return bits() != 0;
+    }
+
+    auto count() const -> int
+    {
+        return std::popcount(bits());
+    }
+
+    friend auto operator&(const PacketMask& a, const PacketMask& b)
+        -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = a.lanes[i] & b.lanes[i];
+        return m;
+    }
+
+    friend auto operator|(const PacketMask& a, const PacketMask& b)
+        -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = a.lanes[i] | b.lanes[i];
+        return m;
+    }
+
+    /// <summary>
+    /// Lanes active in a but not in b.
+    /// </summary>
+    friend auto and_not(const PacketMask& a, const PacketMask& b)
+        -> PacketMask
+    {
+        PacketMask m;
+        for (size_t i = 0; i < N; ++i)
+            m.lanes[i] = a.lanes[i] & ~b.lanes[i];
+        return m;
+    }
+};
+
+/// <summary>
+/// N rays in structure-of-arrays layout with an active mask. The packet
+/// counterpart of the scalar ray class; lane i of a packet behaves exactly
+/// like get(i).
+/// </summary>
+template <size_t N> class RayPacket
+{
+  public:
+    static_assert(N == 4 || N == 8 || N == 16,
+                  "RayPacket width must be 4, 8 or 16");
+
+    static constexpr size_t WIDTH = N;
+
+    RayPacket() : _active(PacketMask<N>::none())
+    {
+    }
+
+    /// <summary>
+    /// Writes a scalar ray into a lane and marks it active.
+    /// </summary>
+    auto set(size_t lane, const ray& r) -> void
+    {
+        _origin.set(lane, r.origin());
+        _direction.set(lane, r.direction());
+        _active.set(lane, true);
+    }
+
+    auto get(size_t lane) const -> ray
+    {
+        return ray(_origin.get(lane), _direction.get(lane));
+    }
+
+    auto origin() const -> const Vec3Packet<N>&
+    {
+        return _origin;
+    }
+    auto direction() const -> const Vec3Packet<N>&
+    {
+        return _direction;
+    }
+
+    auto active() const -> const PacketMask<N>&
+    {
+        return _active;
+    }
+    auto set_active(const PacketMask<N>& mask) -> void
+    {
+        _active = mask;
+    }
+
+    /// <summary>
+    /// Points along every ray: origin + t * direction, lane by lane.
+    /// </summary>
+    auto at(const FloatPacket<N>& t) const -> Vec3Packet<N>
+    {
+        Vec3Packet<N> p;
+        for (size_t i = 0; i < N; ++i)
+        {
+            p.x[i] = _origin.x[i] + t[i] * _direction.x[i];
+            p.y[i] = _origin.y[i] + t[i] * _direction.y[i];
+            p.z[i] = _origin.z[i] + t[i] * _direction.z[i];
+        }
+        return p;
+    }
+
+  private:
+    Vec3Packet<N> _origin;
+    Vec3Packet<N> _direction;
+    PacketMask<N> _active;
+};
+
+using RayPacket4 = RayPacket<4>;
+using RayPacket8 = RayPacket<8>;
+using RayPacket16 = RayPacket<16>;
+
+#endif
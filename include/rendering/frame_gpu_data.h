@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace pathtracer
+{
+/// <summary>
+/// Per-frame constants for compute.hlsl (cbuffer FrameData, register b1).
+/// Uploaded as root constants, so keep this a handful of 32-bit values.
+/// </summary>
+///
+/// <param name="frameIndex">Monotonic frame counter, used to decorrelate
+/// the random sub-pixel jitter between frames.</param>
+///
+/// <param name="resetAccumulation">Non-zero when the accumulation buffer
+/// must be discarded (camera or scene changed). The kernel then overwrites
+/// instead of adding to the running sum.</param>
+struct FrameGPUData
+{
+    uint32_t frameIndex;
+    uint32_t resetAccumulation;
+};
+
+static_assert(sizeof(FrameGPUData) % 4 == 0,
+              "Root constants must be a whole number of 32-bit values");
+
+} // namespace pathtracer
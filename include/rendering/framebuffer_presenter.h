@@ -0,0 +1,105 @@
+#pragma once
+
+#include "core/dx12_info_queue.h"
+#include "core/swap_chain.h"
+#include "cpu/framebuffer.h"
+#include "interfaces/frame_renderer_interface.h"
+#include "interfaces/pathtracer_interface.h"
+#include "scene/camera.h"
+
+#include <d3d12.h>
+
+#include <memory>
+#include <wrl.h>
+
+namespace pathtracer
+{
+/// <summary>
+/// Presents a portable IFrameRenderer through the DX12 front end. The wrapped
+/// renderer draws into a CPU framebuffer, which is packed to the back buffer
+/// format, written into a persistently mapped upload buffer and copied into
+/// the render target.
+/// </summary>
+class FramebufferPresenter : public IPathTracer
+{
+  public:
+    /// <summary>
+    /// Constructs a presenter for the given frame renderer.
+    /// </summary>
+    /// <param name="device">The D3D12 device to use for resource creation.</param>
+    /// <param name="infoQueue">The DX12 info queue for logging messages.</param>
+    /// <param name="frameRenderer">The portable renderer to present.</param>
+    /// <param name="width">The initial width of the render target.</param>
+    /// <param name="height">The initial height of the render target.</param>
+    FramebufferPresenter(ID3D12Device* device, DX12InfoQueue* infoQueue,
+                         std::unique_ptr<IFrameRenderer> frameRenderer,
+                         UINT width, UINT height);
+    ~FramebufferPresenter();
+
+    /// <summary>
+    /// Renders the frame on the CPU and records the copy of the result into
+    /// the render target.
+    /// </summary>
+    /// <param name="commandList">The command list to record the upload
+    /// commands.</param>
+    /// <param name="RenderTarget">The render target to which the image is
+    /// copied.</param>
+    /// <param name="rtvHandle">UNUSED.</param>
+    /// <param name="camera">The camera defining the view for the current
+    /// frame.</param>
+    /// <param name="frameIdx">The index of the current frame.</param>
+    /// <param name="scene">The scene to render.</param>
+    auto Render(ID3D12GraphicsCommandList* commandList,
+                ID3D12Resource* renderTarget,
+                D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, const Camera& camera,
+                const UINT frameIdx, const Scene& scene) -> void override;
+
+    /// <summary>
+    /// Resizes the framebuffer, the wrapped renderer and the upload buffers.
+    /// The caller must make sure the GPU is idle.
+    /// </summary>
+    auto Resize(const UINT width, const UINT height) -> void override;
+
+    /// <summary>
+    /// Returns the name of the wrapped renderer for display in the UI.
+    /// </summary>
+    auto GetName() const -> const char* override
+    {
+        return m_frameRenderer->GetName();
+    }
+
+    /// <summary>
+    /// Forwards to the wrapped renderer.
+    /// </summary>
+    auto ResetAccumulation() -> void override
+    {
+        m_frameRenderer->ResetAccumulation();
+    }
+
+    /// <summary>
+    /// Forwards to the wrapped renderer.
+    /// </summary>
+    auto IsConverged() const -> bool override
+    {
+        return m_frameRenderer->IsConverged();
+    }
+
+  private:
+    auto CreateUploadBuffers() -> void;
+
+    ID3D12Device* m_device;     // Non-owning
+    DX12InfoQueue* m_infoQueue; // Non-owning
+    UINT m_width;
+    UINT m_height;
+
+    std::unique_ptr<IFrameRenderer> m_frameRenderer;
+    Framebuffer m_framebuffer;
+
+    // One upload buffer per frame in flight, persistently mapped
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint{};
+    Microsoft::WRL::ComPtr<ID3D12Resource>
+        m_uploadBuffers[SwapChain::BUFFER_COUNT];
+    void* m_uploadBufferMappedData[SwapChain::BUFFER_COUNT] = {};
+};
+
+} // namespace pathtracer
@@ -5,6 +5,7 @@
 #include "interfaces/pathtracer_interface.h"
 #include "platform/windows_fwd.h"
 #include "scene/camera.h"
+#include "scene/scene.h"
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -45,7 +46,8 @@ class Renderer
     /// Renders a frame using the current pathtracer.
     /// </summary>
     /// <param name="camera">Reference to the camera</param>
-    auto RenderFrame(const Camera& camera /*, const Scene& scene*/) -> void;
+    /// <param name="scene">Reference to the scene</param>
+    auto RenderFrame(const Camera& camera, const Scene& scene) -> void;
 
     /// <summary>
     /// Handles window resize events.
@@ -68,6 +70,24 @@ class Renderer
     /// </summary>
     auto SetPathtracerType(/* PathtracerType type*/) -> void;
 
+    /// <summary>
+    /// Discards the pathtracer's accumulated samples. Camera and scene
+    /// changes are picked up automatically.
+    /// </summary>
+    auto ResetAccumulation() -> void
+    {
+        m_pathtracer->ResetAccumulation();
+    }
+
+    /// <summary>
+    /// Whether the pathtracer's image has converged for the current camera
+    /// and scene, so that frames can stop until either changes.
+    /// </summary>
+    auto IsConverged() const -> bool
+    {
+        return m_pathtracer->IsConverged();
+    }
+
   private:
     auto CreateBackBufferRTVs() -> void;
 
@@ -0,0 +1,152 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace pathtracer
+{
+/// <summary>
+/// Stable reference to an object in a container that stores its objects
+/// densely and moves them around on removal. Tag only keeps handles to
+/// different kinds of objects apart. A default constructed handle is
+/// invalid.
+/// </summary>
+template <typename Tag> struct Handle
+{
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    uint32_t slot = INVALID_SLOT;
+    uint32_t generation = 0;
+
+    auto IsValid() const noexcept -> bool
+    {
+        return slot != INVALID_SLOT;
+    }
+
+    friend auto operator==(const Handle&, const Handle&) -> bool = default;
+};
+
+/// <summary>
+/// Maps handles to indices into densely packed arrays (a slot map). Objects
+/// are appended at the end of the arrays and removed by moving the last
+/// object into the hole, so the arrays never have gaps and kernels can
+/// stream through them; handles stay valid across both. Each slot counts how
+/// often it has been reused, so a handle to a removed object is rejected
+/// instead of silently resolving to whatever object took its slot.
+/// </summary>
+template <typename Tag> class HandleTable
+{
+  public:
+    using HandleType = Handle<Tag>;
+
+    /// <summary>
+    /// Registers an object appended at index GetCount() of the dense arrays.
+    /// </summary>
+    auto Add() -> HandleType
+    {
+        uint32_t slot;
+        if (!m_freeSlots.empty())
+        {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(m_slotIndex.size());
+            m_slotIndex.push_back(0);
+            m_slotGeneration.push_back(0);
+        }
+
+        m_slotIndex[slot] = GetCount();
+        m_denseSlot.push_back(slot);
+        return {slot, m_slotGeneration[slot]};
+    }
+
+    /// <summary>
+    /// Unregisters the object of handle and returns its dense index. The
+    /// caller must move the last object of its arrays to that index and pop
+    /// the last element, which the table already accounts for.
+    /// Throws std::invalid_argument if handle is invalid or stale.
+    /// </summary>
+    auto Remove(HandleType handle) -> uint32_t
+    {
+        const uint32_t idx = GetIndex(handle);
+        const uint32_t lastSlot = m_denseSlot.back();
+        m_denseSlot[idx] = lastSlot;
+        m_slotIndex[lastSlot] = idx;
+        m_denseSlot.pop_back();
+
+        ++m_slotGeneration[handle.slot];
+        m_freeSlots.push_back(handle.slot);
+        return idx;
+    }
+
+    /// <summary>
+    /// Returns the dense index of the object of handle. The index is only
+    /// valid until the next removal. Throws std::invalid_argument if handle
+    /// is invalid or stale.
+    /// </summary>
+    auto GetIndex(HandleType handle) const -> uint32_t
+    {
+        if (!Contains(handle))
+        {
+            throw std::invalid_argument("Invalid or stale handle");
+        }
+        return m_slotIndex[handle.slot];
+    }
+
+    /// <summary>
+    /// Returns the handle of the object at dense index idx.
+    /// </summary>
+    auto GetHandle(uint32_t idx) const -> HandleType
+    {
+        const uint32_t slot = m_denseSlot[idx];
+        return {slot, m_slotGeneration[slot]};
+    }
+
+    auto Contains(HandleType handle) const noexcept -> bool
+    {
+        return handle.slot < m_slotIndex.size() &&
+               m_slotGeneration[handle.slot] == handle.generation &&
+               m_slotIndex[handle.slot] < m_denseSlot.size() &&
+               m_denseSlot[m_slotIndex[handle.slot]] == handle.slot;
+    }
+
+    auto GetCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_denseSlot.size());
+    }
+
+    auto Reserve(uint32_t count) -> void
+    {
+        m_slotIndex.reserve(count);
+        m_slotGeneration.reserve(count);
+        m_denseSlot.reserve(count);
+    }
+
+    /// <summary>
+    /// Removes every object. Outstanding handles become stale.
+    /// </summary>
+    auto Clear() -> void
+    {
+        m_denseSlot.clear();
+        m_freeSlots.clear();
+        for (uint32_t slot = 0; slot < m_slotIndex.size(); ++slot)
+        {
+            ++m_slotGeneration[slot];
+            m_freeSlots.push_back(slot);
+        }
+    }
+
+  private:
+    std::vector<uint32_t> m_slotIndex;      // Dense index per slot
+    std::vector<uint32_t> m_slotGeneration; // Bumped when a slot is freed
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<uint32_t> m_denseSlot; // Slot per dense index
+};
+
+} // namespace pathtracer
+
+#endif // HANDLE_TABLE_H
@@ -0,0 +1,400 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "cpu/sphere_buffer.h"
+#include "cpu/triangle_mesh.h"
+#include "scene/handle_table.h"
+#include "utils/color.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pathtracer
+{
+template <size_t N> class MeshBvh;
+using MeshBvh8 = MeshBvh<8>;
+
+using SphereHandle = Handle<struct SphereTag>;
+using TriangleHandle = Handle<struct TriangleTag>;
+using MaterialHandle = Handle<struct MaterialTag>;
+using InstanceHandle = Handle<struct InstanceTag>;
+using MeshHandle = Handle<struct MeshTag>;
+
+struct Material
+{
+    color albedo{1.0f};
+    color emission{0.0f};
+    float roughness = 1.0f;
+};
+
+/// <summary>
+/// What changed in a Scene since the last Scene::ClearChanges(). Geometry
+/// flags mean primitives moved but the set of primitives is the same, so
+/// acceleration structures can be refit; topology flags mean primitives
+/// were added or removed, which needs a rebuild.
+/// </summary>
+enum class SceneChange : uint32_t
+{
+    None = 0,
+    SphereGeometry = 1u << 0,
+    SphereTopology = 1u << 1,
+    TriangleGeometry = 1u << 2,
+    TriangleTopology = 1u << 3,
+    Materials = 1u << 4,
+    InstanceTransforms = 1u << 5,
+    InstanceTopology = 1u << 6,
+    MeshGeometry = 1u << 7,
+    MeshTopology = 1u << 8,
+};
+
+constexpr auto operator|(SceneChange a, SceneChange b) -> SceneChange
+{
+    return static_cast<SceneChange>(static_cast<uint32_t>(a) |
+                                    static_cast<uint32_t>(b));
+}
+
+constexpr auto operator&(SceneChange a, SceneChange b) -> SceneChange
+{
+    return static_cast<SceneChange>(static_cast<uint32_t>(a) &
+                                    static_cast<uint32_t>(b));
+}
+
+constexpr auto operator|=(SceneChange& a, SceneChange b) -> SceneChange&
+{
+    return a = a | b;
+}
+
+/// <summary>
+/// Primitive store of everything the path tracers render. Each kind of
+/// object lives in its own structure-of-arrays block that kernels and
+/// acceleration structure builders stream through directly; primitives
+/// refer to materials by dense index. Objects are created and edited through
+/// stable handles, while the dense indices, which are what acceleration
+/// structures store, may change when an object of the same kind is removed.
+/// <para></para>
+/// Every edit records a SceneChange. Renderers look at GetChanges() to
+/// decide between keeping, refitting and rebuilding their acceleration
+/// structures; whoever owns the scene calls ClearChanges() once every
+/// renderer has seen the frame, like Camera::ClearDirty().
+/// </summary>
+class Scene
+{
+  public:
+    /// <summary>
+    /// Creates an empty scene with the default material, a white diffuse
+    /// surface, at material index 0.
+    /// </summary>
+    Scene();
+
+    // Spheres
+
+    auto AddSphere(const glm::vec3& center, float radius,
+                   MaterialHandle material = {}) -> SphereHandle;
+    auto RemoveSphere(SphereHandle handle) -> void;
+    auto SetSphere(SphereHandle handle, const glm::vec3& center, float radius)
+        -> void;
+    auto SetSphereMaterial(SphereHandle handle, MaterialHandle material)
+        -> void;
+
+    auto GetSphereIndex(SphereHandle handle) const -> uint32_t
+    {
+        return m_sphereHandles.GetIndex(handle);
+    }
+
+    auto GetSphereHandle(uint32_t idx) const -> SphereHandle
+    {
+        return m_sphereHandles.GetHandle(idx);
+    }
+
+    auto GetSpheres() const noexcept -> const SphereBuffer&
+    {
+        return m_spheres;
+    }
+
+    /// <summary>
+    /// Material index of each sphere, parallel to GetSpheres().
+    /// </summary>
+    auto GetSphereMaterials() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_sphereMaterials;
+    }
+
+    // Triangles
+
+    auto AddTriangle(const glm::vec3& v0, const glm::vec3& v1,
+                     const glm::vec3& v2, MaterialHandle material = {})
+        -> TriangleHandle;
+    auto RemoveTriangle(TriangleHandle handle) -> void;
+    auto SetTriangle(TriangleHandle handle, const glm::vec3& v0,
+                     const glm::vec3& v1, const glm::vec3& v2) -> void;
+
+    auto GetTriangleIndex(TriangleHandle handle) const -> uint32_t
+    {
+        return m_triangleHandles.GetIndex(handle);
+    }
+
+    auto GetTriangleHandle(uint32_t idx) const -> TriangleHandle
+    {
+        return m_triangleHandles.GetHandle(idx);
+    }
+
+    auto GetTriangleCount() const noexcept -> uint32_t
+    {
+        return m_triangleHandles.GetCount();
+    }
+
+    /// <summary>
+    /// First, second and third vertex of each triangle.
+    /// </summary>
+    auto GetTriangleV0() const noexcept -> const std::vector<glm::vec3>&
+    {
+        return m_triangleV0;
+    }
+    auto GetTriangleV1() const noexcept -> const std::vector<glm::vec3>&
+    {
+        return m_triangleV1;
+    }
+    auto GetTriangleV2() const noexcept -> const std::vector<glm::vec3>&
+    {
+        return m_triangleV2;
+    }
+
+    auto GetTriangleMaterials() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_triangleMaterials;
+    }
+
+    // Meshes
+
+    /// <summary>
+    /// Adds an indexed triangle mesh, all of whose triangles use material.
+    /// </summary>
+    auto AddMesh(TriangleMesh mesh, MaterialHandle material = {})
+        -> MeshHandle;
+
+    /// <summary>
+    /// Removes the mesh and its instances.
+    /// </summary>
+    auto RemoveMesh(MeshHandle handle) -> void;
+
+    /// <summary>
+    /// Moves vertex vertexIdx of a mesh. Records MeshGeometry and bumps the
+    /// mesh's revision, so only the acceleration structures of meshes that
+    /// actually changed need to be refit.
+    /// </summary>
+    auto SetMeshVertex(MeshHandle handle, uint32_t vertexIdx,
+                       const glm::vec3& position) -> void;
+
+    auto GetMeshIndex(MeshHandle handle) const -> uint32_t
+    {
+        return m_meshHandles.GetIndex(handle);
+    }
+
+    auto GetMeshHandle(uint32_t idx) const -> MeshHandle
+    {
+        return m_meshHandles.GetHandle(idx);
+    }
+
+    auto GetMeshCount() const noexcept -> uint32_t
+    {
+        return m_meshHandles.GetCount();
+    }
+
+    auto GetMeshes() const noexcept -> const std::vector<TriangleMesh>&
+    {
+        return m_meshes;
+    }
+
+    auto GetMeshMaterials() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_meshMaterials;
+    }
+
+    /// <summary>
+    /// Per mesh, a counter that changes whenever its vertices move.
+    /// </summary>
+    auto GetMeshRevisions() const noexcept -> const std::vector<uint32_t>&
+    {
+        return m_meshRevisions;
+    }
+
+    /// <summary>
+    /// Attaches a finished BVH over a mesh, e.g. one read from a scene
+    /// cache, for renderers to use instead of building their own. It must
+    /// match the mesh as it is now; moving a vertex of the mesh detaches it.
+    /// </summary>
+    auto SetMeshBvh(MeshHandle handle, std::shared_ptr<const MeshBvh8> bvh)
+        -> void;
+
+    /// <summary>
+    /// Attached BVH of each mesh, parallel to GetMeshes(); null if none.
+    /// </summary>
+    auto GetMeshBvhs() const noexcept
+        -> const std::vector<std::shared_ptr<const MeshBvh8>>&
+    {
+        return m_meshBvhs;
+    }
+
+    // Materials
+
+    /// <summary>
+    /// Adds a material. Materials cannot be removed, so their dense index
+    /// never changes and primitives can keep referring to it.
+    /// </summary>
+    auto AddMaterial(const Material& material) -> MaterialHandle;
+    auto SetMaterial(MaterialHandle handle, const Material& material) -> void;
+    auto GetMaterial(MaterialHandle handle) const -> Material;
+
+    /// <summary>
+    /// Dense index of a material; the invalid handle is the default material.
+    /// </summary>
+    auto GetMaterialIndex(MaterialHandle handle) const -> uint32_t;
+
+    auto GetMaterialHandle(uint32_t idx) const -> MaterialHandle
+    {
+        return m_materialHandles.GetHandle(idx);
+    }
+
+    auto GetMaterialCount() const noexcept -> uint32_t
+    {
+        return m_materialHandles.GetCount();
+    }
+
+    auto GetAlbedos() const noexcept -> const std::vector<color>&
+    {
+        return m_albedo;
+    }
+    auto GetEmissions() const noexcept -> const std::vector<color>&
+    {
+        return m_emission;
+    }
+    auto GetRoughnesses() const noexcept -> const std::vector<float>&
+    {
+        return m_roughness;
+    }
+
+    // Instances
+
+    /// <summary>
+    /// Places a copy of mesh with an affine object-to-world transform;
+    /// material overrides the mesh's material if valid. Instances share the
+    /// mesh and its BVH, so a mesh can be placed many times for the memory
+    /// of one. A mesh with instances is drawn only where they place it, a
+    /// mesh without any is drawn once as it is. Removing the mesh removes
+    /// its instances.
+    /// </summary>
+    auto AddInstance(MeshHandle mesh, const glm::mat4& transform,
+                     MaterialHandle material = {}) -> InstanceHandle;
+    auto RemoveInstance(InstanceHandle handle) -> void;
+    auto SetInstanceTransform(InstanceHandle handle,
+                              const glm::mat4& transform) -> void;
+
+    auto GetInstanceIndex(InstanceHandle handle) const -> uint32_t
+    {
+        return m_instanceHandles.GetIndex(handle);
+    }
+
+    auto GetInstanceHandle(uint32_t idx) const -> InstanceHandle
+    {
+        return m_instanceHandles.GetHandle(idx);
+    }
+
+    auto GetInstanceCount() const noexcept -> uint32_t
+    {
+        return m_instanceHandles.GetCount();
+    }
+
+    /// <summary>
+    /// Mesh index per instance.
+    /// </summary>
+    auto GetInstanceGeometries() const noexcept
+        -> const std::vector<uint32_t>&
+    {
+        return m_instanceGeometry;
+    }
+    auto GetInstanceTransforms() const noexcept
+        -> const std::vector<glm::mat4>&
+    {
+        return m_instanceTransform;
+    }
+
+    /// <summary>
+    /// Material index per instance, NO_MATERIAL if it keeps the geometry's.
+    /// </summary>
+    auto GetInstanceMaterials() const noexcept
+        -> const std::vector<uint32_t>&
+    {
+        return m_instanceMaterial;
+    }
+
+    static constexpr uint32_t NO_MATERIAL = UINT32_MAX;
+
+    // Change tracking
+
+    auto GetChanges() const noexcept -> SceneChange
+    {
+        return m_changes;
+    }
+
+    /// <summary>
+    /// Returns true if any of the given changes happened.
+    /// </summary>
+    auto HasChanges(SceneChange changes) const noexcept -> bool
+    {
+        return (m_changes & changes) != SceneChange::None;
+    }
+
+    auto ClearChanges() noexcept -> void
+    {
+        m_changes = SceneChange::None;
+    }
+
+    /// <summary>
+    /// Removes every object and material except the default material.
+    /// Outstanding handles become stale.
+    /// </summary>
+    auto Clear() -> void;
+
+  private:
+    HandleTable<SphereTag> m_sphereHandles;
+    SphereBuffer m_spheres;
+    std::vector<uint32_t> m_sphereMaterials;
+
+    HandleTable<TriangleTag> m_triangleHandles;
+    std::vector<glm::vec3> m_triangleV0;
+    std::vector<glm::vec3> m_triangleV1;
+    std::vector<glm::vec3> m_triangleV2;
+    std::vector<uint32_t> m_triangleMaterials;
+
+    HandleTable<MeshTag> m_meshHandles;
+    std::vector<TriangleMesh> m_meshes;
+    std::vector<uint32_t> m_meshMaterials;
+    std::vector<uint32_t> m_meshRevisions;
+    std::vector<std::shared_ptr<const MeshBvh8>> m_meshBvhs;
+
+    HandleTable<MaterialTag> m_materialHandles;
+    std::vector<color> m_albedo;
+    std::vector<color> m_emission;
+    std::vector<float> m_roughness;
+
+    HandleTable<InstanceTag> m_instanceHandles;
+    std::vector<uint32_t> m_instanceGeometry;
+    std::vector<glm::mat4> m_instanceTransform;
+    std::vector<uint32_t> m_instanceMaterial;
+
+    SceneChange m_changes = SceneChange::None;
+};
+
+/// <summary>
+/// The test scene every renderer started out with and compute.hlsl still
+/// hardcodes: a unit sphere at the origin.
+/// </summary>
+auto CreateTestScene() -> Scene;
+
+} // namespace pathtracer
+
+#endif // SCENE_H
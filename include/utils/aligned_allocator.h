@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace pathtracer
+{
+namespace utils
+{
+
+/// <summary>
+/// Standard allocator that aligns every allocation to Alignment bytes, e.g.
+/// to start an array on a cache line boundary so that fixed-size records
+/// never straddle two lines.
+/// </summary>
+template <typename T, size_t Alignment> struct AlignedAllocator
+{
+    static_assert(Alignment >= alignof(T) &&
+                      (Alignment & (Alignment - 1)) == 0,
+                  "Alignment must be a power of two of at least alignof(T)");
+
+    using value_type = T;
+
+    template <typename U> struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+    {
+    }
+
+    auto allocate(size_t count) -> T*
+    {
+        return static_cast<T*>(::operator new(
+            count * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    auto deallocate(T* ptr, size_t /*count*/) noexcept -> void
+    {
+        ::operator delete(ptr, std::align_val_t{Alignment});
+    }
+
+    template <typename U>
+    auto operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+        -> bool
+    {
+        return true;
+    }
+};
+
+} // namespace utils
+} // namespace pathtracer
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace pathtracer
+{
+namespace utils
+{
+
+/// <summary>
+/// PCG hash (Jarzynski &amp; Olano, "Hash Functions for GPU Rendering").
+/// Stateless, so any thread can derive random numbers from a pixel and sample
+/// index. Mirrors pcgHash() in compute.hlsl bit for bit.
+/// </summary>
+/// <param name="v">The value to hash</param>
+/// <returns>A well distributed 32-bit hash of v</returns>
+constexpr auto PcgHash(uint32_t v) -> uint32_t
+{
+    const uint32_t state = v * 747796405u + 2891336453u;
+    const uint32_t word =
+        ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+/// <summary>
+/// Maps the upper 24 bits of a hash to a float in [0, 1). Mirrors
+/// uintToUnitFloat() in compute.hlsl.
+/// </summary>
+constexpr auto UintToUnitFloat(uint32_t v) -> float
+{
+    return static_cast<float>(v >> 8) * (1.0f / 16777216.0f);
+}
+
+/// <summary>
+/// Hashes a pixel coordinate and a sample/frame index into a seed.
+/// </summary>
+constexpr auto PixelSeed(uint32_t x, uint32_t y, uint32_t index) -> uint32_t
+{
+    return PcgHash(PcgHash(x + PcgHash(y)) + index);
+}
+
+} // namespace utils
+} // namespace pathtracer
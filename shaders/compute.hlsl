@@ -14,8 +14,32 @@ cbuffer CameraData : register(b0)
     float _pad1;
 };
 
+// Per-frame constants (root constants, see FrameGPUData)
+cbuffer FrameData : register(b1)
+{
+    uint frameIndex;
+    uint resetAccumulation;
+};
+
 RWTexture2D<float4> OutputTexture : register(u0);
 
+// Progressive accumulation: rgb = running sum, a = sample count
+RWTexture2D<float4> AccumulationTexture : register(u1);
+
+// PCG hash, mirrors utils::PcgHash() on the CPU
+uint pcgHash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Upper 24 bits to [0, 1), mirrors utils::UintToUnitFloat()
+float uintToUnitFloat(uint v)
+{
+    return float(v >> 8) * (1.0 / 16777216.0);
+}
+
 // Simple sphere intersection
 bool intersectSphere(float3 rayOrigin, float3 rayDirection, float3 sphereCenter, float sphereRadius, out float t)
 {
@@ -59,8 +83,12 @@ void CSMain(uint3 DTid : SV_DispatchThreadID)
     if (DTid.x >= width || DTid.y >= height)
         return;
 
+    // Random sub-pixel jitter, decorrelated between frames
+    uint seed = pcgHash(pcgHash(DTid.x + pcgHash(DTid.y)) + frameIndex);
+    float2 jitter = float2(uintToUnitFloat(seed), uintToUnitFloat(pcgHash(seed)));
+
     // Compute UV in [-1, 1] range
-    float2 uv = (float2(DTid.xy) + 0.5) / float2(width, height);
+    float2 uv = (float2(DTid.xy) + jitter) / float2(width, height);
     uv = uv * 2.0 - 1.0;
     uv.y = -uv.y; // Flip Y for correct orientation
 
@@ -93,5 +121,12 @@ void CSMain(uint3 DTid : SV_DispatchThreadID)
         color = lerp(float3(1.0, 1.0, 1.0), float3(0.5, 0.7, 1.0), gradient);
     }
 
-        OutputTexture[DTid.xy] = float4(color, 1.0);
+    // Accumulate and output the running mean
+    float4 accumulation = resetAccumulation != 0
+        ? float4(0, 0, 0, 0)
+        : AccumulationTexture[DTid.xy];
+    accumulation += float4(color, 1.0);
+    AccumulationTexture[DTid.xy] = accumulation;
+
+    OutputTexture[DTid.xy] = float4(accumulation.rgb / accumulation.w, 1.0);
 }
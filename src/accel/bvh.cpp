@@ -0,0 +1,1005 @@
+#include "accel/bvh.h"
+#include "cpu/task_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// A parallel loop over the primitives of a node hands out chunks of this
+/// many at a time.
+/// </summary>
+constexpr uint32_t PARALLEL_CHUNK_SIZE = 16 * 1024;
+
+/// <summary>
+/// Builds over fewer primitives than this run on the calling thread only;
+/// waking a pool costs more than it saves.
+/// </summary>
+constexpr uint32_t MIN_PARALLEL_PRIMS = 4 * PARALLEL_CHUNK_SIZE;
+
+/// <summary>
+/// A parallel refit splits the tree into about this many subtrees per
+/// thread, so threads that drew small subtrees pick up more.
+/// </summary>
+constexpr uint32_t REFIT_TASKS_PER_THREAD = 8;
+
+/// <summary>
+/// Bounds and primitive count of one bin along one axis.
+/// </summary>
+struct Bin
+{
+    Aabb bounds;
+    uint32_t count = 0;
+
+    auto Merge(const Bin& other) -> void
+    {
+        bounds.Grow(other.bounds);
+        count += other.count;
+    }
+};
+
+/// <summary>
+/// Bounds of a primitive together with its index. The builder partitions
+/// these in place, so every pass over a node reads contiguous memory instead
+/// of gathering bounds through permuted indices.
+/// </summary>
+struct PrimRef
+{
+    Aabb bounds;
+    uint32_t primIdx;
+
+    auto Centroid() const -> glm::vec3
+    {
+        // Empty boxes get a finite centroid so they can still be binned
+        return bounds.IsEmpty() ? glm::vec3{0.0f} : bounds.Centroid();
+    }
+};
+
+/// <summary>
+/// A range of PrimRefs that still has to be turned into a subtree rooted at
+/// nodeIdx.
+/// </summary>
+struct WorkItem
+{
+    uint32_t nodeIdx;
+    uint32_t first;
+    uint32_t count;
+    uint32_t depth;
+};
+
+/// <summary>
+/// A node as the builders create it: children are allocated in pairs when
+/// their parent is split, so a subtree's nodes are scattered. Build() copies
+/// the finished tree into depth-first order.
+/// </summary>
+struct BuildNode
+{
+    Aabb bounds;
+    uint32_t left = 0;
+    uint32_t right = 0;
+    uint32_t firstPrim = 0;
+    uint32_t primCount = 0;
+
+    auto IsLeaf() const -> bool
+    {
+        return primCount > 0;
+    }
+};
+
+/// <summary>
+/// Maps centroids to bins along each axis of a node's centroid bounds.
+/// </summary>
+class Binner
+{
+  public:
+    Binner(const Aabb& centroidBounds, uint32_t binCount)
+        : m_min(centroidBounds.min), m_binCount(binCount)
+    {
+        const glm::vec3 extent = centroidBounds.Extent();
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            m_scale[axis] =
+                extent[axis] > 0.0f ? binCount / extent[axis] : 0.0f;
+        }
+    }
+
+    auto BinIndex(const glm::vec3& centroid, uint32_t axis) const
+        -> uint32_t
+    {
+        const auto bin = static_cast<int64_t>((centroid[axis] - m_min[axis]) *
+                                              m_scale[axis]);
+        return static_cast<uint32_t>(
+            std::clamp<int64_t>(bin, 0, static_cast<int64_t>(m_binCount) - 1));
+    }
+
+    /// <summary>
+    /// Adds every reference to one bin per axis. bins holds binCount bins
+    /// for x, then y, then z.
+    /// </summary>
+    auto Fill(const PrimRef* refs, uint32_t count, Bin* bins) const -> void
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 centroid = refs[i].Centroid();
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                Bin& bin = bins[axis * m_binCount + BinIndex(centroid, axis)];
+                bin.bounds.Grow(refs[i].bounds);
+                ++bin.count;
+            }
+        }
+    }
+
+  private:
+    glm::vec3 m_min;
+    glm::vec3 m_scale;
+    uint32_t m_binCount;
+};
+
+/// <summary>
+/// A split found by the binned SAH: primitives whose centroid falls in a bin
+/// below splitBin along axis go to the left child. cost is the
+/// area-weighted intersection cost of both children, not yet divided by the
+/// parent area.
+/// </summary>
+struct Split
+{
+    uint32_t axis = 0;
+    uint32_t splitBin = 0;
+    float cost = std::numeric_limits<float>::infinity();
+
+    auto IsValid() const -> bool
+    {
+        return cost != std::numeric_limits<float>::infinity();
+    }
+};
+
+/// <summary>
+/// Evaluates the SAH at every bin boundary along every axis.
+/// rightBounds is scratch space for binCount boxes.
+/// </summary>
+auto FindBestSplit(const Bin* bins, uint32_t count,
+                   const BvhBuildOptions& options, Aabb* rightBounds)
+    -> Split
+{
+    const uint32_t binCount = options.binCount;
+
+    Split best;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        const Bin* axisBins = bins + axis * binCount;
+
+        // Sweep from the right to get the bounds right of every plane, then
+        // from the left to evaluate each plane
+        Aabb right;
+        for (uint32_t b = binCount - 1; b > 0; --b)
+        {
+            right.Grow(axisBins[b].bounds);
+            rightBounds[b] = right;
+        }
+
+        Aabb left;
+        uint32_t leftCount = 0;
+        for (uint32_t b = 1; b < binCount; ++b)
+        {
+            left.Grow(axisBins[b - 1].bounds);
+            leftCount += axisBins[b - 1].count;
+            const uint32_t rightCount = count - leftCount;
+            if (leftCount == 0 || rightCount == 0)
+                continue;
+
+            const float cost =
+                options.intersectionCost *
+                (left.SurfaceArea() * leftCount +
+                 rightBounds[b].SurfaceArea() * rightCount);
+            if (cost < best.cost)
+            {
+                best = {axis, b, cost};
+            }
+        }
+    }
+    return best;
+}
+
+/// <summary>
+/// Whether a node should be split rather than become a leaf: always when it
+/// holds more than maxLeafSize primitives, otherwise when the SAH says so.
+/// The traversal cost of the node itself is paid either way.
+/// </summary>
+auto ShouldSplit(uint32_t count, const Aabb& bounds, const Split& split,
+                 const BvhBuildOptions& options) -> bool
+{
+    if (count <= 1)
+        return false;
+    if (count > options.maxLeafSize)
+        return true;
+
+    const float leafCost = options.intersectionCost * count;
+    const float splitCost =
+        options.traversalCost +
+        split.cost / std::max(bounds.SurfaceArea(),
+                              std::numeric_limits<float>::min());
+    return splitCost < leafCost;
+}
+
+/// <summary>
+/// Serial top-down binned SAH builder for one subtree. Nodes are processed
+/// from an explicit work list rather than by recursion, so degenerate
+/// inputs cannot overflow the call stack. Several instances may run
+/// concurrently on disjoint ranges of the same PrimRef array, each writing
+/// its own node array.
+/// </summary>
+class SubtreeBuilder
+{
+  public:
+    SubtreeBuilder(PrimRef* refs, const BvhBuildOptions& options,
+                   uint32_t maxDepth, std::vector<BuildNode>& nodes,
+                   BvhStats& stats)
+        : m_refs(refs), m_options(options), m_maxDepth(maxDepth),
+          m_nodes(nodes), m_stats(stats), m_bins(3 * options.binCount),
+          m_rightBounds(options.binCount)
+    {
+    }
+
+    /// <summary>
+    /// Builds the subtree for root, whose node must already exist.
+    /// </summary>
+    auto Build(const WorkItem& root) -> void
+    {
+        std::vector<WorkItem> work{root};
+        while (!work.empty())
+        {
+            const WorkItem item = work.back();
+            work.pop_back();
+
+            m_stats.maxDepth = std::max(m_stats.maxDepth, item.depth);
+
+            const PrimRef* refs = m_refs + item.first;
+            Aabb bounds;
+            Aabb centroidBounds;
+            for (uint32_t i = 0; i < item.count; ++i)
+            {
+                bounds.Grow(refs[i].bounds);
+                centroidBounds.Grow(refs[i].Centroid());
+            }
+            m_nodes[item.nodeIdx].bounds = bounds;
+
+            const uint32_t leftCount =
+                item.depth < m_maxDepth
+                    ? FindSplitAndPartition(item, bounds, centroidBounds)
+                    : 0;
+            if (leftCount == 0)
+            {
+                BuildNode& leaf = m_nodes[item.nodeIdx];
+                leaf.firstPrim = item.first;
+                leaf.primCount = item.count;
+                ++m_stats.leafCount;
+                m_stats.maxLeafPrims =
+                    std::max(m_stats.maxLeafPrims, item.count);
+                continue;
+            }
+
+            const auto left = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back(BuildNode{});
+            m_nodes.push_back(BuildNode{});
+            m_nodes[item.nodeIdx].left = left;
+            m_nodes[item.nodeIdx].right = left + 1;
+
+            // Push right first so the left subtree is built first
+            work.push_back({left + 1, item.first + leftCount,
+                            item.count - leftCount, item.depth + 1});
+            work.push_back({left, item.first, leftCount, item.depth + 1});
+        }
+    }
+
+  private:
+    /// <summary>
+    /// Partitions the item's references by the cheapest SAH split and
+    /// returns the size of the left half, or 0 if the node should become a
+    /// leaf.
+    /// </summary>
+    auto FindSplitAndPartition(const WorkItem& item, const Aabb& bounds,
+                               const Aabb& centroidBounds) -> uint32_t
+    {
+        if (item.count <= 1)
+            return 0;
+
+        const Binner binner(centroidBounds, m_options.binCount);
+        std::fill(m_bins.begin(), m_bins.end(), Bin{});
+        binner.Fill(m_refs + item.first, item.count, m_bins.data());
+        const Split split = FindBestSplit(m_bins.data(), item.count,
+                                          m_options, m_rightBounds.data());
+        if (!ShouldSplit(item.count, bounds, split, m_options))
+            return 0;
+
+        if (!split.IsValid())
+        {
+            // All centroids coincide, so no plane separates them. Halve the
+            // node so leaves stay bounded.
+            return item.count / 2;
+        }
+
+        PrimRef* begin = m_refs + item.first;
+        const PrimRef* middle = std::partition(
+            begin, begin + item.count,
+            [&](const PrimRef& ref)
+            {
+                return binner.BinIndex(ref.Centroid(), split.axis) <
+                       split.splitBin;
+            });
+        return static_cast<uint32_t>(middle - begin);
+    }
+
+    PrimRef* m_refs;
+    const BvhBuildOptions& m_options;
+    uint32_t m_maxDepth;
+    std::vector<BuildNode>& m_nodes;
+    BvhStats& m_stats;
+
+    std::vector<Bin> m_bins; // binCount per axis, x then y then z
+    std::vector<Aabb> m_rightBounds;
+};
+
+/// <summary>
+/// Parallel build in two phases. The top levels hold few nodes with many
+/// primitives each, so every node is split with all threads binning and
+/// partitioning chunks of its primitives. Once nodes are small enough they
+/// are plentiful, and each becomes an independent task for a serial
+/// SubtreeBuilder; their node arrays are stitched together at the end.
+/// </summary>
+class ParallelBuilder
+{
+  public:
+    ParallelBuilder(std::vector<PrimRef>& refs, const BvhBuildOptions& options,
+                    uint32_t maxDepth, TaskPool& pool,
+                    std::vector<BuildNode>& nodes, BvhStats& stats)
+        : m_refs(refs), m_options(options), m_maxDepth(maxDepth),
+          m_pool(pool), m_nodes(nodes), m_stats(stats),
+          m_scratch(refs.size()), m_rightBounds(options.binCount)
+    {
+        // Enough subtrees to keep every thread busy with room to balance,
+        // but none so small that parallel binning would not pay off, and
+        // none that could still become a leaf
+        const auto primCount = static_cast<uint32_t>(refs.size());
+        m_taskThreshold =
+            std::max({PARALLEL_CHUNK_SIZE, options.maxLeafSize,
+                      primCount / (8 * pool.GetThreadCount())});
+    }
+
+    auto Build() -> void
+    {
+        std::vector<WorkItem> subtrees;
+        std::vector<WorkItem> work{
+            {0, 0, static_cast<uint32_t>(m_refs.size()), 1}};
+        while (!work.empty())
+        {
+            const WorkItem item = work.back();
+            work.pop_back();
+
+            if (item.count <= m_taskThreshold || item.depth >= m_maxDepth)
+            {
+                subtrees.push_back(item);
+                continue;
+            }
+
+            m_stats.maxDepth = std::max(m_stats.maxDepth, item.depth);
+            const uint32_t leftCount = SplitNode(item);
+
+            const auto left = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back(BuildNode{});
+            m_nodes.push_back(BuildNode{});
+            m_nodes[item.nodeIdx].left = left;
+            m_nodes[item.nodeIdx].right = left + 1;
+
+            work.push_back({left + 1, item.first + leftCount,
+                            item.count - leftCount, item.depth + 1});
+            work.push_back({left, item.first, leftCount, item.depth + 1});
+        }
+
+        BuildSubtrees(subtrees);
+    }
+
+  private:
+    /// <summary>
+    /// Splits a node that holds more than m_taskThreshold primitives and
+    /// returns the size of its left half. Nodes this large never become
+    /// leaves.
+    /// </summary>
+    auto SplitNode(const WorkItem& item) -> uint32_t
+    {
+        const uint32_t chunkCount =
+            (item.count + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+        const uint32_t binCount = m_options.binCount;
+        PrimRef* refs = m_refs.data() + item.first;
+
+        const auto chunkSize = [&](uint32_t chunk) -> uint32_t
+        {
+            return std::min(PARALLEL_CHUNK_SIZE,
+                            item.count - chunk * PARALLEL_CHUNK_SIZE);
+        };
+
+        // Node bounds and centroid bounds, reduced per chunk
+        std::vector<Aabb> chunkBounds(2 * static_cast<size_t>(chunkCount));
+        m_pool.ParallelFor(
+            chunkCount,
+            [&](uint32_t chunk, uint32_t /*threadIdx*/)
+            {
+                const PrimRef* chunkRefs = refs + chunk * PARALLEL_CHUNK_SIZE;
+                Aabb bounds;
+                Aabb centroidBounds;
+                for (uint32_t i = 0; i < chunkSize(chunk); ++i)
+                {
+                    bounds.Grow(chunkRefs[i].bounds);
+                    centroidBounds.Grow(chunkRefs[i].Centroid());
+                }
+                chunkBounds[2 * chunk] = bounds;
+                chunkBounds[2 * chunk + 1] = centroidBounds;
+            });
+
+        Aabb bounds;
+        Aabb centroidBounds;
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            bounds.Grow(chunkBounds[2 * chunk]);
+            centroidBounds.Grow(chunkBounds[2 * chunk + 1]);
+        }
+        m_nodes[item.nodeIdx].bounds = bounds;
+
+        // Every chunk fills its own bins, which are then merged. Bounds are
+        // merged with min/max, so the result does not depend on the order.
+        const Binner binner(centroidBounds, binCount);
+        const size_t binsPerChunk = 3 * static_cast<size_t>(binCount);
+        std::vector<Bin> chunkBins(chunkCount * binsPerChunk);
+        m_pool.ParallelFor(chunkCount,
+                           [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                           {
+                               binner.Fill(refs + chunk * PARALLEL_CHUNK_SIZE,
+                                           chunkSize(chunk),
+                                           &chunkBins[chunk * binsPerChunk]);
+                           });
+
+        std::vector<Bin> bins(binsPerChunk);
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            for (size_t b = 0; b < binsPerChunk; ++b)
+            {
+                bins[b].Merge(chunkBins[chunk * binsPerChunk + b]);
+            }
+        }
+
+        const Split split = FindBestSplit(bins.data(), item.count, m_options,
+                                          m_rightBounds.data());
+        if (!split.IsValid())
+        {
+            // All centroids coincide, so no plane separates them
+            return item.count / 2;
+        }
+
+        const auto goesLeft = [&](const PrimRef& ref)
+        {
+            return binner.BinIndex(ref.Centroid(), split.axis) <
+                   split.splitBin;
+        };
+
+        // Stable parallel partition: count each chunk's left references,
+        // scatter both halves into scratch at their prefix-sum offsets and
+        // copy the result back
+        std::vector<uint32_t> leftOffsets(chunkCount + 1, 0);
+        m_pool.ParallelFor(
+            chunkCount,
+            [&](uint32_t chunk, uint32_t /*threadIdx*/)
+            {
+                const PrimRef* chunkRefs = refs + chunk * PARALLEL_CHUNK_SIZE;
+                leftOffsets[chunk + 1] = static_cast<uint32_t>(std::count_if(
+                    chunkRefs, chunkRefs + chunkSize(chunk), goesLeft));
+            });
+
+        std::vector<uint32_t> rightOffsets(chunkCount + 1, 0);
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            rightOffsets[chunk + 1] = rightOffsets[chunk] + chunkSize(chunk) -
+                                      leftOffsets[chunk + 1];
+            leftOffsets[chunk + 1] += leftOffsets[chunk];
+        }
+        const uint32_t leftCount = leftOffsets[chunkCount];
+
+        PrimRef* scratch = m_scratch.data() + item.first;
+        m_pool.ParallelFor(
+            chunkCount,
+            [&](uint32_t chunk, uint32_t /*threadIdx*/)
+            {
+                const PrimRef* chunkRefs = refs + chunk * PARALLEL_CHUNK_SIZE;
+                PrimRef* left = scratch + leftOffsets[chunk];
+                PrimRef* right = scratch + leftCount + rightOffsets[chunk];
+                for (uint32_t i = 0; i < chunkSize(chunk); ++i)
+                {
+                    if (goesLeft(chunkRefs[i]))
+                        *left++ = chunkRefs[i];
+                    else
+                        *right++ = chunkRefs[i];
+                }
+            });
+
+        m_pool.ParallelFor(chunkCount,
+                           [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                           {
+                               const uint32_t begin =
+                                   chunk * PARALLEL_CHUNK_SIZE;
+                               std::copy_n(scratch + begin, chunkSize(chunk),
+                                           refs + begin);
+                           });
+
+        return leftCount;
+    }
+
+    /// <summary>
+    /// Builds every subtree as an independent task into its own node array,
+    /// then appends those arrays to m_nodes with their child indices
+    /// rebased.
+    /// </summary>
+    auto BuildSubtrees(std::vector<WorkItem>& subtrees) -> void
+    {
+        // Largest first, so the last tasks to start are short ones
+        std::sort(subtrees.begin(), subtrees.end(),
+                  [](const WorkItem& a, const WorkItem& b)
+                  { return a.count > b.count; });
+
+        const auto taskCount = static_cast<uint32_t>(subtrees.size());
+        std::vector<std::vector<BuildNode>> taskNodes(taskCount);
+        std::vector<BvhStats> taskStats(taskCount);
+        m_pool.ParallelFor(
+            taskCount,
+            [&](uint32_t task, uint32_t /*threadIdx*/)
+            {
+                // Local node 0 stands in for the subtree's root
+                WorkItem root = subtrees[task];
+                root.nodeIdx = 0;
+                taskNodes[task].reserve(2 * static_cast<size_t>(root.count));
+                taskNodes[task].push_back(BuildNode{});
+                SubtreeBuilder builder(m_refs.data(), m_options, m_maxDepth,
+                                       taskNodes[task], taskStats[task]);
+                builder.Build(root);
+            });
+
+        // Local node k > 0 of a task lands at offset + k - 1
+        std::vector<uint32_t> offsets(taskCount);
+        auto nodeCount = static_cast<uint32_t>(m_nodes.size());
+        for (uint32_t task = 0; task < taskCount; ++task)
+        {
+            offsets[task] = nodeCount;
+            nodeCount += static_cast<uint32_t>(taskNodes[task].size()) - 1;
+
+            m_stats.leafCount += taskStats[task].leafCount;
+            m_stats.maxDepth =
+                std::max(m_stats.maxDepth, taskStats[task].maxDepth);
+            m_stats.maxLeafPrims =
+                std::max(m_stats.maxLeafPrims, taskStats[task].maxLeafPrims);
+        }
+        m_nodes.resize(nodeCount);
+
+        m_pool.ParallelFor(
+            taskCount,
+            [&](uint32_t task, uint32_t /*threadIdx*/)
+            {
+                const uint32_t rootIdx = subtrees[task].nodeIdx;
+                const uint32_t offset = offsets[task];
+                const auto rebase = [&](uint32_t k)
+                { return k == 0 ? rootIdx : offset + k - 1; };
+
+                const std::vector<BuildNode>& local = taskNodes[task];
+                for (uint32_t k = 0; k < local.size(); ++k)
+                {
+                    BuildNode node = local[k];
+                    if (!node.IsLeaf())
+                    {
+                        node.left = rebase(node.left);
+                        node.right = rebase(node.right);
+                    }
+                    m_nodes[rebase(k)] = node;
+                }
+            });
+    }
+
+    std::vector<PrimRef>& m_refs;
+    const BvhBuildOptions& m_options;
+    uint32_t m_maxDepth;
+    TaskPool& m_pool;
+    std::vector<BuildNode>& m_nodes;
+    BvhStats& m_stats;
+
+    uint32_t m_taskThreshold;
+    std::vector<PrimRef> m_scratch;
+    std::vector<Aabb> m_rightBounds;
+};
+/// <summary>
+/// A node's contribution to the SAH cost before dividing by the area of the
+/// root: its surface area times the cost of what a ray does inside it.
+/// </summary>
+auto NodeCost(const BvhNode& node, const BvhBuildOptions& options) -> double
+{
+    const float cost = node.IsLeaf()
+                           ? options.intersectionCost * node.primCount
+                           : options.traversalCost;
+    return static_cast<double>(node.bounds.SurfaceArea()) * cost;
+}
+
+/// <summary>
+/// Copies the builders' tree into nodes in depth-first order, so that every
+/// interior node is directly followed by its first child.
+/// </summary>
+auto Flatten(const std::vector<BuildNode>& buildNodes, Bvh::NodeArray& nodes)
+    -> void
+{
+    constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+    // Each entry names a build node and, for second children, the flattened
+    // parent that needs to know where it lands
+    struct Entry
+    {
+        uint32_t buildIdx;
+        uint32_t parentIdx;
+    };
+
+    nodes.resize(buildNodes.size());
+    std::vector<Entry> stack{{0, NO_PARENT}};
+    uint32_t nodeIdx = 0;
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.parentIdx != NO_PARENT)
+            nodes[entry.parentIdx].offset = nodeIdx;
+
+        const BuildNode& src = buildNodes[entry.buildIdx];
+        BvhNode& dst = nodes[nodeIdx];
+        dst.bounds = src.bounds;
+        dst.primCount = src.primCount;
+        if (src.IsLeaf())
+        {
+            dst.offset = src.firstPrim;
+        }
+        else
+        {
+            stack.push_back({src.right, nodeIdx});
+            stack.push_back({src.left, NO_PARENT});
+        }
+        ++nodeIdx;
+    }
+}
+
+/// <summary>
+/// Recomputes the bounds of one node from its children or primitives, which
+/// must be up to date, and returns its NodeCost().
+/// </summary>
+auto RefitNode(BvhNode* nodes, uint32_t nodeIdx,
+               const std::vector<uint32_t>& primIndices,
+               std::span<const Aabb> primBounds,
+               const BvhBuildOptions& options) -> double
+{
+    BvhNode& node = nodes[nodeIdx];
+    Aabb bounds;
+    if (node.IsLeaf())
+    {
+        for (uint32_t i = 0; i < node.primCount; ++i)
+        {
+            bounds.Grow(primBounds[primIndices[node.offset + i]]);
+        }
+    }
+    else
+    {
+        bounds = nodes[nodeIdx + 1].bounds;
+        bounds.Grow(nodes[node.offset].bounds);
+    }
+    node.bounds = bounds;
+    return NodeCost(node, options);
+}
+
+/// <summary>
+/// Refits the nodes [begin, end), which must be a whole subtree, and returns
+/// the sum of NodeCost() over them. Children are stored after their parents,
+/// so a backwards sweep refits bottom-up while streaming through the nodes.
+/// </summary>
+auto RefitRange(BvhNode* nodes, uint32_t begin, uint32_t end,
+                const std::vector<uint32_t>& primIndices,
+                std::span<const Aabb> primBounds,
+                const BvhBuildOptions& options) -> double
+{
+    double cost = 0.0;
+    for (uint32_t nodeIdx = end; nodeIdx-- > begin;)
+    {
+        cost += RefitNode(nodes, nodeIdx, primIndices, primBounds, options);
+    }
+    return cost;
+}
+} // namespace
+
+auto Bvh::Build(std::span<const Aabb> primBounds,
+                const BvhBuildOptions& options, TaskPool* pool) -> void
+{
+    if (options.binCount < 2)
+        throw std::invalid_argument("BVH build needs at least 2 bins");
+    if (options.maxLeafSize < 1)
+        throw std::invalid_argument("BVH leaves must hold a primitive");
+    if (!options.IsValid())
+        throw std::invalid_argument("Invalid BVH build options");
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    Clear();
+    m_options = options;
+    if (primBounds.empty())
+        return;
+
+    const auto primCount = static_cast<uint32_t>(primBounds.size());
+    std::vector<PrimRef> refs(primCount);
+
+    // A binary tree with n leaves has at most 2n - 1 nodes
+    std::vector<BuildNode> buildNodes;
+    buildNodes.reserve(2 * static_cast<size_t>(primCount) - 1);
+    buildNodes.push_back(BuildNode{});
+
+    // The traversal stack holds at most one entry per level, so the depth
+    // is capped at MAX_STACK_DEPTH
+    const bool parallel = (pool != nullptr || options.threadCount != 1) &&
+                          primCount >= MIN_PARALLEL_PRIMS;
+    if (parallel)
+    {
+        std::unique_ptr<TaskPool> ownedPool;
+        if (pool == nullptr)
+        {
+            ownedPool = std::make_unique<TaskPool>(options.threadCount);
+            pool = ownedPool.get();
+        }
+
+        const uint32_t chunkCount =
+            (primCount + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+        pool->ParallelFor(chunkCount,
+                          [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                          {
+                              const uint32_t begin =
+                                  chunk * PARALLEL_CHUNK_SIZE;
+                              const uint32_t end = std::min(
+                                  begin + PARALLEL_CHUNK_SIZE, primCount);
+                              for (uint32_t i = begin; i < end; ++i)
+                              {
+                                  refs[i] = {primBounds[i], i};
+                              }
+                          });
+
+        ParallelBuilder builder(refs, m_options, MAX_STACK_DEPTH, *pool,
+                                buildNodes, m_stats);
+        builder.Build();
+    }
+    else
+    {
+        for (uint32_t i = 0; i < primCount; ++i)
+        {
+            refs[i] = {primBounds[i], i};
+        }
+
+        SubtreeBuilder builder(refs.data(), m_options, MAX_STACK_DEPTH,
+                               buildNodes, m_stats);
+        builder.Build({0, 0, primCount, 1});
+    }
+
+    m_primIndices.resize(primCount);
+    for (uint32_t i = 0; i < primCount; ++i)
+    {
+        m_primIndices[i] = refs[i].primIdx;
+    }
+
+    Flatten(buildNodes, m_nodes);
+
+    m_stats.nodeCount = static_cast<uint32_t>(m_nodes.size());
+    m_stats.sahCost = ComputeSahCost();
+    m_builtSahCost = m_stats.sahCost;
+    m_stats.buildMs = std::chrono::duration<double, std::milli>(
+                          std::chrono::high_resolution_clock::now() - start)
+                          .count();
+}
+
+auto Bvh::Refit(std::span<const Aabb> primBounds, TaskPool* pool) -> void
+{
+    if (primBounds.size() != m_primIndices.size())
+    {
+        throw std::invalid_argument(
+            "BVH refit needs the bounds of every primitive it was built over");
+    }
+    if (m_nodes.empty())
+        return;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::unique_ptr<TaskPool> ownedPool;
+    if (pool == nullptr && m_options.threadCount != 1 &&
+        primBounds.size() >= MIN_PARALLEL_PRIMS)
+    {
+        ownedPool = std::make_unique<TaskPool>(m_options.threadCount);
+        pool = ownedPool.get();
+    }
+
+    const auto nodeCount = static_cast<uint32_t>(m_nodes.size());
+    double cost = 0.0;
+    if (pool == nullptr || pool->GetThreadCount() == 1 ||
+        primBounds.size() < MIN_PARALLEL_PRIMS)
+    {
+        cost = RefitRange(m_nodes.data(), ROOT, nodeCount, m_primIndices,
+                          primBounds, m_options);
+    }
+    else
+    {
+        // Cut the tree one level at a time until there are enough subtrees,
+        // refit those in parallel, then the few nodes above the cut. In
+        // depth-first order every subtree is a contiguous range of nodes.
+        struct Subtree
+        {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        const size_t taskCount =
+            size_t{REFIT_TASKS_PER_THREAD} * pool->GetThreadCount();
+        std::vector<uint32_t> top;
+        std::vector<Subtree> subtrees{{ROOT, nodeCount}};
+        while (subtrees.size() < taskCount)
+        {
+            std::vector<Subtree> next;
+            for (const Subtree& subtree : subtrees)
+            {
+                const BvhNode& node = m_nodes[subtree.begin];
+                if (node.IsLeaf())
+                {
+                    next.push_back(subtree);
+                    continue;
+                }
+                top.push_back(subtree.begin);
+                next.push_back({subtree.begin + 1, node.offset});
+                next.push_back({node.offset, subtree.end});
+            }
+            if (next.size() == subtrees.size())
+                break; // Only leaves left
+            subtrees.swap(next);
+        }
+
+        std::vector<double> taskCosts(subtrees.size());
+        pool->ParallelFor(
+            static_cast<uint32_t>(subtrees.size()),
+            [&](uint32_t task, uint32_t /*threadIdx*/)
+            {
+                taskCosts[task] = RefitRange(
+                    m_nodes.data(), subtrees[task].begin, subtrees[task].end,
+                    m_primIndices, primBounds, m_options);
+            });
+        for (const double taskCost : taskCosts)
+        {
+            cost += taskCost;
+        }
+
+        // top lists the levels above the cut top-down
+        for (auto it = top.rbegin(); it != top.rend(); ++it)
+        {
+            cost += RefitNode(m_nodes.data(), *it, m_primIndices, primBounds,
+                              m_options);
+        }
+    }
+
+    const double rootArea =
+        std::max(m_nodes[ROOT].bounds.SurfaceArea(),
+                 std::numeric_limits<float>::min());
+    m_stats.sahCost = static_cast<float>(cost / rootArea);
+    ++m_stats.refitCount;
+    m_stats.refitMs = std::chrono::duration<double, std::milli>(
+                          std::chrono::high_resolution_clock::now() - start)
+                          .count();
+}
+
+auto Bvh::IsValid(uint32_t primCount) const -> bool
+{
+    for (const uint32_t primIdx : m_primIndices)
+    {
+        if (primIdx >= primCount)
+            return false;
+    }
+    if (m_nodes.empty())
+        return m_primIndices.empty();
+
+    // Walk the tree from the root. In depth-first order the left child
+    // follows its parent and the right child comes after the left subtree.
+    struct Entry
+    {
+        uint32_t nodeIdx;
+        uint32_t depth;
+    };
+    const auto nodeCount = static_cast<uint32_t>(m_nodes.size());
+    std::vector<bool> reached(nodeCount, false);
+    std::vector<Entry> work{{ROOT, 1}};
+    uint32_t reachedCount = 0;
+    while (!work.empty())
+    {
+        const Entry entry = work.back();
+        work.pop_back();
+        if (reached[entry.nodeIdx])
+            return false;
+        reached[entry.nodeIdx] = true;
+        ++reachedCount;
+
+        const BvhNode& node = m_nodes[entry.nodeIdx];
+        if (node.IsLeaf())
+        {
+            if (node.offset > m_primIndices.size() ||
+                node.primCount > m_primIndices.size() - node.offset)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (entry.depth >= MAX_STACK_DEPTH ||
+            node.offset <= entry.nodeIdx + 1 || node.offset >= nodeCount)
+        {
+            return false;
+        }
+        work.push_back({entry.nodeIdx + 1, entry.depth + 1});
+        work.push_back({node.offset, entry.depth + 1});
+    }
+    return reachedCount == nodeCount;
+}
+
+auto Bvh::Update(std::span<const Aabb> primBounds, TaskPool* pool) -> bool
+{
+    Refit(primBounds, pool);
+    if (m_options.maxSahDegradation > 1.0f &&
+        GetSahDegradation() <= m_options.maxSahDegradation)
+    {
+        return false;
+    }
+
+    const BvhBuildOptions options = m_options;
+    Build(primBounds, options, pool);
+    return true;
+}
+
+auto Bvh::Assign(NodeArray nodes, std::vector<uint32_t> primIndices,
+                 const BvhBuildOptions& options, const BvhStats& stats)
+    -> void
+{
+    m_nodes = std::move(nodes);
+    m_primIndices = std::move(primIndices);
+    m_options = options;
+    m_stats = stats;
+    m_builtSahCost = stats.sahCost;
+}
+
+auto Bvh::Clear() -> void
+{
+    m_nodes.clear();
+    m_primIndices.clear();
+    m_stats = {};
+    m_builtSahCost = 0.0f;
+}
+
+auto Bvh::ComputeSahCost() const -> float
+{
+    if (m_nodes.empty())
+        return 0.0f;
+
+    // Probability of a ray that hits the root also hitting a node is the
+    // ratio of their surface areas. Summed in double: with millions of nodes
+    // a float sum would depend on the order the nodes are stored in.
+    double cost = 0.0;
+    for (const BvhNode& node : m_nodes)
+    {
+        cost += NodeCost(node, m_options);
+    }
+    const double rootArea =
+        std::max(m_nodes[ROOT].bounds.SurfaceArea(),
+                 std::numeric_limits<float>::min());
+    return static_cast<float>(cost / rootArea);
+}
+
+} // namespace pathtracer
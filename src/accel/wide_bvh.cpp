@@ -0,0 +1,120 @@
+#include "accel/wide_bvh.h"
+
+#include <utility>
+
+namespace pathtracer
+{
+template <size_t N> auto WideBvh<N>::Build(const Bvh& bvh) -> void
+{
+    Clear();
+    if (bvh.IsEmpty())
+        return;
+
+    const Bvh::NodeArray& binary = bvh.GetNodes();
+    m_primIndices = bvh.GetPrimIndices();
+
+    // At least one wide node per N - 1 binary interior nodes
+    m_nodes.reserve(binary.size() / (N - 1) + 1);
+    m_nodes.push_back(Node{});
+
+    // Pairs of a binary interior node and the wide node it becomes. A leaf
+    // root becomes the only child of the wide root.
+    struct Entry
+    {
+        uint32_t binaryIdx;
+        uint32_t wideIdx;
+    };
+    std::vector<Entry> work{{0, ROOT}};
+    while (!work.empty())
+    {
+        const Entry entry = work.back();
+        work.pop_back();
+
+        uint32_t children[N];
+        uint32_t childCount = 0;
+        const BvhNode& root = binary[entry.binaryIdx];
+        if (root.IsLeaf())
+        {
+            children[childCount++] = entry.binaryIdx;
+        }
+        else
+        {
+            children[childCount++] = entry.binaryIdx + 1;
+            children[childCount++] = root.offset;
+        }
+
+        // Open the largest interior child until the node is full; the
+        // largest child is the one a ray is most likely to enter
+        while (childCount < N)
+        {
+            uint32_t largest = N;
+            float largestArea = -1.0f;
+            for (uint32_t i = 0; i < childCount; ++i)
+            {
+                const BvhNode& child = binary[children[i]];
+                const float area = child.bounds.SurfaceArea();
+                if (!child.IsLeaf() && area > largestArea)
+                {
+                    largest = i;
+                    largestArea = area;
+                }
+            }
+            if (largest == N)
+                break; // Only leaves left
+
+            const uint32_t opened = children[largest];
+            children[largest] = opened + 1;
+            children[childCount++] = binary[opened].offset;
+        }
+
+        // Allocate the interior children before filling in the node, since
+        // growing m_nodes moves it
+        uint32_t wideChildren[N];
+        for (uint32_t i = 0; i < childCount; ++i)
+        {
+            if (!binary[children[i]].IsLeaf())
+            {
+                wideChildren[i] = static_cast<uint32_t>(m_nodes.size());
+                m_nodes.push_back(Node{});
+                work.push_back({children[i], wideChildren[i]});
+            }
+        }
+
+        Node& node = m_nodes[entry.wideIdx];
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (i >= childCount)
+            {
+                constexpr float INF = std::numeric_limits<float>::infinity();
+                node.SetChildBounds(i, {glm::vec3{INF}, glm::vec3{INF}});
+                node.child[i] = 0;
+                node.primCount[i] = 0;
+                continue;
+            }
+
+            const BvhNode& child = binary[children[i]];
+            node.SetChildBounds(i, child.bounds);
+            node.child[i] = child.IsLeaf() ? child.offset : wideChildren[i];
+            node.primCount[i] = child.primCount;
+        }
+    }
+}
+
+template <size_t N>
+auto WideBvh<N>::Assign(NodeArray nodes, std::vector<uint32_t> primIndices)
+    -> void
+{
+    m_nodes = std::move(nodes);
+    m_primIndices = std::move(primIndices);
+}
+
+template <size_t N> auto WideBvh<N>::Clear() -> void
+{
+    m_nodes.clear();
+    m_primIndices.clear();
+}
+
+template class WideBvh<4>;
+template class WideBvh<8>;
+
+} // namespace pathtracer
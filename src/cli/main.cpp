@@ -0,0 +1,688 @@
+#include "cpu/compute_kernel_emulator.h"
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/image_resolver.h"
+#include "cpu/samplers.h"
+#include "interfaces/frame_renderer_interface.h"
+#include "io/image_encoding.h"
+#include "io/image_writer.h"
+#include "io/mesh_import.h"
+#include "io/scene_cache.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+struct CliOptions
+{
+    uint32_t width = 960;
+    uint32_t height = 540;
+    uint32_t frames = 1;
+    uint32_t threads = 0;
+    uint32_t tileSize = pathtracer::TileScheduler::DEFAULT_TILE_SIZE;
+    bool printStats = false;
+    std::string renderer = "cpu";
+    std::string integrator = "preview";
+    std::string sampler = "independent";
+    std::string execution = "path";
+    bool sortRays = false;
+    bool denoise = false;
+    bool reproject = false;
+    float orbit = 0.0f;
+    float exposure = 0.0f;
+    std::string tonemap = "none";
+    bool dither = true;
+    float adaptiveThreshold = 0.0f;
+    uint32_t minSamples =
+        pathtracer::CpuPathtracer::DEFAULT_ADAPTIVE_MIN_SAMPLES;
+    uint32_t bounces = pathtracer::CpuPathtracer::DEFAULT_MAX_BOUNCES;
+    uint32_t rouletteDepth = pathtracer::CpuPathtracer::DEFAULT_ROULETTE_DEPTH;
+    std::string output = "output.ppm";
+    uint32_t saveEvery = 0;
+    uint32_t writerThreads = 2;
+    std::string mesh;
+    std::string cache;
+};
+
+auto PrintUsage() -> void
+{
+    std::cout << "Usage: pathtracer_cli [options]\n"
+              << "  --width <px>      Image width (default 960)\n"
+              << "  --height <px>     Image height (default 540)\n"
+              << "  --frames <n>      Frames to accumulate (default 1)\n"
+              << "  --renderer <name> cpu or kernel (compute.hlsl emulation)\n"
+              << "  --integrator <n>  cpu renderer: preview, naive or nee\n"
+              << "  --bounces <n>     Most path bounces after the first hit\n"
+              << "                    (default 16)\n"
+              << "  --sampler <name>  independent, stratified (over --frames\n"
+              << "                    samples), sobol or blue-noise\n"
+              << "  --execution <m>   path (one path at a time) or wavefront\n"
+              << "                    (bounce by bounce per tile)\n"
+              << "  --sort-rays       Trace wavefront bounces sorted by\n"
+              << "                    direction and origin (needs\n"
+              << "                    --execution wavefront)\n"
+              << "  --denoise         Filter the image with the a-trous\n"
+              << "                    denoiser (cpu renderer)\n"
+              << "  --reproject       Keep the samples of surfaces still in\n"
+              << "                    view when the camera moves\n"
+              << "  --orbit <rad>     Rotate the camera by rad around its\n"
+              << "                    target every frame (default 0)\n"
+              << "  --adaptive <err>  Stop sampling pixels whose relative\n"
+              << "                    error is below err, and stop early\n"
+              << "                    once all are (default 0 = off)\n"
+              << "  --min-samples <n> Samples per pixel before --adaptive\n"
+              << "                    may stop it (default 16)\n"
+              << "  --exposure <ev>   Scale the image by 2^ev (default 0)\n"
+              << "  --tonemap <name>  none (clip), reinhard or aces\n"
+              << "  --no-dither       Round to nearest instead of dithering\n"
+              << "  --roulette-depth <n>\n"
+              << "                    Bounces before Russian roulette\n"
+              << "                    (default 3)\n"
+              << "  --threads <n>     Render threads (default 0 = all cores)\n"
+              << "  --tile-size <px>  Scheduler tile edge length (default 32)\n"
+              << "  --stats           Print per-thread busy/idle times and\n"
+              << "                    rays per path depth\n"
+              << "  --output <path>   Output .ppm, .png (8-bit sRGB) or .exr\n"
+              << "                    (half-float linear) file (default\n"
+              << "                    output.ppm)\n"
+              << "  --save-every <n>  Also write every nth frame, as\n"
+              << "                    <name>_<frame>.<ext>, unless the\n"
+              << "                    writer is behind (default 0 = off)\n"
+              << "  --writer-threads <n>\n"
+              << "                    Threads encoding images (default 2)\n"
+              << "  --mesh <path>     Add an .obj or .ply mesh to the scene\n"
+              << "  --cache <path>    Load the scene from this cache file, or\n"
+              << "                    build it and write the cache\n"
+              << "  --help            Show this message\n";
+}
+
+auto ParseUint(std::string_view name, const char* value) -> uint32_t
+{
+    if (!value)
+    {
+        throw std::invalid_argument("Missing value for " + std::string(name));
+    }
+    return static_cast<uint32_t>(std::stoul(value));
+}
+
+auto ParseFloat(std::string_view name, const char* value) -> float
+{
+    if (!value)
+    {
+        throw std::invalid_argument("Missing value for " + std::string(name));
+    }
+    return std::stof(value);
+}
+
+auto ParseIntegrator(const std::string& name) -> pathtracer::Integrator
+{
+    if (name == "preview")
+        return pathtracer::Integrator::Preview;
+    if (name == "naive")
+        return pathtracer::Integrator::Naive;
+    if (name == "nee")
+        return pathtracer::Integrator::NextEvent;
+    throw std::invalid_argument("Unknown integrator: " + name);
+}
+
+auto ParseExecutionMode(const std::string& name) -> pathtracer::ExecutionMode
+{
+    if (name == "path")
+        return pathtracer::ExecutionMode::PerPath;
+    if (name == "wavefront")
+        return pathtracer::ExecutionMode::Wavefront;
+    throw std::invalid_argument("Unknown execution mode: " + name);
+}
+
+auto ParseTonemap(const std::string& name) -> pathtracer::Tonemap
+{
+    if (name == "none")
+        return pathtracer::Tonemap::None;
+    if (name == "reinhard")
+        return pathtracer::Tonemap::Reinhard;
+    if (name == "aces")
+        return pathtracer::Tonemap::Aces;
+    throw std::invalid_argument("Unknown tonemap: " + name);
+}
+
+auto CreateSampler(const CliOptions& options)
+    -> std::shared_ptr<const pathtracer::ISampler>
+{
+    if (options.sampler == "independent")
+        return std::make_shared<pathtracer::IndependentSampler>();
+    if (options.sampler == "stratified")
+    {
+        return std::make_shared<pathtracer::StratifiedSampler>(
+            std::max(options.frames, 1u));
+    }
+    if (options.sampler == "sobol")
+        return std::make_shared<pathtracer::SobolSampler>();
+    if (options.sampler == "blue-noise")
+        return std::make_shared<pathtracer::BlueNoiseSampler>();
+    throw std::invalid_argument("Unknown sampler: " + options.sampler);
+}
+
+/// <summary>
+/// Parses command line arguments. Returns false if the program should exit
+/// without rendering (e.g. --help).
+/// </summary>
+auto ParseArgs(int argc, char** argv, CliOptions& options) -> bool
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+        if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage();
+            return false;
+        }
+        else if (arg == "--width")
+        {
+            options.width = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--height")
+        {
+            options.height = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--frames")
+        {
+            options.frames = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--tile-size")
+        {
+            options.tileSize = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--stats")
+        {
+            options.printStats = true;
+        }
+        else if (arg == "--sort-rays")
+        {
+            options.sortRays = true;
+        }
+        else if (arg == "--denoise")
+        {
+            options.denoise = true;
+        }
+        else if (arg == "--no-dither")
+        {
+            options.dither = false;
+        }
+        else if (arg == "--reproject")
+        {
+            options.reproject = true;
+        }
+        else if (arg == "--orbit")
+        {
+            options.orbit = ParseFloat(arg, value);
+            ++i;
+        }
+        else if (arg == "--renderer")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --renderer");
+            }
+            options.renderer = value;
+            ++i;
+        }
+        else if (arg == "--integrator")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --integrator");
+            }
+            options.integrator = value;
+            ++i;
+        }
+        else if (arg == "--sampler")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --sampler");
+            }
+            options.sampler = value;
+            ++i;
+        }
+        else if (arg == "--execution")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --execution");
+            }
+            options.execution = value;
+            ++i;
+        }
+        else if (arg == "--bounces")
+        {
+            options.bounces = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--exposure")
+        {
+            options.exposure = ParseFloat(arg, value);
+            ++i;
+        }
+        else if (arg == "--tonemap")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --tonemap");
+            }
+            options.tonemap = value;
+            ++i;
+        }
+        else if (arg == "--adaptive")
+        {
+            options.adaptiveThreshold = ParseFloat(arg, value);
+            ++i;
+        }
+        else if (arg == "--min-samples")
+        {
+            options.minSamples = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--roulette-depth")
+        {
+            options.rouletteDepth = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--output")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --output");
+            }
+            options.output = value;
+            ++i;
+        }
+        else if (arg == "--save-every")
+        {
+            options.saveEvery = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--writer-threads")
+        {
+            options.writerThreads = ParseUint(arg, value);
+            ++i;
+        }
+        else if (arg == "--mesh")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --mesh");
+            }
+            options.mesh = value;
+            ++i;
+        }
+        else if (arg == "--cache")
+        {
+            if (!value)
+            {
+                throw std::invalid_argument("Missing value for --cache");
+            }
+            options.cache = value;
+            ++i;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown argument: " +
+                                        std::string(arg));
+        }
+    }
+
+    if (options.width == 0 || options.height == 0)
+    {
+        throw std::invalid_argument("Image size must be non-zero");
+    }
+    if (options.tileSize == 0)
+    {
+        throw std::invalid_argument("Tile size must be non-zero");
+    }
+    if (options.sortRays &&
+        (options.renderer != "cpu" || options.execution != "wavefront" ||
+         options.integrator == "preview"))
+    {
+        // Only the wavefront bounces of the cpu path tracers sort rays
+        throw std::invalid_argument(
+            "--sort-rays needs --renderer cpu, --execution wavefront and a "
+            "path tracing integrator");
+    }
+
+    // Fail before rendering rather than after
+    const pathtracer::ImageFormat format =
+        pathtracer::GetImageFormat(options.output);
+    if (format == pathtracer::ImageFormat::Png &&
+        !pathtracer::IsPngSupported())
+    {
+        throw std::invalid_argument(
+            "PNG output needs stb, which was not found at build time");
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Prints the per-thread busy/idle breakdown of the last scheduler run.
+/// </summary>
+auto PrintThreadStats(const pathtracer::TileScheduler& scheduler) -> void
+{
+    const auto& stats = scheduler.GetThreadStats();
+    const double wallMs = scheduler.GetLastRunMs();
+
+    double busyTotal = 0.0;
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        const auto& s = stats[i];
+        busyTotal += s.busyMs;
+        std::cout << "  thread " << i << ": busy " << s.busyMs << " ms, idle "
+                  << s.idleMs << " ms, tiles " << s.tilesExecuted
+                  << " (stolen " << s.tilesStolen << ")\n";
+    }
+
+    if (wallMs > 0.0 && !stats.empty())
+    {
+        std::cout << "  utilization: "
+                  << 100.0 * busyTotal / (wallMs * stats.size()) << "% of "
+                  << stats.size() << " threads over " << wallMs << " ms\n";
+    }
+}
+
+/// <summary>
+/// Prints how many rays the last frame traced at each path depth.
+/// </summary>
+auto PrintDepthStats(const pathtracer::PathDepthStats& stats) -> void
+{
+    uint64_t total = 0;
+    for (size_t depth = 0; depth < stats.rays.size(); ++depth)
+    {
+        if (stats.rays[depth] == 0 && stats.shadowRays[depth] == 0)
+            continue;
+        total += stats.rays[depth] + stats.shadowRays[depth];
+        std::cout << "  depth " << depth << ": " << stats.rays[depth]
+                  << " rays, " << stats.shadowRays[depth]
+                  << " shadow rays\n";
+    }
+    std::cout << "  total: " << total << " rays\n";
+}
+
+/// <summary>
+/// Path of the intermediate image of a frame: output with the frame number
+/// appended to its name, e.g. output_0016.png.
+/// </summary>
+auto GetFramePath(const std::string& output, uint32_t frame)
+    -> std::filesystem::path
+{
+    std::string number = std::to_string(frame);
+    if (number.size() < 4)
+        number.insert(0, 4 - number.size(), '0');
+    std::filesystem::path path = output;
+    path.replace_filename(path.stem().string() + "_" + number +
+                          path.extension().string());
+    return path;
+}
+
+/// <summary>
+/// Hands a snapshot of the framebuffer to the writer: a copy of the linear
+/// radiance for EXR, and otherwise the pixels resolved on the render
+/// threads, which takes a fraction of a frame. With wait false the
+/// snapshot is dropped if the writer is behind, so rendering never waits
+/// for it. Returns whether it was queued.
+/// </summary>
+auto SubmitSnapshot(pathtracer::AsyncImageWriter& writer,
+                    const std::filesystem::path& path,
+                    const pathtracer::Framebuffer& framebuffer,
+                    pathtracer::ImageResolver& resolver,
+                    pathtracer::TileScheduler& scheduler, bool wait) -> bool
+{
+    const uint32_t width = framebuffer.GetWidth();
+    const uint32_t height = framebuffer.GetHeight();
+    if (pathtracer::IsLinearFormat(pathtracer::GetImageFormat(path)))
+    {
+        std::vector<glm::vec4> radiance = framebuffer.GetPixels();
+        if (!wait)
+            return writer.TrySubmit(path, width, height, std::move(radiance));
+        writer.Submit(path, width, height, std::move(radiance));
+        return true;
+    }
+
+    std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+    resolver.Resolve(framebuffer, pixels, scheduler);
+    if (!wait)
+        return writer.TrySubmit(path, width, height, std::move(pixels));
+    writer.Submit(path, width, height, std::move(pixels));
+    return true;
+}
+
+auto ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+    -> double
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+/// <summary>
+/// The test scene plus the --mesh file. With --cache, comes from the cache
+/// when it is valid for the mesh file, and otherwise is built and cached.
+/// </summary>
+auto LoadScene(const CliOptions& options) -> pathtracer::Scene
+{
+    std::vector<std::filesystem::path> sources;
+    if (!options.mesh.empty())
+        sources.emplace_back(options.mesh);
+
+    const auto loadStart = std::chrono::high_resolution_clock::now();
+    if (!options.cache.empty())
+    {
+        std::optional<pathtracer::Scene> cached =
+            pathtracer::LoadSceneCache(options.cache, sources);
+        if (cached)
+        {
+            std::cout << "Loaded " << options.cache << " in "
+                      << ElapsedMs(loadStart) << " ms\n";
+            return std::move(*cached);
+        }
+    }
+
+    pathtracer::Scene scene = pathtracer::CreateTestScene();
+    if (!options.mesh.empty())
+    {
+        pathtracer::TriangleMesh mesh = pathtracer::LoadMesh(options.mesh);
+        std::cout << "Loaded " << options.mesh << ": "
+                  << mesh.GetTriangleCount() << " triangles in "
+                  << ElapsedMs(loadStart) << " ms\n";
+        scene.AddMesh(std::move(mesh));
+    }
+
+    if (!options.cache.empty())
+    {
+        const auto saveStart = std::chrono::high_resolution_clock::now();
+        pathtracer::SaveSceneCache(options.cache, scene, sources);
+        std::cout << "Wrote " << options.cache << " in "
+                  << ElapsedMs(saveStart) << " ms\n";
+    }
+    return scene;
+}
+} // namespace
+
+/// <summary>
+/// Entry point for the headless path tracer. Renders with the portable CPU
+/// core only, so it runs on any platform with a C++23 compiler and glm.
+/// </summary>
+int main(int argc, char** argv)
+{
+    try
+    {
+        CliOptions options;
+        if (!ParseArgs(argc, argv, options))
+        {
+            return EXIT_SUCCESS;
+        }
+
+        const float aspectRatio = static_cast<float>(options.width) /
+                                  static_cast<float>(options.height);
+        pathtracer::Camera camera(glm::radians(60.0f), aspectRatio, 0.1f,
+                                  1000.0f);
+
+        pathtracer::Framebuffer framebuffer(options.width, options.height);
+        pathtracer::ImageResolver resolver;
+        resolver.SetSettings({options.exposure, ParseTonemap(options.tonemap),
+                              options.dither,
+                              pathtracer::PixelFormat::Rgba8});
+        pathtracer::AsyncImageWriter writer(options.writerThreads);
+        pathtracer::Scene scene = LoadScene(options);
+
+        // Keep the scheduler around for --stats, whichever renderer owns it
+        std::unique_ptr<pathtracer::IFrameRenderer> renderer;
+        pathtracer::TileScheduler* scheduler = nullptr;
+        const pathtracer::CpuPathtracer* cpuRenderer = nullptr;
+        if (options.renderer == "cpu")
+        {
+            auto cpu = std::make_unique<pathtracer::CpuPathtracer>(
+                options.width, options.height, options.threads,
+                options.tileSize);
+            cpu->SetIntegrator(ParseIntegrator(options.integrator));
+            cpu->SetMaxBounces(options.bounces);
+            cpu->SetRouletteDepth(options.rouletteDepth);
+            cpu->SetSampler(CreateSampler(options));
+            cpu->SetExecutionMode(ParseExecutionMode(options.execution));
+            cpu->SetRaySorting(options.sortRays);
+            cpu->SetAdaptiveSampling(options.adaptiveThreshold,
+                                     options.minSamples);
+            cpu->SetDenoising(options.denoise);
+            cpu->SetTemporalReprojection(options.reproject);
+            scheduler = &cpu->GetScheduler();
+            cpuRenderer = cpu.get();
+            renderer = std::move(cpu);
+        }
+        else if (options.renderer == "kernel")
+        {
+            auto kernel = std::make_unique<pathtracer::ComputeKernelEmulator>(
+                options.width, options.height, options.threads);
+            scheduler = &kernel->GetScheduler();
+            scheduler->SetTileSize(options.tileSize);
+            renderer = std::move(kernel);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown renderer: " +
+                                        options.renderer);
+        }
+
+        // Unless the camera orbits, nothing changes between frames, so a
+        // converged image is final
+        const auto start = std::chrono::high_resolution_clock::now();
+        uint32_t frames = 0;
+        while (frames < options.frames &&
+               (options.orbit != 0.0f || !renderer->IsConverged()))
+        {
+            if (frames > 0 && options.orbit != 0.0f)
+                camera.Rotate(options.orbit, 0.0f);
+            renderer->Render(framebuffer, camera, frames++, scene);
+            camera.ClearDirty();
+            scene.ClearChanges();
+
+            if (options.saveEvery > 0 && frames % options.saveEvery == 0 &&
+                frames < options.frames)
+            {
+                SubmitSnapshot(writer, GetFramePath(options.output, frames),
+                               framebuffer, resolver, *scheduler, false);
+            }
+        }
+        const double elapsedMs =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start)
+                .count();
+
+        std::cout << renderer->GetName() << ": " << frames
+                  << " frame(s) at " << options.width << "x" << options.height
+                  << " in " << elapsedMs << " ms ("
+                  << elapsedMs / std::max(frames, 1u) << " ms/frame) on "
+                  << scheduler->GetThreadCount()
+                  << " thread(s)\n";
+        if (cpuRenderer && options.denoise)
+        {
+            std::cout << "Denoised the last frame in "
+                      << cpuRenderer->GetDenoiser().GetLastRunMs() << " ms\n";
+        }
+        if (cpuRenderer && options.adaptiveThreshold > 0.0f)
+        {
+            if (renderer->IsConverged())
+            {
+                std::cout << "Converged after " << frames << " frame(s)\n";
+            }
+            else
+            {
+                std::cout << cpuRenderer->GetUnconvergedPixelCount()
+                          << " pixel(s) still above the error threshold\n";
+            }
+        }
+
+        if (options.printStats)
+        {
+            std::cout << "Last frame:\n";
+            PrintThreadStats(*scheduler);
+            if (cpuRenderer)
+                PrintDepthStats(cpuRenderer->GetDepthStats());
+        }
+
+        SubmitSnapshot(writer, options.output, framebuffer, resolver,
+                       *scheduler, true);
+        if (options.printStats &&
+            !pathtracer::IsLinearFormat(
+                pathtracer::GetImageFormat(options.output)))
+        {
+            std::cout << "Resolved in " << resolver.GetLastRunMs()
+                      << " ms\n";
+        }
+
+        writer.Flush();
+        std::cout << "Wrote " << options.output << " in "
+                  << writer.GetLastWriteMs() << " ms\n";
+        if (options.saveEvery > 0)
+        {
+            std::cout << "Wrote " << writer.GetWrittenCount() - 1
+                      << " intermediate image(s)";
+            if (writer.GetDroppedCount() > 0)
+            {
+                std::cout << ", skipped " << writer.GetDroppedCount()
+                          << " while the writer was behind";
+            }
+            std::cout << "\n";
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
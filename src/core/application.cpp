@@ -3,15 +3,19 @@
 #include "core/application.h"
 #include "core/dx12_device.h"
 #include "core/window.h"
+#include "cpu/cpu_pathtracer.h"
 #include "rendering/compute_pathtracer.h"
-// #include "rendering/cpu_pathtracer.h"
+#include "rendering/framebuffer_presenter.h"
 #include "rendering/renderer.h"
 #include "scene/camera.h"
+#include "scene/scene.h"
 
 namespace pathtracer
 {
-Application::Application(const UINT width, const UINT height, LPCTSTR title)
-    : m_width(width), m_height(height), m_title(title),
+Application::Application(const RendererKind rendererKind, const UINT width,
+                         const UINT height, LPCTSTR title)
+    : m_rendererKind(rendererKind), m_width(width), m_height(height),
+      m_title(title),
       m_aspectRatio(static_cast<float>(width) / static_cast<float>(height))
 {
     Initialize();
@@ -34,6 +38,15 @@ int Application::Run()
             m_isRunning = false;
             break;
         }
+
+        // A converged image does not change until the camera or the scene
+        // does, and both only change in response to window messages
+        if (m_renderer->IsConverged() && !m_camera->IsDirty() &&
+            m_scene->GetChanges() == SceneChange::None)
+        {
+            m_window->WaitForMessages();
+            continue;
+        }
         Tick();
 
         Sleep(1);
@@ -51,9 +64,23 @@ void Application::Initialize()
     m_device = std::make_unique<DX12Device>();
 
     // Create pathtracer
-    auto pathtracer = std::make_unique<ComputePathtracer>(
-        m_device->GetDevice(), m_device->GetInfoQueue(), m_window->GetWidth(),
-        m_window->GetHeight());
+    std::unique_ptr<IPathTracer> pathtracer;
+    if (m_rendererKind == RendererKind::Cpu)
+    {
+        // Adaptive sampling is what lets the CPU path tracer converge
+        auto cpu = std::make_unique<CpuPathtracer>(m_window->GetWidth(),
+                                                   m_window->GetHeight());
+        cpu->SetAdaptiveSampling(m_ADAPTIVE_THRESHOLD);
+        pathtracer = std::make_unique<FramebufferPresenter>(
+            m_device->GetDevice(), m_device->GetInfoQueue(), std::move(cpu),
+            m_window->GetWidth(), m_window->GetHeight());
+    }
+    else
+    {
+        pathtracer = std::make_unique<ComputePathtracer>(
+            m_device->GetDevice(), m_device->GetInfoQueue(),
+            m_window->GetWidth(), m_window->GetHeight());
+    }
 
     // Create renderer
     m_renderer = std::make_unique<Renderer>(
@@ -66,6 +93,9 @@ void Application::Initialize()
     m_camera = std::make_unique<Camera>(m_CAMERA_FOV, m_aspectRatio,
                                         m_NEAR_PLANE, m_FAR_PLANE);
 
+    // Create scene
+    m_scene = std::make_unique<Scene>(CreateTestScene());
+
     // Set window callbacks
     m_window->SetResizeCallback([this](UINT width, UINT height)
                                 { OnResize(width, height); });
@@ -112,7 +142,12 @@ void Application::Tick()
         m_window->SetTitle(titleBuffer);
     }
 
-    m_renderer->RenderFrame(*m_camera);
+    m_renderer->RenderFrame(*m_camera, *m_scene);
+
+    // The path tracer has seen this camera and scene state, so it can keep
+    // accumulating until either changes again
+    m_camera->ClearDirty();
+    m_scene->ClearChanges();
 }
 
 void Application::Shutdown()
@@ -104,6 +104,11 @@ bool Window::ProcessMessages()
     return true;
 }
 
+auto Window::WaitForMessages() const -> void
+{
+    WaitMessage();
+}
+
 void Window::Show() const
 {
     // TODO: handle ShowWindow failure (returns 0 on failure)
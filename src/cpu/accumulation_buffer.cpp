@@ -0,0 +1,46 @@
+#include "cpu/accumulation_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace pathtracer
+{
+auto AccumulationBuffer::Resize(uint32_t width, uint32_t height) -> void
+{
+    m_width = width;
+    m_height = height;
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    m_sum.resize(pixelCount);
+    m_luminanceSqSum.resize(pixelCount);
+    m_sampleCount.resize(pixelCount);
+
+    Reset();
+}
+
+auto AccumulationBuffer::Reset() -> void
+{
+    std::fill(m_sum.begin(), m_sum.end(), glm::vec3{0.0f});
+    std::fill(m_luminanceSqSum.begin(), m_luminanceSqSum.end(), 0.0f);
+    std::fill(m_sampleCount.begin(), m_sampleCount.end(), 0u);
+    ++m_resetCount;
+}
+
+auto AccumulationBuffer::GetRelativeError(uint32_t x, uint32_t y) const
+    -> float
+{
+    const size_t idx = Index(x, y);
+    const uint32_t count = m_sampleCount[idx];
+    if (count < 2)
+        return std::numeric_limits<float>::infinity();
+
+    // Unbiased sample variance of the luminance, then of its mean
+    const float n = static_cast<float>(count);
+    const float mean = Luminance(m_sum[idx]) / n;
+    const float variance =
+        std::max(m_luminanceSqSum[idx] - mean * mean * n, 0.0f) / (n - 1.0f);
+    return std::sqrt(variance / n) / std::max(mean, MIN_LUMINANCE);
+}
+
+} // namespace pathtracer
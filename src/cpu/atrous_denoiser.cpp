@@ -0,0 +1,221 @@
+#include "cpu/atrous_denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace pathtracer
+{
+namespace
+{
+// B3-spline weights of the 5 taps along each axis
+constexpr float KERNEL[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f,
+                             1.0f / 4.0f, 1.0f / 16.0f};
+
+// Albedo the radiance is divided by at least, so black surfaces do not
+// turn their emission or noise into unbounded illumination
+constexpr float MIN_ALBEDO = 0.01f;
+
+// Row accumulators: weight, r, g, b, then the center pixels' depth scale
+constexpr size_t ROW_SUMS = 5;
+} // namespace
+
+auto AtrousDenoiser::Resize(uint32_t width, uint32_t height,
+                            uint32_t threadCount, uint32_t tileSize) -> void
+{
+    m_width = width;
+    m_height = height;
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    const auto resize = [&](Vec3Planes& planes)
+    {
+        planes.x.resize(pixelCount);
+        planes.y.resize(pixelCount);
+        planes.z.resize(pixelCount);
+    };
+    resize(m_illumination[0]);
+    resize(m_illumination[1]);
+    resize(m_albedo);
+    resize(m_normal);
+    m_depth.resize(pixelCount);
+
+    m_rowSums.resize(threadCount);
+    for (std::vector<float>& sums : m_rowSums)
+    {
+        sums.resize(ROW_SUMS * tileSize);
+    }
+}
+
+auto AtrousDenoiser::Denoise(const AccumulationBuffer& accumulation,
+                             const FeatureBuffer& features,
+                             Framebuffer& framebuffer,
+                             TileScheduler& scheduler) -> void
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const uint32_t width = accumulation.GetWidth();
+    const uint32_t height = accumulation.GetHeight();
+    Resize(width, height, scheduler.GetThreadCount(),
+           scheduler.GetTileSize());
+
+    // Load the illumination and the features into planes
+    Vec3Planes* src = &m_illumination[0];
+    scheduler.Run(
+        width, height,
+        [&](const Tile& tile, uint32_t /*threadIdx*/)
+        {
+            for (uint32_t y = tile.y0; y < tile.y1; ++y)
+            {
+                for (uint32_t x = tile.x0; x < tile.x1; ++x)
+                {
+                    const size_t p = static_cast<size_t>(y) * width + x;
+                    const glm::vec3 albedo = features.GetAlbedo(x, y);
+                    const glm::vec3 illumination =
+                        accumulation.Resolve(x, y) /
+                        glm::max(albedo, glm::vec3{MIN_ALBEDO});
+                    const glm::vec3 normal = features.GetNormal(x, y);
+                    src->x[p] = illumination.r;
+                    src->y[p] = illumination.g;
+                    src->z[p] = illumination.b;
+                    m_albedo.x[p] = albedo.r;
+                    m_albedo.y[p] = albedo.g;
+                    m_albedo.z[p] = albedo.b;
+                    m_normal.x[p] = normal.x;
+                    m_normal.y[p] = normal.y;
+                    m_normal.z[p] = normal.z;
+                    m_depth[p] = features.GetDepth(x, y);
+                }
+            }
+        });
+
+    float colorPhi = m_settings.colorPhi;
+    for (uint32_t pass = 0; pass < m_settings.iterations; ++pass)
+    {
+        Vec3Planes* dst =
+            src == &m_illumination[0] ? &m_illumination[1] : &m_illumination[0];
+        scheduler.Run(width, height,
+                      [&](const Tile& tile, uint32_t threadIdx)
+                      {
+                          FilterTile(tile, 1u << pass, colorPhi, *src, *dst,
+                                     threadIdx);
+                      });
+        src = dst;
+        colorPhi *= 0.5f;
+    }
+
+    // Multiply the albedo back in
+    scheduler.Run(
+        width, height,
+        [&](const Tile& tile, uint32_t /*threadIdx*/)
+        {
+            for (uint32_t y = tile.y0; y < tile.y1; ++y)
+            {
+                glm::vec4* row = framebuffer.GetRow(y);
+                for (uint32_t x = tile.x0; x < tile.x1; ++x)
+                {
+                    const size_t p = static_cast<size_t>(y) * width + x;
+                    row[x] = glm::vec4{src->x[p] * m_albedo.x[p],
+                                       src->y[p] * m_albedo.y[p],
+                                       src->z[p] * m_albedo.z[p], 1.0f};
+                }
+            }
+        });
+
+    m_lastRunMs = std::chrono::duration<double, std::milli>(
+                      std::chrono::high_resolution_clock::now() - start)
+                      .count();
+}
+
+auto AtrousDenoiser::FilterTile(const Tile& tile, uint32_t step,
+                                float colorPhi, const Vec3Planes& src,
+                                Vec3Planes& dst, uint32_t threadIdx) -> void
+{
+    const ptrdiff_t width = m_width;
+    const ptrdiff_t height = m_height;
+    const ptrdiff_t x0 = tile.x0;
+    const ptrdiff_t x1 = tile.x1;
+    const ptrdiff_t tileWidth = x1 - x0;
+
+    float* sumW = m_rowSums[threadIdx].data();
+    float* sumR = sumW + tileWidth;
+    float* sumG = sumR + tileWidth;
+    float* sumB = sumG + tileWidth;
+    float* depthScale = sumB + tileWidth;
+
+    const float invColorPhi = 1.0f / colorPhi;
+    const float invNormalPhi = 1.0f / m_settings.normalPhi;
+    const float stepSq = static_cast<float>(step) * static_cast<float>(step);
+
+    for (ptrdiff_t y = tile.y0; y < tile.y1; ++y)
+    {
+        const ptrdiff_t rowP = y * width;
+        for (ptrdiff_t x = x0; x < x1; ++x)
+        {
+            // Depth differences relative to the center's depth, per pixel
+            // of tap spacing
+            const float z = m_depth[rowP + x];
+            const ptrdiff_t i = x - x0;
+            sumW[i] = 0.0f;
+            sumR[i] = 0.0f;
+            sumG[i] = 0.0f;
+            sumB[i] = 0.0f;
+            depthScale[i] =
+                1.0f / (z * z * stepSq * m_settings.depthPhi + 1e-6f);
+        }
+
+        for (ptrdiff_t ty = 0; ty < 5; ++ty)
+        {
+            const ptrdiff_t yq = y + (ty - 2) * static_cast<ptrdiff_t>(step);
+            if (yq < 0 || yq >= height)
+                continue;
+
+            for (ptrdiff_t tx = 0; tx < 5; ++tx)
+            {
+                // Only the pixels whose tap lands inside the image
+                const ptrdiff_t offset =
+                    (tx - 2) * static_cast<ptrdiff_t>(step);
+                const ptrdiff_t xBegin = std::max(x0, -offset);
+                const ptrdiff_t xEnd = std::min(x1, width - offset);
+                const float h = KERNEL[ty] * KERNEL[tx];
+                const ptrdiff_t rowQ = yq * width + offset;
+                for (ptrdiff_t x = xBegin; x < xEnd; ++x)
+                {
+                    const ptrdiff_t p = rowP + x;
+                    const ptrdiff_t q = rowQ + x;
+                    const ptrdiff_t i = x - x0;
+
+                    const float dr = src.x[q] - src.x[p];
+                    const float dg = src.y[q] - src.y[p];
+                    const float db = src.z[q] - src.z[p];
+                    const float dnx = m_normal.x[q] - m_normal.x[p];
+                    const float dny = m_normal.y[q] - m_normal.y[p];
+                    const float dnz = m_normal.z[q] - m_normal.z[p];
+                    const float dz = m_depth[q] - m_depth[p];
+                    const float w =
+                        h * std::exp(
+                                -(dr * dr + dg * dg + db * db) * invColorPhi -
+                                (dnx * dnx + dny * dny + dnz * dnz) *
+                                    invNormalPhi -
+                                dz * dz * depthScale[i]);
+
+                    sumW[i] += w;
+                    sumR[i] += w * src.x[q];
+                    sumG[i] += w * src.y[q];
+                    sumB[i] += w * src.z[q];
+                }
+            }
+        }
+
+        // The center tap always has a weight, so sumW is never 0
+        for (ptrdiff_t x = x0; x < x1; ++x)
+        {
+            const ptrdiff_t i = x - x0;
+            const float invW = 1.0f / sumW[i];
+            dst.x[rowP + x] = sumR[i] * invW;
+            dst.y[rowP + x] = sumG[i] * invW;
+            dst.z[rowP + x] = sumB[i] * invW;
+        }
+    }
+}
+
+} // namespace pathtracer
@@ -0,0 +1,182 @@
+#include "cpu/compute_kernel_emulator.h"
+#include "utils/random.h"
+
+#include <glm/glm.hpp>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// Port of intersectSphere() from compute.hlsl.
+/// </summary>
+auto intersectSphere(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                     const glm::vec3& sphereCenter, float sphereRadius,
+                     float& t) -> bool
+{
+    t = 0.0f;
+
+    const glm::vec3 oc = rayOrigin - sphereCenter;
+
+    const float a = glm::dot(rayDirection, rayDirection);
+    const float h = glm::dot(rayDirection, oc);
+    const float c = glm::dot(oc, oc) - sphereRadius * sphereRadius;
+    const float discriminant = h * h - a * c;
+
+    if (discriminant < 0.0f)
+        return false;
+
+    const float sqrtd = glm::sqrt(discriminant);
+
+    float root = (-h - sqrtd) / a;
+    if (root <= 0.0f)
+    {
+        root = (-h + sqrtd) / a;
+        if (root <= 0.0f)
+            return false;
+    }
+
+    t = root;
+    return true;
+}
+
+/// <summary>
+/// The first multiple of ComputeKernelEmulator::THREAD_GROUP_SIZE at or
+/// after coordinate.
+/// </summary>
+auto FirstGroupOrigin(uint32_t coordinate) -> uint32_t
+{
+    constexpr uint32_t SIZE = ComputeKernelEmulator::THREAD_GROUP_SIZE;
+    return (coordinate + SIZE - 1) / SIZE * SIZE;
+}
+} // namespace
+
+ComputeKernelEmulator::ComputeKernelEmulator(uint32_t width, uint32_t height,
+                                             uint32_t threadCount)
+    : m_width(width), m_height(height),
+      m_scheduler(threadCount)
+{
+    Resize(width, height);
+}
+
+auto ComputeKernelEmulator::Render(Framebuffer& framebuffer,
+                                   const Camera& camera,
+                                   const uint32_t frameIdx,
+                                   const Scene& scene) -> void
+{
+    // Explicitly mark unused parameter to avoid warnings
+    (void)frameIdx;
+
+    // Same constants ComputePathtracer uploads
+    m_cameraData = camera.GetGPUData();
+    m_frameData.frameIndex = m_frameCounter++;
+    const bool reset = camera.IsDirty() ||
+                       scene.GetChanges() != SceneChange::None ||
+                       m_resetPending;
+    m_frameData.resetAccumulation = reset ? 1u : 0u;
+    m_resetPending = false;
+
+    // Dispatch((width + 7) / 8, (height + 7) / 8, 1): each tile runs the
+    // thread groups whose first thread falls inside it, so every group runs
+    // once whatever the tile size, and threads past the edge return early
+    // like on the GPU
+    m_scheduler.Run(
+        m_width, m_height,
+        [&](const Tile& tile, uint32_t /*threadIdx*/)
+        {
+            const uint32_t gx0 = FirstGroupOrigin(tile.x0);
+            const uint32_t gy0 = FirstGroupOrigin(tile.y0);
+            for (uint32_t gy = gy0; gy < tile.y1; gy += THREAD_GROUP_SIZE)
+            {
+                for (uint32_t gx = gx0; gx < tile.x1; gx += THREAD_GROUP_SIZE)
+                {
+                    for (uint32_t y = 0; y < THREAD_GROUP_SIZE; ++y)
+                    {
+                        for (uint32_t x = 0; x < THREAD_GROUP_SIZE; ++x)
+                        {
+                            CSMain(glm::uvec2{gx + x, gy + y}, framebuffer);
+                        }
+                    }
+                }
+            }
+        });
+}
+
+auto ComputeKernelEmulator::Resize(const uint32_t width, const uint32_t height)
+    -> void
+{
+    m_width = width;
+    m_height = height;
+    m_accumulationTexture.assign(static_cast<size_t>(width) * height,
+                                 glm::vec4{0.0f});
+    m_resetPending = true;
+}
+
+auto ComputeKernelEmulator::CSMain(const glm::uvec2& DTid,
+                                   Framebuffer& outputTexture) -> void
+{
+    const uint32_t width = m_width;
+    const uint32_t height = m_height;
+
+    if (DTid.x >= width || DTid.y >= height)
+        return;
+
+    // Random sub-pixel jitter, decorrelated between frames
+    const uint32_t seed =
+        utils::PixelSeed(DTid.x, DTid.y, m_frameData.frameIndex);
+    const glm::vec2 jitter{utils::UintToUnitFloat(seed),
+                           utils::UintToUnitFloat(utils::PcgHash(seed))};
+
+    // Compute UV in [-1, 1] range
+    glm::vec2 uv = (glm::vec2{DTid} + jitter) /
+                   glm::vec2{static_cast<float>(width),
+                             static_cast<float>(height)};
+    uv = uv * 2.0f - 1.0f;
+    uv.y = -uv.y; // Flip Y for correct orientation
+
+    // Generate ray from camera
+    uv.x *= m_cameraData.aspectRatio;
+    uv *= m_cameraData.fovTanHalf;
+    const glm::vec3 rayDirection =
+        glm::normalize(m_cameraData.forward + uv.x * m_cameraData.right +
+                       uv.y * m_cameraData.up);
+    const glm::vec3 rayOrigin = m_cameraData.position;
+
+    // Test scene: sphere at origin
+    const glm::vec3 sphereCenter{0.0f, 0.0f, 0.0f};
+    const float sphereRadius = 1.0f;
+
+    float t = 0.0f;
+    glm::vec3 color{0.0f};
+
+    if (intersectSphere(rayOrigin, rayDirection, sphereCenter, sphereRadius,
+                        t))
+    {
+        // Hit sphere, shade like normal
+        const glm::vec3 hitPoint = rayOrigin + rayDirection * t;
+        const glm::vec3 normal = glm::normalize(hitPoint - sphereCenter);
+        // Simple normal-based color, map [-1, 1] to [0, 1] range
+        color = normal * 0.5f + 0.5f;
+    }
+    else
+    {
+        // Sky color
+        const float gradient = uv.y * 0.5f + 0.5f; // Vertical gradient
+        color = glm::mix(glm::vec3{1.0f, 1.0f, 1.0f},
+                         glm::vec3{0.5f, 0.7f, 1.0f}, gradient);
+    }
+
+    // Progressive accumulation: rgb = running sum, a = sample count
+    glm::vec4& accumulation =
+        m_accumulationTexture[static_cast<size_t>(DTid.y) * width + DTid.x];
+    if (m_frameData.resetAccumulation != 0)
+    {
+        accumulation = glm::vec4{0.0f};
+    }
+    accumulation += glm::vec4{color, 1.0f};
+
+    outputTexture.At(DTid.x, DTid.y) =
+        glm::vec4{glm::vec3{accumulation} / accumulation.w, 1.0f};
+}
+
+} // namespace pathtracer
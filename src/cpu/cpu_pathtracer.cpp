@@ -0,0 +1,1140 @@
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/intersection.h"
+#include "cpu/samplers.h"
+#include "cpu/sampling.h"
+#include "ray/ray.h"
+#include "ray/ray_packet.h"
+#include "utils/color.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <stdexcept>
+
+namespace pathtracer
+{
+
+CpuPathtracer::CpuPathtracer(uint32_t width, uint32_t height,
+                             uint32_t threadCount, uint32_t tileSize)
+    : m_width(width), m_height(height), m_scheduler(threadCount, tileSize),
+      m_accumulation(width, height), m_features(width, height),
+      m_historyPending(static_cast<size_t>(width) * height, 0),
+      m_sampler(std::make_shared<IndependentSampler>())
+{
+}
+
+auto CpuPathtracer::SetSampler(std::shared_ptr<const ISampler> sampler)
+    -> void
+{
+    if (!sampler)
+        throw std::invalid_argument("Sampler must not be null");
+    m_sampler = std::move(sampler);
+    m_resetPending = true;
+}
+
+auto CpuPathtracer::Render(Framebuffer& framebuffer, const Camera& camera,
+                           const uint32_t frameIdx, const Scene& scene)
+    -> void
+{
+    // Explicitly mark unused parameter to avoid warnings
+    (void)frameIdx;
+
+    const CameraGPUData cam = camera.GetGPUData();
+    const bool reproject = m_reprojection && m_hasPreviousCamera;
+    if (scene.GetChanges() != SceneChange::None || m_resetPending ||
+        (camera.IsDirty() && !reproject))
+    {
+        m_accumulation.Reset();
+        m_features.Reset();
+        std::fill(m_historyPending.begin(), m_historyPending.end(), 0);
+        m_resetPending = false;
+    }
+    else if (camera.IsDirty())
+    {
+        ReprojectHistory(m_previousCamera, cam);
+    }
+    m_previousCamera = cam;
+    m_hasPreviousCamera = true;
+
+    const bool newScene = &scene != m_scene;
+    m_scene = &scene;
+    UpdateSphereBvh(scene, newScene);
+    UpdateMeshBvhs(scene, newScene);
+    UpdateInstanceBvh(scene, newScene);
+    UpdateLights(scene, newScene);
+
+    // Counters for depths 0 to m_maxBounces, rays then shadow rays, then
+    // unconverged pixels, rounded up to whole cache lines per thread
+    constexpr size_t COUNTS_PER_LINE = 64 / sizeof(uint64_t);
+    const size_t depths = m_maxBounces + 1;
+    const size_t unconvergedSlot = 2 * depths;
+    m_threadRayCountStride = (unconvergedSlot + COUNTS_PER_LINE) /
+                             COUNTS_PER_LINE * COUNTS_PER_LINE;
+    m_threadRayCounts.assign(
+        m_threadRayCountStride * m_scheduler.GetThreadCount(), 0);
+
+    const bool wavefront = m_executionMode == ExecutionMode::Wavefront &&
+                           m_integrator != Integrator::Preview;
+    if (wavefront)
+    {
+        m_wavefronts.resize(m_scheduler.GetThreadCount());
+        const size_t tileSize = m_scheduler.GetTileSize();
+        for (WavefrontQueues& queues : m_wavefronts)
+            queues.sorter.SetMinBatch(tileSize * tileSize /
+                                      WAVEFRONT_SORT_DIVISOR);
+    }
+
+    const auto renderTile = [&](const Tile& tile, uint32_t threadIdx)
+    {
+        uint64_t* counts =
+            m_threadRayCounts.data() + threadIdx * m_threadRayCountStride;
+        const DepthCounters counters{counts, counts + depths};
+        if (wavefront)
+        {
+            counts[unconvergedSlot] += RenderTileWavefront(
+                cam, scene, tile, threadIdx, counters, framebuffer);
+            return;
+        }
+
+        glm::vec3 radiance[PACKET_WIDTH];
+        PixelFeatures features[PACKET_WIDTH];
+        bool sample[PACKET_WIDTH];
+        for (uint32_t y = tile.y0; y < tile.y1; ++y)
+        {
+            glm::vec4* row = framebuffer.GetRow(y);
+            for (uint32_t x0 = tile.x0; x0 < tile.x1; x0 += PACKET_WIDTH)
+            {
+                const uint32_t x1 =
+                    std::min(x0 + static_cast<uint32_t>(PACKET_WIDTH),
+                             tile.x1);
+                bool anySample = false;
+                for (uint32_t x = x0; x < x1; ++x)
+                {
+                    sample[x - x0] = NeedsSample(x, y);
+                    anySample |= sample[x - x0];
+                }
+                if (anySample)
+                {
+                    TracePacket(cam, scene, x0, x1, y, sample, radiance,
+                                counters,
+                                RecordsFeatures() ? features : nullptr);
+                }
+
+                // Converged pixels only show their mean
+                for (uint32_t x = x0; x < x1; ++x)
+                {
+                    const glm::vec3 mean =
+                        sample[x - x0]
+                            ? AddPixelSample(x, y, radiance[x - x0],
+                                             RecordsFeatures()
+                                                 ? &features[x - x0]
+                                                 : nullptr)
+                            : m_accumulation.Resolve(x, y);
+                    row[x] = glm::vec4{mean, 1.0f};
+                    if (sample[x - x0] && NeedsSample(x, y))
+                        ++counts[unconvergedSlot];
+                }
+            }
+        }
+    };
+
+    m_scheduler.Run(m_width, m_height, renderTile);
+
+    m_depthStats.rays.assign(depths, 0);
+    m_depthStats.shadowRays.assign(depths, 0);
+    m_unconvergedPixels = 0;
+    for (uint32_t thread = 0; thread < m_scheduler.GetThreadCount(); ++thread)
+    {
+        const uint64_t* counts =
+            m_threadRayCounts.data() + thread * m_threadRayCountStride;
+        for (size_t depth = 0; depth < depths; ++depth)
+        {
+            m_depthStats.rays[depth] += counts[depth];
+            m_depthStats.shadowRays[depth] += counts[depths + depth];
+        }
+        m_unconvergedPixels += counts[unconvergedSlot];
+    }
+    m_converged = m_adaptiveThreshold > 0.0f && m_unconvergedPixels == 0;
+
+    if (m_denoising)
+        m_denoiser.Denoise(m_accumulation, m_features, framebuffer,
+                           m_scheduler);
+}
+
+auto CpuPathtracer::UpdateSphereBvh(const Scene& scene, bool newScene)
+    -> void
+{
+    const SphereBuffer& spheres = scene.GetSpheres();
+    if (spheres.GetCount() <= PACKET_SPHERE_LIMIT)
+    {
+        // Traced without a BVH
+        m_sphereBvh.Clear();
+        m_sphereBvh8.Clear();
+        return;
+    }
+
+    const bool rebuild =
+        newScene || scene.HasChanges(SceneChange::SphereTopology) ||
+        m_sphereBvh.GetPrimIndices().size() != spheres.GetCount();
+    if (!rebuild && !scene.HasChanges(SceneChange::SphereGeometry))
+        return;
+
+    const std::vector<Aabb> bounds = ComputeSphereBounds(spheres);
+    if (rebuild)
+    {
+        m_sphereBvh.Build(bounds, {}, &m_scheduler.GetPool());
+    }
+    else
+    {
+        // Refits, or rebuilds if the motion degraded the tree too much
+        m_sphereBvh.Update(bounds, &m_scheduler.GetPool());
+    }
+    m_sphereBvh8.Build(m_sphereBvh);
+}
+
+auto CpuPathtracer::UpdateMeshBvhs(const Scene& scene, bool newScene) -> void
+{
+    const std::vector<TriangleMesh>& meshes = scene.GetMeshes();
+    const std::vector<uint32_t>& revisions = scene.GetMeshRevisions();
+    const auto& attached = scene.GetMeshBvhs();
+    if (newScene || scene.HasChanges(SceneChange::MeshTopology) ||
+        m_meshBvhs.size() != meshes.size())
+    {
+        // Take the scene's BVHs where it has them, e.g. from a scene cache
+        m_meshBvhs.assign(meshes.size(), MeshBvh8{});
+        m_attachedMeshBvhs = attached;
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            if (!attached[i])
+            {
+                m_meshBvhs[i].Build(meshes[i], TriangleLeafLayout::Packed, {},
+                                    &m_scheduler.GetPool());
+            }
+        }
+        m_meshRevisions = revisions;
+    }
+    else if (scene.HasChanges(SceneChange::MeshGeometry))
+    {
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            if (revisions[i] == m_meshRevisions[i])
+                continue;
+
+            m_meshRevisions[i] = revisions[i];
+            if (attached[i])
+            {
+                m_attachedMeshBvhs[i] = attached[i];
+                continue;
+            }
+
+            // The mesh moved away from its attached BVH: refit a copy
+            if (m_attachedMeshBvhs[i])
+            {
+                m_meshBvhs[i] = *m_attachedMeshBvhs[i];
+                m_attachedMeshBvhs[i].reset();
+            }
+            m_meshBvhs[i].Update(meshes[i], &m_scheduler.GetPool());
+        }
+    }
+
+    const bool looseTopology =
+        newScene || scene.HasChanges(SceneChange::TriangleTopology) ||
+        m_looseTriangles.GetTriangleCount() != scene.GetTriangleCount();
+    if (!looseTopology && !scene.HasChanges(SceneChange::TriangleGeometry))
+        return;
+
+    const std::vector<glm::vec3>& v0 = scene.GetTriangleV0();
+    const std::vector<glm::vec3>& v1 = scene.GetTriangleV1();
+    const std::vector<glm::vec3>& v2 = scene.GetTriangleV2();
+    if (looseTopology)
+    {
+        m_looseTriangles.Clear();
+        m_looseTriangles.Reserve(scene.GetTriangleCount() * 3,
+                                 scene.GetTriangleCount());
+        for (uint32_t i = 0; i < scene.GetTriangleCount(); ++i)
+        {
+            const uint32_t a = m_looseTriangles.AddVertex(v0[i]);
+            const uint32_t b = m_looseTriangles.AddVertex(v1[i]);
+            const uint32_t c = m_looseTriangles.AddVertex(v2[i]);
+            m_looseTriangles.AddTriangle(a, b, c);
+        }
+        m_looseTriangleBvh.Build(m_looseTriangles, TriangleLeafLayout::Packed,
+                                 {}, &m_scheduler.GetPool());
+    }
+    else
+    {
+        for (uint32_t i = 0; i < scene.GetTriangleCount(); ++i)
+        {
+            m_looseTriangles.SetVertex(i * 3, v0[i]);
+            m_looseTriangles.SetVertex(i * 3 + 1, v1[i]);
+            m_looseTriangles.SetVertex(i * 3 + 2, v2[i]);
+        }
+        m_looseTriangleBvh.Update(m_looseTriangles, &m_scheduler.GetPool());
+    }
+}
+
+auto CpuPathtracer::UpdateInstanceBvh(const Scene& scene, bool newScene)
+    -> void
+{
+    // Mesh BVHs may have been rebuilt or swapped for attached ones
+    const std::vector<TriangleMesh>& meshes = scene.GetMeshes();
+    m_bottomLevels.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        m_bottomLevels[i] = {&meshes[i], &GetMeshBvh(i)};
+    }
+
+    const std::vector<uint32_t>& geometries = scene.GetInstanceGeometries();
+    const std::vector<glm::mat4>& transforms = scene.GetInstanceTransforms();
+    const bool rebuild = newScene ||
+                         scene.HasChanges(SceneChange::InstanceTopology) ||
+                         scene.HasChanges(SceneChange::MeshTopology);
+    if (rebuild)
+    {
+        std::vector<bool> instanced(meshes.size(), false);
+        for (const uint32_t mesh : geometries)
+        {
+            instanced[mesh] = true;
+        }
+
+        m_instanceMeshes = geometries;
+        m_instanceTransforms = transforms;
+        m_instanceMaterials = scene.GetInstanceMaterials();
+        for (uint32_t mesh = 0; mesh < meshes.size(); ++mesh)
+        {
+            if (instanced[mesh])
+                continue;
+            m_instanceMeshes.push_back(mesh);
+            m_instanceTransforms.emplace_back(1.0f);
+            m_instanceMaterials.push_back(Scene::NO_MATERIAL);
+        }
+        m_instanceBvh.Build(m_bottomLevels, m_instanceMeshes,
+                            m_instanceTransforms, &m_scheduler.GetPool());
+    }
+    else if (scene.HasChanges(SceneChange::InstanceTransforms) ||
+             scene.HasChanges(SceneChange::MeshGeometry))
+    {
+        // Same instances; new transforms or mesh bounds only move boxes of
+        // the top level
+        std::copy(transforms.begin(), transforms.end(),
+                  m_instanceTransforms.begin());
+        m_instanceBvh.Update(m_bottomLevels, m_instanceTransforms,
+                             &m_scheduler.GetPool());
+    }
+}
+
+auto CpuPathtracer::UpdateLights(const Scene& scene, bool newScene) -> void
+{
+    if (newScene || scene.GetChanges() != SceneChange::None)
+    {
+        m_lights.Build(scene, m_instanceMeshes, m_instanceTransforms,
+                       m_instanceMaterials);
+    }
+}
+
+auto CpuPathtracer::ToCameraPlane(const CameraGPUData& cam,
+                                  glm::vec2 position) const -> glm::vec2
+{
+    // Compute UV in [-1, 1] range, flipping Y for correct orientation
+    const glm::vec2 size{static_cast<float>(m_width),
+                         static_cast<float>(m_height)};
+    glm::vec2 uv = position / size;
+    uv = uv * 2.0f - 1.0f;
+    uv.y = -uv.y;
+
+    uv.x *= cam.aspectRatio;
+    uv *= cam.fovTanHalf;
+    return uv;
+}
+
+auto CpuPathtracer::GeneratePrimaryRay(const CameraGPUData& cam, uint32_t x,
+                                       uint32_t y, uint32_t sampleIdx,
+                                       float& gradient) const -> ray
+{
+    // Position inside the pixel
+    const glm::vec2 jitter = m_sampler->Get2D(x, y, sampleIdx, PIXEL_DIMENSION);
+
+    // Generate ray from camera
+    const glm::vec2 uv = ToCameraPlane(
+        cam, glm::vec2{static_cast<float>(x), static_cast<float>(y)} + jitter);
+    gradient = uv.y * 0.5f + 0.5f;
+    return ray{cam.position, glm::normalize(cam.forward + uv.x * cam.right +
+                                            uv.y * cam.up)};
+}
+
+auto CpuPathtracer::IntersectPrimary(const CameraGPUData& cam,
+                                     const Scene& scene, uint32_t x0,
+                                     uint32_t x1, uint32_t y, ray* rays,
+                                     float* gradient, SurfaceHit* hits,
+                                     bool* found) const -> void
+{
+    const SphereBuffer& spheres = scene.GetSpheres();
+
+    // Lanes past x1 stay inactive at the ragged right edge of a tile
+    RayPacket<PACKET_WIDTH> packet;
+    for (uint32_t x = x0; x < x1; ++x)
+    {
+        const size_t lane = x - x0;
+        packet.set(lane, GeneratePrimaryRay(cam, x, y,
+                                            m_accumulation.GetSampleCount(x, y),
+                                            gradient[lane]));
+    }
+
+    // Closest hit per lane: primitive primIdx of instance hitInstance, where
+    // LOOSE_TRIANGLES stands for the loose triangles and NO_HIT for spheres
+    FloatPacket<PACKET_WIDTH> t;
+    uint32_t primIdx[PACKET_WIDTH];
+    uint32_t hitInstance[PACKET_WIDTH];
+    for (size_t lane = 0; lane < PACKET_WIDTH; ++lane)
+    {
+        t[lane] = std::numeric_limits<float>::max();
+        primIdx[lane] = NO_HIT;
+        hitInstance[lane] = NO_HIT;
+    }
+
+    if (spheres.GetCount() <= PACKET_SPHERE_LIMIT)
+    {
+        for (uint32_t idx = 0; idx < spheres.GetCount(); ++idx)
+        {
+            FloatPacket<PACKET_WIDTH> tHit;
+            const PacketMask<PACKET_WIDTH> hit =
+                IntersectSphere(packet, spheres, idx, tHit);
+            for (size_t lane = 0; lane < PACKET_WIDTH; ++lane)
+            {
+                if (hit.test(lane) && tHit[lane] < t[lane])
+                {
+                    t[lane] = tHit[lane];
+                    primIdx[lane] = idx;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t x = x0; x < x1; ++x)
+        {
+            const size_t lane = x - x0;
+            float tHit;
+            uint32_t idx;
+            if (IntersectSpheres(packet.get(lane), spheres, m_sphereBvh8,
+                                 std::numeric_limits<float>::max(), tHit,
+                                 idx))
+            {
+                t[lane] = tHit;
+                primIdx[lane] = idx;
+            }
+        }
+    }
+
+    // Triangles, one ray at a time through the instances and the loose
+    // triangles
+    if (!m_instanceBvh.IsEmpty() || !m_looseTriangleBvh.IsEmpty())
+    {
+        for (uint32_t x = x0; x < x1; ++x)
+        {
+            const size_t lane = x - x0;
+            const ray r = packet.get(lane);
+            TriangleHit hit;
+            uint32_t instanceIdx;
+            if (m_instanceBvh.Intersect(r, m_bottomLevels, t[lane], hit,
+                                        instanceIdx))
+            {
+                t[lane] = hit.t;
+                primIdx[lane] = hit.triIdx;
+                hitInstance[lane] = instanceIdx;
+            }
+            if (m_looseTriangleBvh.Intersect(r, m_looseTriangles, t[lane],
+                                             hit))
+            {
+                t[lane] = hit.t;
+                primIdx[lane] = hit.triIdx;
+                hitInstance[lane] = LOOSE_TRIANGLES;
+            }
+        }
+    }
+
+    const Vec3Packet<PACKET_WIDTH> hitPoint = packet.at(t);
+    for (uint32_t x = x0; x < x1; ++x)
+    {
+        const size_t lane = x - x0;
+        rays[lane] = packet.get(lane);
+        found[lane] = primIdx[lane] != NO_HIT;
+        if (found[lane])
+        {
+            hits[lane].t = t[lane];
+            ResolveHit(scene, rays[lane], primIdx[lane], hitInstance[lane],
+                       hitPoint.get(lane), hits[lane]);
+        }
+    }
+}
+
+auto CpuPathtracer::TracePacket(const CameraGPUData& cam, const Scene& scene,
+                                uint32_t x0, uint32_t x1, uint32_t y,
+                                const bool* sample, glm::vec3* radiance,
+                                DepthCounters counters,
+                                PixelFeatures* features) const -> void
+{
+    ray rays[PACKET_WIDTH];
+    float gradient[PACKET_WIDTH];
+    SurfaceHit hits[PACKET_WIDTH];
+    bool found[PACKET_WIDTH];
+    IntersectPrimary(cam, scene, x0, x1, y, rays, gradient, hits, found);
+    counters.rays[0] += x1 - x0;
+
+    const std::vector<color>& albedos = scene.GetAlbedos();
+    for (uint32_t x = x0; x < x1; ++x)
+    {
+        const size_t lane = x - x0;
+        if (!sample[lane])
+            continue;
+        if (features)
+        {
+            features[lane] =
+                GetPixelFeatures(scene, found[lane] ? &hits[lane] : nullptr);
+        }
+        if (m_integrator != Integrator::Preview)
+        {
+            radiance[lane] = TracePath(
+                scene, rays[lane], found[lane] ? &hits[lane] : nullptr, x, y,
+                m_accumulation.GetSampleCount(x, y), counters);
+        }
+        else if (found[lane])
+        {
+            // Simple normal-based color, map [-1, 1] to [0, 1] range, tinted
+            // by the material
+            const SurfaceHit& hit = hits[lane];
+            radiance[lane] = (hit.normal * 0.5f + 0.5f) * albedos[hit.material];
+        }
+        else
+        {
+            // Sky color, vertical gradient
+            radiance[lane] = glm::mix(color{1.0f}, color{0.5f, 0.7f, 1.0f},
+                                      gradient[lane]);
+        }
+    }
+}
+
+auto CpuPathtracer::GetPixelFeatures(const Scene& scene,
+                                     const SurfaceHit* hit) const
+    -> PixelFeatures
+{
+    if (!hit)
+        return {};
+    return {scene.GetAlbedos()[hit->material], hit->normal, hit->t};
+}
+
+auto CpuPathtracer::AddPixelSample(uint32_t x, uint32_t y,
+                                   const color& radiance,
+                                   const PixelFeatures* features) -> glm::vec3
+{
+    if (!features)
+        return m_accumulation.AddSample(x, y, radiance);
+
+    uint8_t& pending = m_historyPending[static_cast<size_t>(y) * m_width + x];
+    if (pending)
+    {
+        // Reprojected history that this sample does not see was disoccluded
+        pending = 0;
+        const float depth = m_features.GetDepth(x, y);
+        const glm::vec3 normal = m_features.GetNormal(x, y);
+        const bool sameDepth = std::abs(features->depth - depth) <=
+                               HISTORY_DEPTH_TOLERANCE * depth;
+        const bool sameNormal =
+            glm::dot(normal, features->normal) >=
+            HISTORY_NORMAL_TOLERANCE * glm::length(normal);
+        if (!sameDepth || !sameNormal)
+        {
+            m_accumulation.SetPixel(x, y, color{0.0f}, 0.0f, 0);
+            m_features.SetPixel(x, y, color{1.0f}, glm::vec3{0.0f}, 0.0f, 0);
+        }
+    }
+    m_features.AddSample(x, y, features->albedo, features->normal,
+                         features->depth);
+    return m_accumulation.AddSample(x, y, radiance);
+}
+
+auto CpuPathtracer::ReprojectHistory(const CameraGPUData& previous,
+                                     const CameraGPUData& current) -> void
+{
+    std::swap(m_accumulation, m_historyAccumulation);
+    std::swap(m_features, m_historyFeatures);
+    if (m_accumulation.GetWidth() != m_width ||
+        m_accumulation.GetHeight() != m_height)
+    {
+        m_accumulation.Resize(m_width, m_height);
+        m_features.Resize(m_width, m_height);
+    }
+    else
+    {
+        m_accumulation.Reset();
+        m_features.Reset();
+    }
+    std::fill(m_historyPending.begin(), m_historyPending.end(), 0);
+    m_historyNearest.assign(static_cast<size_t>(m_width) * m_height,
+                            NO_HISTORY);
+
+    // Surfaces from different pixels may land on the same pixel and the
+    // nearest must win, so the first pass only records, for each pixel, the
+    // distance and the index of the nearest surface landing on it; the
+    // first pixel in scan order breaks ties, as a serial pass would
+    const glm::vec2 size{static_cast<float>(m_width),
+                         static_cast<float>(m_height)};
+    const glm::vec2 planeScale{current.aspectRatio * current.fovTanHalf,
+                               current.fovTanHalf};
+    m_scheduler.Run(
+        m_width, m_height,
+        [&](const Tile& tile, uint32_t /*threadIdx*/)
+        {
+            for (uint32_t y = tile.y0; y < tile.y1; ++y)
+            {
+                for (uint32_t x = tile.x0; x < tile.x1; ++x)
+                {
+                    // Pixels of the background have no surface to carry over
+                    const float depth = m_historyFeatures.GetDepth(x, y);
+                    if (m_historyAccumulation.GetSampleCount(x, y) == 0 ||
+                        m_historyFeatures.GetSampleCount(x, y) == 0 ||
+                        depth <= 0.0f)
+                    {
+                        continue;
+                    }
+
+                    // The surface through the pixel's center, seen from
+                    // current
+                    const glm::vec2 uv = ToCameraPlane(
+                        previous, glm::vec2{static_cast<float>(x),
+                                            static_cast<float>(y)} +
+                                      0.5f);
+                    const glm::vec3 position =
+                        previous.position +
+                        glm::normalize(previous.forward +
+                                       uv.x * previous.right +
+                                       uv.y * previous.up) *
+                            depth;
+                    const glm::vec3 toSurface = position - current.position;
+                    const glm::vec3 normal = m_historyFeatures.GetNormal(x, y);
+                    const float z = glm::dot(toSurface, current.forward);
+                    if (z <= 0.0f || glm::dot(normal, toSurface) >= 0.0f)
+                        continue;
+
+                    glm::vec2 target =
+                        glm::vec2{glm::dot(toSurface, current.right),
+                                  glm::dot(toSurface, current.up)} /
+                        (z * planeScale);
+                    target.y = -target.y;
+                    target = (target + 1.0f) * 0.5f * size;
+                    if (target.x < 0.0f || target.y < 0.0f ||
+                        target.x >= size.x || target.y >= size.y)
+                    {
+                        continue;
+                    }
+
+                    // Positive floats order like their bits, so the distance
+                    // in the high half makes the smallest key the nearest
+                    const float distance = glm::length(toSurface);
+                    const uint64_t key =
+                        static_cast<uint64_t>(
+                            std::bit_cast<uint32_t>(distance))
+                            << 32 |
+                        (static_cast<uint64_t>(y) * m_width + x);
+                    const size_t idx =
+                        static_cast<size_t>(target.y) * m_width +
+                        static_cast<size_t>(target.x);
+                    std::atomic_ref<uint64_t> nearest(m_historyNearest[idx]);
+                    uint64_t old = nearest.load(std::memory_order_relaxed);
+                    while (key < old &&
+                           !nearest.compare_exchange_weak(
+                               old, key, std::memory_order_relaxed))
+                    {
+                    }
+                }
+            }
+        });
+
+    // The second pass copies the history of the nearest surface to each
+    // pixel, so every pixel is written by one thread only
+    m_scheduler.Run(
+        m_width, m_height,
+        [&](const Tile& tile, uint32_t /*threadIdx*/)
+        {
+            for (uint32_t ty = tile.y0; ty < tile.y1; ++ty)
+            {
+                for (uint32_t tx = tile.x0; tx < tile.x1; ++tx)
+                {
+                    const size_t idx = static_cast<size_t>(ty) * m_width + tx;
+                    const uint64_t key = m_historyNearest[idx];
+                    if (key == NO_HISTORY)
+                        continue;
+
+                    const uint32_t source = static_cast<uint32_t>(key);
+                    const uint32_t x = source % m_width;
+                    const uint32_t y = source / m_width;
+                    const float distance =
+                        std::bit_cast<float>(static_cast<uint32_t>(key >> 32));
+
+                    // History counts as at most m_maxHistory samples
+                    const uint32_t samples =
+                        m_historyAccumulation.GetSampleCount(x, y);
+                    const uint32_t kept = std::min(samples, m_maxHistory);
+                    const float scale =
+                        static_cast<float>(kept) / static_cast<float>(samples);
+                    m_accumulation.SetPixel(
+                        tx, ty, m_historyAccumulation.GetSum(x, y) * scale,
+                        m_historyAccumulation.GetLuminanceSqSum(x, y) * scale,
+                        kept);
+                    m_features.SetPixel(
+                        tx, ty, m_historyFeatures.GetAlbedo(x, y),
+                        m_historyFeatures.GetNormal(x, y), distance,
+                        std::min(m_historyFeatures.GetSampleCount(x, y),
+                                 m_maxHistory));
+                    m_historyPending[idx] = 1;
+                }
+            }
+        });
+}
+
+auto CpuPathtracer::ResolveHit(const Scene& scene, const ray& r,
+                               uint32_t primIdx, uint32_t inst,
+                               const glm::vec3& position,
+                               SurfaceHit& hit) const -> void
+{
+    hit.position = position;
+    if (inst == NO_HIT)
+    {
+        hit.normal = glm::normalize(position -
+                                    scene.GetSpheres().GetCenter(primIdx));
+        hit.material = scene.GetSphereMaterials()[primIdx];
+        hit.light = m_lights.GetSphereLight(primIdx);
+        return;
+    }
+
+    const uint32_t mesh =
+        inst == LOOSE_TRIANGLES ? NO_HIT : m_instanceBvh.GetGeometry(inst);
+    const TriangleMesh& triangles =
+        inst == LOOSE_TRIANGLES ? m_looseTriangles : scene.GetMeshes()[mesh];
+    const glm::uvec3 tri = triangles.GetTriangle(primIdx);
+    const glm::vec3 p0 = triangles.GetVertex(tri.x);
+    glm::vec3 normal = glm::cross(triangles.GetVertex(tri.y) - p0,
+                                  triangles.GetVertex(tri.z) - p0);
+    if (inst == LOOSE_TRIANGLES)
+    {
+        hit.material = scene.GetTriangleMaterials()[primIdx];
+        hit.light = m_lights.GetTriangleLight(primIdx);
+    }
+    else
+    {
+        normal = m_instanceBvh.GetWorldToObject(inst).TransformNormal(normal);
+        hit.material = m_instanceMaterials[inst] != Scene::NO_MATERIAL
+                           ? m_instanceMaterials[inst]
+                           : scene.GetMeshMaterials()[mesh];
+        hit.light = m_lights.GetInstanceLight(inst, primIdx);
+    }
+
+    // Geometric normal, facing the ray
+    hit.normal = glm::normalize(normal);
+    if (glm::dot(hit.normal, r.direction()) > 0.0f)
+        hit.normal = -hit.normal;
+}
+
+auto CpuPathtracer::Intersect(const Scene& scene, const ray& r, float tMax,
+                              SurfaceHit& hit) const -> bool
+{
+    const SphereBuffer& spheres = scene.GetSpheres();
+    float t = tMax;
+    uint32_t primIdx = NO_HIT;
+    uint32_t inst = NO_HIT;
+
+    float tSphere;
+    uint32_t sphereIdx;
+    const bool sphereHit =
+        spheres.GetCount() <= PACKET_SPHERE_LIMIT
+            ? IntersectSpheres(r, spheres, t, tSphere, sphereIdx)
+            : IntersectSpheres(r, spheres, m_sphereBvh8, t, tSphere,
+                               sphereIdx);
+    if (sphereHit)
+    {
+        t = tSphere;
+        primIdx = sphereIdx;
+    }
+
+    TriangleHit triangleHit;
+    uint32_t instanceIdx;
+    if (m_instanceBvh.Intersect(r, m_bottomLevels, t, triangleHit,
+                                instanceIdx))
+    {
+        t = triangleHit.t;
+        primIdx = triangleHit.triIdx;
+        inst = instanceIdx;
+    }
+    if (m_looseTriangleBvh.Intersect(r, m_looseTriangles, t, triangleHit))
+    {
+        t = triangleHit.t;
+        primIdx = triangleHit.triIdx;
+        inst = LOOSE_TRIANGLES;
+    }
+
+    if (primIdx == NO_HIT)
+        return false;
+    hit.t = t;
+    ResolveHit(scene, r, primIdx, inst, r.at(t), hit);
+    return true;
+}
+
+auto CpuPathtracer::IsOccluded(const Scene& scene, const ray& r,
+                               float tMax) const -> bool
+{
+    // Any hit will do: no closest hit, and nothing resolved
+    const SphereBuffer& spheres = scene.GetSpheres();
+    const bool sphereHit =
+        spheres.GetCount() <= PACKET_SPHERE_LIMIT
+            ? pathtracer::IsOccluded(r, spheres, tMax)
+            : pathtracer::IsOccluded(r, spheres, m_sphereBvh8, tMax);
+    return sphereHit || m_instanceBvh.IsOccluded(r, m_bottomLevels, tMax) ||
+           m_looseTriangleBvh.IsOccluded(r, m_looseTriangles, tMax);
+}
+
+auto CpuPathtracer::ShadeVertex(const Scene& scene, const SurfaceHit* hit,
+                                uint32_t x, uint32_t y, uint32_t sampleIdx,
+                                uint32_t depth, PathState& path,
+                                ShadowRequest& shadow) const -> bool
+{
+    if (!hit)
+    {
+        // The sky is not sampled as a light, so it keeps full weight
+        const float gradient =
+            glm::normalize(path.r.direction()).y * 0.5f + 0.5f;
+        path.radiance +=
+            path.beta *
+            glm::mix(color{1.0f}, color{0.5f, 0.7f, 1.0f}, gradient);
+        return false;
+    }
+
+    const bool nextEvent = m_integrator == Integrator::NextEvent;
+    const color& emission = scene.GetEmissions()[hit->material];
+    if (hit->light != LightSampler::NO_LIGHT)
+    {
+        float weight = 1.0f;
+        if (nextEvent && depth > 0)
+        {
+            weight = PowerHeuristic(
+                path.bsdfPdf, m_lights.Pdf(hit->light, path.previous,
+                                           hit->position, hit->normal));
+        }
+        path.radiance += path.beta * emission * weight;
+    }
+
+    if (depth == m_maxBounces)
+        return false;
+
+    // Shade the side the ray arrived from, spheres included
+    const glm::vec3 normal =
+        glm::dot(hit->normal, path.r.direction()) > 0.0f ? -hit->normal
+                                                         : hit->normal;
+    const glm::vec3 extent = glm::abs(hit->position);
+    const glm::vec3 origin =
+        hit->position +
+        normal * (1e-4f * (1.0f + std::max({extent.x, extent.y, extent.z})));
+    const color& albedo = scene.GetAlbedos()[hit->material];
+    const uint32_t dimension =
+        FIRST_BOUNCE_DIMENSION + depth * BOUNCE_DIMENSIONS;
+
+    if (nextEvent)
+    {
+        const float choice = m_sampler->Get1D(
+            x, y, sampleIdx, dimension + LIGHT_CHOICE_DIMENSION);
+        const glm::vec2 point = m_sampler->Get2D(
+            x, y, sampleIdx, dimension + LIGHT_POINT_DIMENSION);
+        LightSample sample;
+        if (m_lights.Sample(origin, choice, point.x, point.y, sample))
+        {
+            const float cosTheta = glm::dot(normal, sample.direction);
+            if (cosTheta > 0.0f)
+            {
+                const float weight =
+                    PowerHeuristic(sample.pdf, cosTheta * INV_PI);
+                shadow.r = ray{origin, sample.direction};
+                shadow.tMax = sample.distance * (1.0f - 1e-3f);
+                shadow.contribution = path.beta * albedo * INV_PI *
+                                      sample.emission *
+                                      (cosTheta / sample.pdf * weight);
+            }
+        }
+    }
+
+    // Cosine-weighted bounce: the Lambert BSDF times cos over the pdf
+    // leaves just the albedo
+    const glm::vec2 u =
+        m_sampler->Get2D(x, y, sampleIdx, dimension + DIRECTION_DIMENSION);
+    const glm::vec3 direction = SampleCosineHemisphere(normal, u.x, u.y);
+    path.beta *= albedo;
+    path.bsdfPdf = glm::dot(normal, direction) * INV_PI;
+    if (!(path.bsdfPdf > 0.0f) || path.beta == color{0.0f})
+        return false;
+
+    // Russian roulette: past the roulette depth a path survives with
+    // probability given by its throughput, capped so that bright paths
+    // end too, and survivors make up for the ones ended
+    if (depth >= m_rouletteDepth)
+    {
+        const float survival = std::min(
+            0.95f, std::max({path.beta.r, path.beta.g, path.beta.b}));
+        if (m_sampler->Get1D(x, y, sampleIdx,
+                             dimension + ROULETTE_DIMENSION) >= survival)
+        {
+            return false;
+        }
+        path.beta /= survival;
+    }
+
+    path.previous = origin;
+    path.r = ray{origin, direction};
+    return true;
+}
+
+auto CpuPathtracer::TracePath(const Scene& scene, const ray& r,
+                              const SurfaceHit* primaryHit, uint32_t x,
+                              uint32_t y, uint32_t sampleIdx,
+                              DepthCounters counters) const -> color
+{
+    PathState path;
+    path.r = r;
+    path.previous = r.origin();
+    SurfaceHit hit;
+    const SurfaceHit* current = primaryHit;
+
+    for (uint32_t depth = 0;; ++depth)
+    {
+        ShadowRequest shadow;
+        const bool extend =
+            ShadeVertex(scene, current, x, y, sampleIdx, depth, path, shadow);
+        if (shadow.tMax > 0.0f)
+        {
+            ++counters.shadowRays[depth];
+            if (!IsOccluded(scene, shadow.r, shadow.tMax))
+                path.radiance += shadow.contribution;
+        }
+        if (!extend)
+            break;
+
+        ++counters.rays[depth + 1];
+        current = Intersect(scene, path.r, std::numeric_limits<float>::max(),
+                            hit)
+                      ? &hit
+                      : nullptr;
+    }
+    return path.radiance;
+}
+
+auto CpuPathtracer::RenderTileWavefront(const CameraGPUData& cam,
+                                        const Scene& scene, const Tile& tile,
+                                        uint32_t threadIdx,
+                                        DepthCounters counters,
+                                        Framebuffer& framebuffer) -> uint64_t
+{
+    WavefrontQueues& queues = m_wavefronts[threadIdx];
+    PathQueue& paths = queues.paths;
+    ShadowQueue& shadows = queues.shadows;
+    const uint32_t width = tile.x1 - tile.x0;
+    const size_t pixelCount = static_cast<size_t>(width) * (tile.y1 - tile.y0);
+    paths.Reserve(pixelCount);
+    shadows.Reserve(pixelCount);
+    queues.active.resize(pixelCount);
+    queues.sampled.resize(pixelCount);
+    queues.radiance.resize(pixelCount);
+    if (RecordsFeatures())
+        queues.features.resize(pixelCount);
+
+    // Generate: one path per pixel that needs a sample, from the primary
+    // rays traced as packets
+    paths.count = 0;
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
+    {
+        uint8_t* sampled =
+            queues.sampled.data() + static_cast<size_t>(y - tile.y0) * width;
+        for (uint32_t x0 = tile.x0; x0 < tile.x1; x0 += PACKET_WIDTH)
+        {
+            const uint32_t x1 =
+                std::min(x0 + static_cast<uint32_t>(PACKET_WIDTH), tile.x1);
+            bool anySample = false;
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                sampled[x - tile.x0] = NeedsSample(x, y);
+                anySample |= sampled[x - tile.x0] != 0;
+            }
+            if (!anySample)
+                continue;
+
+            ray rays[PACKET_WIDTH];
+            float gradient[PACKET_WIDTH];
+            SurfaceHit hits[PACKET_WIDTH];
+            bool found[PACKET_WIDTH];
+            IntersectPrimary(cam, scene, x0, x1, y, rays, gradient, hits,
+                             found);
+            counters.rays[0] += x1 - x0;
+
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                if (!sampled[x - tile.x0])
+                    continue;
+                const size_t lane = x - x0;
+                if (RecordsFeatures())
+                {
+                    queues.features[(y - tile.y0) * width + (x - tile.x0)] =
+                        GetPixelFeatures(scene,
+                                         found[lane] ? &hits[lane] : nullptr);
+                }
+                const size_t i = paths.count++;
+                paths.origins[i] = rays[lane].origin();
+                paths.directions[i] = rays[lane].direction();
+                paths.betas[i] = color{1.0f};
+                paths.radiances[i] = color{0.0f};
+                paths.previous[i] = rays[lane].origin();
+                paths.bsdfPdfs[i] = 0.0f;
+                paths.pixels[i] = (y - tile.y0) * width + (x - tile.x0);
+                paths.found[i] = found[lane];
+                paths.hitPositions[i] = hits[lane].position;
+                paths.hitNormals[i] = hits[lane].normal;
+                paths.hitMaterials[i] = hits[lane].material;
+                paths.hitLights[i] = hits[lane].light;
+            }
+        }
+    }
+
+    for (uint32_t depth = 0; paths.count > 0; ++depth)
+    {
+        // Shade every live path and queue the shadow rays it asks for
+        shadows.count = 0;
+        for (size_t i = 0; i < paths.count; ++i)
+        {
+            const uint32_t x = tile.x0 + paths.pixels[i] % width;
+            const uint32_t y = tile.y0 + paths.pixels[i] / width;
+            SurfaceHit hit;
+            hit.position = paths.hitPositions[i];
+            hit.normal = paths.hitNormals[i];
+            hit.material = paths.hitMaterials[i];
+            hit.light = paths.hitLights[i];
+
+            PathState path;
+            path.r = ray{paths.origins[i], paths.directions[i]};
+            path.beta = paths.betas[i];
+            path.radiance = paths.radiances[i];
+            path.previous = paths.previous[i];
+            path.bsdfPdf = paths.bsdfPdfs[i];
+
+            ShadowRequest shadow;
+            queues.active[i] = ShadeVertex(
+                scene, paths.found[i] ? &hit : nullptr, x, y,
+                m_accumulation.GetSampleCount(x, y), depth, path, shadow);
+
+            paths.origins[i] = path.r.origin();
+            paths.directions[i] = path.r.direction();
+            paths.betas[i] = path.beta;
+            paths.radiances[i] = path.radiance;
+            paths.previous[i] = path.previous;
+            paths.bsdfPdfs[i] = path.bsdfPdf;
+
+            if (shadow.tMax > 0.0f)
+            {
+                const size_t s = shadows.count++;
+                shadows.origins[s] = shadow.r.origin();
+                shadows.directions[s] = shadow.r.direction();
+                shadows.tMax[s] = shadow.tMax;
+                shadows.contributions[s] = shadow.contribution;
+                shadows.paths[s] = static_cast<uint32_t>(i);
+            }
+        }
+
+        // Shadow: add the light of every unblocked shadow ray
+        counters.shadowRays[depth] += shadows.count;
+        for (size_t s = 0; s < shadows.count; ++s)
+        {
+            const ray r{shadows.origins[s], shadows.directions[s]};
+            if (!IsOccluded(scene, r, shadows.tMax[s]))
+            {
+                paths.radiances[shadows.paths[s]] += shadows.contributions[s];
+            }
+        }
+
+        // Compact: finished paths hand in their radiance, live ones close up
+        size_t live = 0;
+        for (size_t i = 0; i < paths.count; ++i)
+        {
+            if (!queues.active[i])
+            {
+                queues.radiance[paths.pixels[i]] = paths.radiances[i];
+                continue;
+            }
+            if (live != i)
+                paths.Move(i, live);
+            ++live;
+        }
+        paths.count = live;
+
+        // Extend: find the next vertex of every live path, with rays that
+        // start close together and head the same way traced together. The
+        // other threads are busy with tiles of their own, so the sort runs
+        // on this one.
+        counters.rays[depth + 1] += paths.count;
+        const bool sorted =
+            m_raySorting &&
+            queues.sorter.Sort({paths.origins.data(), paths.count},
+                               {paths.directions.data(), paths.count});
+        const std::span<const uint32_t> order = queues.sorter.GetOrder();
+        for (size_t k = 0; k < paths.count; ++k)
+        {
+            const size_t i = sorted ? order[k] : k;
+            SurfaceHit hit;
+            paths.found[i] =
+                Intersect(scene, ray{paths.origins[i], paths.directions[i]},
+                          std::numeric_limits<float>::max(), hit);
+            paths.hitPositions[i] = hit.position;
+            paths.hitNormals[i] = hit.normal;
+            paths.hitMaterials[i] = hit.material;
+            paths.hitLights[i] = hit.light;
+        }
+    }
+
+    // Accumulate; converged pixels only show their mean
+    uint64_t unconverged = 0;
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
+    {
+        glm::vec4* row = framebuffer.GetRow(y);
+        const size_t rowStart = static_cast<size_t>(y - tile.y0) * width;
+        const color* radiance = queues.radiance.data() + rowStart;
+        const uint8_t* sampled = queues.sampled.data() + rowStart;
+        const PixelFeatures* features =
+            RecordsFeatures() ? queues.features.data() + rowStart : nullptr;
+        for (uint32_t x = tile.x0; x < tile.x1; ++x)
+        {
+            if (!sampled[x - tile.x0])
+            {
+                row[x] = glm::vec4{m_accumulation.Resolve(x, y), 1.0f};
+                continue;
+            }
+            const glm::vec3 mean =
+                AddPixelSample(x, y, radiance[x - tile.x0],
+                               features ? &features[x - tile.x0] : nullptr);
+            row[x] = glm::vec4{mean, 1.0f};
+            if (NeedsSample(x, y))
+                ++unconverged;
+        }
+    }
+    return unconverged;
+}
+
+auto CpuPathtracer::Resize(const uint32_t width, const uint32_t height) -> void
+{
+    m_width = width;
+    m_height = height;
+    m_accumulation.Resize(width, height);
+    m_features.Resize(width, height);
+    m_historyPending.assign(static_cast<size_t>(width) * height, 0);
+    m_hasPreviousCamera = false;
+    m_converged = false;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,29 @@
+#include "cpu/feature_buffer.h"
+
+#include <algorithm>
+
+namespace pathtracer
+{
+auto FeatureBuffer::Resize(uint32_t width, uint32_t height) -> void
+{
+    m_width = width;
+    m_height = height;
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    m_albedoSum.resize(pixelCount);
+    m_normalSum.resize(pixelCount);
+    m_depthSum.resize(pixelCount);
+    m_sampleCount.resize(pixelCount);
+
+    Reset();
+}
+
+auto FeatureBuffer::Reset() -> void
+{
+    std::fill(m_albedoSum.begin(), m_albedoSum.end(), glm::vec3{0.0f});
+    std::fill(m_normalSum.begin(), m_normalSum.end(), glm::vec3{0.0f});
+    std::fill(m_depthSum.begin(), m_depthSum.end(), 0.0f);
+    std::fill(m_sampleCount.begin(), m_sampleCount.end(), 0u);
+}
+
+} // namespace pathtracer
@@ -0,0 +1,311 @@
+#include "cpu/image_resolver.h"
+
+#include "utils/random.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+namespace pathtracer
+{
+namespace
+{
+static_assert(std::endian::native == std::endian::little,
+              "Pixels are packed as 32-bit words in little-endian order");
+
+// Steps of the sRGB table. It is indexed by the square root of the linear
+// value, which spreads the entries out where the curve is steepest, just
+// above black, so that the nearest entry is within a tenth of an 8-bit
+// step everywhere and no interpolation is needed.
+constexpr uint32_t SRGB_LUT_SIZE = 4096;
+
+constexpr double LN2 = 0.69314718055994530942;
+constexpr double SQRT2 = 1.41421356237309504880;
+
+// ln(x) for x > 0 at compile time, where std::log is not constexpr: x is
+// scaled into [1/sqrt(2), sqrt(2)) by powers of two, where the series
+// ln(x) = 2 atanh((x - 1) / (x + 1)) converges in a few terms
+constexpr auto ConstexprLog(double x) -> double
+{
+    double result = 0.0;
+    while (x >= SQRT2)
+    {
+        x *= 0.5;
+        result += LN2;
+    }
+    while (x < 0.5 * SQRT2)
+    {
+        x *= 2.0;
+        result -= LN2;
+    }
+    const double t = (x - 1.0) / (x + 1.0);
+    const double tSq = t * t;
+    double term = t;
+    double sum = 0.0;
+    for (int k = 1; k < 16; k += 2)
+    {
+        sum += term / k;
+        term *= tSq;
+    }
+    return result + 2.0 * sum;
+}
+
+// e^x at compile time: the Taylor series of e^(x / 2^n) with |x / 2^n| at
+// most 1/2, squared n times
+constexpr auto ConstexprExp(double x) -> double
+{
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5)
+    {
+        x *= 0.5;
+        ++halvings;
+    }
+    double term = 1.0;
+    double sum = 1.0;
+    for (int k = 1; k < 12; ++k)
+    {
+        term *= x / k;
+        sum += term;
+    }
+    for (; halvings > 0; --halvings)
+    {
+        sum *= sum;
+    }
+    return sum;
+}
+
+// The sRGB transfer function of linear root^2 in [0, 1], scaled to
+// [0, 255]; (root^2)^(1 / 2.4) = e^(ln(root) / 1.2)
+constexpr auto SrgbEncodeSquare(double root) -> double
+{
+    const double v = root * root;
+    const double encoded =
+        v <= 0.0031308
+            ? 12.92 * v
+            : 1.055 * ConstexprExp(ConstexprLog(root) / 1.2) - 0.055;
+    return 255.0 * encoded;
+}
+
+constexpr auto MakeSrgbLut() -> std::array<float, SRGB_LUT_SIZE + 1>
+{
+    std::array<float, SRGB_LUT_SIZE + 1> lut{};
+    for (uint32_t i = 0; i <= SRGB_LUT_SIZE; ++i)
+    {
+        lut[i] = static_cast<float>(
+            SrgbEncodeSquare(static_cast<double>(i) / SRGB_LUT_SIZE));
+    }
+    return lut;
+}
+
+constexpr std::array<float, SRGB_LUT_SIZE + 1> SRGB_LUT = MakeSrgbLut();
+
+/// <summary>
+/// The settings, reduced to what the row loop needs.
+/// </summary>
+struct RowParams
+{
+    float scale;
+
+    // The rounding offset is ditherScale times a hash in [0, 1) plus
+    // ditherOffset: 1 and 0 with dithering, 0 and 1/2 without
+    float ditherScale;
+    float ditherOffset;
+
+    uint32_t redShift;
+    uint32_t blueShift;
+};
+
+auto MakeRowParams(const ResolveSettings& settings) -> RowParams
+{
+    const bool bgra = settings.format == PixelFormat::Bgra8;
+    return {std::exp2(settings.exposure), settings.dither ? 1.0f : 0.0f,
+            settings.dither ? 0.0f : 0.5f, bgra ? 16u : 0u, bgra ? 0u : 16u};
+}
+
+template <Tonemap TONEMAP> auto ApplyTonemap(float c) -> float
+{
+    if constexpr (TONEMAP == Tonemap::Reinhard)
+        return c / (1.0f + c);
+    else if constexpr (TONEMAP == Tonemap::Aces)
+        return (c * (2.51f * c + 0.03f)) / (c * (2.43f * c + 0.59f) + 0.14f);
+    else
+        return c;
+}
+
+// Pixels per chunk of a row, resolved in two loops over stack arrays
+constexpr uint32_t CHUNK_SIZE = 64;
+
+/// <summary>
+/// Index of the sRGB table entry nearest to linear c, clamped to [0, 1].
+/// NaNs map to black.
+/// </summary>
+auto ToLutIndex(float c) -> int32_t
+{
+    // Signed, as vector units convert to signed integers only
+    const float clamped = std::min(c > 0.0f ? c : 0.0f, 1.0f);
+    return static_cast<int32_t>(
+        std::sqrt(clamped) * static_cast<float>(SRGB_LUT_SIZE) + 0.5f);
+}
+
+/// <summary>
+/// Looks up the sRGB encoding of table entry i, adds the rounding offset
+/// and truncates to a byte.
+/// </summary>
+auto Quantize(int32_t i, float offset) -> uint32_t
+{
+    return static_cast<uint32_t>(
+        static_cast<int32_t>(std::min(SRGB_LUT[i] + offset, 255.0f)));
+}
+
+/// <summary>
+/// Resolves count pixels from src, dividing by counts if DIVIDE, into dst.
+/// firstIndex is the row-major index of the first pixel, which seeds the
+/// dither.
+/// <para></para>
+/// The arithmetic and the table lookups run as separate loops over chunks
+/// of the row: GCC does not vectorize table lookups whose index is
+/// computed in the same loop, and keeping them apart lets everything
+/// before them vectorize regardless.
+/// </summary>
+template <Tonemap TONEMAP, bool DIVIDE, typename Pixel>
+auto ResolveRow(const Pixel* src, const uint32_t* counts, uint32_t count,
+                uint32_t firstIndex, const RowParams& params, uint32_t* dst)
+    -> void
+{
+    int32_t red[CHUNK_SIZE];
+    int32_t green[CHUNK_SIZE];
+    int32_t blue[CHUNK_SIZE];
+    float offsets[CHUNK_SIZE];
+    for (uint32_t begin = 0; begin < count; begin += CHUNK_SIZE)
+    {
+        const uint32_t size = std::min(count - begin, CHUNK_SIZE);
+        const Pixel* chunk = src + begin;
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            // Pixels without samples have a sum of 0, so need no branch
+            float scale = params.scale;
+            if constexpr (DIVIDE)
+            {
+                scale /= std::max(static_cast<float>(counts[begin + i]), 1.0f);
+            }
+            red[i] = ToLutIndex(ApplyTonemap<TONEMAP>(chunk[i].r * scale));
+            green[i] =
+                ToLutIndex(ApplyTonemap<TONEMAP>(chunk[i].g * scale));
+            blue[i] = ToLutIndex(ApplyTonemap<TONEMAP>(chunk[i].b * scale));
+            offsets[i] = params.ditherOffset +
+                         params.ditherScale *
+                             utils::UintToUnitFloat(
+                                 utils::PcgHash(firstIndex + begin + i));
+        }
+
+        uint32_t* out = dst + begin;
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            const uint32_t r = Quantize(red[i], offsets[i]);
+            const uint32_t g = Quantize(green[i], offsets[i]);
+            const uint32_t b = Quantize(blue[i], offsets[i]);
+            out[i] = (r << params.redShift) | (g << 8) |
+                     (b << params.blueShift) | 0xFF000000u;
+        }
+    }
+}
+
+template <bool DIVIDE, typename Pixel>
+auto ResolveRow(Tonemap tonemap, const Pixel* src, const uint32_t* counts,
+                uint32_t count, uint32_t firstIndex, const RowParams& params,
+                uint32_t* dst) -> void
+{
+    switch (tonemap)
+    {
+    case Tonemap::None:
+        ResolveRow<Tonemap::None, DIVIDE>(src, counts, count, firstIndex,
+                                          params, dst);
+        break;
+    case Tonemap::Reinhard:
+        ResolveRow<Tonemap::Reinhard, DIVIDE>(src, counts, count, firstIndex,
+                                              params, dst);
+        break;
+    case Tonemap::Aces:
+        ResolveRow<Tonemap::Aces, DIVIDE>(src, counts, count, firstIndex,
+                                          params, dst);
+        break;
+    }
+}
+
+auto CheckSize(std::span<const uint32_t> pixels, uint32_t width,
+               uint32_t height) -> void
+{
+    if (pixels.size() != static_cast<size_t>(width) * height)
+    {
+        throw std::invalid_argument(
+            "Resolve target must hold one pixel per image pixel");
+    }
+}
+
+auto ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+    -> double
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+} // namespace
+
+auto ImageResolver::Resolve(const AccumulationBuffer& accumulation,
+                            std::span<uint32_t> pixels,
+                            TileScheduler& scheduler) -> void
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const uint32_t width = accumulation.GetWidth();
+    const uint32_t height = accumulation.GetHeight();
+    CheckSize(pixels, width, height);
+
+    const RowParams params = MakeRowParams(m_settings);
+    scheduler.Run(width, height,
+                  [&](const Tile& tile, uint32_t /*threadIdx*/)
+                  {
+                      for (uint32_t y = tile.y0; y < tile.y1; ++y)
+                      {
+                          const uint32_t first = y * width + tile.x0;
+                          ResolveRow<true>(
+                              m_settings.tonemap,
+                              accumulation.GetSumRow(y) + tile.x0,
+                              accumulation.GetSampleCountRow(y) + tile.x0,
+                              tile.x1 - tile.x0, first, params,
+                              pixels.data() + first);
+                      }
+                  });
+    m_lastRunMs = ElapsedMs(start);
+}
+
+auto ImageResolver::Resolve(const Framebuffer& framebuffer,
+                            std::span<uint32_t> pixels,
+                            TileScheduler& scheduler) -> void
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const uint32_t width = framebuffer.GetWidth();
+    const uint32_t height = framebuffer.GetHeight();
+    CheckSize(pixels, width, height);
+
+    const RowParams params = MakeRowParams(m_settings);
+    scheduler.Run(width, height,
+                  [&](const Tile& tile, uint32_t /*threadIdx*/)
+                  {
+                      for (uint32_t y = tile.y0; y < tile.y1; ++y)
+                      {
+                          const uint32_t first = y * width + tile.x0;
+                          ResolveRow<false>(
+                              m_settings.tonemap,
+                              framebuffer.GetRow(y) + tile.x0, nullptr,
+                              tile.x1 - tile.x0, first, params,
+                              pixels.data() + first);
+                      }
+                  });
+    m_lastRunMs = ElapsedMs(start);
+}
+
+} // namespace pathtracer
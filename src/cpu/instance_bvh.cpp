@@ -0,0 +1,152 @@
+#include "cpu/instance_bvh.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// Testing an instance means traversing a whole bottom-level tree, so
+/// leaves hold a single instance and the top level culls all it can.
+/// </summary>
+auto GetInstanceBuildOptions() -> BvhBuildOptions
+{
+    BvhBuildOptions options;
+    options.maxLeafSize = 1;
+    return options;
+}
+} // namespace
+
+auto AffineTransform::Inverse() const -> AffineTransform
+{
+    // Inverse of the linear part by cofactors, then -inverse * translation
+    const glm::vec3 r0{rows[0]};
+    const glm::vec3 r1{rows[1]};
+    const glm::vec3 r2{rows[2]};
+    const glm::vec3 c0 = glm::cross(r1, r2);
+    const glm::vec3 c1 = glm::cross(r2, r0);
+    const glm::vec3 c2 = glm::cross(r0, r1);
+    const float invDet = 1.0f / glm::dot(r0, c0);
+
+    // Columns of the inverse are the cofactor rows scaled by 1 / det
+    AffineTransform result;
+    for (int row = 0; row < 3; ++row)
+    {
+        result.rows[row] = {c0[row] * invDet, c1[row] * invDet,
+                            c2[row] * invDet, 0.0f};
+    }
+    const glm::vec3 offset =
+        -result.TransformVector({rows[0].w, rows[1].w, rows[2].w});
+    for (int row = 0; row < 3; ++row)
+    {
+        result.rows[row].w = offset[row];
+    }
+    return result;
+}
+
+auto AffineTransform::TransformBounds(const Aabb& box) const -> Aabb
+{
+    if (box.IsEmpty())
+        return box;
+
+    Aabb result;
+    for (int row = 0; row < 3; ++row)
+    {
+        result.min[row] = result.max[row] = rows[row].w;
+        for (int col = 0; col < 3; ++col)
+        {
+            const float a = rows[row][col] * box.min[col];
+            const float b = rows[row][col] * box.max[col];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+auto InstanceBvh::Build(std::span<const BottomLevelGeometry> geometries,
+                        std::span<const uint32_t> instanceGeometry,
+                        std::span<const glm::mat4> transforms,
+                        TaskPool* pool) -> void
+{
+    if (instanceGeometry.size() != transforms.size())
+    {
+        throw std::invalid_argument(
+            "Instance geometries and transforms differ in count");
+    }
+    for (const uint32_t geometry : instanceGeometry)
+    {
+        if (geometry >= geometries.size())
+        {
+            throw std::invalid_argument(
+                "Instance references a geometry that does not exist");
+        }
+    }
+
+    m_geometry.assign(instanceGeometry.begin(), instanceGeometry.end());
+    if (m_geometry.empty())
+    {
+        Clear();
+        return;
+    }
+    m_bvh.Build(PlaceInstances(geometries, transforms),
+                GetInstanceBuildOptions(), pool);
+    m_wide.Build(m_bvh);
+}
+
+auto InstanceBvh::Update(std::span<const BottomLevelGeometry> geometries,
+                         std::span<const glm::mat4> transforms,
+                         TaskPool* pool) -> void
+{
+    if (transforms.size() != m_geometry.size())
+    {
+        throw std::invalid_argument(
+            "Instance count changed since the last build");
+    }
+    if (m_geometry.empty())
+        return;
+
+    m_bvh.Update(PlaceInstances(geometries, transforms), pool);
+    m_wide.Build(m_bvh);
+}
+
+auto InstanceBvh::Clear() -> void
+{
+    m_bvh.Clear();
+    m_wide.Clear();
+    m_geometry.clear();
+    m_worldToObject.clear();
+}
+
+auto InstanceBvh::GetTraversalBytes() const noexcept -> size_t
+{
+    return m_wide.GetNodes().size() * sizeof(Bvh8::Node) +
+           m_wide.GetPrimIndices().size() * sizeof(uint32_t) +
+           m_worldToObject.size() * sizeof(AffineTransform) +
+           m_geometry.size() * sizeof(uint32_t);
+}
+
+auto InstanceBvh::PlaceInstances(
+    std::span<const BottomLevelGeometry> geometries,
+    std::span<const glm::mat4> transforms) -> std::vector<Aabb>
+{
+    m_worldToObject.resize(transforms.size());
+    std::vector<Aabb> bounds(transforms.size());
+    for (size_t i = 0; i < transforms.size(); ++i)
+    {
+        const AffineTransform toWorld =
+            AffineTransform::FromMatrix(transforms[i]);
+        m_worldToObject[i] = toWorld.Inverse();
+        bounds[i] = toWorld.TransformBounds(
+            geometries[m_geometry[i]].bvh->GetBvh().GetBounds());
+
+        // Instances of empty meshes become a point the builder can place
+        if (bounds[i].IsEmpty())
+            bounds[i].Grow(toWorld.TransformPoint(glm::vec3{0.0f}));
+    }
+    return bounds;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,272 @@
+#include "cpu/intersection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// One ray against the spheres of a buffer through any BVH with the
+/// Bvh::Intersect() contract.
+/// </summary>
+template <typename BvhType>
+auto IntersectSpheresWithBvh(const ray& r, const SphereBuffer& spheres,
+                             const BvhType& bvh, float tMax, float& t,
+                             uint32_t& sphereIdx) -> bool
+{
+    t = tMax;
+    sphereIdx = NO_SPHERE_HIT;
+    return bvh.Intersect(r, t,
+                         [&](uint32_t idx, float& tClosest) -> bool
+                         {
+                             float root = 0.0f;
+                             if (!IntersectSphereRadiusSq(
+                                     r, spheres.GetCenter(idx),
+                                     spheres.GetRadiusSq(idx), root) ||
+                                 root >= tClosest)
+                             {
+                                 return false;
+                             }
+                             tClosest = root;
+                             sphereIdx = idx;
+                             return true;
+                         });
+}
+
+/// <summary>
+/// One ray against the arrays of a SphereBuffer, for the blocked kernels.
+/// </summary>
+struct SphereArrayRay
+{
+    const float* cx;
+    const float* cy;
+    const float* cz;
+    const float* radiusSq;
+    glm::vec3 o;
+    glm::vec3 d;
+    float a;
+
+    SphereArrayRay(const ray& r, const SphereBuffer& spheres)
+        : cx(spheres.GetCenterX()), cy(spheres.GetCenterY()),
+          cz(spheres.GetCenterZ()), radiusSq(spheres.GetRadiusSq()),
+          o(r.origin()), d(r.direction()), a(glm::dot(d, d))
+    {
+    }
+
+    /// <summary>
+    /// Discriminant against sphere idx, and h = dot(d, o - center).
+    /// </summary>
+    auto Discriminant(uint32_t idx, float& h) const -> float
+    {
+        // Same operations, in the same order, as IntersectSphereRadiusSq
+        const float ocx = o.x - cx[idx];
+        const float ocy = o.y - cy[idx];
+        const float ocz = o.z - cz[idx];
+
+        h = d.x * ocx + d.y * ocy + d.z * ocz;
+        const float c = ocx * ocx + ocy * ocy + ocz * ocz - radiusSq[idx];
+        return h * h - a * c;
+    }
+
+    /// <summary>
+    /// Nearest positive root for a discriminant and h from Discriminant();
+    /// meaningless if the discriminant is negative.
+    /// </summary>
+    auto Root(float disc, float h) const -> float
+    {
+        const float sqrtd = std::sqrt(std::max(disc, 0.0f));
+        const float nearRoot = (-h - sqrtd) / a;
+        const float farRoot = (-h + sqrtd) / a;
+        return nearRoot <= 0.0f ? farRoot : nearRoot;
+    }
+};
+} // namespace
+
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres, float tMax,
+                      float& t, uint32_t& sphereIdx) -> bool
+{
+    constexpr uint32_t W = SphereBuffer::BLOCK_SIZE;
+
+    const SphereArrayRay sr(r, spheres);
+    const uint32_t count = spheres.GetPaddedCount();
+
+    // Each lane keeps the closest hit among the spheres it has seen. Within
+    // a lane indices only increase, so the strict < keeps the lowest index
+    // on equal distances, like the scalar loop.
+    float bestT[W];
+    uint32_t bestIdx[W];
+    for (uint32_t i = 0; i < W; ++i)
+    {
+        bestT[i] = tMax;
+        bestIdx[i] = NO_SPHERE_HIT;
+    }
+
+    for (uint32_t base = 0; base < count; base += W)
+    {
+        // Most spheres are missed. Test the discriminants of a block first,
+        // so whole blocks of misses skip the square roots and divisions; a
+        // block with a hit recomputes them, which is cheaper than keeping
+        // them around.
+        int32_t anyHit = 0;
+        for (uint32_t i = 0; i < W; ++i)
+        {
+            float h;
+            anyHit |=
+                static_cast<int32_t>(sr.Discriminant(base + i, h) >= 0.0f);
+        }
+
+        if (anyHit == 0)
+            continue;
+
+        for (uint32_t i = 0; i < W; ++i)
+        {
+            float h;
+            const float disc = sr.Discriminant(base + i, h);
+            const float root = sr.Root(disc, h);
+
+            const int32_t closer = -static_cast<int32_t>(disc >= 0.0f) &
+                                   -static_cast<int32_t>(root > 0.0f) &
+                                   -static_cast<int32_t>(root < bestT[i]);
+            bestT[i] = closer != 0 ? root : bestT[i];
+            bestIdx[i] = closer != 0 ? base + i : bestIdx[i];
+        }
+    }
+
+    // Horizontal reduction across lanes, ties go to the lower index
+    t = tMax;
+    sphereIdx = NO_SPHERE_HIT;
+    for (uint32_t i = 0; i < W; ++i)
+    {
+        if (bestIdx[i] != NO_SPHERE_HIT &&
+            (bestT[i] < t || (bestT[i] == t && bestIdx[i] < sphereIdx)))
+        {
+            t = bestT[i];
+            sphereIdx = bestIdx[i];
+        }
+    }
+    return sphereIdx != NO_SPHERE_HIT;
+}
+
+auto IsOccluded(const ray& r, const SphereBuffer& spheres, float tMax)
+    -> bool
+{
+    constexpr uint32_t W = SphereBuffer::BLOCK_SIZE;
+
+    const SphereArrayRay sr(r, spheres);
+    const uint32_t count = spheres.GetPaddedCount();
+    for (uint32_t base = 0; base < count; base += W)
+    {
+        int32_t anyHit = 0;
+        for (uint32_t i = 0; i < W; ++i)
+        {
+            float h;
+            anyHit |=
+                static_cast<int32_t>(sr.Discriminant(base + i, h) >= 0.0f);
+        }
+        if (anyHit == 0)
+            continue;
+
+        int32_t blocked = 0;
+        for (uint32_t i = 0; i < W; ++i)
+        {
+            float h;
+            const float disc = sr.Discriminant(base + i, h);
+            const float root = sr.Root(disc, h);
+            blocked |= static_cast<int32_t>(disc >= 0.0f) &
+                       static_cast<int32_t>(root > 0.0f) &
+                       static_cast<int32_t>(root < tMax);
+        }
+        if (blocked != 0)
+            return true;
+    }
+    return false;
+}
+
+auto IsOccluded(const ray& r, const SphereBuffer& spheres, const Bvh8& bvh,
+                float tMax) -> bool
+{
+    return bvh.IsOccluded(
+        r, tMax,
+        [&](uint32_t first, uint32_t count, float tLeaf) -> bool
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                const uint32_t idx = bvh.GetPrimIndices()[i];
+                float root = 0.0f;
+                if (IntersectSphereRadiusSq(r, spheres.GetCenter(idx),
+                                            spheres.GetRadiusSq(idx),
+                                            root) &&
+                    root < tLeaf)
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+}
+
+auto IntersectSpheresScalar(const ray& r, const SphereBuffer& spheres,
+                            float tMax, float& t, uint32_t& sphereIdx)
+    -> bool
+{
+    bool hit = false;
+    t = tMax;
+    sphereIdx = NO_SPHERE_HIT;
+    for (uint32_t idx = 0; idx < spheres.GetCount(); ++idx)
+    {
+        float root = 0.0f;
+        if (IntersectSphereRadiusSq(r, spheres.GetCenter(idx),
+                                    spheres.GetRadiusSq(idx), root) &&
+            root < t)
+        {
+            t = root;
+            sphereIdx = idx;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool
+{
+    return IntersectSpheresWithBvh(r, spheres, bvh, tMax, t, sphereIdx);
+}
+
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh4& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool
+{
+    return IntersectSpheresWithBvh(r, spheres, bvh, tMax, t, sphereIdx);
+}
+
+auto IntersectSpheres(const ray& r, const SphereBuffer& spheres,
+                      const Bvh8& bvh, float tMax, float& t,
+                      uint32_t& sphereIdx) -> bool
+{
+    return IntersectSpheresWithBvh(r, spheres, bvh, tMax, t, sphereIdx);
+}
+
+auto ComputeSphereBounds(const SphereBuffer& spheres) -> std::vector<Aabb>
+{
+    std::vector<Aabb> bounds(spheres.GetCount());
+    for (uint32_t i = 0; i < spheres.GetCount(); ++i)
+    {
+        bounds[i] = Aabb::FromSphere(spheres.GetCenter(i),
+                                     std::sqrt(spheres.GetRadiusSq(i)));
+    }
+    return bounds;
+}
+
+auto BuildSphereBvh(const SphereBuffer& spheres, Bvh& bvh,
+                    const BvhBuildOptions& options, TaskPool* pool) -> void
+{
+    bvh.Build(ComputeSphereBounds(spheres), options, pool);
+}
+
+} // namespace pathtracer
@@ -0,0 +1,237 @@
+#include "cpu/light_sampler.h"
+#include "cpu/instance_bvh.h"
+#include "cpu/intersection.h"
+#include "cpu/sampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace pathtracer
+{
+namespace
+{
+auto IsEmissive(const color& emission) -> bool
+{
+    return emission.r > 0.0f || emission.g > 0.0f || emission.b > 0.0f;
+}
+
+/// <summary>
+/// 1 - cos of the half angle of the cone a sphere of squared radius
+/// radiusSq subtends at squared distance distanceSq, written so it does
+/// not cancel to 0 for small, distant spheres.
+/// </summary>
+auto ConeSolidAngleFactor(float radiusSq, float distanceSq) -> float
+{
+    const float sinSq = radiusSq / distanceSq;
+    return sinSq / (1.0f + std::sqrt(std::max(0.0f, 1.0f - sinSq)));
+}
+} // namespace
+
+auto LightSampler::Build(const Scene& scene,
+                         std::span<const uint32_t> instanceMeshes,
+                         std::span<const glm::mat4> instanceTransforms,
+                         std::span<const uint32_t> instanceMaterials) -> void
+{
+    Clear();
+    const std::vector<color>& emissions = scene.GetEmissions();
+
+    const SphereBuffer& spheres = scene.GetSpheres();
+    m_sphereLights.assign(spheres.GetCount(), NO_LIGHT);
+    for (uint32_t i = 0; i < spheres.GetCount(); ++i)
+    {
+        const color& emission = emissions[scene.GetSphereMaterials()[i]];
+        if (!IsEmissive(emission))
+            continue;
+        const float radiusSq = spheres.GetRadiusSq(i);
+        m_sphereLights[i] = AddLight({LightKind::Sphere,
+                                      spheres.GetCenter(i),
+                                      glm::vec3{std::sqrt(radiusSq)},
+                                      {},
+                                      emission,
+                                      4.0f * PI * radiusSq});
+    }
+
+    const auto addTriangle = [&](const glm::vec3& v0, const glm::vec3& v1,
+                                 const glm::vec3& v2, const color& emission)
+    {
+        const float area = 0.5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+        return AddLight({LightKind::Triangle, v0, v1, v2, emission, area});
+    };
+
+    m_triangleLights.assign(scene.GetTriangleCount(), NO_LIGHT);
+    for (uint32_t i = 0; i < scene.GetTriangleCount(); ++i)
+    {
+        const color& emission = emissions[scene.GetTriangleMaterials()[i]];
+        if (IsEmissive(emission))
+        {
+            m_triangleLights[i] =
+                addTriangle(scene.GetTriangleV0()[i], scene.GetTriangleV1()[i],
+                            scene.GetTriangleV2()[i], emission);
+        }
+    }
+
+    // Instance triangles get consecutive lights, so one index per instance
+    // finds them all
+    m_instanceFirstLights.assign(instanceMeshes.size(), NO_LIGHT);
+    for (size_t inst = 0; inst < instanceMeshes.size(); ++inst)
+    {
+        const uint32_t mesh = instanceMeshes[inst];
+        const uint32_t material = instanceMaterials[inst] != Scene::NO_MATERIAL
+                                      ? instanceMaterials[inst]
+                                      : scene.GetMeshMaterials()[mesh];
+        if (!IsEmissive(emissions[material]))
+            continue;
+
+        const TriangleMesh& triangles = scene.GetMeshes()[mesh];
+        const AffineTransform toWorld =
+            AffineTransform::FromMatrix(instanceTransforms[inst]);
+        m_instanceFirstLights[inst] = GetLightCount();
+        for (uint32_t tri = 0; tri < triangles.GetTriangleCount(); ++tri)
+        {
+            const glm::uvec3 v = triangles.GetTriangle(tri);
+            addTriangle(toWorld.TransformPoint(triangles.GetVertex(v.x)),
+                        toWorld.TransformPoint(triangles.GetVertex(v.y)),
+                        toWorld.TransformPoint(triangles.GetVertex(v.z)),
+                        emissions[material]);
+        }
+    }
+
+    // Choose lights by power
+    float total = 0.0f;
+    for (const Light& light : m_lights)
+    {
+        total += Luminance(light.emission) * light.area;
+    }
+    m_probabilities.resize(m_lights.size());
+    m_cdf.resize(m_lights.size());
+    float sum = 0.0f;
+    for (size_t i = 0; i < m_lights.size(); ++i)
+    {
+        const float power = Luminance(m_lights[i].emission) * m_lights[i].area;
+        m_probabilities[i] = total > 0.0f
+                                 ? power / total
+                                 : 1.0f / static_cast<float>(m_lights.size());
+        m_cdf[i] = sum;
+        sum += m_probabilities[i];
+    }
+}
+
+auto LightSampler::Clear() -> void
+{
+    m_lights.clear();
+    m_probabilities.clear();
+    m_cdf.clear();
+    m_sphereLights.clear();
+    m_triangleLights.clear();
+    m_instanceFirstLights.clear();
+}
+
+auto LightSampler::Sample(const glm::vec3& origin, float u0, float u1,
+                          float u2, LightSample& sample) const -> bool
+{
+    if (m_lights.empty())
+        return false;
+
+    // Last light whose running sum does not exceed u0
+    const auto it = std::upper_bound(m_cdf.begin(), m_cdf.end(), u0);
+    const auto idx = static_cast<uint32_t>(
+        std::max<ptrdiff_t>(0, (it - m_cdf.begin()) - 1));
+    const Light& light = m_lights[idx];
+
+    glm::vec3 normal;
+    if (light.kind == LightKind::Sphere)
+    {
+        // Uniform in the cone of directions towards the sphere
+        const glm::vec3 toCenter = light.v0 - origin;
+        const float distanceSq = glm::dot(toCenter, toCenter);
+        const float radiusSq = light.v1.x * light.v1.x;
+        if (distanceSq <= radiusSq)
+            return false;
+
+        const float factor = ConeSolidAngleFactor(radiusSq, distanceSq);
+        const float cosTheta = 1.0f - u1 * factor;
+        const float sinTheta =
+            std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        const float phi = 2.0f * PI * u2;
+        const glm::vec3 axis = toCenter / std::sqrt(distanceSq);
+        glm::vec3 t;
+        glm::vec3 b;
+        BuildBasis(axis, t, b);
+        const glm::vec3 direction =
+            t * (sinTheta * std::cos(phi)) + b * (sinTheta * std::sin(phi)) +
+            axis * cosTheta;
+
+        float distance;
+        if (!IntersectSphere(ray{origin, direction}, light.v0, light.v1.x,
+                             distance))
+        {
+            // Grazing the silhouette, lost to rounding
+            return false;
+        }
+        sample.position = origin + direction * distance;
+        sample.direction = direction;
+        sample.distance = distance;
+        normal = (sample.position - light.v0) / light.v1.x;
+    }
+    else
+    {
+        // Uniform by area
+        const float s = std::sqrt(u1);
+        const float b1 = 1.0f - s;
+        const float b2 = u2 * s;
+        sample.position =
+            light.v0 + b1 * (light.v1 - light.v0) + b2 * (light.v2 - light.v0);
+        const glm::vec3 offset = sample.position - origin;
+        sample.distance = glm::length(offset);
+        if (!(sample.distance > 0.0f))
+            return false;
+        sample.direction = offset / sample.distance;
+        normal = glm::cross(light.v1 - light.v0, light.v2 - light.v0);
+    }
+
+    sample.emission = light.emission;
+    sample.pdf = m_probabilities[idx] *
+                 PointPdf(light, origin, sample.position, normal);
+    return sample.pdf > 0.0f;
+}
+
+auto LightSampler::Pdf(uint32_t light, const glm::vec3& origin,
+                       const glm::vec3& position,
+                       const glm::vec3& normal) const -> float
+{
+    return m_probabilities[light] *
+           PointPdf(m_lights[light], origin, position, normal);
+}
+
+auto LightSampler::AddLight(const Light& light) -> uint32_t
+{
+    m_lights.push_back(light);
+    return GetLightCount() - 1;
+}
+
+auto LightSampler::PointPdf(const Light& light, const glm::vec3& origin,
+                            const glm::vec3& position,
+                            const glm::vec3& normal) const -> float
+{
+    if (light.kind == LightKind::Sphere)
+    {
+        const glm::vec3 toCenter = light.v0 - origin;
+        const float distanceSq = glm::dot(toCenter, toCenter);
+        const float radiusSq = light.v1.x * light.v1.x;
+        if (distanceSq <= radiusSq)
+            return 0.0f;
+        return 1.0f /
+               (2.0f * PI * ConeSolidAngleFactor(radiusSq, distanceSq));
+    }
+
+    // Area density converted to solid angle; either side emits
+    const glm::vec3 offset = position - origin;
+    const float distanceSq = glm::dot(offset, offset);
+    const float cosLight = std::abs(glm::dot(glm::normalize(normal), offset)) /
+                           std::sqrt(distanceSq);
+    if (!(cosLight > 0.0f) || !(light.area > 0.0f))
+        return 0.0f;
+    return distanceSq / (light.area * cosLight);
+}
+
+} // namespace pathtracer
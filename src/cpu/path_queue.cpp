@@ -0,0 +1,53 @@
+#include "cpu/path_queue.h"
+
+namespace pathtracer
+{
+
+auto PathQueue::Reserve(size_t capacity) -> void
+{
+    if (origins.size() >= capacity)
+        return;
+
+    origins.resize(capacity);
+    directions.resize(capacity);
+    betas.resize(capacity);
+    radiances.resize(capacity);
+    previous.resize(capacity);
+    bsdfPdfs.resize(capacity);
+    pixels.resize(capacity);
+    found.resize(capacity);
+    hitPositions.resize(capacity);
+    hitNormals.resize(capacity);
+    hitMaterials.resize(capacity);
+    hitLights.resize(capacity);
+}
+
+auto PathQueue::Move(size_t from, size_t to) -> void
+{
+    origins[to] = origins[from];
+    directions[to] = directions[from];
+    betas[to] = betas[from];
+    radiances[to] = radiances[from];
+    previous[to] = previous[from];
+    bsdfPdfs[to] = bsdfPdfs[from];
+    pixels[to] = pixels[from];
+    found[to] = found[from];
+    hitPositions[to] = hitPositions[from];
+    hitNormals[to] = hitNormals[from];
+    hitMaterials[to] = hitMaterials[from];
+    hitLights[to] = hitLights[from];
+}
+
+auto ShadowQueue::Reserve(size_t capacity) -> void
+{
+    if (origins.size() >= capacity)
+        return;
+
+    origins.resize(capacity);
+    directions.resize(capacity);
+    tMax.resize(capacity);
+    contributions.resize(capacity);
+    paths.resize(capacity);
+}
+
+} // namespace pathtracer
@@ -0,0 +1,178 @@
+#include "cpu/ray_sorter.h"
+#include "cpu/task_pool.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace pathtracer
+{
+namespace
+{
+// Rays per task of a parallel sort, and per histogram
+constexpr size_t PARALLEL_CHUNK_SIZE = 16384;
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX = 1u << RADIX_BITS;
+
+constexpr uint32_t MORTON_AXIS_BITS = 9;
+constexpr float MORTON_CELLS = static_cast<float>(1u << MORTON_AXIS_BITS);
+
+/// <summary>
+/// Spreads the low 10 bits of v out to every third bit.
+/// </summary>
+auto SpreadBits(uint32_t v) -> uint32_t
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+} // namespace
+
+auto RaySorter::Sort(std::span<const glm::vec3> origins,
+                     std::span<const glm::vec3> directions, TaskPool* pool)
+    -> bool
+{
+    const size_t count = origins.size();
+    if (count == 0 || count < m_minBatch)
+        return false;
+
+    m_count = count;
+    if (m_keys.size() < count)
+    {
+        m_keys.resize(count);
+        m_order.resize(count);
+        m_keyScratch.resize(count);
+        m_orderScratch.resize(count);
+    }
+
+    const uint32_t chunkCount = static_cast<uint32_t>(
+        (count + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE);
+    const auto chunkEnd = [&](uint32_t chunk)
+    { return std::min(count, (chunk + 1) * PARALLEL_CHUNK_SIZE); };
+    const auto forEachChunk = [&](const auto& fn)
+    {
+        if (pool && chunkCount > 1)
+        {
+            pool->ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t)
+                              { fn(chunk); });
+        }
+        else
+        {
+            for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                fn(chunk);
+            }
+        }
+    };
+
+    // Bounds of the origins, reduced per chunk
+    m_chunkBounds.resize(2 * static_cast<size_t>(chunkCount));
+    forEachChunk(
+        [&](uint32_t chunk)
+        {
+            glm::vec3 lo{std::numeric_limits<float>::max()};
+            glm::vec3 hi{std::numeric_limits<float>::lowest()};
+            for (size_t i = chunk * PARALLEL_CHUNK_SIZE; i < chunkEnd(chunk);
+                 ++i)
+            {
+                lo = glm::min(lo, origins[i]);
+                hi = glm::max(hi, origins[i]);
+            }
+            m_chunkBounds[2 * chunk] = lo;
+            m_chunkBounds[2 * chunk + 1] = hi;
+        });
+    glm::vec3 lo = m_chunkBounds[0];
+    glm::vec3 hi = m_chunkBounds[1];
+    for (uint32_t chunk = 1; chunk < chunkCount; ++chunk)
+    {
+        lo = glm::min(lo, m_chunkBounds[2 * chunk]);
+        hi = glm::max(hi, m_chunkBounds[2 * chunk + 1]);
+    }
+
+    // Cells per unit along each axis; flat axes all fall in cell 0
+    glm::vec3 scale{0.0f};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (hi[axis] > lo[axis])
+            scale[axis] = MORTON_CELLS / (hi[axis] - lo[axis]);
+    }
+
+    forEachChunk(
+        [&](uint32_t chunk)
+        {
+            const glm::uvec3 maxCell{(1u << MORTON_AXIS_BITS) - 1};
+            for (size_t i = chunk * PARALLEL_CHUNK_SIZE; i < chunkEnd(chunk);
+                 ++i)
+            {
+                const glm::uvec3 cell =
+                    glm::min(glm::uvec3{(origins[i] - lo) * scale}, maxCell);
+                const glm::vec3& d = directions[i];
+                const uint32_t octant = (d.x < 0.0f ? 1u : 0u) |
+                                        (d.y < 0.0f ? 2u : 0u) |
+                                        (d.z < 0.0f ? 4u : 0u);
+                m_keys[i] = (octant << (3 * MORTON_AXIS_BITS)) |
+                            SpreadBits(cell.x) | (SpreadBits(cell.y) << 1) |
+                            (SpreadBits(cell.z) << 2);
+                m_order[i] = static_cast<uint32_t>(i);
+            }
+        });
+
+    // Least significant digit first; every pass is stable, so each keeps
+    // the order of the digits below it
+    m_histograms.resize(static_cast<size_t>(chunkCount) * RADIX);
+    for (uint32_t shift = 0; shift < KEY_BITS; shift += RADIX_BITS)
+    {
+        std::fill(m_histograms.begin(), m_histograms.end(), 0u);
+        forEachChunk(
+            [&](uint32_t chunk)
+            {
+                uint32_t* histogram = m_histograms.data() + chunk * RADIX;
+                for (size_t i = chunk * PARALLEL_CHUNK_SIZE;
+                     i < chunkEnd(chunk); ++i)
+                {
+                    ++histogram[(m_keys[i] >> shift) & (RADIX - 1)];
+                }
+            });
+
+        // Each chunk scatters a digit after the chunks before it and after
+        // all smaller digits. A pass where every key has the same digit
+        // would only copy.
+        uint32_t offset = 0;
+        bool skip = false;
+        for (uint32_t digit = 0; digit < RADIX && !skip; ++digit)
+        {
+            const uint32_t digitStart = offset;
+            for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                const uint32_t n = m_histograms[chunk * RADIX + digit];
+                m_histograms[chunk * RADIX + digit] = offset;
+                offset += n;
+            }
+            skip = offset - digitStart == count;
+        }
+        if (skip)
+            continue;
+
+        forEachChunk(
+            [&](uint32_t chunk)
+            {
+                uint32_t* next = m_histograms.data() + chunk * RADIX;
+                for (size_t i = chunk * PARALLEL_CHUNK_SIZE;
+                     i < chunkEnd(chunk); ++i)
+                {
+                    const uint32_t dst =
+                        next[(m_keys[i] >> shift) & (RADIX - 1)]++;
+                    m_keyScratch[dst] = m_keys[i];
+                    m_orderScratch[dst] = m_order[i];
+                }
+            });
+        std::swap(m_keys, m_keyScratch);
+        std::swap(m_order, m_orderScratch);
+    }
+    return true;
+}
+
+} // namespace pathtracer
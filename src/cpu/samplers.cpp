@@ -0,0 +1,359 @@
+#include "cpu/samplers.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr uint32_t MASK_TEXELS =
+    BlueNoiseSampler::MASK_SIZE * BlueNoiseSampler::MASK_SIZE;
+
+// 2^32 times the golden ratio conjugate and the R2 sequence's generators
+// (Roberts 2018), so integer multiples wrap like fractional parts
+constexpr uint32_t GOLDEN_STEP = 2654435769u;
+constexpr uint32_t R2_STEP_X = 3242174889u;
+constexpr uint32_t R2_STEP_Y = 2447445414u;
+
+/// <summary>
+/// Hash of a pixel alone, the part PixelSeed() mixes in before the index.
+/// </summary>
+auto HashPixel(uint32_t x, uint32_t y) -> uint32_t
+{
+    return utils::PcgHash(x + utils::PcgHash(y));
+}
+
+auto HashCombine(uint32_t seed, uint32_t v) -> uint32_t
+{
+    return utils::PcgHash(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+auto ReverseBits(uint32_t v) -> uint32_t
+{
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+/// <summary>
+/// Owen scrambling of the bits of v, most significant first, by a hash
+/// that only lets each bit depend on the bits above it (Burley 2020, after
+/// Laine and Karras).
+/// </summary>
+auto NestedUniformScramble(uint32_t v, uint32_t seed) -> uint32_t
+{
+    v = ReverseBits(v);
+    v += seed;
+    v ^= v * 0x6c50b47cu;
+    v ^= v * 0xb82f1e52u;
+    v ^= v * 0xc7afe638u;
+    v ^= v * 0x8d22f6e6u;
+    return ReverseBits(v);
+}
+
+/// <summary>
+/// Dimension 1 of the Sobol sequence as a 32-bit fraction; dimension 0 is
+/// ReverseBits(idx).
+/// </summary>
+auto Sobol1(uint32_t idx) -> uint32_t
+{
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; idx != 0; idx >>= 1, v ^= v >> 1)
+    {
+        if (idx & 1u)
+            result ^= v;
+    }
+    return result;
+}
+
+/// <summary>
+/// Element i of a pseudorandom permutation of [0, count) chosen by seed
+/// (Kensler 2013, "Correlated Multi-Jittered Sampling").
+/// </summary>
+auto Permute(uint32_t i, uint32_t count, uint32_t seed) -> uint32_t
+{
+    uint32_t w = count - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do
+    {
+        i ^= seed;
+        i *= 0xe170893du;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fu;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1u | seed >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= count);
+    return (i + seed) % count;
+}
+
+/// <summary>
+/// (stratum + jitter) / count, kept below 1 where rounding would reach it.
+/// </summary>
+auto StratumPoint(uint32_t stratum, float jitter, uint32_t count) -> float
+{
+    const float v = (static_cast<float>(stratum) + jitter) /
+                    static_cast<float>(count);
+    return std::min(v, 1.0f - std::numeric_limits<float>::epsilon() / 2.0f);
+}
+
+/// <summary>
+/// Ranks a MASK_SIZE^2 texel pattern by void and cluster (Ulichney 1993):
+/// every prefix of the ranking is a blue-noise point set. Energies are sums
+/// of a toroidal Gaussian around each point, so a tight cluster has the
+/// highest energy among the points and a large void the lowest among the
+/// empty texels.
+/// </summary>
+auto BuildBlueNoiseRanks() -> std::vector<uint16_t>
+{
+    constexpr int SIZE = static_cast<int>(BlueNoiseSampler::MASK_SIZE);
+    constexpr float SIGMA = 1.9f;
+
+    std::vector<float> kernel(MASK_TEXELS);
+    for (int dy = 0; dy < SIZE; ++dy)
+    {
+        for (int dx = 0; dx < SIZE; ++dx)
+        {
+            const int wx = std::min(dx, SIZE - dx);
+            const int wy = std::min(dy, SIZE - dy);
+            const auto distanceSq = static_cast<float>(wx * wx + wy * wy);
+            kernel[dy * SIZE + dx] =
+                std::exp(-distanceSq / (2.0f * SIGMA * SIGMA));
+        }
+    }
+
+    std::vector<uint8_t> pattern(MASK_TEXELS, 0);
+    std::vector<float> energy(MASK_TEXELS, 0.0f);
+    const auto toggle = [&](std::vector<uint8_t>& bits,
+                            std::vector<float>& field, uint32_t texel)
+    {
+        bits[texel] ^= 1;
+        const float sign = bits[texel] ? 1.0f : -1.0f;
+        const int px = static_cast<int>(texel) % SIZE;
+        const int py = static_cast<int>(texel) / SIZE;
+        for (int y = 0; y < SIZE; ++y)
+        {
+            const float* row = &kernel[((y - py + SIZE) % SIZE) * SIZE];
+            float* out = &field[y * SIZE];
+            for (int x = 0; x < SIZE; ++x)
+            {
+                out[x] += sign * row[(x - px + SIZE) % SIZE];
+            }
+        }
+    };
+    const auto tightestCluster = [&](const std::vector<uint8_t>& bits,
+                                     const std::vector<float>& field)
+    {
+        uint32_t best = 0;
+        float bestEnergy = -std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < MASK_TEXELS; ++i)
+        {
+            if (bits[i] && field[i] > bestEnergy)
+            {
+                bestEnergy = field[i];
+                best = i;
+            }
+        }
+        return best;
+    };
+    const auto largestVoid = [&](const std::vector<uint8_t>& bits,
+                                 const std::vector<float>& field)
+    {
+        uint32_t best = 0;
+        float bestEnergy = std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < MASK_TEXELS; ++i)
+        {
+            if (!bits[i] && field[i] < bestEnergy)
+            {
+                bestEnergy = field[i];
+                best = i;
+            }
+        }
+        return best;
+    };
+
+    // A tenth of the texels at random, then moved from the tightest
+    // cluster into the largest void until that changes nothing (or, in
+    // case it cycles, a bounded number of times)
+    const uint32_t initialCount = MASK_TEXELS / 10;
+    uint32_t state = 1;
+    for (uint32_t placed = 0; placed < initialCount;)
+    {
+        state = utils::PcgHash(state);
+        const uint32_t texel = state % MASK_TEXELS;
+        if (pattern[texel])
+            continue;
+        toggle(pattern, energy, texel);
+        ++placed;
+    }
+    for (uint32_t iteration = 0; iteration < MASK_TEXELS; ++iteration)
+    {
+        const uint32_t cluster = tightestCluster(pattern, energy);
+        toggle(pattern, energy, cluster);
+        const uint32_t hole = largestVoid(pattern, energy);
+        toggle(pattern, energy, hole);
+        if (hole == cluster)
+            break;
+    }
+
+    // Ranks below the initial points: take them out tightest first
+    std::vector<uint16_t> ranks(MASK_TEXELS);
+    std::vector<uint8_t> shrinking = pattern;
+    std::vector<float> shrinkingEnergy = energy;
+    for (uint32_t rank = initialCount; rank-- > 0;)
+    {
+        const uint32_t cluster = tightestCluster(shrinking, shrinkingEnergy);
+        toggle(shrinking, shrinkingEnergy, cluster);
+        ranks[cluster] = static_cast<uint16_t>(rank);
+    }
+
+    // Ranks above: fill the largest void first. Past half the texels this
+    // is the tightest cluster of the empty texels, whose energy is the
+    // kernel's total minus the points' energy
+    for (uint32_t rank = initialCount; rank < MASK_TEXELS; ++rank)
+    {
+        const uint32_t hole = largestVoid(pattern, energy);
+        toggle(pattern, energy, hole);
+        ranks[hole] = static_cast<uint16_t>(rank);
+    }
+    return ranks;
+}
+} // namespace
+
+auto IndependentSampler::Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                               uint32_t dimension) const -> float
+{
+    // With seed 0, dimensions 0 and 1 hash the seed as compute.hlsl does
+    // for its jitter. Other seeds hash dimension 0 too, or they would only
+    // flip its low bits
+    const uint32_t seed = utils::PixelSeed(x, y, sampleIdx) ^ m_seed;
+    const uint32_t hash =
+        dimension == 0 && m_seed == 0
+            ? seed
+            : utils::PcgHash(seed + (dimension - 1) * GOLDEN_STEP);
+    return utils::UintToUnitFloat(hash);
+}
+
+StratifiedSampler::StratifiedSampler(uint32_t samplesPerPixel, uint32_t seed)
+    : m_seed(seed), m_samplesPerPixel(samplesPerPixel)
+{
+    if (samplesPerPixel == 0)
+    {
+        throw std::invalid_argument(
+            "Stratified sampler needs at least one sample per pixel");
+    }
+
+    // Fewest rows of a grid about as wide as high with a cell per sample
+    m_gridWidth = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(samplesPerPixel))));
+    m_gridHeight = (samplesPerPixel + m_gridWidth - 1) / m_gridWidth;
+}
+
+auto StratifiedSampler::Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                              uint32_t dimension) const -> float
+{
+    const uint32_t run = sampleIdx / m_samplesPerPixel;
+    const uint32_t seed =
+        HashCombine(HashCombine(HashPixel(x, y) ^ m_seed, dimension), run);
+    const uint32_t stratum =
+        Permute(sampleIdx % m_samplesPerPixel, m_samplesPerPixel, seed);
+    const float jitter =
+        utils::UintToUnitFloat(HashCombine(seed, sampleIdx + 1));
+    return StratumPoint(stratum, jitter, m_samplesPerPixel);
+}
+
+auto StratifiedSampler::Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                              uint32_t dimension) const -> glm::vec2
+{
+    // Distinct cells of the grid for the samples of a run
+    const uint32_t run = sampleIdx / m_samplesPerPixel;
+    const uint32_t seed =
+        HashCombine(HashCombine(HashPixel(x, y) ^ m_seed, dimension), run);
+    const uint32_t cell = Permute(sampleIdx % m_samplesPerPixel,
+                                  m_gridWidth * m_gridHeight, seed);
+    const uint32_t jitter = HashCombine(seed, sampleIdx + 1);
+    return {StratumPoint(cell % m_gridWidth, utils::UintToUnitFloat(jitter),
+                         m_gridWidth),
+            StratumPoint(cell / m_gridWidth,
+                         utils::UintToUnitFloat(utils::PcgHash(jitter)),
+                         m_gridHeight)};
+}
+
+auto SobolSampler::Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                         uint32_t dimension) const -> float
+{
+    const glm::vec2 pair = Get2D(x, y, sampleIdx, dimension & ~1u);
+    return (dimension & 1u) ? pair.y : pair.x;
+}
+
+auto SobolSampler::Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                         uint32_t dimension) const -> glm::vec2
+{
+    const uint32_t seed = HashCombine(HashPixel(x, y) ^ m_seed, dimension);
+    const uint32_t idx = NestedUniformScramble(sampleIdx, seed);
+    const uint32_t sx = NestedUniformScramble(ReverseBits(idx),
+                                              HashCombine(seed, 1));
+    const uint32_t sy =
+        NestedUniformScramble(Sobol1(idx), HashCombine(seed, 2));
+    return {utils::UintToUnitFloat(sx), utils::UintToUnitFloat(sy)};
+}
+
+BlueNoiseSampler::BlueNoiseSampler(uint32_t seed) : m_seed(seed)
+{
+    static const std::vector<uint16_t> ranks = BuildBlueNoiseRanks();
+    m_ranks = ranks.data();
+}
+
+auto BlueNoiseSampler::GetMask(uint32_t x, uint32_t y,
+                               uint32_t dimension) const -> uint32_t
+{
+    // Rank r stands for the fraction (r + 1/2) / MASK_TEXELS
+    const uint32_t offset = HashCombine(m_seed, dimension);
+    const uint32_t mx = (x + offset) % MASK_SIZE;
+    const uint32_t my = (y + (offset >> 16)) % MASK_SIZE;
+    constexpr uint32_t RANK_SHIFT = 20;
+    static_assert(MASK_TEXELS == 1u << (32 - RANK_SHIFT));
+    return (static_cast<uint32_t>(m_ranks[my * MASK_SIZE + mx])
+            << RANK_SHIFT) +
+           (1u << (RANK_SHIFT - 1));
+}
+
+auto BlueNoiseSampler::Get1D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                             uint32_t dimension) const -> float
+{
+    return utils::UintToUnitFloat(GetMask(x, y, dimension) +
+                                  sampleIdx * GOLDEN_STEP);
+}
+
+auto BlueNoiseSampler::Get2D(uint32_t x, uint32_t y, uint32_t sampleIdx,
+                             uint32_t dimension) const -> glm::vec2
+{
+    return {utils::UintToUnitFloat(GetMask(x, y, dimension) +
+                                   sampleIdx * R2_STEP_X),
+            utils::UintToUnitFloat(GetMask(x, y, dimension + 1) +
+                                   sampleIdx * R2_STEP_Y)};
+}
+
+} // namespace pathtracer
@@ -0,0 +1,89 @@
+#include "cpu/sphere_buffer.h"
+
+#include <limits>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// Radius squared of a padding sphere. c = |oc|^2 - radiusSq becomes +inf,
+/// so the discriminant is never positive and the sphere is never hit.
+/// </summary>
+constexpr float PADDING_RADIUS_SQ = -std::numeric_limits<float>::infinity();
+
+auto PaddedSize(uint32_t count) -> size_t
+{
+    return (static_cast<size_t>(count) + SphereBuffer::BLOCK_SIZE - 1) /
+           SphereBuffer::BLOCK_SIZE * SphereBuffer::BLOCK_SIZE;
+}
+} // namespace
+
+auto SphereBuffer::Add(const glm::vec3& center, float radius) -> uint32_t
+{
+    const uint32_t idx = m_count++;
+    if (idx == m_radiusSq.size())
+    {
+        // Start a new block, filled with spheres that can never be hit
+        const size_t size = PaddedSize(m_count);
+        m_centerX.resize(size, 0.0f);
+        m_centerY.resize(size, 0.0f);
+        m_centerZ.resize(size, 0.0f);
+        m_radiusSq.resize(size, PADDING_RADIUS_SQ);
+    }
+
+    Set(idx, center, radius);
+    return idx;
+}
+
+auto SphereBuffer::Set(uint32_t idx, const glm::vec3& center, float radius)
+    -> void
+{
+    m_centerX[idx] = center.x;
+    m_centerY[idx] = center.y;
+    m_centerZ[idx] = center.z;
+    // Same expression as the scalar kernel, so both see identical bits
+    m_radiusSq[idx] = radius * radius;
+}
+
+auto SphereBuffer::SwapRemove(uint32_t idx) -> uint32_t
+{
+    const uint32_t last = --m_count;
+    m_centerX[idx] = m_centerX[last];
+    m_centerY[idx] = m_centerY[last];
+    m_centerZ[idx] = m_centerZ[last];
+    m_radiusSq[idx] = m_radiusSq[last];
+
+    // The freed element becomes padding of the last block, or the block
+    // goes away entirely
+    m_centerX[last] = 0.0f;
+    m_centerY[last] = 0.0f;
+    m_centerZ[last] = 0.0f;
+    m_radiusSq[last] = PADDING_RADIUS_SQ;
+    const size_t size = PaddedSize(m_count);
+    m_centerX.resize(size);
+    m_centerY.resize(size);
+    m_centerZ.resize(size);
+    m_radiusSq.resize(size);
+    return last;
+}
+
+auto SphereBuffer::Reserve(uint32_t count) -> void
+{
+    const size_t size = PaddedSize(count);
+    m_centerX.reserve(size);
+    m_centerY.reserve(size);
+    m_centerZ.reserve(size);
+    m_radiusSq.reserve(size);
+}
+
+auto SphereBuffer::Clear() -> void
+{
+    m_count = 0;
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_radiusSq.clear();
+}
+
+} // namespace pathtracer
@@ -0,0 +1,146 @@
+#include "cpu/task_pool.h"
+
+#include <algorithm>
+
+namespace pathtracer
+{
+TaskPool::TaskPool(uint32_t threadCount) : m_threadCount(threadCount)
+{
+    if (m_threadCount == 0)
+    {
+        m_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Thread 0 is the caller, so only spawn the others
+    m_workers.reserve(m_threadCount - 1);
+    for (uint32_t i = 1; i < m_threadCount; ++i)
+    {
+        m_workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard lock(m_jobMutex);
+        m_shutdown = true;
+    }
+    m_jobStart.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+auto TaskPool::ParallelFor(uint32_t count, const TaskFunction& fn) -> void
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Small loops are not worth waking anyone for
+    if (count == 1 || m_threadCount == 1)
+    {
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            fn(index, 0);
+        }
+        return;
+    }
+
+    alignas(64) std::atomic<uint32_t> next{0};
+    RunOnAllThreads(
+        [&](uint32_t threadIdx)
+        {
+            for (;;)
+            {
+                const uint32_t index =
+                    next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= count || IsCancelled())
+                {
+                    return;
+                }
+                fn(index, threadIdx);
+            }
+        });
+}
+
+auto TaskPool::RunOnAllThreads(const ThreadFunction& fn) -> void
+{
+    m_function = &fn;
+    m_exception = nullptr;
+    m_cancelled = false;
+
+    // Wake the workers
+    {
+        std::lock_guard lock(m_jobMutex);
+        m_activeWorkers = m_threadCount - 1;
+        ++m_generation;
+    }
+    m_jobStart.notify_all();
+
+    Execute(0);
+
+    // Wait for the stragglers
+    {
+        std::unique_lock lock(m_jobMutex);
+        m_jobDone.wait(lock, [this] { return m_activeWorkers == 0; });
+    }
+
+    m_function = nullptr;
+
+    if (m_exception)
+    {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+auto TaskPool::WorkerLoop(uint32_t threadIdx) -> void
+{
+    uint64_t seenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock lock(m_jobMutex);
+            m_jobStart.wait(lock,
+                            [&] {
+                                return m_shutdown ||
+                                       m_generation != seenGeneration;
+                            });
+            if (m_shutdown)
+            {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        Execute(threadIdx);
+
+        {
+            std::lock_guard lock(m_jobMutex);
+            --m_activeWorkers;
+        }
+        m_jobDone.notify_one();
+    }
+}
+
+auto TaskPool::Execute(uint32_t threadIdx) -> void
+{
+    try
+    {
+        (*m_function)(threadIdx);
+    }
+    catch (...)
+    {
+        std::lock_guard lock(m_jobMutex);
+        if (!m_exception)
+        {
+            m_exception = std::current_exception();
+        }
+        m_cancelled = true;
+    }
+}
+
+} // namespace pathtracer
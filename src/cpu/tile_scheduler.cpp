@@ -0,0 +1,143 @@
+#include "cpu/tile_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace pathtracer
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+auto ElapsedMs(Clock::time_point start, Clock::time_point end) -> double
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+} // namespace
+
+TileScheduler::TileScheduler(uint32_t threadCount, uint32_t tileSize)
+    : m_pool(threadCount), m_tileSize(std::max(tileSize, 1u))
+{
+    m_queues = std::make_unique<WorkQueue[]>(GetThreadCount());
+    m_stats.resize(GetThreadCount());
+}
+
+auto TileScheduler::SetTileSize(uint32_t tileSize) -> void
+{
+    m_tileSize = std::max(tileSize, 1u);
+}
+
+auto TileScheduler::Run(uint32_t width, uint32_t height,
+                        const TileFunction& fn) -> void
+{
+    const auto start = Clock::now();
+
+    // Build the tile list in row-major order
+    m_tiles.clear();
+    for (uint32_t y = 0; y < height; y += m_tileSize)
+    {
+        for (uint32_t x = 0; x < width; x += m_tileSize)
+        {
+            m_tiles.push_back(Tile{x, y, std::min(x + m_tileSize, width),
+                                   std::min(y + m_tileSize, height)});
+        }
+    }
+
+    // Hand out contiguous runs of tiles so each thread starts on a coherent
+    // region of the image. Stealing evens out the imbalance.
+    const auto tileCount = static_cast<uint32_t>(m_tiles.size());
+    const uint32_t threadCount = GetThreadCount();
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        const uint32_t begin =
+            static_cast<uint32_t>(uint64_t(tileCount) * t / threadCount);
+        const uint32_t end = static_cast<uint32_t>(uint64_t(tileCount) *
+                                                   (t + 1) / threadCount);
+
+        std::lock_guard lock(m_queues[t].mutex);
+        m_queues[t].tiles.clear();
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            m_queues[t].tiles.push_back(i);
+        }
+        m_stats[t] = ThreadStats{};
+    }
+
+    // Exceptions thrown by fn are rethrown here by the pool
+    m_pool.RunOnAllThreads([&](uint32_t threadIdx)
+                           { Execute(threadIdx, fn); });
+
+    m_lastRunMs = ElapsedMs(start, Clock::now());
+    for (auto& stats : m_stats)
+    {
+        stats.idleMs = std::max(m_lastRunMs - stats.busyMs, 0.0);
+    }
+}
+
+auto TileScheduler::Execute(uint32_t threadIdx, const TileFunction& fn)
+    -> void
+{
+    // Accumulate locally so threads don't false-share the stats vector
+    ThreadStats stats{};
+    uint32_t tileIdx = 0;
+
+    for (;;)
+    {
+        const bool local = PopLocal(threadIdx, tileIdx);
+        if (!local && !Steal(threadIdx, tileIdx))
+        {
+            // Every queue is empty, nothing left to do for this run
+            m_stats[threadIdx] = stats;
+            return;
+        }
+
+        if (m_pool.IsCancelled())
+        {
+            continue; // Drain the queues without running anything
+        }
+
+        const auto start = Clock::now();
+        fn(m_tiles[tileIdx], threadIdx);
+        stats.busyMs += ElapsedMs(start, Clock::now());
+        ++stats.tilesExecuted;
+        if (!local)
+        {
+            ++stats.tilesStolen;
+        }
+    }
+}
+
+auto TileScheduler::PopLocal(uint32_t threadIdx, uint32_t& tileIdx) -> bool
+{
+    // The owner works front to back through its contiguous run
+    WorkQueue& queue = m_queues[threadIdx];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tiles.empty())
+    {
+        return false;
+    }
+    tileIdx = queue.tiles.front();
+    queue.tiles.pop_front();
+    return true;
+}
+
+auto TileScheduler::Steal(uint32_t thiefIdx, uint32_t& tileIdx) -> bool
+{
+    // Thieves take from the back, as far as possible from where the owner is
+    // working. Start at the next thread so victims are spread evenly.
+    const uint32_t threadCount = GetThreadCount();
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        WorkQueue& victim = m_queues[(thiefIdx + i) % threadCount];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tiles.empty())
+        {
+            tileIdx = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,157 @@
+#include "cpu/triangle_intersection.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace pathtracer
+{
+auto ComputeTriangleBounds(const TriangleMesh& mesh) -> std::vector<Aabb>
+{
+    std::vector<Aabb> bounds(mesh.GetTriangleCount());
+    for (uint32_t i = 0; i < mesh.GetTriangleCount(); ++i)
+    {
+        const glm::uvec3 tri = mesh.GetTriangle(i);
+        bounds[i].Grow(mesh.GetVertex(tri.x));
+        bounds[i].Grow(mesh.GetVertex(tri.y));
+        bounds[i].Grow(mesh.GetVertex(tri.z));
+    }
+    return bounds;
+}
+
+template <size_t N>
+auto MeshBvh<N>::Build(const TriangleMesh& mesh, TriangleLeafLayout layout,
+                       const BvhBuildOptions& options, TaskPool* pool) -> void
+{
+    // A leaf costs one group test whether it holds one triangle or N, so
+    // price triangles at 1 / N of a test to let the SAH fill the groups
+    BvhBuildOptions meshOptions = options;
+    meshOptions.maxLeafSize =
+        std::min(options.maxLeafSize, static_cast<uint32_t>(N));
+    meshOptions.intersectionCost = options.intersectionCost / N;
+
+    m_layout = layout;
+    m_bvh.Build(ComputeTriangleBounds(mesh), meshOptions, pool);
+    Finish(mesh);
+}
+
+template <size_t N>
+auto MeshBvh<N>::Update(const TriangleMesh& mesh, TaskPool* pool) -> void
+{
+    m_bvh.Update(ComputeTriangleBounds(mesh), pool);
+    Finish(mesh);
+}
+
+template <size_t N>
+auto MeshBvh<N>::Assign(Bvh bvh, WideBvh<N> wide, GroupArray groups,
+                        TriangleLeafLayout layout) -> void
+{
+    m_bvh = std::move(bvh);
+    m_wide = std::move(wide);
+    m_groups = std::move(groups);
+    m_layout = layout;
+}
+
+template <size_t N>
+auto MeshBvh<N>::IsValid(uint32_t triangleCount) const -> bool
+{
+    if (!m_bvh.IsValid(triangleCount))
+        return false;
+
+    const std::vector<uint32_t>& primIndices = m_wide.GetPrimIndices();
+    for (const uint32_t triIdx : primIndices)
+    {
+        if (triIdx >= triangleCount)
+            return false;
+    }
+
+    // Unused lanes of a group hold NaN vertices, which no ray hits
+    constexpr uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+    for (const Group& group : m_groups)
+    {
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            if (group.triIdx[i] >= triangleCount &&
+                (group.triIdx[i] != NO_TRIANGLE || !std::isnan(group.v0x[i])))
+            {
+                return false;
+            }
+        }
+    }
+
+    // A leaf is one group, or at most N indices Pack() gathers per visit
+    return m_wide.IsValid(
+        [&](uint32_t first, uint32_t count) -> bool
+        {
+            if (count > N)
+                return false;
+            if (m_layout == TriangleLeafLayout::Packed)
+                return first < m_groups.size();
+            return first <= primIndices.size() &&
+                   count <= primIndices.size() - first;
+        });
+}
+
+template <size_t N> auto MeshBvh<N>::Clear() -> void
+{
+    m_bvh.Clear();
+    m_wide.Clear();
+    m_groups.clear();
+}
+
+template <size_t N>
+auto MeshBvh<N>::GetTraversalBytes() const noexcept -> size_t
+{
+    const size_t leafBytes =
+        m_layout == TriangleLeafLayout::Packed
+            ? m_groups.size() * sizeof(Group)
+            : m_wide.GetPrimIndices().size() * sizeof(uint32_t);
+    return m_wide.GetNodes().size() * sizeof(typename WideBvh<N>::Node) +
+           leafBytes;
+}
+
+template <size_t N>
+auto MeshBvh<N>::Finish(const TriangleMesh& mesh) -> void
+{
+    m_wide.Build(m_bvh);
+    m_groups.clear();
+    if (m_layout != TriangleLeafLayout::Packed)
+        return;
+
+    // Leaves hold at most N triangles, so each becomes exactly one group
+    const uint32_t* primIndices = m_wide.GetPrimIndices().data();
+    m_groups.reserve(m_bvh.GetStats().leafCount);
+    m_wide.RemapLeaves(
+        [&](uint32_t first, uint32_t count) -> uint32_t
+        {
+            m_groups.push_back(Group::Pack(mesh, primIndices + first, count));
+            return static_cast<uint32_t>(m_groups.size() - 1);
+        });
+}
+
+template class MeshBvh<4>;
+template class MeshBvh<8>;
+
+auto IntersectTriangles(const ray& r, const TriangleMesh& mesh,
+                        const Bvh& bvh, float tMax, TriangleHit& hit) -> bool
+{
+    const WatertightRay wr(r);
+    float tClosest = tMax;
+    return bvh.Intersect(r, tClosest,
+                         [&](uint32_t idx, float& t) -> bool
+                         {
+                             const glm::uvec3 tri = mesh.GetTriangle(idx);
+                             if (!IntersectTriangle(wr, mesh.GetVertex(tri.x),
+                                                    mesh.GetVertex(tri.y),
+                                                    mesh.GetVertex(tri.z), t,
+                                                    hit))
+                             {
+                                 return false;
+                             }
+                             t = hit.t;
+                             hit.triIdx = idx;
+                             return true;
+                         });
+}
+
+} // namespace pathtracer
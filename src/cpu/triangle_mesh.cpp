@@ -0,0 +1,58 @@
+#include "cpu/triangle_mesh.h"
+
+#include <stdexcept>
+
+namespace pathtracer
+{
+auto TriangleMesh::AddVertex(const glm::vec3& position) -> uint32_t
+{
+    const uint32_t idx = GetVertexCount();
+    m_positionX.push_back(position.x);
+    m_positionY.push_back(position.y);
+    m_positionZ.push_back(position.z);
+    return idx;
+}
+
+auto TriangleMesh::AddTriangle(uint32_t i0, uint32_t i1, uint32_t i2)
+    -> uint32_t
+{
+    const uint32_t vertexCount = GetVertexCount();
+    if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount)
+    {
+        throw std::invalid_argument("Triangle references a missing vertex");
+    }
+
+    const uint32_t idx = GetTriangleCount();
+    m_indices.push_back(i0);
+    m_indices.push_back(i1);
+    m_indices.push_back(i2);
+    return idx;
+}
+
+auto TriangleMesh::Reserve(uint32_t vertexCount, uint32_t triangleCount)
+    -> void
+{
+    m_positionX.reserve(vertexCount);
+    m_positionY.reserve(vertexCount);
+    m_positionZ.reserve(vertexCount);
+    m_indices.reserve(static_cast<size_t>(triangleCount) * 3);
+}
+
+auto TriangleMesh::Resize(uint32_t vertexCount, uint32_t triangleCount)
+    -> void
+{
+    m_positionX.resize(vertexCount);
+    m_positionY.resize(vertexCount);
+    m_positionZ.resize(vertexCount);
+    m_indices.resize(static_cast<size_t>(triangleCount) * 3);
+}
+
+auto TriangleMesh::Clear() -> void
+{
+    m_positionX.clear();
+    m_positionY.clear();
+    m_positionZ.clear();
+    m_indices.clear();
+}
+
+} // namespace pathtracer
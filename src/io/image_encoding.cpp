@@ -0,0 +1,766 @@
+#include "io/image_encoding.h"
+#include "cpu/task_pool.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef USE_STB
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_STATIC
+#define STBI_WRITE_NO_STDIO
+#include <stb_image_write.h>
+#pragma GCC diagnostic pop
+#endif
+
+namespace pathtracer
+{
+namespace
+{
+static_assert(std::endian::native == std::endian::little,
+              "Pixels are packed as 32-bit words in little-endian order");
+
+/// <summary>
+/// Scanlines per independently compressed block of a PNG. Each block
+/// starts the compressor with an empty window, so blocks much smaller than
+/// this cost compression ratio.
+/// </summary>
+constexpr uint32_t PNG_BLOCK_ROWS = 64;
+
+/// <summary>
+/// Scanlines per chunk of an EXR: fixed at 16 by ZIP compression, and 1
+/// for uncompressed files.
+/// </summary>
+#ifdef USE_STB
+constexpr uint32_t EXR_CHUNK_ROWS = 16;
+#else
+constexpr uint32_t EXR_CHUNK_ROWS = 1;
+#endif
+
+// stb's default, trading speed against ratio
+constexpr int ZLIB_QUALITY = 8;
+
+// Largest prime below 2^16, the modulus of Adler-32
+constexpr uint32_t ADLER_BASE = 65521;
+
+auto AppendLe32(std::vector<uint8_t>& out, uint32_t value) -> void
+{
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 24));
+}
+
+auto AppendLe64(std::vector<uint8_t>& out, uint64_t value) -> void
+{
+    AppendLe32(out, static_cast<uint32_t>(value));
+    AppendLe32(out, static_cast<uint32_t>(value >> 32));
+}
+
+auto AppendFloat(std::vector<uint8_t>& out, float value) -> void
+{
+    AppendLe32(out, std::bit_cast<uint32_t>(value));
+}
+
+// Appends s with its terminating null
+auto AppendString(std::vector<uint8_t>& out, std::string_view s) -> void
+{
+    out.insert(out.end(), s.begin(), s.end());
+    out.push_back(0);
+}
+
+auto CheckSize(size_t size, uint32_t width, uint32_t height) -> void
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("Image size must be non-zero");
+    }
+    if (size != static_cast<size_t>(width) * height)
+    {
+        throw std::invalid_argument(
+            "Image must hold one pixel per image pixel");
+    }
+}
+
+auto ToRgb(const uint32_t* pixels, uint32_t count, uint8_t* out) -> void
+{
+    for (uint32_t x = 0; x < count; ++x)
+    {
+        out[x * 3] = static_cast<uint8_t>(pixels[x]);
+        out[x * 3 + 1] = static_cast<uint8_t>(pixels[x] >> 8);
+        out[x * 3 + 2] = static_cast<uint8_t>(pixels[x] >> 16);
+    }
+}
+
+#ifdef USE_STB
+auto AppendBe32(std::vector<uint8_t>& out, uint32_t value) -> void
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+constexpr auto MakeCrcTable() -> std::array<uint32_t, 256>
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; ++n)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC_TABLE = MakeCrcTable();
+
+auto Crc32(std::span<const uint8_t> data) -> uint32_t
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (const uint8_t byte : data)
+        c = CRC_TABLE[(c ^ byte) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+/// <summary>
+/// Appends a PNG chunk: length, type, data and the CRC of type and data.
+/// </summary>
+auto AppendPngChunk(std::vector<uint8_t>& out, const char (&type)[5],
+                    std::span<const uint8_t> data) -> void
+{
+    AppendBe32(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    AppendBe32(out, Crc32({out.data() + start, out.size() - start}));
+}
+
+/// <summary>
+/// Adler-32 of the concatenation of two buffers from the Adler-32 of each
+/// and the length of the second, as zlib's adler32_combine().
+/// </summary>
+auto Adler32Combine(uint32_t first, uint32_t second, size_t secondLength)
+    -> uint32_t
+{
+    const uint64_t rem = secondLength % ADLER_BASE;
+    uint64_t sum1 = first & 0xFFFF;
+    uint64_t sum2 = rem * sum1 % ADLER_BASE;
+    sum1 += (second & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (first >> 16) + (second >> 16) + ADLER_BASE - rem;
+    sum1 %= ADLER_BASE;
+    sum2 %= ADLER_BASE;
+    return static_cast<uint32_t>(sum1 | (sum2 << 16));
+}
+
+/// <summary>
+/// Reads a deflate stream least significant bit first through a 64-bit
+/// window, as the format packs it.
+/// </summary>
+class BitReader
+{
+  public:
+    explicit BitReader(std::span<const uint8_t> data) : m_data(data)
+    {
+    }
+
+    /// <summary>
+    /// The next count (at most 32) bits without consuming them; zeros
+    /// past the end of the data.
+    /// </summary>
+    auto Peek(uint32_t count) -> uint32_t
+    {
+        while (m_count <= 56 && m_next < m_data.size())
+        {
+            m_window |= static_cast<uint64_t>(m_data[m_next++]) << m_count;
+            m_count += 8;
+        }
+        return static_cast<uint32_t>(m_window & ((uint64_t{1} << count) - 1));
+    }
+
+    auto Consume(uint32_t count) -> void
+    {
+        if (count > m_count)
+        {
+            throw std::runtime_error("Truncated deflate stream");
+        }
+        m_window >>= count;
+        m_count -= count;
+    }
+
+    auto Read(uint32_t count) -> uint32_t
+    {
+        const uint32_t value = Peek(count);
+        Consume(count);
+        return value;
+    }
+
+    /// <summary>
+    /// Index of the next bit from the start of the data.
+    /// </summary>
+    auto GetPosition() const noexcept -> size_t
+    {
+        return m_next * 8 - m_count;
+    }
+
+  private:
+    std::span<const uint8_t> m_data;
+    size_t m_next = 0;
+    uint64_t m_window = 0;
+    uint32_t m_count = 0;
+};
+
+struct HuffmanEntry
+{
+    uint16_t symbol;
+    uint8_t length;
+};
+
+// Reverses the low length bits of code: Huffman codes are packed most
+// significant bit first, against the order of everything else
+constexpr auto ReverseBits(uint32_t code, uint32_t length) -> uint32_t
+{
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < length; ++i)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    return reversed;
+}
+
+/// <summary>
+/// The fixed literal/length code of deflate, indexed by the next 9 bits of
+/// the stream.
+/// </summary>
+constexpr auto MakeFixedLiteralTable() -> std::array<HuffmanEntry, 512>
+{
+    std::array<HuffmanEntry, 512> table{};
+    for (uint32_t symbol = 0; symbol < 288; ++symbol)
+    {
+        uint32_t code;
+        uint32_t length;
+        if (symbol < 144)
+        {
+            code = 0x30 + symbol;
+            length = 8;
+        }
+        else if (symbol < 256)
+        {
+            code = 0x190 + symbol - 144;
+            length = 9;
+        }
+        else if (symbol < 280)
+        {
+            code = symbol - 256;
+            length = 7;
+        }
+        else
+        {
+            code = 0xC0 + symbol - 280;
+            length = 8;
+        }
+        const uint32_t reversed = ReverseBits(code, length);
+        for (uint32_t high = 0; high < (1u << (9 - length)); ++high)
+        {
+            table[reversed | (high << length)] = {
+                static_cast<uint16_t>(symbol), static_cast<uint8_t>(length)};
+        }
+    }
+    return table;
+}
+
+constexpr std::array<HuffmanEntry, 512> FIXED_LITERAL_TABLE =
+    MakeFixedLiteralTable();
+
+/// <summary>
+/// Where the last block of a raw deflate stream starts and where its
+/// end-of-block code ends, in bits.
+/// </summary>
+struct DeflateEnd
+{
+    size_t finalBlockBit;
+    size_t endBit;
+};
+
+/// <summary>
+/// Walks a raw deflate stream of stored and fixed-code blocks, which is
+/// all stb and zlib's Z_FIXED strategy emit, to the end of its final block.
+/// Only lengths of codes are decoded, nothing is inflated.
+/// </summary>
+auto FindDeflateEnd(std::span<const uint8_t> deflate) -> DeflateEnd
+{
+    BitReader bits(deflate);
+    for (;;)
+    {
+        const size_t blockBit = bits.GetPosition();
+        const bool final = bits.Read(1) != 0;
+        const uint32_t type = bits.Read(2);
+        if (type == 0)
+        {
+            bits.Consume(static_cast<uint32_t>(-bits.GetPosition() % 8));
+            const uint32_t length = bits.Read(16);
+            bits.Consume(16);
+            for (uint32_t i = 0; i < length; ++i)
+                bits.Read(8);
+        }
+        else if (type == 1)
+        {
+            for (;;)
+            {
+                const HuffmanEntry entry = FIXED_LITERAL_TABLE[bits.Peek(9)];
+                bits.Consume(entry.length);
+                if (entry.symbol < 256)
+                    continue;
+                if (entry.symbol == 256)
+                    break;
+                if (entry.symbol > 285)
+                {
+                    throw std::runtime_error("Invalid deflate length code");
+                }
+
+                const uint32_t lengthCode = entry.symbol - 257;
+                if (lengthCode >= 8 && lengthCode < 28)
+                    bits.Consume(lengthCode / 4 - 1);
+                const uint32_t distanceCode = ReverseBits(bits.Read(5), 5);
+                if (distanceCode >= 30)
+                {
+                    throw std::runtime_error("Invalid deflate distance code");
+                }
+                if (distanceCode >= 4)
+                    bits.Consume(distanceCode / 2 - 1);
+            }
+        }
+        else
+        {
+            throw std::runtime_error(
+                "Unexpected dynamic Huffman block in deflate stream");
+        }
+
+        if (final)
+            return {blockBit, bits.GetPosition()};
+    }
+}
+
+/// <summary>
+/// One block of scanlines, compressed into a piece of a shared zlib
+/// stream: raw deflate data that ends on a byte, plus what the zlib
+/// trailer of the whole stream needs.
+/// </summary>
+struct DeflateSegment
+{
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> data;
+    uint32_t adler = 1;
+    size_t rawSize = 0;
+};
+
+auto Deflate(std::span<uint8_t> data) -> std::vector<uint8_t>
+{
+    int size = 0;
+    unsigned char* compressed = stbi_zlib_compress(
+        data.data(), static_cast<int>(data.size()), &size, ZLIB_QUALITY);
+    if (!compressed)
+    {
+        throw std::runtime_error("Failed to compress image data");
+    }
+    std::vector<uint8_t> result(compressed, compressed + size);
+    STBIW_FREE(compressed);
+    return result;
+}
+
+/// <summary>
+/// Cuts a complete zlib stream down to a segment. stb writes each stream as
+/// one final block, and independent streams cannot just be concatenated:
+/// unless last, the segment's final block is made non-final and followed by
+/// an empty stored block, a sync flush, which pads it to a byte so the next
+/// segment may follow.
+/// </summary>
+auto ToDeflateSegment(std::span<const uint8_t> zlib, size_t rawSize,
+                      bool last) -> DeflateSegment
+{
+    if (zlib.size() < 6 || (zlib[0] & 0x0F) != 8 || (zlib[1] & 0x20) != 0)
+    {
+        throw std::runtime_error("Invalid zlib stream");
+    }
+    const std::span<const uint8_t> deflate = zlib.subspan(2, zlib.size() - 6);
+    const DeflateEnd end = FindDeflateEnd(deflate);
+
+    DeflateSegment segment;
+    segment.header.assign(zlib.begin(), zlib.begin() + 2);
+    segment.rawSize = rawSize;
+    const uint8_t* adler = zlib.data() + zlib.size() - 4;
+    segment.adler = (static_cast<uint32_t>(adler[0]) << 24) |
+                    (static_cast<uint32_t>(adler[1]) << 16) |
+                    (static_cast<uint32_t>(adler[2]) << 8) | adler[3];
+
+    // Keep the bits up to the end-of-block code, with any padding after it
+    // cleared to make room for the stored block's zero header bits
+    segment.data.assign(deflate.begin(),
+                        deflate.begin() + (end.endBit + 7) / 8);
+    const uint32_t usedBits = static_cast<uint32_t>(end.endBit % 8);
+    if (usedBits != 0)
+        segment.data.back() &= static_cast<uint8_t>((1u << usedBits) - 1);
+    if (last)
+        return segment;
+
+    segment.data[end.finalBlockBit / 8] &=
+        static_cast<uint8_t>(~(1u << (end.finalBlockBit % 8)));
+    if ((end.endBit + 3 + 7) / 8 > segment.data.size())
+        segment.data.push_back(0);
+    segment.data.insert(segment.data.end(), {0x00, 0x00, 0xFF, 0xFF});
+    return segment;
+}
+
+auto PaethPredictor(int a, int b, int c) -> int
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+/// <summary>
+/// Filters an RGB scanline with PNG filter type filter against the
+/// unfiltered scanline above it.
+/// </summary>
+auto FilterRow(uint32_t filter, const uint8_t* row, const uint8_t* prior,
+               size_t size, uint8_t* out) -> void
+{
+    constexpr size_t BPP = 3;
+    for (size_t i = 0; i < size; ++i)
+    {
+        const int a = i >= BPP ? row[i - BPP] : 0;
+        const int b = prior[i];
+        const int c = i >= BPP ? prior[i - BPP] : 0;
+        int predicted = 0;
+        switch (filter)
+        {
+        case 1:
+            predicted = a;
+            break;
+        case 2:
+            predicted = b;
+            break;
+        case 3:
+            predicted = (a + b) / 2;
+            break;
+        case 4:
+            predicted = PaethPredictor(a, b, c);
+            break;
+        }
+        out[i] = static_cast<uint8_t>(row[i] - predicted);
+    }
+}
+
+/// <summary>
+/// Sum of the filtered bytes as signed values, the usual estimate of how
+/// well a filter will compress.
+/// </summary>
+auto FilterCost(const uint8_t* filtered, size_t size) -> uint64_t
+{
+    uint64_t cost = 0;
+    for (size_t i = 0; i < size; ++i)
+        cost += static_cast<uint64_t>(
+            std::abs(static_cast<int>(static_cast<int8_t>(filtered[i]))));
+    return cost;
+}
+
+/// <summary>
+/// Filters and compresses scanlines [y0, y1), each with the filter that
+/// scores best. The block's first scanline is filtered against the last of
+/// the block above, which is in the same image, so filtering does not care
+/// where blocks split.
+/// </summary>
+auto EncodePngBlock(uint32_t width, std::span<const uint32_t> pixels,
+                    uint32_t y0, uint32_t y1, bool last) -> DeflateSegment
+{
+    const size_t rowSize = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> prior(rowSize, 0);
+    std::vector<uint8_t> row(rowSize);
+    std::vector<uint8_t> candidate(rowSize);
+    std::vector<uint8_t> best(rowSize);
+    if (y0 > 0)
+        ToRgb(pixels.data() + static_cast<size_t>(y0 - 1) * width, width,
+              prior.data());
+
+    std::vector<uint8_t> filtered;
+    filtered.reserve((rowSize + 1) * (y1 - y0));
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        ToRgb(pixels.data() + static_cast<size_t>(y) * width, width,
+              row.data());
+        uint32_t bestFilter = 0;
+        uint64_t bestCost = UINT64_MAX;
+        for (uint32_t filter = 0; filter < 5; ++filter)
+        {
+            FilterRow(filter, row.data(), prior.data(), rowSize,
+                      candidate.data());
+            const uint64_t cost = FilterCost(candidate.data(), rowSize);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(static_cast<uint8_t>(bestFilter));
+        filtered.insert(filtered.end(), best.begin(), best.end());
+        prior.swap(row);
+    }
+
+    const std::vector<uint8_t> zlib = Deflate(filtered);
+    return ToDeflateSegment(zlib, filtered.size(), last);
+}
+#endif
+
+/// <summary>
+/// The EXR header of a file of half-float B, G and R channels, up to the
+/// offset table.
+/// </summary>
+auto MakeExrHeader(uint32_t width, uint32_t height) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> header;
+    AppendLe32(header, 20000630); // Magic number
+    AppendLe32(header, 2);        // Version 2, single-part scanline file
+
+    AppendString(header, "channels");
+    AppendString(header, "chlist");
+    AppendLe32(header, 3 * 18 + 1);
+    for (const char* channel : {"B", "G", "R"})
+    {
+        AppendString(header, channel);
+        AppendLe32(header, 1);                 // HALF
+        header.insert(header.end(), 4, 0);     // pLinear and reserved
+        AppendLe32(header, 1);                 // xSampling
+        AppendLe32(header, 1);                 // ySampling
+    }
+    header.push_back(0);
+
+    AppendString(header, "compression");
+    AppendString(header, "compression");
+    AppendLe32(header, 1);
+    header.push_back(EXR_CHUNK_ROWS == 16 ? 3 : 0); // ZIP or NONE
+
+    for (const char* window : {"dataWindow", "displayWindow"})
+    {
+        AppendString(header, window);
+        AppendString(header, "box2i");
+        AppendLe32(header, 16);
+        AppendLe32(header, 0);
+        AppendLe32(header, 0);
+        AppendLe32(header, width - 1);
+        AppendLe32(header, height - 1);
+    }
+
+    AppendString(header, "lineOrder");
+    AppendString(header, "lineOrder");
+    AppendLe32(header, 1);
+    header.push_back(0); // INCREASING_Y
+
+    AppendString(header, "pixelAspectRatio");
+    AppendString(header, "float");
+    AppendLe32(header, 4);
+    AppendFloat(header, 1.0f);
+
+    AppendString(header, "screenWindowCenter");
+    AppendString(header, "v2f");
+    AppendLe32(header, 8);
+    AppendFloat(header, 0.0f);
+    AppendFloat(header, 0.0f);
+
+    AppendString(header, "screenWindowWidth");
+    AppendString(header, "float");
+    AppendLe32(header, 4);
+    AppendFloat(header, 1.0f);
+
+    header.push_back(0);
+    return header;
+}
+
+/// <summary>
+/// The data of the EXR chunk of scanlines [y0, y1): per scanline, the
+/// half floats of each channel in turn, ZIP-compressed when that helps.
+/// </summary>
+auto EncodeExrChunk(uint32_t width, std::span<const glm::vec4> pixels,
+                    uint32_t y0, uint32_t y1) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> raw(static_cast<size_t>(width) * (y1 - y0) * 3 * 2);
+    uint8_t* out = raw.data();
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const glm::vec4* row = pixels.data() + static_cast<size_t>(y) * width;
+        for (const int channel : {2, 1, 0})
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint16_t half = glm::packHalf1x16(row[x][channel]);
+                *out++ = static_cast<uint8_t>(half);
+                *out++ = static_cast<uint8_t>(half >> 8);
+            }
+        }
+    }
+
+#ifdef USE_STB
+    // Low bytes of the halves first, then high bytes, each as differences
+    // from the byte before, which is what makes floats compressible
+    std::vector<uint8_t> predicted(raw.size());
+    const size_t half = (raw.size() + 1) / 2;
+    for (size_t i = 0; i < raw.size(); ++i)
+        predicted[(i % 2 == 0 ? 0 : half) + i / 2] = raw[i];
+    uint8_t previous = predicted[0];
+    for (size_t i = 1; i < predicted.size(); ++i)
+    {
+        const uint8_t current = predicted[i];
+        predicted[i] = static_cast<uint8_t>(current - previous + 128 + 256);
+        previous = current;
+    }
+
+    // Readers take a chunk no smaller than its raw size as uncompressed
+    std::vector<uint8_t> compressed = Deflate(predicted);
+    if (compressed.size() < raw.size())
+        return compressed;
+#endif
+    return raw;
+}
+} // namespace
+
+auto GetImageFormat(const std::filesystem::path& path) -> ImageFormat
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".ppm")
+        return ImageFormat::Ppm;
+    if (extension == ".png")
+        return ImageFormat::Png;
+    if (extension == ".exr")
+        return ImageFormat::Exr;
+    throw std::invalid_argument("Unsupported image format: " +
+                                path.string() +
+                                " (expected .ppm, .png or .exr)");
+}
+
+auto IsPngSupported() noexcept -> bool
+{
+#ifdef USE_STB
+    return true;
+#else
+    return false;
+#endif
+}
+
+auto EncodePpm(uint32_t width, uint32_t height,
+               std::span<const uint32_t> pixels) -> std::vector<uint8_t>
+{
+    CheckSize(pixels.size(), width, height);
+    const std::string header = "P6\n" + std::to_string(width) + " " +
+                               std::to_string(height) + "\n255\n";
+    std::vector<uint8_t> file(header.size() + pixels.size() * 3);
+    std::memcpy(file.data(), header.data(), header.size());
+    ToRgb(pixels.data(), static_cast<uint32_t>(pixels.size()),
+          file.data() + header.size());
+    return file;
+}
+
+auto EncodePng(uint32_t width, uint32_t height,
+               std::span<const uint32_t> pixels, TaskPool& pool)
+    -> std::vector<uint8_t>
+{
+    CheckSize(pixels.size(), width, height);
+#ifdef USE_STB
+    const uint32_t blockCount = (height + PNG_BLOCK_ROWS - 1) / PNG_BLOCK_ROWS;
+    std::vector<DeflateSegment> segments(blockCount);
+    pool.ParallelFor(blockCount,
+                     [&](uint32_t block, uint32_t /*threadIdx*/)
+                     {
+                         const uint32_t y0 = block * PNG_BLOCK_ROWS;
+                         const uint32_t y1 =
+                             std::min(y0 + PNG_BLOCK_ROWS, height);
+                         segments[block] =
+                             EncodePngBlock(width, pixels, y0, y1,
+                                            block + 1 == blockCount);
+                     });
+
+    std::vector<uint8_t> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<uint8_t> ihdr;
+    AppendBe32(ihdr, width);
+    AppendBe32(ihdr, height);
+    ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, not interlaced
+    AppendPngChunk(file, "IHDR", ihdr);
+
+    // One IDAT chunk per block; together they hold a single zlib stream
+    uint32_t adler = 1;
+    for (uint32_t block = 0; block < blockCount; ++block)
+    {
+        DeflateSegment& segment = segments[block];
+        adler = Adler32Combine(adler, segment.adler, segment.rawSize);
+        if (block == 0)
+        {
+            segment.data.insert(segment.data.begin(), segment.header.begin(),
+                                segment.header.end());
+        }
+        if (block + 1 == blockCount)
+            AppendBe32(segment.data, adler);
+        AppendPngChunk(file, "IDAT", segment.data);
+    }
+    AppendPngChunk(file, "IEND", {});
+    return file;
+#else
+    (void)pool;
+    throw std::runtime_error("PNG output needs stb, which was not found at "
+                             "build time; write .ppm or .exr instead");
+#endif
+}
+
+auto EncodeExr(uint32_t width, uint32_t height,
+               std::span<const glm::vec4> pixels, TaskPool& pool)
+    -> std::vector<uint8_t>
+{
+    CheckSize(pixels.size(), width, height);
+    const uint32_t chunkCount = (height + EXR_CHUNK_ROWS - 1) / EXR_CHUNK_ROWS;
+    std::vector<std::vector<uint8_t>> chunks(chunkCount);
+    pool.ParallelFor(chunkCount,
+                     [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                     {
+                         const uint32_t y0 = chunk * EXR_CHUNK_ROWS;
+                         const uint32_t y1 =
+                             std::min(y0 + EXR_CHUNK_ROWS, height);
+                         chunks[chunk] = EncodeExrChunk(width, pixels, y0, y1);
+                     });
+
+    std::vector<uint8_t> file = MakeExrHeader(width, height);
+    uint64_t offset = file.size() + static_cast<uint64_t>(chunkCount) * 8;
+    for (const auto& chunk : chunks)
+    {
+        AppendLe64(file, offset);
+        offset += 8 + chunk.size();
+    }
+    file.reserve(offset);
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        AppendLe32(file, chunk * EXR_CHUNK_ROWS);
+        AppendLe32(file, static_cast<uint32_t>(chunks[chunk].size()));
+        file.insert(file.end(), chunks[chunk].begin(), chunks[chunk].end());
+    }
+    return file;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,225 @@
+#include "io/image_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace pathtracer
+{
+AsyncImageWriter::AsyncImageWriter(uint32_t threadCount,
+                                   uint32_t queueCapacity)
+    : m_capacity(std::max(queueCapacity, 1u)), m_pool(threadCount),
+      m_thread([this] { WriterLoop(); })
+{
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_jobReady.notify_all();
+    m_thread.join();
+}
+
+auto AsyncImageWriter::Submit(const std::filesystem::path& path,
+                              uint32_t width, uint32_t height,
+                              std::vector<uint32_t> pixels) -> void
+{
+    Job job = MakeJob(path, width, height, pixels.size(), false);
+    job.pixels = std::move(pixels);
+    Enqueue(std::move(job), true);
+}
+
+auto AsyncImageWriter::Submit(const std::filesystem::path& path,
+                              uint32_t width, uint32_t height,
+                              std::vector<glm::vec4> radiance) -> void
+{
+    Job job = MakeJob(path, width, height, radiance.size(), true);
+    job.radiance = std::move(radiance);
+    Enqueue(std::move(job), true);
+}
+
+auto AsyncImageWriter::TrySubmit(const std::filesystem::path& path,
+                                 uint32_t width, uint32_t height,
+                                 std::vector<uint32_t> pixels) -> bool
+{
+    Job job = MakeJob(path, width, height, pixels.size(), false);
+    job.pixels = std::move(pixels);
+    return Enqueue(std::move(job), false);
+}
+
+auto AsyncImageWriter::TrySubmit(const std::filesystem::path& path,
+                                 uint32_t width, uint32_t height,
+                                 std::vector<glm::vec4> radiance) -> bool
+{
+    Job job = MakeJob(path, width, height, radiance.size(), true);
+    job.radiance = std::move(radiance);
+    return Enqueue(std::move(job), false);
+}
+
+auto AsyncImageWriter::Flush() -> void
+{
+    std::unique_lock lock(m_mutex);
+    m_jobDone.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+    if (m_error)
+    {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+auto AsyncImageWriter::GetWrittenCount() const -> uint64_t
+{
+    std::lock_guard lock(m_mutex);
+    return m_writtenCount;
+}
+
+auto AsyncImageWriter::GetDroppedCount() const -> uint64_t
+{
+    std::lock_guard lock(m_mutex);
+    return m_droppedCount;
+}
+
+auto AsyncImageWriter::GetLastWriteMs() const -> double
+{
+    std::lock_guard lock(m_mutex);
+    return m_lastWriteMs;
+}
+
+auto AsyncImageWriter::MakeJob(const std::filesystem::path& path,
+                               uint32_t width, uint32_t height,
+                               size_t pixelCount, bool linear) -> Job
+{
+    const ImageFormat format = GetImageFormat(path);
+    if (IsLinearFormat(format) != linear)
+    {
+        throw std::invalid_argument(
+            path.string() + (linear ? " takes resolved 8-bit pixels"
+                                    : " takes linear radiance"));
+    }
+    if (format == ImageFormat::Png && !IsPngSupported())
+    {
+        throw std::runtime_error("PNG output needs stb, which was not found "
+                                 "at build time; write .ppm or .exr instead");
+    }
+    if (width == 0 || height == 0 ||
+        pixelCount != static_cast<size_t>(width) * height)
+    {
+        throw std::invalid_argument(
+            "Image must hold one pixel per image pixel");
+    }
+    return {path, format, width, height, {}, {}};
+}
+
+auto AsyncImageWriter::Enqueue(Job&& job, bool wait) -> bool
+{
+    {
+        std::unique_lock lock(m_mutex);
+        if (wait)
+        {
+            m_jobDone.wait(lock,
+                           [this] { return m_queue.size() < m_capacity; });
+        }
+        else if (m_queue.size() >= m_capacity)
+        {
+            ++m_droppedCount;
+            return false;
+        }
+        m_queue.push_back(std::move(job));
+    }
+    m_jobReady.notify_one();
+    return true;
+}
+
+auto AsyncImageWriter::WriterLoop() -> void
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_jobReady.wait(lock,
+                            [this] { return m_shutdown || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_writing = true;
+        }
+
+        // A slot is free as soon as the job leaves the queue
+        m_jobDone.notify_all();
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        std::exception_ptr error;
+        try
+        {
+            Write(job);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        const double elapsedMs =
+            std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start)
+                .count();
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_writing = false;
+            if (error)
+            {
+                if (!m_error)
+                    m_error = error;
+            }
+            else
+            {
+                ++m_writtenCount;
+                m_lastWriteMs = elapsedMs;
+            }
+        }
+        m_jobDone.notify_all();
+    }
+}
+
+auto AsyncImageWriter::Write(const Job& job) -> void
+{
+    std::vector<uint8_t> encoded;
+    switch (job.format)
+    {
+    case ImageFormat::Ppm:
+        encoded = EncodePpm(job.width, job.height, job.pixels);
+        break;
+    case ImageFormat::Png:
+        encoded = EncodePng(job.width, job.height, job.pixels, m_pool);
+        break;
+    case ImageFormat::Exr:
+        encoded = EncodeExr(job.width, job.height, job.radiance, m_pool);
+        break;
+    }
+
+    std::filesystem::path tempPath = job.path;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open output file " +
+                                     tempPath.string());
+        }
+        file.write(reinterpret_cast<const char*>(encoded.data()),
+                   static_cast<std::streamsize>(encoded.size()));
+        if (!file.flush())
+        {
+            throw std::runtime_error("Failed to write output file " +
+                                     tempPath.string());
+        }
+    }
+    std::filesystem::rename(tempPath, job.path);
+}
+
+} // namespace pathtracer
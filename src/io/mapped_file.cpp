@@ -0,0 +1,139 @@
+#include "io/mapped_file.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pathtracer
+{
+namespace
+{
+[[noreturn]] auto ThrowMapError(const std::filesystem::path& path,
+                                const char* what) -> void
+{
+    throw std::runtime_error(std::string("Failed to ") + what + " " +
+                             path.string());
+}
+} // namespace
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        ThrowMapError(path, "open");
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        ThrowMapError(path, "stat");
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    // The view keeps the mapping, and the mapping the file, alive
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        ThrowMapError(path, "map");
+
+    m_data = static_cast<const char*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (m_data == nullptr)
+        ThrowMapError(path, "map");
+}
+
+auto MappedFile::Unmap() noexcept -> void
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        ThrowMapError(path, "open");
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        ThrowMapError(path, "stat");
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    // The mapping keeps the file alive
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        ThrowMapError(path, "map");
+
+    // Start reading ahead right away; parsing threads touch the whole file
+    madvise(data, m_size, MADV_WILLNEED);
+    m_data = static_cast<const char*>(data);
+}
+
+auto MappedFile::Unmap() noexcept -> void
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+} // namespace pathtracer
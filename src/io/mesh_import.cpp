@@ -0,0 +1,894 @@
+#include "io/mesh_import.h"
+#include "cpu/task_pool.h"
+#include "io/mapped_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// OBJ files are cut into chunks of about this many bytes, extended to the
+/// next line break.
+/// </summary>
+constexpr size_t OBJ_CHUNK_BYTES = 1 << 20;
+
+/// <summary>
+/// PLY records are decoded this many at a time.
+/// </summary>
+constexpr uint32_t PLY_CHUNK_RECORDS = 64 * 1024;
+
+/// <summary>
+/// Without a pool, files smaller than this are parsed on the calling
+/// thread only; starting threads costs more than it saves.
+/// </summary>
+constexpr size_t MIN_PARALLEL_BYTES = 8 * OBJ_CHUNK_BYTES;
+
+/// <summary>
+/// Runs a loop over chunks on the given pool, on a pool of its own for
+/// large files, or on the calling thread.
+/// </summary>
+class ChunkRunner
+{
+  public:
+    ChunkRunner(TaskPool* pool, size_t fileBytes) : m_pool(pool)
+    {
+        if (m_pool == nullptr && fileBytes >= MIN_PARALLEL_BYTES)
+        {
+            m_ownedPool = std::make_unique<TaskPool>();
+            m_pool = m_ownedPool.get();
+        }
+    }
+
+    auto Run(size_t chunkCount, const std::function<void(uint32_t)>& fn)
+        -> void
+    {
+        if (m_pool == nullptr || chunkCount < 2)
+        {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                fn(static_cast<uint32_t>(chunk));
+            }
+            return;
+        }
+        m_pool->ParallelFor(static_cast<uint32_t>(chunkCount),
+                            [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                            { fn(chunk); });
+    }
+
+  private:
+    std::unique_ptr<TaskPool> m_ownedPool;
+    TaskPool* m_pool;
+};
+
+auto FileError(const std::filesystem::path& path, const std::string& what)
+    -> std::runtime_error
+{
+    return std::runtime_error(path.string() + ": " + what);
+}
+
+/// <summary>
+/// Meshes index vertices and triangles with 32 bits.
+/// </summary>
+auto CheckCount(uint64_t count, const std::filesystem::path& path,
+                const char* what) -> uint32_t
+{
+    if (count > UINT32_MAX)
+        throw FileError(path, std::string("too many ") + what);
+    return static_cast<uint32_t>(count);
+}
+
+// OBJ
+
+auto IsBlank(char c) -> bool
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+auto SkipBlanks(const char* p, const char* end) -> const char*
+{
+    while (p < end && IsBlank(*p))
+        ++p;
+    return p;
+}
+
+auto SkipWord(const char* p, const char* end) -> const char*
+{
+    while (p < end && !IsBlank(*p))
+        ++p;
+    return p;
+}
+
+enum class ObjLine
+{
+    Other,
+    Vertex,
+    Face,
+};
+
+/// <summary>
+/// Classifies the line [p, end) and advances p past its keyword. Both
+/// passes go through here, so that they agree on where a line ends: end is
+/// pulled back to the '#' of a trailing comment, if any.
+/// </summary>
+auto ClassifyObjLine(const char*& p, const char*& end) -> ObjLine
+{
+    const auto* comment = static_cast<const char*>(
+        std::memchr(p, '#', static_cast<size_t>(end - p)));
+    if (comment != nullptr)
+        end = comment;
+
+    p = SkipBlanks(p, end);
+    if (end - p < 2 || !IsBlank(p[1]))
+        return ObjLine::Other;
+
+    const char keyword = p[0];
+    p += 2;
+    if (keyword == 'v')
+        return ObjLine::Vertex;
+    if (keyword == 'f')
+        return ObjLine::Face;
+    return ObjLine::Other;
+}
+
+/// <summary>
+/// Calls fn(begin, end) for every line in [begin, end), without the line
+/// break.
+/// </summary>
+template <typename LineFn>
+auto ForEachLine(const char* begin, const char* end, LineFn&& fn) -> void
+{
+    while (begin < end)
+    {
+        const auto* eol = static_cast<const char*>(
+            std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        if (eol == nullptr)
+            eol = end;
+        fn(begin, eol);
+        begin = eol + 1;
+    }
+}
+
+/// <summary>
+/// One piece of an OBJ file: its bytes, what the first pass counted in it
+/// and, after the prefix sum, where its vertices, triangles and lines start
+/// in the whole file.
+/// </summary>
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    uint64_t vertexCount = 0;
+    uint64_t triangleCount = 0;
+    uint64_t lineCount = 0;
+    uint64_t vertexBase = 0;
+    uint64_t triangleBase = 0;
+    uint64_t lineBase = 0;
+};
+
+/// <summary>
+/// Cuts the file into chunks of about OBJ_CHUNK_BYTES that each end with a
+/// line break (or the end of the file).
+/// </summary>
+auto SplitObjChunks(std::string_view file) -> std::vector<ObjChunk>
+{
+    std::vector<ObjChunk> chunks;
+    size_t begin = 0;
+    while (begin < file.size())
+    {
+        size_t end = std::min(begin + OBJ_CHUNK_BYTES, file.size());
+        if (end < file.size())
+        {
+            const size_t eol = file.find('\n', end - 1);
+            end = eol == std::string_view::npos ? file.size() : eol + 1;
+        }
+
+        ObjChunk chunk;
+        chunk.begin = file.data() + begin;
+        chunk.end = file.data() + end;
+        chunks.push_back(chunk);
+        begin = end;
+    }
+    return chunks;
+}
+
+/// <summary>
+/// First pass: counts vertices, fan triangles and lines without parsing
+/// any numbers.
+/// </summary>
+auto CountObjChunk(ObjChunk& chunk) -> void
+{
+    ForEachLine(chunk.begin, chunk.end,
+                [&](const char* p, const char* end)
+                {
+                    ++chunk.lineCount;
+                    const ObjLine type = ClassifyObjLine(p, end);
+                    if (type == ObjLine::Vertex)
+                    {
+                        ++chunk.vertexCount;
+                    }
+                    else if (type == ObjLine::Face)
+                    {
+                        uint64_t corners = 0;
+                        for (p = SkipBlanks(p, end); p < end;
+                             p = SkipBlanks(SkipWord(p, end), end))
+                        {
+                            ++corners;
+                        }
+                        chunk.triangleCount += corners > 2 ? corners - 2 : 0;
+                    }
+                });
+}
+
+auto ParseObjFloat(const char*& p, const char* end, float& value) -> bool
+{
+    p = SkipBlanks(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    const auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc{} || (next < end && !IsBlank(*next)))
+        return false;
+    p = next;
+    return true;
+}
+
+/// <summary>
+/// Second pass: parses the chunk into the mesh at the place the prefix sum
+/// assigned to it.
+/// </summary>
+auto ParseObjChunk(const ObjChunk& chunk, TriangleMesh& mesh,
+                   const std::filesystem::path& path) -> void
+{
+    float* px = mesh.GetPositionX();
+    float* py = mesh.GetPositionY();
+    float* pz = mesh.GetPositionZ();
+    uint32_t* indices = mesh.GetIndices();
+    const auto totalVertices = static_cast<int64_t>(mesh.GetVertexCount());
+
+    uint64_t vertex = chunk.vertexBase;
+    size_t index = static_cast<size_t>(chunk.triangleBase) * 3;
+    uint64_t line = chunk.lineBase;
+    const auto fail = [&](const char* what)
+    {
+        return std::runtime_error(path.string() + ":" +
+                                  std::to_string(line) + ": " + what);
+    };
+
+    ForEachLine(
+        chunk.begin, chunk.end,
+        [&](const char* p, const char* end)
+        {
+            ++line;
+            const ObjLine type = ClassifyObjLine(p, end);
+            if (type == ObjLine::Vertex)
+            {
+                if (!ParseObjFloat(p, end, px[vertex]) ||
+                    !ParseObjFloat(p, end, py[vertex]) ||
+                    !ParseObjFloat(p, end, pz[vertex]))
+                {
+                    throw fail("invalid vertex");
+                }
+                ++vertex;
+            }
+            else if (type == ObjLine::Face)
+            {
+                // Fan around the first corner: (c0, c1, c2), (c0, c2, c3)...
+                uint32_t first = 0;
+                uint32_t previous = 0;
+                uint32_t corners = 0;
+                for (p = SkipBlanks(p, end); p < end;
+                     p = SkipBlanks(SkipWord(p, end), end))
+                {
+                    // Only the position index of v, v/vt, v//vn or v/vt/vn
+                    int64_t objIdx = 0;
+                    const auto [next, error] = std::from_chars(p, end, objIdx);
+                    if (error != std::errc{} ||
+                        (next < end && !IsBlank(*next) && *next != '/'))
+                    {
+                        throw fail("invalid face index");
+                    }
+
+                    // 1-based, or relative to the vertices read so far
+                    const int64_t resolved =
+                        objIdx > 0 ? objIdx - 1
+                                   : static_cast<int64_t>(vertex) + objIdx;
+                    if (objIdx == 0 || resolved < 0 ||
+                        resolved >= totalVertices)
+                    {
+                        throw fail("face references a missing vertex");
+                    }
+
+                    const auto current = static_cast<uint32_t>(resolved);
+                    if (corners == 0)
+                    {
+                        first = current;
+                    }
+                    else if (corners >= 2)
+                    {
+                        indices[index++] = first;
+                        indices[index++] = previous;
+                        indices[index++] = current;
+                    }
+                    previous = current;
+                    ++corners;
+                }
+                if (corners < 3)
+                    throw fail("face has fewer than 3 vertices");
+            }
+        });
+}
+
+// PLY
+
+enum class PlyType : uint8_t
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64,
+};
+
+auto ParsePlyType(std::string_view name, const std::filesystem::path& path)
+    -> PlyType
+{
+    if (name == "char" || name == "int8")
+        return PlyType::Int8;
+    if (name == "uchar" || name == "uint8")
+        return PlyType::UInt8;
+    if (name == "short" || name == "int16")
+        return PlyType::Int16;
+    if (name == "ushort" || name == "uint16")
+        return PlyType::UInt16;
+    if (name == "int" || name == "int32")
+        return PlyType::Int32;
+    if (name == "uint" || name == "uint32")
+        return PlyType::UInt32;
+    if (name == "float" || name == "float32")
+        return PlyType::Float32;
+    if (name == "double" || name == "float64")
+        return PlyType::Float64;
+    throw FileError(path, "unknown PLY type " + std::string(name));
+}
+
+auto GetPlyTypeSize(PlyType type) -> uint32_t
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    case PlyType::Float64:
+        return 8;
+    }
+    return 0;
+}
+
+/// <summary>
+/// Reads a T stored at p, which need not be aligned, in the file's byte
+/// order.
+/// </summary>
+template <typename T> auto LoadPlyValue(const char* p, bool swap) -> T
+{
+    using Bits = std::conditional_t<
+        sizeof(T) == 1, uint8_t,
+        std::conditional_t<
+            sizeof(T) == 2, uint16_t,
+            std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+    Bits bits;
+    std::memcpy(&bits, p, sizeof(bits));
+    if (swap)
+        bits = std::byteswap(bits);
+    return std::bit_cast<T>(bits);
+}
+
+/// <summary>
+/// Reads a value of the given PLY type and converts it to R.
+/// </summary>
+template <typename R>
+auto ReadPlyValue(const char* p, PlyType type, bool swap) -> R
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+        return static_cast<R>(LoadPlyValue<int8_t>(p, swap));
+    case PlyType::UInt8:
+        return static_cast<R>(LoadPlyValue<uint8_t>(p, swap));
+    case PlyType::Int16:
+        return static_cast<R>(LoadPlyValue<int16_t>(p, swap));
+    case PlyType::UInt16:
+        return static_cast<R>(LoadPlyValue<uint16_t>(p, swap));
+    case PlyType::Int32:
+        return static_cast<R>(LoadPlyValue<int32_t>(p, swap));
+    case PlyType::UInt32:
+        return static_cast<R>(LoadPlyValue<uint32_t>(p, swap));
+    case PlyType::Float32:
+        return static_cast<R>(LoadPlyValue<float>(p, swap));
+    case PlyType::Float64:
+        return static_cast<R>(LoadPlyValue<double>(p, swap));
+    }
+    return R{};
+}
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool isList = false;
+    PlyType countType = PlyType::UInt8;
+};
+
+struct PlyElement
+{
+    std::string name;
+    uint64_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+/// <summary>
+/// Where the data the importer needs sits in the file, and how to read it.
+/// </summary>
+struct PlyLayout
+{
+    bool swap = false;
+
+    size_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t vertexStride = 0;
+    uint32_t coordOffset[3] = {};
+    PlyType coordType[3] = {};
+
+    // A face record is listOffset bytes of scalar properties, the corner
+    // count, the corner indices and trailingBytes of scalar properties
+    size_t faceOffset = 0;
+    uint64_t faceCount = 0;
+    uint32_t listOffset = 0;
+    uint32_t trailingBytes = 0;
+    PlyType countType = PlyType::UInt8;
+    PlyType indexType = PlyType::Int32;
+};
+
+auto SplitWords(std::string_view line) -> std::vector<std::string_view>
+{
+    std::vector<std::string_view> words;
+    const char* p = line.data();
+    const char* end = p + line.size();
+    for (p = SkipBlanks(p, end); p < end; p = SkipBlanks(p, end))
+    {
+        const char* wordEnd = SkipWord(p, end);
+        words.emplace_back(p, static_cast<size_t>(wordEnd - p));
+        p = wordEnd;
+    }
+    return words;
+}
+
+/// <summary>
+/// Size of one record of the element, or 0 if it contains lists and its
+/// records vary in size.
+/// </summary>
+auto GetFixedRecordSize(const PlyElement& element) -> uint32_t
+{
+    uint32_t size = 0;
+    for (const PlyProperty& property : element.properties)
+    {
+        if (property.isList)
+            return 0;
+        size += GetPlyTypeSize(property.type);
+    }
+    return size;
+}
+
+auto ParsePlyVertices(const PlyElement& element, size_t offset,
+                      PlyLayout& layout, const std::filesystem::path& path)
+    -> void
+{
+    layout.vertexOffset = offset;
+    layout.vertexCount = CheckCount(element.count, path, "vertices");
+
+    const char* axes[3] = {"x", "y", "z"};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        uint32_t propertyOffset = 0;
+        bool axisFound = false;
+        for (const PlyProperty& property : element.properties)
+        {
+            if (property.name == axes[axis])
+            {
+                layout.coordOffset[axis] = propertyOffset;
+                layout.coordType[axis] = property.type;
+                axisFound = true;
+            }
+            propertyOffset += GetPlyTypeSize(property.type);
+        }
+        if (!axisFound)
+            throw FileError(path, "PLY vertices lack x, y or z");
+    }
+}
+
+auto ParsePlyFaces(const PlyElement& element, size_t offset,
+                   PlyLayout& layout, const std::filesystem::path& path)
+    -> void
+{
+    layout.faceOffset = offset;
+    layout.faceCount = element.count;
+
+    bool listFound = false;
+    for (const PlyProperty& property : element.properties)
+    {
+        const bool isIndices = property.name == "vertex_indices" ||
+                               property.name == "vertex_index";
+        if (property.isList && (!isIndices || listFound))
+            throw FileError(path, "unsupported PLY face layout");
+
+        if (property.isList)
+        {
+            layout.countType = property.countType;
+            layout.indexType = property.type;
+            listFound = true;
+        }
+        else if (listFound)
+        {
+            layout.trailingBytes += GetPlyTypeSize(property.type);
+        }
+        else
+        {
+            layout.listOffset += GetPlyTypeSize(property.type);
+        }
+    }
+    if (!listFound)
+        throw FileError(path, "PLY faces lack vertex_indices");
+}
+
+auto ParsePlyHeader(std::string_view file, const std::filesystem::path& path)
+    -> PlyLayout
+{
+    size_t pos = 0;
+    const auto nextLine = [&]() -> std::string_view
+    {
+        const size_t eol = file.find('\n', pos);
+        if (eol == std::string_view::npos)
+            throw FileError(path, "PLY header has no end_header");
+        std::string_view line = file.substr(pos, eol - pos);
+        pos = eol + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        return line;
+    };
+
+    if (nextLine() != "ply")
+        throw FileError(path, "not a PLY file");
+
+    PlyLayout layout;
+    std::vector<PlyElement> elements;
+    bool formatFound = false;
+    for (std::string_view line = nextLine(); line != "end_header";
+         line = nextLine())
+    {
+        const std::vector<std::string_view> words = SplitWords(line);
+        if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
+            continue;
+
+        if (words[0] == "format" && words.size() >= 2)
+        {
+            if (words[1] == "ascii")
+                throw FileError(path, "ASCII PLY is not supported");
+            if (words[1] != "binary_little_endian" &&
+                words[1] != "binary_big_endian")
+            {
+                throw FileError(path, "unknown PLY format");
+            }
+            const bool bigEndian = words[1] == "binary_big_endian";
+            layout.swap =
+                bigEndian != (std::endian::native == std::endian::big);
+            formatFound = true;
+        }
+        else if (words[0] == "element" && words.size() == 3)
+        {
+            PlyElement element;
+            element.name = words[1];
+            const auto [next, error] = std::from_chars(
+                words[2].data(), words[2].data() + words[2].size(),
+                element.count);
+            if (error != std::errc{})
+                throw FileError(path, "invalid PLY element count");
+            elements.push_back(std::move(element));
+        }
+        else if (words[0] == "property" && !elements.empty() &&
+                 words.size() == 3)
+        {
+            elements.back().properties.push_back(
+                {std::string(words[2]), ParsePlyType(words[1], path)});
+        }
+        else if (words[0] == "property" && !elements.empty() &&
+                 words.size() == 5 && words[1] == "list")
+        {
+            elements.back().properties.push_back(
+                {std::string(words[4]), ParsePlyType(words[3], path), true,
+                 ParsePlyType(words[2], path)});
+        }
+        else
+        {
+            throw FileError(path, "invalid PLY header line: " +
+                                      std::string(line));
+        }
+    }
+    if (!formatFound)
+        throw FileError(path, "PLY header has no format");
+
+    // Elements come one after another, so everything before the faces
+    // must have records of a known size to find where the vertices and the
+    // faces start. Elements after the faces are not needed.
+    size_t offset = pos;
+    bool vertexFound = false;
+    bool faceFound = false;
+    for (const PlyElement& element : elements)
+    {
+        if (element.name == "face")
+        {
+            if (!vertexFound)
+                throw FileError(path, "PLY faces precede the vertices");
+            ParsePlyFaces(element, offset, layout, path);
+            faceFound = true;
+            break;
+        }
+
+        const uint32_t recordSize = GetFixedRecordSize(element);
+        if (recordSize == 0)
+        {
+            throw FileError(path, "PLY element " + element.name +
+                                      " precedes the faces and has lists");
+        }
+        if (element.name == "vertex")
+        {
+            ParsePlyVertices(element, offset, layout, path);
+            layout.vertexStride = recordSize;
+            vertexFound = true;
+        }
+        offset += element.count * recordSize;
+    }
+    if (!vertexFound)
+        throw FileError(path, "PLY file has no vertex element");
+    if (offset > file.size())
+        throw FileError(path, "PLY file is truncated");
+    if (!faceFound)
+        layout.faceOffset = offset;
+    return layout;
+}
+} // namespace
+
+auto LoadObj(const std::filesystem::path& path, TaskPool* pool)
+    -> TriangleMesh
+{
+    const MappedFile file(path);
+    ChunkRunner runner(pool, file.GetSize());
+
+    // Count, then give every chunk its place with a prefix sum
+    std::vector<ObjChunk> chunks = SplitObjChunks(file.GetView());
+    runner.Run(chunks.size(),
+               [&](uint32_t chunk) { CountObjChunk(chunks[chunk]); });
+
+    uint64_t vertexCount = 0;
+    uint64_t triangleCount = 0;
+    uint64_t lineCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.vertexBase = vertexCount;
+        chunk.triangleBase = triangleCount;
+        chunk.lineBase = lineCount;
+        vertexCount += chunk.vertexCount;
+        triangleCount += chunk.triangleCount;
+        lineCount += chunk.lineCount;
+    }
+
+    TriangleMesh mesh;
+    mesh.Resize(CheckCount(vertexCount, path, "vertices"),
+                CheckCount(triangleCount, path, "triangles"));
+    runner.Run(chunks.size(), [&](uint32_t chunk)
+               { ParseObjChunk(chunks[chunk], mesh, path); });
+    return mesh;
+}
+
+auto LoadPly(const std::filesystem::path& path, TaskPool* pool)
+    -> TriangleMesh
+{
+    const MappedFile file(path);
+    const PlyLayout layout = ParsePlyHeader(file.GetView(), path);
+    const char* data = file.GetData();
+    const size_t fileSize = file.GetSize();
+    const bool swap = layout.swap;
+    ChunkRunner runner(pool, fileSize);
+
+    const auto chunkCount = [](uint64_t records) -> size_t
+    { return (records + PLY_CHUNK_RECORDS - 1) / PLY_CHUNK_RECORDS; };
+
+    // Faces of three corners have a fixed size; assume that is all there
+    // is, and fall back to walking the faces if the file disagrees
+    const uint32_t countSize = GetPlyTypeSize(layout.countType);
+    const uint32_t indexSize = GetPlyTypeSize(layout.indexType);
+    const uint32_t triangleStride =
+        layout.listOffset + countSize + 3 * indexSize + layout.trailingBytes;
+    const bool fitsTriangles =
+        layout.faceOffset + layout.faceCount * triangleStride <= fileSize;
+
+    TriangleMesh mesh;
+    mesh.Resize(layout.vertexCount,
+                fitsTriangles
+                    ? CheckCount(layout.faceCount, path, "triangles")
+                    : 0);
+
+    float* coords[3] = {mesh.GetPositionX(), mesh.GetPositionY(),
+                        mesh.GetPositionZ()};
+    runner.Run(chunkCount(layout.vertexCount),
+               [&](uint32_t chunk)
+               {
+                   const uint32_t begin = chunk * PLY_CHUNK_RECORDS;
+                   const uint32_t end = std::min(begin + PLY_CHUNK_RECORDS,
+                                                 layout.vertexCount);
+                   const char* record =
+                       data + layout.vertexOffset +
+                       static_cast<size_t>(begin) * layout.vertexStride;
+                   for (uint32_t i = begin; i < end; ++i)
+                   {
+                       for (int axis = 0; axis < 3; ++axis)
+                       {
+                           coords[axis][i] = ReadPlyValue<float>(
+                               record + layout.coordOffset[axis],
+                               layout.coordType[axis], swap);
+                       }
+                       record += layout.vertexStride;
+                   }
+               });
+
+    // Writes the fan of one face's corners and returns the record's end
+    const uint32_t vertexCount = layout.vertexCount;
+    const auto decodeFace = [&](const char* record, int64_t corners,
+                                uint32_t* out) -> const char*
+    {
+        const char* list = record + layout.listOffset + countSize;
+        uint32_t first = 0;
+        uint32_t previous = 0;
+        for (int64_t corner = 0; corner < corners; ++corner)
+        {
+            const auto idx = ReadPlyValue<int64_t>(
+                list + corner * indexSize, layout.indexType, swap);
+            if (idx < 0 || idx >= vertexCount)
+                throw FileError(path, "face references a missing vertex");
+
+            const auto current = static_cast<uint32_t>(idx);
+            if (corner == 0)
+            {
+                first = current;
+            }
+            else if (corner >= 2)
+            {
+                *out++ = first;
+                *out++ = previous;
+                *out++ = current;
+            }
+            previous = current;
+        }
+        return list + corners * indexSize + layout.trailingBytes;
+    };
+
+    const auto readCorners = [&](const char* record) -> int64_t
+    {
+        return ReadPlyValue<int64_t>(record + layout.listOffset,
+                                     layout.countType, swap);
+    };
+
+    std::atomic<bool> allTriangles = fitsTriangles;
+    if (fitsTriangles)
+    {
+        uint32_t* indices = mesh.GetIndices();
+        runner.Run(
+            chunkCount(layout.faceCount),
+            [&](uint32_t chunk)
+            {
+                const uint64_t begin = uint64_t{chunk} * PLY_CHUNK_RECORDS;
+                const uint64_t end = std::min(begin + PLY_CHUNK_RECORDS,
+                                              layout.faceCount);
+                const char* record =
+                    data + layout.faceOffset + begin * triangleStride;
+                for (uint64_t face = begin; face < end; ++face)
+                {
+                    if (readCorners(record) != 3)
+                    {
+                        allTriangles = false;
+                        return;
+                    }
+                    decodeFace(record, 3, indices + face * 3);
+                    record += triangleStride;
+                }
+            });
+    }
+    if (allTriangles)
+        return mesh;
+
+    // Polygons: one pass over the corner counts finds where each chunk of
+    // faces starts and, by prefix sum, where its triangles go
+    struct FaceChunk
+    {
+        size_t offset;
+        uint64_t triangleBase;
+    };
+    std::vector<FaceChunk> faceChunks;
+    faceChunks.reserve(chunkCount(layout.faceCount));
+    size_t offset = layout.faceOffset;
+    uint64_t triangleCount = 0;
+    for (uint64_t face = 0; face < layout.faceCount; ++face)
+    {
+        if (face % PLY_CHUNK_RECORDS == 0)
+            faceChunks.push_back({offset, triangleCount});
+        if (offset + layout.listOffset + countSize > fileSize)
+            throw FileError(path, "PLY file is truncated");
+
+        const int64_t corners = readCorners(data + offset);
+        if (corners < 3)
+            throw FileError(path, "face has fewer than 3 vertices");
+        triangleCount += static_cast<uint64_t>(corners - 2);
+        offset += layout.listOffset + countSize +
+                  static_cast<size_t>(corners) * indexSize +
+                  layout.trailingBytes;
+    }
+    if (offset > fileSize)
+        throw FileError(path, "PLY file is truncated");
+
+    mesh.Resize(layout.vertexCount,
+                CheckCount(triangleCount, path, "triangles"));
+    uint32_t* indices = mesh.GetIndices();
+    runner.Run(faceChunks.size(),
+               [&](uint32_t chunk)
+               {
+                   const uint64_t begin = uint64_t{chunk} * PLY_CHUNK_RECORDS;
+                   const uint64_t end = std::min(begin + PLY_CHUNK_RECORDS,
+                                                 layout.faceCount);
+                   const char* record = data + faceChunks[chunk].offset;
+                   uint32_t* out = indices + faceChunks[chunk].triangleBase * 3;
+                   for (uint64_t face = begin; face < end; ++face)
+                   {
+                       const int64_t corners = readCorners(record);
+                       record = decodeFace(record, corners, out);
+                       out += (corners - 2) * 3;
+                   }
+               });
+    return mesh;
+}
+
+auto LoadMesh(const std::filesystem::path& path, TaskPool* pool)
+    -> TriangleMesh
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".obj")
+        return LoadObj(path, pool);
+    if (extension == ".ply")
+        return LoadPly(path, pool);
+    throw std::invalid_argument("Unsupported mesh format: " + path.string());
+}
+
+} // namespace pathtracer
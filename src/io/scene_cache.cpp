@@ -0,0 +1,843 @@
+#include "io/scene_cache.h"
+#include "cpu/task_pool.h"
+#include "cpu/triangle_intersection.h"
+#include "io/mapped_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr char CACHE_MAGIC[8] = {'P', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+
+/// <summary>
+/// Written as is, so a cache from a machine of the other byte order reads
+/// back differently and is rejected.
+/// </summary>
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/// <summary>
+/// Every section starts on a multiple of this from the start of the file,
+/// and mappings start on a page, so arrays are as aligned in the mapping
+/// as in memory the structures allocate themselves.
+/// </summary>
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+/// <summary>
+/// Files are hashed in chunks of this many bytes.
+/// </summary>
+constexpr size_t HASH_CHUNK_BYTES = 4 << 20;
+
+/// <summary>
+/// Without a pool, less than this much data is hashed on the calling
+/// thread only.
+/// </summary>
+constexpr size_t MIN_PARALLEL_HASH_BYTES = 4 * HASH_CHUNK_BYTES;
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t contentHash;
+    uint32_t sourceCount;
+    uint32_t sectionCount;
+};
+
+/// <summary>
+/// Size and modification time of a source when the cache was last
+/// validated, to skip hashing sources that were not touched.
+/// </summary>
+struct SourceStamp
+{
+    uint64_t size;
+    int64_t modified;
+};
+
+enum class SectionKind : uint32_t
+{
+    MaterialAlbedo,
+    MaterialEmission,
+    MaterialRoughness,
+    SphereCenterX,
+    SphereCenterY,
+    SphereCenterZ,
+    SphereRadiusSq,
+    SphereMaterial,
+    TriangleV0,
+    TriangleV1,
+    TriangleV2,
+    TriangleMaterial,
+    InstanceGeometry,
+    InstanceTransform,
+    InstanceMaterial,
+    MeshInfo,
+    MeshPositionX,
+    MeshPositionY,
+    MeshPositionZ,
+    MeshIndices,
+    MeshBvhNodes,
+    MeshBvhPrimIndices,
+    MeshWideNodes,
+    MeshWidePrimIndices,
+    MeshTriangleGroups,
+};
+
+/// <summary>
+/// Directory entry of one array. item is the mesh for per-mesh sections.
+/// </summary>
+struct Section
+{
+    SectionKind kind;
+    uint32_t item;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/// <summary>
+/// Everything about a mesh and its BVH that is not an array.
+/// </summary>
+struct MeshInfo
+{
+    uint32_t material;
+    TriangleLeafLayout layout;
+    BvhBuildOptions options;
+    BvhStats stats;
+};
+
+static_assert(std::is_trivially_copyable_v<MeshInfo> &&
+                  std::is_trivially_copyable_v<MeshBvh8::Group> &&
+                  std::is_trivially_copyable_v<Bvh8::Node>,
+              "Cached structures are copied as bytes");
+
+auto AlignUp(uint64_t value) -> uint64_t
+{
+    return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+auto Rotl(uint64_t x, int r) -> uint64_t
+{
+    return std::rotl(x, r);
+}
+
+/// <summary>
+/// Final avalanche of MurmurHash3.
+/// </summary>
+auto Mix(uint64_t h) -> uint64_t
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/// <summary>
+/// Hashes bytes with four independent multiply-rotate lanes over 8-byte
+/// words, in the manner of xxHash64, so it runs at memory speed.
+/// </summary>
+auto HashBytes(const char* data, size_t size, uint64_t seed) -> uint64_t
+{
+    constexpr uint64_t P1 = 0x9e3779b185ebca87ull;
+    constexpr uint64_t P2 = 0xc2b2ae3d27d4eb4full;
+    const auto round = [](uint64_t acc, uint64_t word)
+    { return Rotl(acc + word * P2, 31) * P1; };
+    const auto load = [](const char* p)
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word;
+    };
+
+    uint64_t lanes[4] = {seed + P1 + P2, seed + P2, seed, seed - P1};
+    size_t pos = 0;
+    for (; pos + 32 <= size; pos += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            lanes[lane] = round(lanes[lane], load(data + pos + lane * 8));
+        }
+    }
+    for (; pos + 8 <= size; pos += 8)
+    {
+        lanes[0] = round(lanes[0], load(data + pos));
+    }
+    if (pos < size)
+    {
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + pos, size - pos);
+        lanes[1] = round(lanes[1], tail);
+    }
+
+    uint64_t h = size;
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        h = Mix(h ^ Rotl(lanes[lane], lane * 16 + 1));
+    }
+    return h;
+}
+
+/// <summary>
+/// Fills info for a mesh. Padding, timings and the build's thread count
+/// are zero, so the same scene always writes the same bytes.
+/// </summary>
+auto SetMeshInfo(uint32_t material, const MeshBvh8& bvh, MeshInfo& info)
+    -> void
+{
+    std::memset(static_cast<void*>(&info), 0, sizeof(info));
+    info.material = material;
+    info.layout = bvh.GetLayout();
+    info.options = bvh.GetBvh().GetOptions();
+    info.options.threadCount = 0;
+
+    // Member by member, as copying the struct may not copy its padding
+    const BvhStats& stats = bvh.GetBvh().GetStats();
+    info.stats.nodeCount = stats.nodeCount;
+    info.stats.leafCount = stats.leafCount;
+    info.stats.maxDepth = stats.maxDepth;
+    info.stats.maxLeafPrims = stats.maxLeafPrims;
+    info.stats.sahCost = stats.sahCost;
+}
+
+auto GetStamp(const std::filesystem::path& path) -> SourceStamp
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    const auto modified = std::filesystem::last_write_time(path, error);
+    if (error)
+        return {UINT64_MAX, 0};
+    return {static_cast<uint64_t>(size),
+            static_cast<int64_t>(modified.time_since_epoch().count())};
+}
+
+/// <summary>
+/// Arrays to write, in order, before their offsets are known.
+/// </summary>
+class SectionWriter
+{
+  public:
+    template <typename T, typename Alloc>
+    auto Add(SectionKind kind, uint32_t item,
+             const std::vector<T, Alloc>& values) -> void
+    {
+        Add(kind, item, values.data(), values.size() * sizeof(T));
+    }
+
+    auto Add(SectionKind kind, uint32_t item, const void* data, size_t size)
+        -> void
+    {
+        m_sections.push_back({kind, item, 0, size});
+        m_data.push_back(data);
+    }
+
+    /// <summary>
+    /// Lays the sections out after the header, stamps and directory and
+    /// writes the whole file.
+    /// </summary>
+    auto Write(std::ofstream& file, const CacheHeader& header,
+               const std::vector<SourceStamp>& stamps) -> void
+    {
+        uint64_t offset = AlignUp(sizeof(CacheHeader) +
+                                  stamps.size() * sizeof(SourceStamp) +
+                                  m_sections.size() * sizeof(Section));
+        for (Section& section : m_sections)
+        {
+            section.offset = offset;
+            offset = AlignUp(offset + section.size);
+        }
+
+        WriteBytes(file, &header, sizeof(header));
+        WriteBytes(file, stamps.data(), stamps.size() * sizeof(SourceStamp));
+        WriteBytes(file, m_sections.data(),
+                   m_sections.size() * sizeof(Section));
+        for (size_t i = 0; i < m_sections.size(); ++i)
+        {
+            Pad(file, m_sections[i].offset);
+            WriteBytes(file, m_data[i], m_sections[i].size);
+        }
+    }
+
+    auto GetCount() const noexcept -> uint32_t
+    {
+        return static_cast<uint32_t>(m_sections.size());
+    }
+
+  private:
+    static auto WriteBytes(std::ofstream& file, const void* data, size_t size)
+        -> void
+    {
+        file.write(static_cast<const char*>(data),
+                   static_cast<std::streamsize>(size));
+    }
+
+    static auto Pad(std::ofstream& file, uint64_t offset) -> void
+    {
+        static constexpr char ZEROS[SECTION_ALIGNMENT] = {};
+        const auto pos = static_cast<uint64_t>(file.tellp());
+        WriteBytes(file, ZEROS, static_cast<size_t>(offset - pos));
+    }
+
+    std::vector<Section> m_sections;
+    std::vector<const void*> m_data;
+};
+
+/// <summary>
+/// Sections of a mapped cache file, looked up by kind and item.
+/// </summary>
+class SectionReader
+{
+  public:
+    SectionReader(const MappedFile& file, const Section* sections,
+                  uint32_t count)
+        : m_file(file)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Section& section = sections[i];
+            if (section.offset > file.GetSize() ||
+                section.size > file.GetSize() - section.offset)
+            {
+                m_valid = false;
+                return;
+            }
+            m_sections.emplace(Key(section.kind, section.item), section);
+        }
+    }
+
+    auto IsValid() const noexcept -> bool
+    {
+        return m_valid;
+    }
+
+    auto Contains(SectionKind kind, uint32_t item) const -> bool
+    {
+        return m_sections.contains(Key(kind, item));
+    }
+
+    /// <summary>
+    /// Copies a section into values. Returns false if it is missing or not
+    /// a whole number of elements.
+    /// </summary>
+    template <typename T, typename Alloc>
+    auto Read(SectionKind kind, uint32_t item,
+              std::vector<T, Alloc>& values) const -> bool
+    {
+        const auto it = m_sections.find(Key(kind, item));
+        if (it == m_sections.end() || it->second.size % sizeof(T) != 0)
+            return false;
+
+        values.resize(static_cast<size_t>(it->second.size / sizeof(T)));
+        if (!values.empty())
+        {
+            std::memcpy(values.data(), m_file.GetData() + it->second.offset,
+                        static_cast<size_t>(it->second.size));
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Number of elements of type T in a section, or nullopt if it is
+    /// missing or not a whole number of elements.
+    /// </summary>
+    template <typename T>
+    auto GetCount(SectionKind kind, uint32_t item) const
+        -> std::optional<size_t>
+    {
+        const auto it = m_sections.find(Key(kind, item));
+        if (it == m_sections.end() || it->second.size % sizeof(T) != 0)
+            return std::nullopt;
+        return static_cast<size_t>(it->second.size / sizeof(T));
+    }
+
+    /// <summary>
+    /// Copies a section of exactly count elements straight into values.
+    /// </summary>
+    template <typename T>
+    auto Read(SectionKind kind, uint32_t item, T* values, size_t count) const
+        -> bool
+    {
+        const auto it = m_sections.find(Key(kind, item));
+        if (it == m_sections.end() || it->second.size != count * sizeof(T))
+            return false;
+        if (count > 0)
+        {
+            std::memcpy(values, m_file.GetData() + it->second.offset,
+                        count * sizeof(T));
+        }
+        return true;
+    }
+
+    template <typename T>
+    auto Read(SectionKind kind, uint32_t item, T& value) const -> bool
+    {
+        const auto it = m_sections.find(Key(kind, item));
+        if (it == m_sections.end() || it->second.size != sizeof(T))
+            return false;
+        std::memcpy(&value, m_file.GetData() + it->second.offset, sizeof(T));
+        return true;
+    }
+
+  private:
+    static auto Key(SectionKind kind, uint32_t item) -> uint64_t
+    {
+        return (static_cast<uint64_t>(kind) << 32) | item;
+    }
+
+    const MappedFile& m_file;
+    std::unordered_map<uint64_t, Section> m_sections;
+    bool m_valid = true;
+};
+
+/// <summary>
+/// Reads the mesh, and the BVH attached to it, stored under item meshIdx.
+/// </summary>
+auto ReadMesh(const SectionReader& reader, uint32_t meshIdx, Scene& scene)
+    -> bool
+{
+    // A later Bvh::Update() may rebuild with the cached options, so they
+    // must be ones Build() accepts
+    MeshInfo info{};
+    const std::optional<size_t> vertexCount =
+        reader.GetCount<float>(SectionKind::MeshPositionX, meshIdx);
+    const std::optional<size_t> indexCount =
+        reader.GetCount<uint32_t>(SectionKind::MeshIndices, meshIdx);
+    if (!reader.Read(SectionKind::MeshInfo, meshIdx, info) || !vertexCount ||
+        !indexCount || *indexCount % 3 != 0 ||
+        *vertexCount > std::numeric_limits<uint32_t>::max() ||
+        *indexCount / 3 > std::numeric_limits<uint32_t>::max() ||
+        info.material >= scene.GetMaterialCount() ||
+        !info.options.IsValid() || info.options.threadCount != 0)
+    {
+        return false;
+    }
+
+    // Straight from the file into the mesh's arrays
+    TriangleMesh mesh;
+    mesh.Resize(static_cast<uint32_t>(*vertexCount),
+                static_cast<uint32_t>(*indexCount / 3));
+    if (!reader.Read(SectionKind::MeshPositionX, meshIdx,
+                     mesh.GetPositionX(), *vertexCount) ||
+        !reader.Read(SectionKind::MeshPositionY, meshIdx,
+                     mesh.GetPositionY(), *vertexCount) ||
+        !reader.Read(SectionKind::MeshPositionZ, meshIdx,
+                     mesh.GetPositionZ(), *vertexCount) ||
+        !reader.Read(SectionKind::MeshIndices, meshIdx, mesh.GetIndices(),
+                     *indexCount))
+    {
+        return false;
+    }
+    const uint32_t* indices = mesh.GetIndices();
+    for (size_t i = 0; i < *indexCount; ++i)
+    {
+        if (indices[i] >= *vertexCount)
+            return false;
+    }
+
+    Bvh::NodeArray nodes;
+    std::vector<uint32_t> primIndices;
+    Bvh8::NodeArray wideNodes;
+    std::vector<uint32_t> widePrimIndices;
+    MeshBvh8::GroupArray groups;
+    if (!reader.Read(SectionKind::MeshBvhNodes, meshIdx, nodes) ||
+        !reader.Read(SectionKind::MeshBvhPrimIndices, meshIdx, primIndices) ||
+        !reader.Read(SectionKind::MeshWideNodes, meshIdx, wideNodes) ||
+        !reader.Read(SectionKind::MeshWidePrimIndices, meshIdx,
+                     widePrimIndices) ||
+        !reader.Read(SectionKind::MeshTriangleGroups, meshIdx, groups))
+    {
+        return false;
+    }
+
+    Bvh bvh;
+    bvh.Assign(std::move(nodes), std::move(primIndices), info.options,
+               info.stats);
+    Bvh8 wide;
+    wide.Assign(std::move(wideNodes), std::move(widePrimIndices));
+    auto meshBvh = std::make_shared<MeshBvh8>();
+    meshBvh->Assign(std::move(bvh), std::move(wide), std::move(groups),
+                    info.layout);
+    if (!meshBvh->IsValid(mesh.GetTriangleCount()))
+        return false;
+
+    const MeshHandle handle = scene.AddMesh(
+        std::move(mesh), scene.GetMaterialHandle(info.material));
+    scene.SetMeshBvh(handle, std::move(meshBvh));
+    return true;
+}
+
+/// <summary>
+/// Rebuilds the scene from the sections. Returns false if the cache is
+/// inconsistent.
+/// </summary>
+auto ReadScene(const SectionReader& reader, Scene& scene) -> bool
+{
+    std::vector<color> albedo;
+    std::vector<color> emission;
+    std::vector<float> roughness;
+    if (!reader.Read(SectionKind::MaterialAlbedo, 0, albedo) ||
+        !reader.Read(SectionKind::MaterialEmission, 0, emission) ||
+        !reader.Read(SectionKind::MaterialRoughness, 0, roughness) ||
+        albedo.empty() || emission.size() != albedo.size() ||
+        roughness.size() != albedo.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < albedo.size(); ++i)
+    {
+        const Material material{albedo[i], emission[i], roughness[i]};
+        if (i == 0)
+            scene.SetMaterial(scene.GetMaterialHandle(0), material);
+        else
+            scene.AddMaterial(material);
+    }
+    const uint32_t materialCount = scene.GetMaterialCount();
+
+    std::vector<float> cx;
+    std::vector<float> cy;
+    std::vector<float> cz;
+    std::vector<float> radiusSq;
+    std::vector<uint32_t> sphereMaterials;
+    if (!reader.Read(SectionKind::SphereCenterX, 0, cx) ||
+        !reader.Read(SectionKind::SphereCenterY, 0, cy) ||
+        !reader.Read(SectionKind::SphereCenterZ, 0, cz) ||
+        !reader.Read(SectionKind::SphereRadiusSq, 0, radiusSq) ||
+        !reader.Read(SectionKind::SphereMaterial, 0, sphereMaterials) ||
+        cy.size() != cx.size() || cz.size() != cx.size() ||
+        radiusSq.size() != cx.size() || sphereMaterials.size() != cx.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < cx.size(); ++i)
+    {
+        if (sphereMaterials[i] >= materialCount)
+            return false;
+        // sqrt(r * r) rounds back to exactly r, so the buffer ends up with
+        // the same radius squared
+        scene.AddSphere({cx[i], cy[i], cz[i]}, std::sqrt(radiusSq[i]),
+                        scene.GetMaterialHandle(sphereMaterials[i]));
+    }
+
+    std::vector<glm::vec3> v0;
+    std::vector<glm::vec3> v1;
+    std::vector<glm::vec3> v2;
+    std::vector<uint32_t> triangleMaterials;
+    if (!reader.Read(SectionKind::TriangleV0, 0, v0) ||
+        !reader.Read(SectionKind::TriangleV1, 0, v1) ||
+        !reader.Read(SectionKind::TriangleV2, 0, v2) ||
+        !reader.Read(SectionKind::TriangleMaterial, 0, triangleMaterials) ||
+        v1.size() != v0.size() || v2.size() != v0.size() ||
+        triangleMaterials.size() != v0.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < v0.size(); ++i)
+    {
+        if (triangleMaterials[i] >= materialCount)
+            return false;
+        scene.AddTriangle(v0[i], v1[i], v2[i],
+                          scene.GetMaterialHandle(triangleMaterials[i]));
+    }
+
+    for (uint32_t meshIdx = 0;
+         reader.Contains(SectionKind::MeshInfo, meshIdx); ++meshIdx)
+    {
+        if (!ReadMesh(reader, meshIdx, scene))
+            return false;
+    }
+
+    // After the meshes they place
+    std::vector<uint32_t> geometry;
+    std::vector<glm::mat4> transforms;
+    std::vector<uint32_t> instanceMaterials;
+    if (!reader.Read(SectionKind::InstanceGeometry, 0, geometry) ||
+        !reader.Read(SectionKind::InstanceTransform, 0, transforms) ||
+        !reader.Read(SectionKind::InstanceMaterial, 0, instanceMaterials) ||
+        transforms.size() != geometry.size() ||
+        instanceMaterials.size() != geometry.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < geometry.size(); ++i)
+    {
+        if (geometry[i] >= scene.GetMeshCount())
+            return false;
+        MaterialHandle material;
+        if (instanceMaterials[i] != Scene::NO_MATERIAL)
+        {
+            if (instanceMaterials[i] >= materialCount)
+                return false;
+            material = scene.GetMaterialHandle(instanceMaterials[i]);
+        }
+        scene.AddInstance(scene.GetMeshHandle(geometry[i]), transforms[i],
+                          material);
+    }
+    return true;
+}
+/// <summary>
+/// Reads the scene from a mapped cache file if it is valid for the current
+/// contents of sources. stamps receives the current stamps of the sources,
+/// and touched whether they differ from the cached ones.
+/// </summary>
+auto ReadCache(const MappedFile& file,
+               std::span<const std::filesystem::path> sources, TaskPool* pool,
+               std::vector<SourceStamp>& stamps, bool& touched)
+    -> std::optional<Scene>
+{
+    CacheHeader header{};
+    if (file.GetSize() < sizeof(header))
+        return std::nullopt;
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != SCENE_CACHE_VERSION ||
+        header.byteOrder != BYTE_ORDER_MARK ||
+        header.sourceCount != sources.size())
+    {
+        return std::nullopt;
+    }
+
+    const uint64_t stampsOffset = sizeof(CacheHeader);
+    const uint64_t sectionsOffset =
+        stampsOffset + uint64_t{header.sourceCount} * sizeof(SourceStamp);
+    if (sectionsOffset + uint64_t{header.sectionCount} * sizeof(Section) >
+        file.GetSize())
+    {
+        return std::nullopt;
+    }
+
+    // Hash only if a source was touched since the cache was validated. A
+    // missing source has no contents to match.
+    stamps.resize(header.sourceCount);
+    std::memcpy(stamps.data(), file.GetData() + stampsOffset,
+                stamps.size() * sizeof(SourceStamp));
+    touched = false;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        const SourceStamp current = GetStamp(sources[i]);
+        if (current.size == UINT64_MAX)
+            return std::nullopt;
+        touched = touched || current.size != stamps[i].size ||
+                  current.modified != stamps[i].modified;
+        stamps[i] = current;
+    }
+    if (touched && HashFiles(sources, pool) != header.contentHash)
+        return std::nullopt;
+
+    std::vector<Section> sections(header.sectionCount);
+    std::memcpy(sections.data(), file.GetData() + sectionsOffset,
+                sections.size() * sizeof(Section));
+    const SectionReader reader(file, sections.data(), header.sectionCount);
+    Scene scene;
+    if (!reader.IsValid() || !ReadScene(reader, scene))
+        return std::nullopt;
+    return scene;
+}
+} // namespace
+
+auto HashFiles(std::span<const std::filesystem::path> files, TaskPool* pool)
+    -> uint64_t
+{
+    uint64_t hash = Mix(files.size());
+    std::unique_ptr<TaskPool> ownedPool;
+    for (const std::filesystem::path& path : files)
+    {
+        const MappedFile file(path);
+        const size_t size = file.GetSize();
+        const size_t chunkCount =
+            std::max<size_t>(1, (size + HASH_CHUNK_BYTES - 1) /
+                                    HASH_CHUNK_BYTES);
+        std::vector<uint64_t> chunkHashes(chunkCount);
+        const auto hashChunk = [&](uint32_t chunk, uint32_t /*threadIdx*/)
+        {
+            const size_t begin = size_t{chunk} * HASH_CHUNK_BYTES;
+            const size_t end = std::min(begin + HASH_CHUNK_BYTES, size);
+            chunkHashes[chunk] =
+                HashBytes(file.GetData() + begin, end - begin, chunk);
+        };
+
+        if (pool == nullptr && ownedPool == nullptr &&
+            size >= MIN_PARALLEL_HASH_BYTES)
+        {
+            ownedPool = std::make_unique<TaskPool>();
+        }
+        TaskPool* hashPool = pool != nullptr ? pool : ownedPool.get();
+        if (hashPool != nullptr && chunkCount > 1)
+        {
+            hashPool->ParallelFor(static_cast<uint32_t>(chunkCount),
+                                  hashChunk);
+        }
+        else
+        {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                hashChunk(static_cast<uint32_t>(chunk), 0);
+            }
+        }
+
+        // Chunk hashes combine in order, so the result does not depend on
+        // the number of threads
+        hash = Mix(hash ^ size);
+        for (const uint64_t chunkHash : chunkHashes)
+        {
+            hash = Mix(hash ^ chunkHash);
+        }
+    }
+    return hash;
+}
+
+auto SaveSceneCache(const std::filesystem::path& cachePath,
+                    const Scene& scene,
+                    std::span<const std::filesystem::path> sources,
+                    TaskPool* pool) -> void
+{
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = SCENE_CACHE_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.contentHash = HashFiles(sources, pool);
+    header.sourceCount = static_cast<uint32_t>(sources.size());
+
+    std::vector<SourceStamp> stamps;
+    for (const std::filesystem::path& source : sources)
+    {
+        stamps.push_back(GetStamp(source));
+    }
+
+    SectionWriter writer;
+    writer.Add(SectionKind::MaterialAlbedo, 0, scene.GetAlbedos());
+    writer.Add(SectionKind::MaterialEmission, 0, scene.GetEmissions());
+    writer.Add(SectionKind::MaterialRoughness, 0, scene.GetRoughnesses());
+
+    // Only the real spheres, not the buffer's padding
+    const SphereBuffer& spheres = scene.GetSpheres();
+    const size_t sphereBytes = spheres.GetCount() * sizeof(float);
+    writer.Add(SectionKind::SphereCenterX, 0, spheres.GetCenterX(),
+               sphereBytes);
+    writer.Add(SectionKind::SphereCenterY, 0, spheres.GetCenterY(),
+               sphereBytes);
+    writer.Add(SectionKind::SphereCenterZ, 0, spheres.GetCenterZ(),
+               sphereBytes);
+    writer.Add(SectionKind::SphereRadiusSq, 0, spheres.GetRadiusSq(),
+               sphereBytes);
+    writer.Add(SectionKind::SphereMaterial, 0, scene.GetSphereMaterials());
+
+    writer.Add(SectionKind::TriangleV0, 0, scene.GetTriangleV0());
+    writer.Add(SectionKind::TriangleV1, 0, scene.GetTriangleV1());
+    writer.Add(SectionKind::TriangleV2, 0, scene.GetTriangleV2());
+    writer.Add(SectionKind::TriangleMaterial, 0,
+               scene.GetTriangleMaterials());
+
+    writer.Add(SectionKind::InstanceGeometry, 0,
+               scene.GetInstanceGeometries());
+    writer.Add(SectionKind::InstanceTransform, 0,
+               scene.GetInstanceTransforms());
+    writer.Add(SectionKind::InstanceMaterial, 0,
+               scene.GetInstanceMaterials());
+
+    // Meshes without an attached BVH get one built here, kept alive until
+    // the file is written
+    const std::vector<TriangleMesh>& meshes = scene.GetMeshes();
+    std::vector<std::shared_ptr<const MeshBvh8>> meshBvhs =
+        scene.GetMeshBvhs();
+    std::vector<MeshInfo> infos(meshes.size());
+    for (uint32_t m = 0; m < meshes.size(); ++m)
+    {
+        if (!meshBvhs[m])
+        {
+            auto built = std::make_shared<MeshBvh8>();
+            built->Build(meshes[m], TriangleLeafLayout::Packed, {}, pool);
+            meshBvhs[m] = std::move(built);
+        }
+
+        const TriangleMesh& mesh = meshes[m];
+        const MeshBvh8& bvh = *meshBvhs[m];
+        SetMeshInfo(scene.GetMeshMaterials()[m], bvh, infos[m]);
+
+        const size_t positionBytes = mesh.GetVertexCount() * sizeof(float);
+        writer.Add(SectionKind::MeshInfo, m, &infos[m], sizeof(MeshInfo));
+        writer.Add(SectionKind::MeshPositionX, m, mesh.GetPositionX(),
+                   positionBytes);
+        writer.Add(SectionKind::MeshPositionY, m, mesh.GetPositionY(),
+                   positionBytes);
+        writer.Add(SectionKind::MeshPositionZ, m, mesh.GetPositionZ(),
+                   positionBytes);
+        writer.Add(SectionKind::MeshIndices, m, mesh.GetIndices(),
+                   mesh.GetTriangleCount() * 3 * sizeof(uint32_t));
+        writer.Add(SectionKind::MeshBvhNodes, m, bvh.GetBvh().GetNodes());
+        writer.Add(SectionKind::MeshBvhPrimIndices, m,
+                   bvh.GetBvh().GetPrimIndices());
+        writer.Add(SectionKind::MeshWideNodes, m,
+                   bvh.GetWideBvh().GetNodes());
+        writer.Add(SectionKind::MeshWidePrimIndices, m,
+                   bvh.GetWideBvh().GetPrimIndices());
+        writer.Add(SectionKind::MeshTriangleGroups, m, bvh.GetGroups());
+    }
+    header.sectionCount = writer.GetCount();
+
+    std::filesystem::path tempPath = cachePath;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open scene cache " +
+                                     tempPath.string());
+        }
+        writer.Write(file, header, stamps);
+        if (!file.flush())
+        {
+            throw std::runtime_error("Failed to write scene cache " +
+                                     tempPath.string());
+        }
+    }
+    std::filesystem::rename(tempPath, cachePath);
+}
+
+auto LoadSceneCache(const std::filesystem::path& cachePath,
+                    std::span<const std::filesystem::path> sources,
+                    TaskPool* pool) -> std::optional<Scene>
+{
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cachePath, error))
+        return std::nullopt;
+
+    std::vector<SourceStamp> stamps;
+    bool touched = false;
+    std::optional<Scene> scene;
+    {
+        // Unmapped before the stamps are written back below
+        const MappedFile file(cachePath);
+        scene = ReadCache(file, sources, pool, stamps, touched);
+    }
+
+    if (scene && touched)
+    {
+        // Same contents, new times: record them so the next load skips
+        // the hash. Failing to is harmless.
+        std::fstream update(cachePath,
+                            std::ios::in | std::ios::out | std::ios::binary);
+        update.seekp(static_cast<std::streamoff>(sizeof(CacheHeader)));
+        update.write(reinterpret_cast<const char*>(stamps.data()),
+                     static_cast<std::streamsize>(stamps.size() *
+                                                  sizeof(SourceStamp)));
+    }
+    return scene;
+}
+
+} // namespace pathtracer
@@ -5,8 +5,28 @@
 
 #include <exception>
 #include <iostream>
+#include <sstream>
 #include <string>
 
+namespace
+{
+/// <summary>
+/// The renderer the command line asks for: --cpu selects the portable CPU
+/// path tracer, anything else keeps the compute shader.
+/// </summary>
+auto ParseRendererKind(LPCWSTR cmdLine) -> pathtracer::RendererKind
+{
+    std::wistringstream args(cmdLine ? cmdLine : L"");
+    std::wstring arg;
+    while (args >> arg)
+    {
+        if (arg == L"--cpu")
+            return pathtracer::RendererKind::Cpu;
+    }
+    return pathtracer::RendererKind::Compute;
+}
+} // namespace
+
 /// <summary>
 /// Entry point for the DX12 Path Tracer application
 /// <para></para>
@@ -17,13 +37,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 {
     UNREFERENCED_PARAMETER(hInstance);
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
     UNREFERENCED_PARAMETER(nCmdShow);
 
     try
     {
-        // Create application with window size and title
-        pathtracer::Application app;
+        // Create application with the renderer picked on the command line
+        pathtracer::Application app(ParseRendererKind(lpCmdLine));
 
         // Run the application (blocks until window closes)
         return app.Run();
@@ -25,6 +25,7 @@ ComputePathtracer::ComputePathtracer(ID3D12Device* device,
     CreateRootSignature();
     CreatePipelineState();
     CreateOutputTexture();
+    CreateAccumulationTexture();
     CreateDescriptorHeap();
     CreateCameraConstantBuffers();
 }
@@ -32,8 +33,8 @@ ComputePathtracer::ComputePathtracer(ID3D12Device* device,
 auto ComputePathtracer::Render(ID3D12GraphicsCommandList* commandList,
                                ID3D12Resource* renderTarget,
                                D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle,
-                               const Camera& camera, const UINT frameIdx)
-    -> void
+                               const Camera& camera, const UINT frameIdx,
+                               const Scene& scene) -> void
 {
     // Explicitly mark unused parameter to avoid warnings
     (void)rtvHandle;
@@ -43,6 +44,14 @@ auto ComputePathtracer::Render(ID3D12GraphicsCommandList* commandList,
     memcpy(m_cameraConstantBufferMappedData[frameIdx], &cameraData,
            sizeof(cameraData));
 
+    // Frame constants: discard the running sum whenever the view changed
+    const bool reset = camera.IsDirty() ||
+                       scene.GetChanges() != SceneChange::None ||
+                       m_resetAccumulation;
+    const FrameGPUData frameData{m_frameCounter++, reset ? 1u : 0u};
+    m_resetAccumulation = false;
+    m_accumulatedSamples = reset ? 1 : m_accumulatedSamples + 1;
+
     // Set the compute pipeline state and root signature
     // Tells GPU which shader to run and what resources to expect
     commandList->SetPipelineState(m_pipelineState.Get());
@@ -66,6 +75,10 @@ auto ComputePathtracer::Render(ID3D12GraphicsCommandList* commandList,
     commandList->SetComputeRootConstantBufferView(
         1, m_cameraConstantBuffers[frameIdx]->GetGPUVirtualAddress());
 
+    // Bind frame constants (root param 2)
+    commandList->SetComputeRoot32BitConstants(
+        2, sizeof(FrameGPUData) / sizeof(UINT), &frameData, 0);
+
     // Dispatch compute shader (runs on GPU)
 
     /// NOTE TO SELF:
@@ -93,9 +106,11 @@ auto ComputePathtracer::Render(ID3D12GraphicsCommandList* commandList,
     // Wait for compute to finish (barrier)
     // Ensures all UAV writes from compute shader are complete before reading.
     // GPUs execute out-of-order, so this syncs compute writes with copy op.
-    CD3DX12_RESOURCE_BARRIER uavBarrier =
-        CD3DX12_RESOURCE_BARRIER::UAV(m_outputTexture.Get());
-    commandList->ResourceBarrier(1, &uavBarrier);
+    // The accumulation texture is read back by next frame's dispatch.
+    CD3DX12_RESOURCE_BARRIER uavBarriers[] = {
+        CD3DX12_RESOURCE_BARRIER::UAV(m_outputTexture.Get()),
+        CD3DX12_RESOURCE_BARRIER::UAV(m_accumulationTexture.Get())};
+    commandList->ResourceBarrier(_countof(uavBarriers), uavBarriers);
 
     // Transition output texture: UAV to COPY_SOURCE
     CD3DX12_RESOURCE_BARRIER toCopySource =
@@ -132,9 +147,12 @@ auto ComputePathtracer::Resize(const UINT width, const UINT height) -> void
 {
     m_width = width;
     m_height = height;
-    // Recreate output texture and descriptor heap to match new size
+    // Recreate output/accumulation textures and descriptor heap to match new
+    // size. The new accumulation texture holds no valid history.
     CreateOutputTexture();
+    CreateAccumulationTexture();
     CreateDescriptorHeap();
+    m_resetAccumulation = true;
 }
 
 auto ComputePathtracer::LoadComputeShader() -> void
@@ -197,13 +215,15 @@ auto ComputePathtracer::CreateRootSignature() -> void
 
     // v1.1 descriptor ranges
     CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0,
-                   D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE); // U0
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0, 0,
+                   D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE); // U0-U1
 
     // Root parameter with v1.1
-    CD3DX12_ROOT_PARAMETER1 rootParams[2];
-    rootParams[0].InitAsDescriptorTable(1, &ranges[0]); // UAV table (u0)
+    CD3DX12_ROOT_PARAMETER1 rootParams[3];
+    rootParams[0].InitAsDescriptorTable(1, &ranges[0]); // UAV table (u0-u1)
     rootParams[1].InitAsConstantBufferView(0); // CBV at b0 (camera data)
+    rootParams[2].InitAsConstants(sizeof(FrameGPUData) / sizeof(UINT),
+                                  1); // Root constants at b1 (frame data)
 
     // Versioned root signature descriptor (1.1)
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSigDesc;
@@ -333,11 +353,42 @@ auto ComputePathtracer::CreateOutputTexture() -> void
     m_outputTexture->SetName(L"ComputePathTracer Output Texture");
 }
 
+auto ComputePathtracer::CreateAccumulationTexture() -> void
+{
+    // Full float precision: fp16 runs out of mantissa after a few thousand
+    // samples and the image would stop converging
+    CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+        DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0,
+        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+
+#ifdef _DEBUG
+    if (m_infoQueue)
+    {
+        DX12_CHECK_MSG(m_device->CreateCommittedResource(
+                           &heapProps, D3D12_HEAP_FLAG_NONE, &texDesc,
+                           D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
+                           IID_PPV_ARGS(&m_accumulationTexture)),
+                       *m_infoQueue);
+    }
+    else
+#endif // _DEBUG
+    {
+        DX12_CHECK(m_device->CreateCommittedResource(
+            &heapProps, D3D12_HEAP_FLAG_NONE, &texDesc,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
+            IID_PPV_ARGS(&m_accumulationTexture)));
+    }
+
+    m_accumulationTexture->SetName(L"ComputePathTracer Accumulation Texture");
+}
+
 auto ComputePathtracer::CreateDescriptorHeap() -> void
 {
     // Create descriptor heap for UAV
     D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-    heapDesc.NumDescriptors = 1; // Only need one UAV descriptor
+    heapDesc.NumDescriptors = 2; // Output (u0) and accumulation (u1) UAVs
     heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     heapDesc.Flags =
         D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE; // Visible to shader
@@ -376,6 +427,12 @@ auto ComputePathtracer::CreateDescriptorHeap() -> void
     m_device->CreateUnorderedAccessView(m_outputTexture.Get(),
                                         nullptr, // No counter resource
                                         &uavDesc, cpuHandle);
+
+    // Accumulation UAV follows in the next slot (u1)
+    cpuHandle.Offset(1, m_descriptorSize);
+    uavDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    m_device->CreateUnorderedAccessView(m_accumulationTexture.Get(), nullptr,
+                                        &uavDesc, cpuHandle);
 }
 
 auto ComputePathtracer::CreateCameraConstantBuffers() -> void
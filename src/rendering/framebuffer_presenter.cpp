@@ -0,0 +1,145 @@
+#include "stdafx.h"
+
+#include "core/dx12_info_queue.h"
+#include "rendering/framebuffer_presenter.h"
+#include "utils/d3dx12.h"
+#include "utils/exception_macros.h"
+
+#include <d3d12.h>
+#include <dxgiformat.h>
+
+#include <cstdint>
+#include <glm/gtc/packing.hpp>
+#include <utility>
+
+namespace pathtracer
+{
+FramebufferPresenter::FramebufferPresenter(
+    ID3D12Device* device, DX12InfoQueue* infoQueue,
+    std::unique_ptr<IFrameRenderer> frameRenderer, UINT width, UINT height)
+    : m_device(device), m_infoQueue(infoQueue), m_width(width),
+      m_height(height), m_frameRenderer(std::move(frameRenderer)),
+      m_framebuffer(width, height)
+{
+    m_frameRenderer->Resize(m_width, m_height);
+    CreateUploadBuffers();
+}
+
+FramebufferPresenter::~FramebufferPresenter()
+{
+    for (auto& buffer : m_uploadBuffers)
+    {
+        if (buffer)
+        {
+            buffer->Unmap(0, nullptr);
+        }
+    }
+}
+
+auto FramebufferPresenter::Render(ID3D12GraphicsCommandList* commandList,
+                                  ID3D12Resource* renderTarget,
+                                  D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle,
+                                  const Camera& camera, const UINT frameIdx,
+                                  const Scene& scene) -> void
+{
+    // Explicitly mark unused parameter to avoid warnings
+    (void)rtvHandle;
+
+    m_frameRenderer->Render(m_framebuffer, camera, frameIdx, scene);
+
+    // Pack float RGBA to the R16G16B16A16_FLOAT back buffer format, honouring
+    // the 256-byte row pitch of the upload footprint
+    auto* dst = static_cast<uint8_t*>(m_uploadBufferMappedData[frameIdx]) +
+                m_footprint.Offset;
+    for (UINT y = 0; y < m_height; ++y)
+    {
+        const glm::vec4* src = m_framebuffer.GetRow(y);
+        auto* dstRow = reinterpret_cast<uint64_t*>(
+            dst + static_cast<size_t>(y) * m_footprint.Footprint.RowPitch);
+        for (UINT x = 0; x < m_width; ++x)
+        {
+            dstRow[x] = glm::packHalf4x16(src[x]);
+        }
+    }
+
+    // Transition render target: RENDER_TARGET to COPY_DEST
+    CD3DX12_RESOURCE_BARRIER toCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(
+        renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET,
+        D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList->ResourceBarrier(1, &toCopyDest);
+
+    // Copy upload buffer to render target
+    CD3DX12_TEXTURE_COPY_LOCATION dstLocation(renderTarget, 0);
+    CD3DX12_TEXTURE_COPY_LOCATION srcLocation(m_uploadBuffers[frameIdx].Get(),
+                                              m_footprint);
+    commandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation,
+                                   nullptr);
+
+    // Transition render target back: COPY_DEST to RENDER_TARGET
+    CD3DX12_RESOURCE_BARRIER toRenderTarget =
+        CD3DX12_RESOURCE_BARRIER::Transition(
+            renderTarget, D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_RENDER_TARGET);
+    commandList->ResourceBarrier(1, &toRenderTarget);
+}
+
+auto FramebufferPresenter::Resize(const UINT width, const UINT height) -> void
+{
+    m_width = width;
+    m_height = height;
+    m_framebuffer.Resize(m_width, m_height);
+    m_frameRenderer->Resize(m_width, m_height);
+    CreateUploadBuffers();
+}
+
+auto FramebufferPresenter::CreateUploadBuffers() -> void
+{
+    // Query the copyable footprint of a back buffer sized texture so the
+    // upload rows match the required pitch
+    CD3DX12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+        DXGI_FORMAT_R16G16B16A16_FLOAT, m_width, m_height, 1, 1);
+    UINT64 totalBytes = 0;
+    m_device->GetCopyableFootprints(&texDesc, 0, 1, 0, &m_footprint, nullptr,
+                                    nullptr, &totalBytes);
+
+    CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc =
+        CD3DX12_RESOURCE_DESC::Buffer(totalBytes);
+
+    for (UINT i = 0; i < SwapChain::BUFFER_COUNT; ++i)
+    {
+        if (m_uploadBuffers[i])
+        {
+            m_uploadBuffers[i]->Unmap(0, nullptr);
+            m_uploadBuffers[i].Reset();
+            m_uploadBufferMappedData[i] = nullptr;
+        }
+
+#ifdef _DEBUG
+        if (m_infoQueue)
+        {
+            DX12_CHECK_MSG(m_device->CreateCommittedResource(
+                               &uploadHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                               D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                               IID_PPV_ARGS(&m_uploadBuffers[i])),
+                           *m_infoQueue);
+        }
+        else
+#endif // _DEBUG
+        {
+            DX12_CHECK(m_device->CreateCommittedResource(
+                &uploadHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+                IID_PPV_ARGS(&m_uploadBuffers[i])));
+        }
+
+        m_uploadBuffers[i]->SetName(L"FramebufferPresenter Upload Buffer");
+
+        // We won't read from this buffer on CPU
+        CD3DX12_RANGE readRange(0, 0);
+        DX12_CHECK(m_uploadBuffers[i]->Map(0, &readRange,
+                                           &m_uploadBufferMappedData[i]));
+    }
+}
+
+} // namespace pathtracer
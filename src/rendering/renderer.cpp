@@ -141,7 +141,8 @@ Renderer::~Renderer()
     // reverse order of creation, so no need to manually release them here
 }
 
-auto Renderer::RenderFrame(const Camera& camera) -> void
+auto Renderer::RenderFrame(const Camera& camera, const Scene& scene)
+    -> void
 {
     const UINT frameIdx = m_swapChain->GetCurrentBackBufferIndex();
 
@@ -188,7 +189,8 @@ auto Renderer::RenderFrame(const Camera& camera) -> void
         m_rtvDescriptorSize);
 
     // Render with pathtracer
-    m_pathtracer->Render(m_commandList.Get(), backBuffer, rtvHandle, camera, frameIdx);
+    m_pathtracer->Render(m_commandList.Get(), backBuffer, rtvHandle, camera,
+                         frameIdx, scene);
 
     // Transition back to present
     barrier = CD3DX12_RESOURCE_BARRIER::Transition(
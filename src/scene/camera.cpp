@@ -1,5 +1,3 @@
-#include "stdafx.h"
-
 #include "scene/camera.h"
 
 #include <glm/gtc/constants.hpp>
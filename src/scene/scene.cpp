@@ -0,0 +1,259 @@
+#include "scene/scene.h"
+
+#include <utility>
+
+namespace pathtracer
+{
+namespace
+{
+/// <summary>
+/// Removes element idx by moving the last element into its place, matching
+/// HandleTable::Remove().
+/// </summary>
+template <typename T>
+auto SwapRemove(std::vector<T>& values, uint32_t idx) -> void
+{
+    values[idx] = std::move(values.back());
+    values.pop_back();
+}
+} // namespace
+
+Scene::Scene()
+{
+    AddMaterial(Material{});
+    m_changes = SceneChange::None;
+}
+
+auto Scene::AddSphere(const glm::vec3& center, float radius,
+                      MaterialHandle material) -> SphereHandle
+{
+    const uint32_t materialIdx = GetMaterialIndex(material);
+    const SphereHandle handle = m_sphereHandles.Add();
+    m_spheres.Add(center, radius);
+    m_sphereMaterials.push_back(materialIdx);
+    m_changes |= SceneChange::SphereTopology;
+    return handle;
+}
+
+auto Scene::RemoveSphere(SphereHandle handle) -> void
+{
+    const uint32_t idx = m_sphereHandles.Remove(handle);
+    m_spheres.SwapRemove(idx);
+    SwapRemove(m_sphereMaterials, idx);
+    m_changes |= SceneChange::SphereTopology;
+}
+
+auto Scene::SetSphere(SphereHandle handle, const glm::vec3& center,
+                      float radius) -> void
+{
+    m_spheres.Set(m_sphereHandles.GetIndex(handle), center, radius);
+    m_changes |= SceneChange::SphereGeometry;
+}
+
+auto Scene::SetSphereMaterial(SphereHandle handle, MaterialHandle material)
+    -> void
+{
+    m_sphereMaterials[m_sphereHandles.GetIndex(handle)] =
+        GetMaterialIndex(material);
+    m_changes |= SceneChange::Materials;
+}
+
+auto Scene::AddTriangle(const glm::vec3& v0, const glm::vec3& v1,
+                        const glm::vec3& v2, MaterialHandle material)
+    -> TriangleHandle
+{
+    const uint32_t materialIdx = GetMaterialIndex(material);
+    const TriangleHandle handle = m_triangleHandles.Add();
+    m_triangleV0.push_back(v0);
+    m_triangleV1.push_back(v1);
+    m_triangleV2.push_back(v2);
+    m_triangleMaterials.push_back(materialIdx);
+    m_changes |= SceneChange::TriangleTopology;
+    return handle;
+}
+
+auto Scene::RemoveTriangle(TriangleHandle handle) -> void
+{
+    const uint32_t idx = m_triangleHandles.Remove(handle);
+    SwapRemove(m_triangleV0, idx);
+    SwapRemove(m_triangleV1, idx);
+    SwapRemove(m_triangleV2, idx);
+    SwapRemove(m_triangleMaterials, idx);
+    m_changes |= SceneChange::TriangleTopology;
+}
+
+auto Scene::SetTriangle(TriangleHandle handle, const glm::vec3& v0,
+                        const glm::vec3& v1, const glm::vec3& v2) -> void
+{
+    const uint32_t idx = m_triangleHandles.GetIndex(handle);
+    m_triangleV0[idx] = v0;
+    m_triangleV1[idx] = v1;
+    m_triangleV2[idx] = v2;
+    m_changes |= SceneChange::TriangleGeometry;
+}
+
+auto Scene::AddMesh(TriangleMesh mesh, MaterialHandle material) -> MeshHandle
+{
+    const uint32_t materialIdx = GetMaterialIndex(material);
+    const MeshHandle handle = m_meshHandles.Add();
+    m_meshes.push_back(std::move(mesh));
+    m_meshMaterials.push_back(materialIdx);
+    m_meshRevisions.push_back(0);
+    m_meshBvhs.emplace_back();
+    m_changes |= SceneChange::MeshTopology;
+    return handle;
+}
+
+auto Scene::RemoveMesh(MeshHandle handle) -> void
+{
+    const uint32_t idx = m_meshHandles.Remove(handle);
+
+    // The last mesh moves into the freed index; its instances follow it
+    const auto lastIdx = static_cast<uint32_t>(m_meshes.size() - 1);
+    for (uint32_t inst = m_instanceHandles.GetCount(); inst-- > 0;)
+    {
+        if (m_instanceGeometry[inst] == idx)
+            RemoveInstance(m_instanceHandles.GetHandle(inst));
+    }
+    for (uint32_t& geometry : m_instanceGeometry)
+    {
+        if (geometry == lastIdx)
+            geometry = idx;
+    }
+
+    SwapRemove(m_meshes, idx);
+    SwapRemove(m_meshMaterials, idx);
+    SwapRemove(m_meshRevisions, idx);
+    SwapRemove(m_meshBvhs, idx);
+    m_changes |= SceneChange::MeshTopology;
+}
+
+auto Scene::SetMeshVertex(MeshHandle handle, uint32_t vertexIdx,
+                          const glm::vec3& position) -> void
+{
+    const uint32_t idx = m_meshHandles.GetIndex(handle);
+    m_meshes[idx].SetVertex(vertexIdx, position);
+    ++m_meshRevisions[idx];
+    m_meshBvhs[idx].reset();
+    m_changes |= SceneChange::MeshGeometry;
+}
+
+auto Scene::SetMeshBvh(MeshHandle handle,
+                       std::shared_ptr<const MeshBvh8> bvh) -> void
+{
+    m_meshBvhs[m_meshHandles.GetIndex(handle)] = std::move(bvh);
+}
+
+auto Scene::AddMaterial(const Material& material) -> MaterialHandle
+{
+    const MaterialHandle handle = m_materialHandles.Add();
+    m_albedo.push_back(material.albedo);
+    m_emission.push_back(material.emission);
+    m_roughness.push_back(material.roughness);
+    m_changes |= SceneChange::Materials;
+    return handle;
+}
+
+auto Scene::SetMaterial(MaterialHandle handle, const Material& material)
+    -> void
+{
+    const uint32_t idx = GetMaterialIndex(handle);
+    m_albedo[idx] = material.albedo;
+    m_emission[idx] = material.emission;
+    m_roughness[idx] = material.roughness;
+    m_changes |= SceneChange::Materials;
+}
+
+auto Scene::GetMaterial(MaterialHandle handle) const -> Material
+{
+    const uint32_t idx = GetMaterialIndex(handle);
+    return {m_albedo[idx], m_emission[idx], m_roughness[idx]};
+}
+
+auto Scene::GetMaterialIndex(MaterialHandle handle) const -> uint32_t
+{
+    return handle.IsValid() ? m_materialHandles.GetIndex(handle) : 0;
+}
+
+auto Scene::AddInstance(MeshHandle mesh, const glm::mat4& transform,
+                        MaterialHandle material) -> InstanceHandle
+{
+    const uint32_t geometry = m_meshHandles.GetIndex(mesh);
+    const uint32_t materialIdx =
+        material.IsValid() ? GetMaterialIndex(material) : NO_MATERIAL;
+    const InstanceHandle handle = m_instanceHandles.Add();
+    m_instanceGeometry.push_back(geometry);
+    m_instanceTransform.push_back(transform);
+    m_instanceMaterial.push_back(materialIdx);
+    m_changes |= SceneChange::InstanceTopology;
+    return handle;
+}
+
+auto Scene::RemoveInstance(InstanceHandle handle) -> void
+{
+    const uint32_t idx = m_instanceHandles.Remove(handle);
+    SwapRemove(m_instanceGeometry, idx);
+    SwapRemove(m_instanceTransform, idx);
+    SwapRemove(m_instanceMaterial, idx);
+    m_changes |= SceneChange::InstanceTopology;
+}
+
+auto Scene::SetInstanceTransform(InstanceHandle handle,
+                                 const glm::mat4& transform) -> void
+{
+    m_instanceTransform[m_instanceHandles.GetIndex(handle)] = transform;
+    m_changes |= SceneChange::InstanceTransforms;
+}
+
+auto Scene::Clear() -> void
+{
+    if (m_sphereHandles.GetCount() > 0)
+        m_changes |= SceneChange::SphereTopology;
+    if (m_triangleHandles.GetCount() > 0)
+        m_changes |= SceneChange::TriangleTopology;
+    if (m_instanceHandles.GetCount() > 0)
+        m_changes |= SceneChange::InstanceTopology;
+    if (m_meshHandles.GetCount() > 0)
+        m_changes |= SceneChange::MeshTopology;
+    if (m_materialHandles.GetCount() > 1)
+        m_changes |= SceneChange::Materials;
+
+    m_sphereHandles.Clear();
+    m_spheres.Clear();
+    m_sphereMaterials.clear();
+
+    m_triangleHandles.Clear();
+    m_triangleV0.clear();
+    m_triangleV1.clear();
+    m_triangleV2.clear();
+    m_triangleMaterials.clear();
+
+    m_meshHandles.Clear();
+    m_meshes.clear();
+    m_meshMaterials.clear();
+    m_meshRevisions.clear();
+    m_meshBvhs.clear();
+
+    m_instanceHandles.Clear();
+    m_instanceGeometry.clear();
+    m_instanceTransform.clear();
+    m_instanceMaterial.clear();
+
+    // Keep the default material at index 0
+    m_materialHandles.Clear();
+    m_albedo.clear();
+    m_emission.clear();
+    m_roughness.clear();
+    const SceneChange changes = m_changes;
+    AddMaterial(Material{});
+    m_changes = changes;
+}
+
+auto CreateTestScene() -> Scene
+{
+    Scene scene;
+    scene.AddSphere(glm::vec3{0.0f, 0.0f, 0.0f}, 1.0f);
+    return scene;
+}
+
+} // namespace pathtracer
@@ -0,0 +1,178 @@
+#include "cpu/accumulation_buffer.h"
+#include "cpu/atrous_denoiser.h"
+#include "cpu/feature_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/tile_scheduler.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace pathtracer
+{
+namespace
+{
+// Not a multiple of the tile size, and wide enough for every pass
+constexpr uint32_t WIDTH = 75;
+constexpr uint32_t HEIGHT = 41;
+constexpr uint32_t EDGE = WIDTH / 2;
+constexpr uint32_t SAMPLE_COUNT = 4;
+
+/// <summary>
+/// Two surfaces meeting at column EDGE: a near one facing the camera on
+/// the left, a far one turned away on the right. Each pixel gets
+/// SAMPLE_COUNT radiance samples of illumination(x, y) times its albedo.
+/// </summary>
+template <typename IlluminationFn>
+auto Fill(AccumulationBuffer& accumulation, FeatureBuffer& features,
+          const glm::vec3& leftAlbedo, const glm::vec3& rightAlbedo,
+          IlluminationFn&& illumination) -> void
+{
+    accumulation.Resize(WIDTH, HEIGHT);
+    features.Resize(WIDTH, HEIGHT);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            const bool left = x < EDGE;
+            const glm::vec3 albedo = left ? leftAlbedo : rightAlbedo;
+            for (uint32_t s = 0; s < SAMPLE_COUNT; ++s)
+            {
+                accumulation.AddSample(x, y, albedo * illumination(x, y));
+                features.AddSample(
+                    x, y, albedo,
+                    left ? glm::vec3{0.0f, 0.0f, 1.0f}
+                         : glm::vec3{0.7071f, 0.0f, 0.7071f},
+                    left ? 2.0f : 6.0f);
+            }
+        }
+    }
+}
+
+auto Denoise(const AccumulationBuffer& accumulation,
+             const FeatureBuffer& features, uint32_t threadCount = 2,
+             uint32_t tileSize = 16) -> Framebuffer
+{
+    TileScheduler scheduler(threadCount, tileSize);
+    AtrousDenoiser denoiser;
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    denoiser.Denoise(accumulation, features, framebuffer, scheduler);
+    return framebuffer;
+}
+
+auto GetPixel(const Framebuffer& framebuffer, uint32_t x, uint32_t y)
+    -> glm::vec3
+{
+    return glm::vec3(framebuffer.GetRow(y)[x]);
+}
+
+auto ExpectNear(const glm::vec3& actual, const glm::vec3& expected,
+                float tolerance, uint32_t x, uint32_t y) -> void
+{
+    EXPECT_NEAR(actual.r, expected.r, tolerance) << x << ", " << y;
+    EXPECT_NEAR(actual.g, expected.g, tolerance) << x << ", " << y;
+    EXPECT_NEAR(actual.b, expected.b, tolerance) << x << ", " << y;
+}
+} // namespace
+
+// Every tap weighs the same value, whatever the features say, and the
+// albedo divided out is multiplied back in
+TEST(AtrousDenoiserTest, PreservesAConstantImage)
+{
+    AccumulationBuffer accumulation;
+    FeatureBuffer features;
+    const glm::vec3 albedo{0.6f, 0.3f, 0.1f};
+    Fill(accumulation, features, albedo, albedo,
+         [](uint32_t, uint32_t) { return glm::vec3{2.0f}; });
+    const Framebuffer framebuffer = Denoise(accumulation, features);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            ExpectNear(GetPixel(framebuffer, x, y), albedo * 2.0f, 1e-5f, x,
+                       y);
+            EXPECT_EQ(framebuffer.GetRow(y)[x].a, 1.0f);
+        }
+    }
+}
+
+// Evenly lit surfaces of different colours only differ in albedo, which
+// the filter never blurs
+TEST(AtrousDenoiserTest, KeepsAlbedoEdges)
+{
+    AccumulationBuffer accumulation;
+    FeatureBuffer features;
+    const glm::vec3 red{0.8f, 0.1f, 0.1f};
+    const glm::vec3 blue{0.1f, 0.1f, 0.8f};
+    Fill(accumulation, features, red, blue,
+         [](uint32_t, uint32_t) { return glm::vec3{1.0f}; });
+    const Framebuffer framebuffer = Denoise(accumulation, features);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        ExpectNear(GetPixel(framebuffer, EDGE - 1, y), red, 1e-5f, EDGE - 1,
+                   y);
+        ExpectNear(GetPixel(framebuffer, EDGE, y), blue, 1e-5f, EDGE, y);
+    }
+}
+
+// A bright near surface next to a dark far one: the noise within each
+// is smoothed, but the depth and normal edge between them is not
+TEST(AtrousDenoiserTest, SmoothsNoiseButKeepsGeometryEdges)
+{
+    constexpr float BRIGHT = 1.0f;
+    constexpr float DARK = 0.1f;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> noise(0.8f, 1.2f);
+    AccumulationBuffer accumulation;
+    FeatureBuffer features;
+    Fill(accumulation, features, glm::vec3{0.5f}, glm::vec3{0.5f},
+         [&](uint32_t x, uint32_t)
+         { return glm::vec3{(x < EDGE ? BRIGHT : DARK) * noise(rng)}; });
+    const Framebuffer framebuffer = Denoise(accumulation, features);
+
+    float inputError = 0.0f;
+    float outputError = 0.0f;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            const float expected = 0.5f * (x < EDGE ? BRIGHT : DARK);
+            inputError += std::abs(accumulation.Resolve(x, y).g - expected);
+            outputError += std::abs(GetPixel(framebuffer, x, y).g - expected);
+        }
+        EXPECT_NEAR(GetPixel(framebuffer, EDGE - 1, y).g, 0.5f * BRIGHT,
+                    0.05f * BRIGHT)
+            << "row " << y;
+        EXPECT_NEAR(GetPixel(framebuffer, EDGE, y).g, 0.5f * DARK,
+                    0.05f * DARK)
+            << "row " << y;
+    }
+    EXPECT_LT(outputError, inputError / 2.0f);
+}
+
+// Every pixel sums its taps in the same order whatever the tiles
+TEST(AtrousDenoiserTest, IsIndependentOfTilesAndThreads)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> noise(0.0f, 2.0f);
+    AccumulationBuffer accumulation;
+    FeatureBuffer features;
+    Fill(accumulation, features, glm::vec3{0.7f}, glm::vec3{0.2f, 0.9f, 0.4f},
+         [&](uint32_t, uint32_t)
+         { return glm::vec3{noise(rng), noise(rng), noise(rng)}; });
+    const Framebuffer a = Denoise(accumulation, features, 1, 64);
+    const Framebuffer b = Denoise(accumulation, features, 3, 8);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        ASSERT_EQ(std::memcmp(a.GetRow(y), b.GetRow(y),
+                              WIDTH * sizeof(glm::vec4)),
+                  0)
+            << "row " << y;
+    }
+}
+
+} // namespace pathtracer
@@ -0,0 +1,442 @@
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "cpu/task_pool.h"
+#include "ray/ray.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr uint32_t RAY_COUNT = 500;
+
+struct Sphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+auto RandomVec3(std::mt19937& rng, float lo, float hi) -> glm::vec3
+{
+    std::uniform_real_distribution<float> dist(lo, hi);
+    return {dist(rng), dist(rng), dist(rng)};
+}
+
+auto RandomSpheres(std::mt19937& rng, uint32_t count) -> std::vector<Sphere>
+{
+    std::uniform_real_distribution<float> radius(0.05f, 0.5f);
+    std::vector<Sphere> spheres(count);
+    for (Sphere& sphere : spheres)
+        sphere = {RandomVec3(rng, -10.0f, 10.0f), radius(rng)};
+    return spheres;
+}
+
+auto GetBounds(const std::vector<Sphere>& spheres) -> std::vector<Aabb>
+{
+    std::vector<Aabb> bounds;
+    for (const Sphere& sphere : spheres)
+        bounds.push_back(Aabb::FromSphere(sphere.center, sphere.radius));
+    return bounds;
+}
+
+/// <summary>
+/// Nearest hit in (0, tMax), lowering tMax to it.
+/// </summary>
+auto IntersectSphere(const Sphere& sphere, const ray& r, float& tMax) -> bool
+{
+    const glm::vec3 oc = r.origin() - sphere.center;
+    const float a = glm::dot(r.direction(), r.direction());
+    const float h = glm::dot(r.direction(), oc);
+    const float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    const float discriminant = h * h - a * c;
+    if (discriminant < 0.0f)
+        return false;
+    const float sqrtd = std::sqrt(discriminant);
+    float t = (-h - sqrtd) / a;
+    if (t <= 0.0f)
+        t = (-h + sqrtd) / a;
+    if (t <= 0.0f || t >= tMax)
+        return false;
+    tMax = t;
+    return true;
+}
+
+struct Hit
+{
+    uint32_t primIdx = std::numeric_limits<uint32_t>::max();
+    float t = std::numeric_limits<float>::infinity();
+};
+
+auto TraceBruteForce(const std::vector<Sphere>& spheres, const ray& r) -> Hit
+{
+    Hit hit;
+    for (uint32_t i = 0; i < spheres.size(); ++i)
+    {
+        if (IntersectSphere(spheres[i], r, hit.t))
+            hit.primIdx = i;
+    }
+    return hit;
+}
+
+auto TraceBvh(const Bvh& bvh, const std::vector<Sphere>& spheres,
+              const ray& r) -> Hit
+{
+    Hit hit;
+    bvh.Intersect(r, hit.t,
+                  [&](uint32_t primIdx, float& tMax)
+                  {
+                      if (!IntersectSphere(spheres[primIdx], r, tMax))
+                          return false;
+                      hit.primIdx = primIdx;
+                      return true;
+                  });
+    return hit;
+}
+
+/// <summary>
+/// Traces random rays from inside and around the spheres, every other one
+/// aimed near a sphere, expecting the same closest hit as testing every
+/// sphere.
+/// </summary>
+auto ExpectSameHits(const Bvh& bvh, const std::vector<Sphere>& spheres,
+                    uint32_t seed) -> void
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, spheres.size() - 1);
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 origin = RandomVec3(rng, -12.0f, 12.0f);
+        const glm::vec3 direction =
+            i % 2 == 0 ? RandomVec3(rng, -1.0f, 1.0f)
+                       : spheres[pick(rng)].center +
+                             RandomVec3(rng, -0.3f, 0.3f) - origin;
+        const ray r(origin, direction);
+        const Hit expected = TraceBruteForce(spheres, r);
+        const Hit actual = TraceBvh(bvh, spheres, r);
+        ASSERT_EQ(actual.primIdx, expected.primIdx) << "ray " << i;
+        ASSERT_EQ(actual.t, expected.t) << "ray " << i;
+        hits += expected.primIdx != std::numeric_limits<uint32_t>::max();
+    }
+    EXPECT_GT(hits, 0u);
+}
+
+/// <summary>
+/// Every primitive sits in exactly one leaf, and the stats match the tree.
+/// </summary>
+auto ExpectWellFormed(const Bvh& bvh, const std::vector<Aabb>& bounds,
+                      const BvhBuildOptions& options) -> void
+{
+    std::vector<uint32_t> sorted = bvh.GetPrimIndices();
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> all(bounds.size());
+    std::iota(all.begin(), all.end(), 0u);
+    EXPECT_EQ(sorted, all);
+
+    uint32_t leafCount = 0;
+    uint32_t leafPrims = 0;
+    for (const BvhNode& node : bvh.GetNodes())
+    {
+        if (!node.IsLeaf())
+            continue;
+        ++leafCount;
+        leafPrims += node.primCount;
+        EXPECT_LE(node.primCount, options.maxLeafSize);
+        for (uint32_t i = 0; i < node.primCount; ++i)
+        {
+            const Aabb& prim =
+                bounds[bvh.GetPrimIndices()[node.offset + i]];
+            EXPECT_EQ(glm::min(node.bounds.min, prim.min), node.bounds.min);
+            EXPECT_EQ(glm::max(node.bounds.max, prim.max), node.bounds.max);
+        }
+    }
+    EXPECT_EQ(leafPrims, bounds.size());
+    EXPECT_EQ(bvh.GetStats().nodeCount, bvh.GetNodes().size());
+    EXPECT_EQ(bvh.GetStats().leafCount, leafCount);
+    EXPECT_FLOAT_EQ(bvh.GetStats().sahCost, bvh.ComputeSahCost());
+}
+
+/// <summary>
+/// Spheres moved by up to distance along each axis.
+/// </summary>
+auto Move(const std::vector<Sphere>& spheres, float distance, uint32_t seed)
+    -> std::vector<Sphere>
+{
+    std::mt19937 rng(seed);
+    std::vector<Sphere> moved = spheres;
+    for (Sphere& sphere : moved)
+        sphere.center += RandomVec3(rng, -distance, distance);
+    return moved;
+}
+} // namespace
+
+class BvhBuildTest
+    : public testing::TestWithParam<std::tuple<uint32_t, uint32_t, uint32_t>>
+{
+};
+
+TEST_P(BvhBuildTest, FindsTheSameHitsAsBruteForce)
+{
+    const auto [primCount, binCount, maxLeafSize] = GetParam();
+    std::mt19937 rng(primCount);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, primCount);
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+
+    BvhBuildOptions options;
+    options.binCount = binCount;
+    options.maxLeafSize = maxLeafSize;
+    Bvh bvh;
+    bvh.Build(bounds, options);
+    ExpectWellFormed(bvh, bounds, options);
+    ExpectSameHits(bvh, spheres, primCount + 1);
+}
+
+// A single leaf, a few levels, a deep tree, and the smallest bin count
+INSTANTIATE_TEST_SUITE_P(Bvh, BvhBuildTest,
+                         testing::Values(std::make_tuple(1u, 16u, 8u),
+                                         std::make_tuple(7u, 16u, 2u),
+                                         std::make_tuple(2000u, 16u, 4u),
+                                         std::make_tuple(2000u, 2u, 1u)));
+
+TEST(BvhTest, StacksOfEqualBoundsStillSplit)
+{
+    // Identical centroids leave the binned SAH nothing to split on
+    const std::vector<Sphere> spheres(50, {glm::vec3{1.0f}, 0.5f});
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+    BvhBuildOptions options;
+    options.maxLeafSize = 4;
+    Bvh bvh;
+    bvh.Build(bounds, options);
+    ExpectWellFormed(bvh, bounds, options);
+}
+
+TEST(BvhTest, EmptyTreeHitsNothing)
+{
+    Bvh bvh;
+    bvh.Build({});
+    EXPECT_TRUE(bvh.IsEmpty());
+    float tMax = std::numeric_limits<float>::infinity();
+    EXPECT_FALSE(bvh.Intersect(ray({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}),
+                               tMax, [](uint32_t, float&) { return true; }));
+}
+
+TEST(BvhTest, RejectsInvalidOptions)
+{
+    const std::vector<Aabb> bounds{Aabb::FromSphere(glm::vec3{0.0f}, 1.0f)};
+    BvhBuildOptions options;
+    options.binCount = 1;
+    Bvh bvh;
+    EXPECT_THROW(bvh.Build(bounds, options), std::invalid_argument);
+    options = {};
+    options.maxLeafSize = 0;
+    EXPECT_THROW(bvh.Build(bounds, options), std::invalid_argument);
+}
+
+// Large enough for the top levels to be split by every thread at once
+TEST(BvhTest, ParallelBuildMatchesSerialBuild)
+{
+    std::mt19937 rng(7);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 100000);
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+
+    BvhBuildOptions serialOptions;
+    serialOptions.threadCount = 1;
+    Bvh serial;
+    serial.Build(bounds, serialOptions);
+
+    TaskPool pool(4);
+    Bvh parallel;
+    parallel.Build(bounds, {}, &pool);
+
+    // The same nodes in the same depth-first order; only the order of the
+    // primitives within a leaf may differ
+    ASSERT_EQ(parallel.GetNodes().size(), serial.GetNodes().size());
+    EXPECT_EQ(std::memcmp(parallel.GetNodes().data(), serial.GetNodes().data(),
+                          serial.GetNodes().size() * sizeof(BvhNode)),
+              0);
+    for (const BvhNode& node : serial.GetNodes())
+    {
+        if (!node.IsLeaf())
+            continue;
+        const auto leafPrims = [&](const Bvh& bvh)
+        {
+            const auto first = bvh.GetPrimIndices().begin() + node.offset;
+            std::vector<uint32_t> prims(first, first + node.primCount);
+            std::sort(prims.begin(), prims.end());
+            return prims;
+        };
+        ASSERT_EQ(leafPrims(parallel), leafPrims(serial));
+    }
+    EXPECT_EQ(parallel.GetStats().sahCost, serial.GetStats().sahCost);
+    ExpectWellFormed(parallel, bounds, {});
+    ExpectSameHits(parallel, spheres, 8);
+}
+
+TEST(BvhTest, RefitFollowsMovedPrimitives)
+{
+    std::mt19937 rng(11);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 3000);
+    Bvh bvh;
+    bvh.Build(GetBounds(spheres));
+    const size_t nodeCount = bvh.GetNodes().size();
+
+    const std::vector<Sphere> moved = Move(spheres, 1.0f, 12);
+    const std::vector<Aabb> bounds = GetBounds(moved);
+    bvh.Refit(bounds);
+    EXPECT_EQ(bvh.GetNodes().size(), nodeCount);
+    EXPECT_EQ(bvh.GetStats().refitCount, 1u);
+    ExpectWellFormed(bvh, bounds, {});
+    ExpectSameHits(bvh, moved, 13);
+
+    EXPECT_THROW(bvh.Refit({bounds.data(), bounds.size() - 1}),
+                 std::invalid_argument);
+}
+
+// Large enough for subtrees to be refit in parallel
+TEST(BvhTest, ParallelRefitMatchesSerialRefit)
+{
+    std::mt19937 rng(21);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 100000);
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+    const std::vector<Aabb> moved = GetBounds(Move(spheres, 0.5f, 22));
+
+    BvhBuildOptions serialOptions;
+    serialOptions.threadCount = 1;
+    Bvh serial;
+    serial.Build(bounds, serialOptions);
+    Bvh parallel;
+    parallel.Build(bounds, serialOptions);
+
+    serial.Refit(moved);
+    TaskPool pool(4);
+    parallel.Refit(moved, &pool);
+    ASSERT_EQ(parallel.GetNodes().size(), serial.GetNodes().size());
+    EXPECT_EQ(std::memcmp(parallel.GetNodes().data(), serial.GetNodes().data(),
+                          serial.GetNodes().size() * sizeof(BvhNode)),
+              0);
+    EXPECT_EQ(parallel.GetStats().sahCost, serial.GetStats().sahCost);
+}
+
+TEST(BvhTest, UpdateRebuildsOnceTheTreeDegrades)
+{
+    std::mt19937 rng(31);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 3000);
+    Bvh bvh;
+    bvh.Build(GetBounds(spheres));
+    EXPECT_EQ(bvh.GetSahDegradation(), 1.0f);
+
+    // A little motion only refits
+    const std::vector<Sphere> nudged = Move(spheres, 0.01f, 32);
+    EXPECT_FALSE(bvh.Update(GetBounds(nudged)));
+    EXPECT_LE(bvh.GetSahDegradation(), BvhBuildOptions{}.maxSahDegradation);
+    ExpectSameHits(bvh, nudged, 33);
+
+    // Scattering every sphere across the scene makes leaves span it
+    std::vector<Sphere> scattered = spheres;
+    std::shuffle(scattered.begin(), scattered.end(), rng);
+    EXPECT_TRUE(bvh.Update(GetBounds(scattered)));
+    EXPECT_EQ(bvh.GetSahDegradation(), 1.0f);
+    EXPECT_EQ(bvh.GetStats().refitCount, 0u);
+    ExpectWellFormed(bvh, GetBounds(scattered), {});
+    ExpectSameHits(bvh, scattered, 34);
+}
+
+TEST(BvhTest, UpdateAlwaysRebuildsWithALimitOfOne)
+{
+    std::mt19937 rng(41);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 100);
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+    for (const float limit : {1.0f, 0.5f})
+    {
+        BvhBuildOptions options;
+        options.maxSahDegradation = limit;
+        Bvh bvh;
+        bvh.Build(bounds, options);
+        EXPECT_TRUE(bvh.Update(bounds)) << "limit " << limit;
+        EXPECT_TRUE(bvh.Update(bounds)) << "limit " << limit;
+    }
+}
+
+TEST(BvhTest, RejectsOptionsOutOfRange)
+{
+    const std::vector<Aabb> bounds{Aabb::FromSphere(glm::vec3{0.0f}, 1.0f)};
+    BvhBuildOptions options;
+    options.binCount = BvhBuildOptions::MAX_BIN_COUNT + 1;
+    Bvh bvh;
+    EXPECT_THROW(bvh.Build(bounds, options), std::invalid_argument);
+    options = {};
+    options.traversalCost = std::numeric_limits<float>::quiet_NaN();
+    EXPECT_THROW(bvh.Build(bounds, options), std::invalid_argument);
+    options = {};
+    options.intersectionCost = -1.0f;
+    EXPECT_THROW(bvh.Build(bounds, options), std::invalid_argument);
+}
+
+// Trees read back from a file are adopted through Assign() only if
+// IsValid() holds, so it has to catch anything traversal would trip over
+TEST(BvhTest, IsValidRejectsCorruptTrees)
+{
+    constexpr uint32_t PRIM_COUNT = 1000;
+    std::mt19937 rng(51);
+    const std::vector<Aabb> bounds =
+        GetBounds(RandomSpheres(rng, PRIM_COUNT));
+    Bvh bvh;
+    bvh.Build(bounds);
+    ASSERT_TRUE(bvh.IsValid(PRIM_COUNT));
+    EXPECT_FALSE(bvh.IsValid(PRIM_COUNT - 1));
+
+    const auto isValidAfter = [&](auto&& corrupt)
+    {
+        Bvh::NodeArray nodes = bvh.GetNodes();
+        std::vector<uint32_t> primIndices = bvh.GetPrimIndices();
+        corrupt(nodes, primIndices);
+        Bvh assigned;
+        assigned.Assign(std::move(nodes), std::move(primIndices),
+                        bvh.GetOptions(), bvh.GetStats());
+        return assigned.IsValid(PRIM_COUNT);
+    };
+    const auto firstLeaf = [](Bvh::NodeArray& nodes) -> BvhNode&
+    {
+        return *std::find_if(nodes.begin(), nodes.end(),
+                             [](const BvhNode& node) { return node.IsLeaf(); });
+    };
+    using Prims = std::vector<uint32_t>;
+
+    EXPECT_TRUE(isValidAfter([](Bvh::NodeArray&, Prims&) {}));
+    EXPECT_FALSE(isValidAfter([](Bvh::NodeArray&, Prims& prims)
+                              { prims[prims.size() / 2] = PRIM_COUNT; }));
+    EXPECT_FALSE(isValidAfter(
+        [&](Bvh::NodeArray& nodes, Prims& prims)
+        { firstLeaf(nodes).offset = static_cast<uint32_t>(prims.size()); }));
+    EXPECT_FALSE(isValidAfter(
+        [&](Bvh::NodeArray& nodes, Prims&)
+        { firstLeaf(nodes).primCount = PRIM_COUNT + 1; }));
+    // Right children pointing back, at the left child or past the end
+    for (const uint32_t offset : {0u, 1u, PRIM_COUNT * 2})
+    {
+        EXPECT_FALSE(isValidAfter([&](Bvh::NodeArray& nodes, Prims&)
+                                  { nodes[0].offset = offset; }))
+            << "offset " << offset;
+    }
+    // A node no path reaches
+    EXPECT_FALSE(isValidAfter([](Bvh::NodeArray& nodes, Prims&)
+                              { nodes.push_back(nodes.back()); }));
+    EXPECT_FALSE(isValidAfter([](Bvh::NodeArray& nodes, Prims&)
+                              { nodes.clear(); }));
+}
+
+} // namespace pathtracer
@@ -0,0 +1,407 @@
+#include "cpu/accumulation_buffer.h"
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/triangle_mesh.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+namespace pathtracer
+{
+namespace
+{
+// Not a multiple of the tile size, so partial tiles are rendered too
+constexpr uint32_t WIDTH = 72;
+constexpr uint32_t HEIGHT = 40;
+constexpr uint32_t TILE_SIZE = 16;
+constexpr uint32_t THREAD_COUNT = 2;
+constexpr uint32_t FRAME_COUNT = 3;
+constexpr uint32_t MAX_HISTORY = 2;
+
+auto Translation(const glm::vec3& offset) -> glm::mat4
+{
+    glm::mat4 transform(1.0f);
+    transform[3] = glm::vec4(offset, 1.0f);
+    return transform;
+}
+
+/// <summary>
+/// A closed box of loose triangles lit by a small sphere, with a mesh
+/// placed twice and a grid of sphereGrid x sphereGrid small spheres on its
+/// floor; more than a few spheres are traced through the BVH8.
+/// </summary>
+auto CreateBox(uint32_t sphereGrid) -> Scene
+{
+    Scene scene;
+    const MaterialHandle white = scene.AddMaterial({color{0.75f}});
+    const MaterialHandle red =
+        scene.AddMaterial({color{0.75f, 0.15f, 0.15f}});
+    const MaterialHandle light =
+        scene.AddMaterial({color{0.0f}, color{30.0f}});
+
+    const auto addQuad = [&](const glm::vec3& a, const glm::vec3& b,
+                             const glm::vec3& c, const glm::vec3& d,
+                             MaterialHandle material)
+    {
+        scene.AddTriangle(a, b, c, material);
+        scene.AddTriangle(a, c, d, material);
+    };
+
+    constexpr float S = 2.0f;
+    constexpr float BACK = -2.0f;
+    constexpr float FRONT = 6.0f;
+    addQuad({-S, -S, BACK}, {S, -S, BACK}, {S, S, BACK}, {-S, S, BACK},
+            white);
+    addQuad({-S, -S, FRONT}, {-S, S, FRONT}, {S, S, FRONT}, {S, -S, FRONT},
+            white);
+    addQuad({-S, -S, BACK}, {-S, -S, FRONT}, {S, -S, FRONT}, {S, -S, BACK},
+            white);
+    addQuad({-S, S, BACK}, {S, S, BACK}, {S, S, FRONT}, {-S, S, FRONT},
+            white);
+    addQuad({-S, -S, BACK}, {-S, S, BACK}, {-S, S, FRONT}, {-S, -S, FRONT},
+            red);
+    addQuad({S, -S, BACK}, {S, -S, FRONT}, {S, S, FRONT}, {S, S, BACK},
+            white);
+    scene.AddSphere({0.0f, 1.7f, 0.0f}, 0.15f, light);
+
+    TriangleMesh tetrahedron;
+    const uint32_t v0 = tetrahedron.AddVertex({-0.5f, 0.0f, -0.5f});
+    const uint32_t v1 = tetrahedron.AddVertex({0.5f, 0.0f, -0.5f});
+    const uint32_t v2 = tetrahedron.AddVertex({0.0f, 0.0f, 0.5f});
+    const uint32_t v3 = tetrahedron.AddVertex({0.0f, 0.8f, 0.0f});
+    tetrahedron.AddTriangle(v0, v2, v1);
+    tetrahedron.AddTriangle(v0, v1, v3);
+    tetrahedron.AddTriangle(v1, v2, v3);
+    tetrahedron.AddTriangle(v2, v0, v3);
+    const MeshHandle mesh = scene.AddMesh(std::move(tetrahedron), white);
+    scene.AddInstance(mesh, Translation({-0.9f, -2.0f, -0.8f}));
+    scene.AddInstance(mesh, Translation({0.9f, -2.0f, -0.4f}), red);
+
+    const float spacing = 3.6f / static_cast<float>(sphereGrid);
+    for (uint32_t z = 0; z < sphereGrid; ++z)
+    {
+        for (uint32_t x = 0; x < sphereGrid; ++x)
+        {
+            const glm::vec3 center{-1.8f + (x + 0.5f) * spacing, -1.9f,
+                                   -1.8f + (z + 0.5f) * spacing};
+            scene.AddSphere(center, 0.3f * spacing, white);
+        }
+    }
+    return scene;
+}
+
+auto Render(Scene& scene, Integrator integrator, ExecutionMode mode,
+            bool sortRays = false) -> Framebuffer
+{
+    Camera camera(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT,
+                  0.1f, 1000.0f);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    pathtracer.SetIntegrator(integrator);
+    pathtracer.SetExecutionMode(mode);
+    pathtracer.SetRaySorting(sortRays);
+
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        pathtracer.Render(framebuffer, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+    return framebuffer;
+}
+
+auto IsBlack(const Framebuffer& framebuffer) -> bool
+{
+    for (const glm::vec4& pixel : framebuffer.GetPixels())
+    {
+        if (pixel.r > 0.0f || pixel.g > 0.0f || pixel.b > 0.0f)
+            return false;
+    }
+    return true;
+}
+
+auto ExpectSameImage(const Framebuffer& a, const Framebuffer& b) -> void
+{
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        ASSERT_EQ(std::memcmp(a.GetRow(y), b.GetRow(y),
+                              WIDTH * sizeof(glm::vec4)),
+                  0)
+            << "row " << y;
+    }
+}
+
+/// <summary>
+/// Renders frames of scene with adaptive sampling until the path tracer
+/// reports convergence or maxFrames have been rendered, and returns the
+/// number of frames.
+/// </summary>
+auto RenderUntilConverged(CpuPathtracer& pathtracer, Scene& scene,
+                          Framebuffer& framebuffer, uint32_t maxFrames)
+    -> uint32_t
+{
+    Camera camera(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT,
+                  0.1f, 1000.0f);
+    uint32_t frame = 0;
+    while (frame < maxFrames && !pathtracer.IsConverged())
+    {
+        pathtracer.Render(framebuffer, camera, frame++, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+    return frame;
+}
+
+/// <summary>
+/// An 8 x 8 wall centered at (0, 0, depth), turned by tilt radians around
+/// the vertical axis, lit by a small sphere.
+/// </summary>
+auto CreateWall(float depth, float tilt) -> Scene
+{
+    Scene scene;
+    const MaterialHandle white = scene.AddMaterial({color{0.75f}});
+    const MaterialHandle light =
+        scene.AddMaterial({color{0.0f}, color{30.0f}});
+    const glm::vec3 right{4.0f * std::cos(tilt), 0.0f, 4.0f * std::sin(tilt)};
+    const glm::vec3 up{0.0f, 4.0f, 0.0f};
+    const glm::vec3 center{0.0f, 0.0f, depth};
+    scene.AddTriangle(center - right - up, center + right - up,
+                      center + right + up, white);
+    scene.AddTriangle(center - right - up, center + right + up,
+                      center - right + up, white);
+    scene.AddSphere({0.0f, 1.5f, 1.0f}, 0.2f, light);
+    return scene;
+}
+
+/// <summary>
+/// Renders FRAME_COUNT frames of before, turns the camera a little and
+/// renders one frame of after, as if the scene had not changed.
+/// </summary>
+auto RenderMoved(CpuPathtracer& pathtracer, Scene& before, Scene& after)
+    -> Framebuffer
+{
+    Camera camera(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT,
+                  0.1f, 1000.0f);
+    pathtracer.SetTemporalReprojection(true, MAX_HISTORY);
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        pathtracer.Render(framebuffer, camera, frame, before);
+        camera.ClearDirty();
+        before.ClearChanges();
+    }
+    camera.Rotate(0.01f, 0.0f);
+    after.ClearChanges();
+    pathtracer.Render(framebuffer, camera, FRAME_COUNT, after);
+    return framebuffer;
+}
+
+auto GetCenterSampleCount(const CpuPathtracer& pathtracer) -> uint32_t
+{
+    return pathtracer.GetAccumulation().GetSampleCount(WIDTH / 2, HEIGHT / 2);
+}
+} // namespace
+
+class WavefrontTest
+    : public testing::TestWithParam<std::tuple<Integrator, uint32_t>>
+{
+};
+
+TEST_P(WavefrontTest, MatchesPerPathBitForBit)
+{
+    const auto [integrator, sphereGrid] = GetParam();
+    Scene scene = CreateBox(sphereGrid);
+    const Framebuffer perPath =
+        Render(scene, integrator, ExecutionMode::PerPath);
+    const Framebuffer wavefront =
+        Render(scene, integrator, ExecutionMode::Wavefront);
+    ASSERT_FALSE(IsBlack(perPath));
+    ExpectSameImage(perPath, wavefront);
+}
+
+TEST_P(WavefrontTest, SortedRaysMatchPerPathBitForBit)
+{
+    const auto [integrator, sphereGrid] = GetParam();
+    Scene scene = CreateBox(sphereGrid);
+    const Framebuffer perPath =
+        Render(scene, integrator, ExecutionMode::PerPath);
+    const Framebuffer sorted =
+        Render(scene, integrator, ExecutionMode::Wavefront, true);
+    ExpectSameImage(perPath, sorted);
+}
+
+// A 1x1 grid stays under the sphere packet limit, a 4x4 grid goes over it
+INSTANTIATE_TEST_SUITE_P(
+    CpuPathtracer, WavefrontTest,
+    testing::Combine(testing::Values(Integrator::Naive,
+                                     Integrator::NextEvent),
+                     testing::Values(1u, 4u)));
+
+class AdaptiveSamplingTest : public testing::TestWithParam<ExecutionMode>
+{
+};
+
+// Any error passes the threshold, so pixels stop at exactly minSamples
+TEST_P(AdaptiveSamplingTest, TakesMinSamplesFirst)
+{
+    constexpr uint32_t MIN_SAMPLES = 5;
+    Scene scene = CreateBox(1);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    pathtracer.SetExecutionMode(GetParam());
+    pathtracer.SetAdaptiveSampling(1e30f, MIN_SAMPLES);
+    Camera camera(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT,
+                  0.1f, 1000.0f);
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    Framebuffer converged(WIDTH, HEIGHT);
+    for (uint32_t frame = 0; frame < MIN_SAMPLES + 2; ++frame)
+    {
+        pathtracer.Render(framebuffer, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+
+        const uint32_t samples = std::min(frame + 1, MIN_SAMPLES);
+        for (uint32_t y = 0; y < HEIGHT; ++y)
+        {
+            for (uint32_t x = 0; x < WIDTH; ++x)
+            {
+                ASSERT_EQ(pathtracer.GetAccumulation().GetSampleCount(x, y),
+                          samples)
+                    << "frame " << frame << ", pixel " << x << ", " << y;
+            }
+        }
+        EXPECT_EQ(pathtracer.IsConverged(), samples == MIN_SAMPLES);
+        EXPECT_EQ(pathtracer.GetUnconvergedPixelCount(),
+                  samples == MIN_SAMPLES ? 0u : WIDTH * HEIGHT);
+        if (frame + 1 == MIN_SAMPLES)
+            converged = framebuffer;
+    }
+    // Converged pixels keep showing their mean
+    ExpectSameImage(framebuffer, converged);
+}
+
+TEST_P(AdaptiveSamplingTest, StopsEachPixelAtTheThreshold)
+{
+    constexpr float THRESHOLD = 0.1f;
+    constexpr uint32_t MIN_SAMPLES = 8;
+    Scene scene = CreateBox(1);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetExecutionMode(GetParam());
+    pathtracer.SetAdaptiveSampling(THRESHOLD, MIN_SAMPLES);
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    const uint32_t frames =
+        RenderUntilConverged(pathtracer, scene, framebuffer, 2000);
+    ASSERT_TRUE(pathtracer.IsConverged());
+    EXPECT_EQ(pathtracer.GetUnconvergedPixelCount(), 0u);
+
+    const AccumulationBuffer& accumulation = pathtracer.GetAccumulation();
+    uint32_t fewest = frames;
+    uint32_t most = 0;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            const uint32_t samples = accumulation.GetSampleCount(x, y);
+            EXPECT_GE(samples, MIN_SAMPLES) << x << ", " << y;
+            EXPECT_LE(accumulation.GetRelativeError(x, y), THRESHOLD)
+                << x << ", " << y;
+            fewest = std::min(fewest, samples);
+            most = std::max(most, samples);
+        }
+    }
+    // Pixels stopped on their own: the last ones took every frame, while
+    // smooth ones stopped early
+    EXPECT_EQ(most, frames);
+    EXPECT_LT(fewest, frames / 2);
+
+    // Lowering the threshold resumes sampling where it is still too high
+    pathtracer.SetAdaptiveSampling(THRESHOLD / 2, MIN_SAMPLES);
+    EXPECT_FALSE(pathtracer.IsConverged());
+    RenderUntilConverged(pathtracer, scene, framebuffer, 1);
+    EXPECT_GT(pathtracer.GetUnconvergedPixelCount(), 0u);
+}
+
+// Both execution modes skip the same pixels, so they converge alike
+TEST(AdaptiveSampling, WavefrontMatchesPerPathBitForBit)
+{
+    Scene scene = CreateBox(1);
+    Framebuffer images[2] = {{WIDTH, HEIGHT}, {WIDTH, HEIGHT}};
+    uint32_t frames[2] = {};
+    const ExecutionMode modes[2] = {ExecutionMode::PerPath,
+                                    ExecutionMode::Wavefront};
+    for (int i = 0; i < 2; ++i)
+    {
+        CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+        pathtracer.SetIntegrator(Integrator::NextEvent);
+        pathtracer.SetExecutionMode(modes[i]);
+        pathtracer.SetAdaptiveSampling(0.2f, 4);
+        frames[i] = RenderUntilConverged(pathtracer, scene, images[i], 500);
+    }
+    EXPECT_EQ(frames[0], frames[1]);
+    ExpectSameImage(images[0], images[1]);
+}
+
+INSTANTIATE_TEST_SUITE_P(CpuPathtracer, AdaptiveSamplingTest,
+                         testing::Values(ExecutionMode::PerPath,
+                                         ExecutionMode::Wavefront));
+
+TEST(ReprojectionTest, KeepsHistoryOfAStaticSurface)
+{
+    Scene before = CreateWall(-2.0f, 0.0f);
+    Scene after = CreateWall(-2.0f, 0.0f);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    RenderMoved(pathtracer, before, after);
+
+    // History counts as at most MAX_HISTORY samples, plus the new one
+    EXPECT_EQ(GetCenterSampleCount(pathtracer), MAX_HISTORY + 1);
+    uint32_t kept = 0;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+            kept += pathtracer.GetAccumulation().GetSampleCount(x, y) > 1;
+    }
+    EXPECT_GT(kept, WIDTH * HEIGHT / 4);
+}
+
+TEST(ReprojectionTest, DropsHistoryOnDepthMismatch)
+{
+    Scene before = CreateWall(-2.0f, 0.0f);
+    Scene after = CreateWall(-1.0f, 0.0f);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    RenderMoved(pathtracer, before, after);
+    EXPECT_EQ(GetCenterSampleCount(pathtracer), 1u);
+}
+
+TEST(ReprojectionTest, DropsHistoryOnNormalMismatch)
+{
+    // The turned wall still passes through the center at the same depth
+    Scene before = CreateWall(-2.0f, 0.0f);
+    Scene after = CreateWall(-2.0f, glm::radians(45.0f));
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    RenderMoved(pathtracer, before, after);
+    EXPECT_EQ(GetCenterSampleCount(pathtracer), 1u);
+}
+
+// Surfaces landing on the same pixel are resolved in parallel; the result
+// must not depend on which thread gets there first
+TEST(ReprojectionTest, IsIndependentOfThreadCount)
+{
+    Scene before = CreateBox(4);
+    Scene after = CreateBox(4);
+    CpuPathtracer serial(WIDTH, HEIGHT, 1, TILE_SIZE);
+    const Framebuffer a = RenderMoved(serial, before, after);
+    CpuPathtracer parallel(WIDTH, HEIGHT, THREAD_COUNT, TILE_SIZE);
+    const Framebuffer b = RenderMoved(parallel, before, after);
+    ExpectSameImage(a, b);
+}
+
+} // namespace pathtracer
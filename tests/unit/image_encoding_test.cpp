@@ -0,0 +1,230 @@
+#include "cpu/task_pool.h"
+#include "io/image_encoding.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#ifdef USE_STB
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#define STBI_ONLY_PNG
+#include <stb_image.h>
+#pragma GCC diagnostic pop
+#endif
+
+namespace pathtracer
+{
+namespace
+{
+auto ReadBe32(const uint8_t* bytes) -> uint32_t
+{
+    return (static_cast<uint32_t>(bytes[0]) << 24) |
+           (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+auto Adler32(std::span<const uint8_t> data) -> uint32_t
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (const uint8_t byte : data)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+/// <summary>
+/// Width x height RGBA8 pixels: bands of noise, which deflate stores or
+/// codes literally, between flat and gradient bands, which it codes as
+/// long matches.
+/// </summary>
+auto MakePixels(uint32_t width, uint32_t height) -> std::vector<uint32_t>
+{
+    std::mt19937 rng(width * 31 + height);
+    std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t& pixel = pixels[static_cast<size_t>(y) * width + x];
+            switch (y / 24 % 3)
+            {
+            case 0:
+                pixel = rng();
+                break;
+            case 1:
+                pixel = 0xFF336699u;
+                break;
+            default:
+                pixel = 0xFF000000u | (x * 5 % 256) << 8 | (y * 3 % 256);
+                break;
+            }
+        }
+    }
+    return pixels;
+}
+
+/// <summary>
+/// The concatenated IDAT data of a PNG file, after checking the chunk
+/// layout and the image header.
+/// </summary>
+auto GetZlibStream(const std::vector<uint8_t>& png, uint32_t width,
+                   uint32_t height) -> std::vector<uint8_t>
+{
+    constexpr uint8_t SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                     '\n'};
+    EXPECT_GE(png.size(), sizeof(SIGNATURE));
+    EXPECT_TRUE(std::equal(std::begin(SIGNATURE), std::end(SIGNATURE),
+                           png.begin()));
+
+    std::vector<uint8_t> zlib;
+    std::vector<std::string> types;
+    size_t pos = sizeof(SIGNATURE);
+    while (pos + 12 <= png.size())
+    {
+        const uint32_t length = ReadBe32(&png[pos]);
+        const std::string type(png.begin() + pos + 4, png.begin() + pos + 8);
+        const uint8_t* data = &png[pos + 8];
+        if (type == "IHDR")
+        {
+            EXPECT_EQ(ReadBe32(data), width);
+            EXPECT_EQ(ReadBe32(data + 4), height);
+        }
+        else if (type == "IDAT")
+        {
+            zlib.insert(zlib.end(), data, data + length);
+        }
+        types.push_back(type);
+        pos += 12 + static_cast<size_t>(length);
+    }
+    EXPECT_EQ(pos, png.size());
+    EXPECT_GE(types.size(), 3u);
+    EXPECT_EQ(types.front(), "IHDR");
+    EXPECT_EQ(types.back(), "IEND");
+    return zlib;
+}
+
+/// <summary>
+/// Undoes the PNG filter of every scanline of 8-bit RGB data.
+/// </summary>
+auto Unfilter(const std::vector<uint8_t>& filtered, uint32_t width,
+              uint32_t height) -> std::vector<uint8_t>
+{
+    constexpr size_t BPP = 3;
+    const size_t rowSize = static_cast<size_t>(width) * BPP;
+    std::vector<uint8_t> rgb(rowSize * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t filter = filtered[y * (rowSize + 1)];
+        const uint8_t* in = &filtered[y * (rowSize + 1) + 1];
+        uint8_t* out = &rgb[y * rowSize];
+        const uint8_t* up = y > 0 ? out - rowSize : nullptr;
+        for (size_t i = 0; i < rowSize; ++i)
+        {
+            const int a = i >= BPP ? out[i - BPP] : 0;
+            const int b = up ? up[i] : 0;
+            const int c = up && i >= BPP ? up[i - BPP] : 0;
+            int predictor = 0;
+            switch (filter)
+            {
+            case 0:
+                break;
+            case 1:
+                predictor = a;
+                break;
+            case 2:
+                predictor = b;
+                break;
+            case 3:
+                predictor = (a + b) / 2;
+                break;
+            case 4:
+            {
+                const int p = a + b - c;
+                const int pa = std::abs(p - a);
+                const int pb = std::abs(p - b);
+                const int pc = std::abs(p - c);
+                predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                break;
+            }
+            default:
+                ADD_FAILURE() << "Invalid filter " << int{filter} << " in row "
+                              << y;
+                return rgb;
+            }
+            out[i] = static_cast<uint8_t>(in[i] + predictor);
+        }
+    }
+    return rgb;
+}
+} // namespace
+
+class PngEncodingTest : public testing::TestWithParam<uint32_t>
+{
+};
+
+// The blocks deflated on separate threads are stitched into one zlib
+// stream (ToDeflateSegment, FindDeflateEnd); a standalone inflater has to
+// read it back to the exact pixels, with a matching Adler-32
+TEST_P(PngEncodingTest, ZlibStreamInflatesToThePixels)
+{
+    if (!IsPngSupported())
+        GTEST_SKIP() << "Built without stb";
+#ifdef USE_STB
+    constexpr uint32_t WIDTH = 37;
+    const uint32_t height = GetParam();
+    const std::vector<uint32_t> pixels = MakePixels(WIDTH, height);
+
+    TaskPool pool(3);
+    const std::vector<uint8_t> png = EncodePng(WIDTH, height, pixels, pool);
+    const std::vector<uint8_t> zlib = GetZlibStream(png, WIDTH, height);
+    ASSERT_GE(zlib.size(), 6u);
+    ASSERT_EQ((zlib[0] << 8 | zlib[1]) % 31, 0);
+    ASSERT_EQ(zlib[0] & 0x0F, 8);
+
+    int size = 0;
+    char* inflated =
+        stbi_zlib_decode_malloc(reinterpret_cast<const char*>(zlib.data()),
+                                static_cast<int>(zlib.size()), &size);
+    ASSERT_NE(inflated, nullptr);
+    const std::vector<uint8_t> filtered(inflated, inflated + size);
+    STBI_FREE(inflated);
+
+    ASSERT_EQ(filtered.size(), static_cast<size_t>(WIDTH * 3 + 1) * height);
+    EXPECT_EQ(Adler32(filtered), ReadBe32(&zlib[zlib.size() - 4]));
+
+    const std::vector<uint8_t> rgb = Unfilter(filtered, WIDTH, height);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        ASSERT_EQ(rgb[i * 3], pixels[i] & 0xFF) << "pixel " << i;
+        ASSERT_EQ(rgb[i * 3 + 1], pixels[i] >> 8 & 0xFF) << "pixel " << i;
+        ASSERT_EQ(rgb[i * 3 + 2], pixels[i] >> 16 & 0xFF) << "pixel " << i;
+    }
+
+    // The blocks are independent of the threads they were deflated on
+    TaskPool single(1);
+    EXPECT_EQ(EncodePng(WIDTH, height, pixels, single), png);
+#endif
+}
+
+// One block, one row short of and past a block boundary, several blocks
+// with a short last one
+INSTANTIATE_TEST_SUITE_P(ImageEncoding, PngEncodingTest,
+                         testing::Values(1u, 63u, 64u, 65u, 200u));
+
+} // namespace pathtracer
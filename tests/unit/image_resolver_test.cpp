@@ -0,0 +1,226 @@
+#include "cpu/accumulation_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/image_resolver.h"
+#include "cpu/tile_scheduler.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+// Not a multiple of the tile size or of the row chunks
+constexpr uint32_t WIDTH = 141;
+constexpr uint32_t HEIGHT = 37;
+
+/// <summary>
+/// The 8-bit sRGB value of linear radiance c after exposure and tonemap,
+/// before rounding, computed in double precision with pow().
+/// </summary>
+auto Reference(float c, float exposure, Tonemap tonemap) -> double
+{
+    double v = static_cast<double>(c) * std::exp2(exposure);
+    if (tonemap == Tonemap::Reinhard)
+        v = v / (1.0 + v);
+    else if (tonemap == Tonemap::Aces)
+        v = (v * (2.51 * v + 0.03)) / (v * (2.43 * v + 0.59) + 0.14);
+    v = std::clamp(v, 0.0, 1.0);
+    const double encoded = v <= 0.0031308
+                               ? 12.92 * v
+                               : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+    return 255.0 * encoded;
+}
+
+auto GetChannel(uint32_t pixel, int channel) -> uint32_t
+{
+    return pixel >> (8 * channel) & 0xFF;
+}
+
+/// <summary>
+/// Random radiance up to 4 in every pixel, as the sum of 1 to 4 equal
+/// samples, and the same means in a framebuffer.
+/// </summary>
+auto Fill(AccumulationBuffer& accumulation, Framebuffer& framebuffer) -> void
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> radiance(0.0f, 4.0f);
+    std::uniform_int_distribution<uint32_t> samples(1, 4);
+    accumulation.Resize(WIDTH, HEIGHT);
+    framebuffer = Framebuffer(WIDTH, HEIGHT);
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            // Some pixels dark, where the sRGB curve is steepest
+            const float scale = x % 5 == 0 ? 0.001f : 1.0f;
+            const glm::vec3 c =
+                glm::vec3{radiance(rng), radiance(rng), radiance(rng)} *
+                scale;
+            const uint32_t count = samples(rng);
+            for (uint32_t s = 0; s < count; ++s)
+                accumulation.AddSample(x, y, c);
+            framebuffer.GetRow(y)[x] = glm::vec4{c, 1.0f};
+        }
+    }
+}
+
+auto Resolve(const AccumulationBuffer& accumulation,
+             const ResolveSettings& settings, uint32_t threadCount = 2,
+             uint32_t tileSize = 16) -> std::vector<uint32_t>
+{
+    TileScheduler scheduler(threadCount, tileSize);
+    ImageResolver resolver;
+    resolver.SetSettings(settings);
+    std::vector<uint32_t> pixels(WIDTH * HEIGHT);
+    resolver.Resolve(accumulation, pixels, scheduler);
+    return pixels;
+}
+} // namespace
+
+class ImageResolverTest
+    : public testing::TestWithParam<std::tuple<Tonemap, float, bool>>
+{
+};
+
+// Without dither a byte is the reference rounded to nearest, give or take
+// the error of the table; with it, one of the two bytes around it
+TEST_P(ImageResolverTest, FollowsTheReferenceCurve)
+{
+    const auto [tonemap, exposure, dither] = GetParam();
+    AccumulationBuffer accumulation;
+    Framebuffer framebuffer;
+    Fill(accumulation, framebuffer);
+    ResolveSettings settings;
+    settings.tonemap = tonemap;
+    settings.exposure = exposure;
+    settings.dither = dither;
+
+    TileScheduler scheduler(2, 16);
+    ImageResolver resolver;
+    resolver.SetSettings(settings);
+    std::vector<uint32_t> fromAccumulation(WIDTH * HEIGHT);
+    resolver.Resolve(accumulation, fromAccumulation, scheduler);
+    std::vector<uint32_t> fromFramebuffer(WIDTH * HEIGHT);
+    resolver.Resolve(framebuffer, fromFramebuffer, scheduler);
+
+    const double tolerance = (dither ? 1.0 : 0.5) + 0.15;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            const uint32_t idx = y * WIDTH + x;
+            const glm::vec4 c = framebuffer.GetRow(y)[x];
+            EXPECT_EQ(fromAccumulation[idx] >> 24, 0xFFu);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                const double expected =
+                    Reference(c[channel], exposure, tonemap);
+                const auto actual = static_cast<double>(
+                    GetChannel(fromAccumulation[idx], channel));
+                ASSERT_NEAR(actual, expected, tolerance)
+                    << x << ", " << y << " channel " << channel;
+                const auto direct = static_cast<double>(
+                    GetChannel(fromFramebuffer[idx], channel));
+                ASSERT_NEAR(direct, expected, tolerance)
+                    << x << ", " << y << " channel " << channel;
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ImageResolver, ImageResolverTest,
+    testing::Combine(testing::Values(Tonemap::None, Tonemap::Reinhard,
+                                     Tonemap::Aces),
+                     testing::Values(-1.0f, 0.0f, 1.5f), testing::Bool()));
+
+// Dithering rounds a flat value up as often as its fraction says, so the
+// mean over many pixels matches it where rounding to nearest cannot
+TEST(ImageResolver, DitherKeepsTheMeanOfFlatAreas)
+{
+    AccumulationBuffer accumulation(WIDTH, HEIGHT);
+    const float gray = 0.2f;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+            accumulation.AddSample(x, y, glm::vec3{gray});
+    }
+    const double expected = Reference(gray, 0.0f, Tonemap::None);
+    ASSERT_GT(std::abs(expected - std::round(expected)), 0.2);
+
+    ResolveSettings settings;
+    for (const bool dither : {false, true})
+    {
+        settings.dither = dither;
+        const std::vector<uint32_t> pixels = Resolve(accumulation, settings);
+        double sum = 0.0;
+        for (const uint32_t pixel : pixels)
+            sum += GetChannel(pixel, 1);
+        const double mean = sum / pixels.size();
+        if (dither)
+            EXPECT_NEAR(mean, expected, 0.05);
+        else
+            EXPECT_EQ(mean, std::round(expected));
+    }
+}
+
+TEST(ImageResolver, PacksEitherByteOrder)
+{
+    AccumulationBuffer accumulation(WIDTH, HEIGHT);
+    accumulation.AddSample(0, 0, glm::vec3{1.0f, 0.0f, 0.2f});
+    accumulation.AddSample(1, 0, glm::vec3{-1.0f, 8.0f, 0.0f});
+    accumulation.AddSample(
+        2, 0, glm::vec3{std::numeric_limits<float>::quiet_NaN(), 0.0f, 1.0f});
+
+    ResolveSettings settings;
+    settings.dither = false;
+    const std::vector<uint32_t> rgba = Resolve(accumulation, settings);
+    settings.format = PixelFormat::Bgra8;
+    const std::vector<uint32_t> bgra = Resolve(accumulation, settings);
+
+    const auto blue = static_cast<uint32_t>(
+        std::round(Reference(0.2f, 0.0f, Tonemap::None)));
+    EXPECT_EQ(rgba[0], 0xFF0000FFu | blue << 16);
+    EXPECT_EQ(bgra[0], 0xFFFF0000u | blue);
+    // Negative and NaN radiance are black, too much clips
+    EXPECT_EQ(rgba[1], 0xFF00FF00u);
+    EXPECT_EQ(rgba[2], 0xFFFF0000u);
+    EXPECT_EQ(bgra[2], 0xFF0000FFu);
+    // Pixels without samples are black
+    EXPECT_EQ(rgba[3], 0xFF000000u);
+    EXPECT_EQ(rgba.back(), 0xFF000000u);
+}
+
+// The dither is hashed from the pixel index, not from the tile or thread
+TEST(ImageResolver, IsIndependentOfTilesAndThreads)
+{
+    AccumulationBuffer accumulation;
+    Framebuffer framebuffer;
+    Fill(accumulation, framebuffer);
+    ResolveSettings settings;
+    settings.tonemap = Tonemap::Aces;
+    EXPECT_EQ(Resolve(accumulation, settings, 1, 64),
+              Resolve(accumulation, settings, 3, 8));
+}
+
+TEST(ImageResolver, RejectsTargetsOfTheWrongSize)
+{
+    const AccumulationBuffer accumulation(WIDTH, HEIGHT);
+    TileScheduler scheduler(1);
+    ImageResolver resolver;
+    std::vector<uint32_t> pixels(WIDTH * HEIGHT - 1);
+    EXPECT_THROW(resolver.Resolve(accumulation, pixels, scheduler),
+                 std::invalid_argument);
+}
+
+} // namespace pathtracer
@@ -0,0 +1,156 @@
+#include "cpu/intersection.h"
+#include "cpu/sphere_buffer.h"
+#include "ray/ray.h"
+#include "ray/ray_packet.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <random>
+
+namespace pathtracer
+{
+namespace
+{
+auto RandomVec3(std::mt19937& rng, float lo, float hi) -> glm::vec3
+{
+    std::uniform_real_distribution<float> dist(lo, hi);
+    return {dist(rng), dist(rng), dist(rng)};
+}
+
+auto RandomSpheres(std::mt19937& rng, uint32_t count) -> SphereBuffer
+{
+    std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+    SphereBuffer spheres;
+    for (uint32_t i = 0; i < count; ++i)
+        spheres.Add(RandomVec3(rng, -10.0f, 10.0f), radius(rng));
+    return spheres;
+}
+
+auto RandomRay(std::mt19937& rng) -> ray
+{
+    return ray(RandomVec3(rng, -12.0f, 12.0f), RandomVec3(rng, -1.0f, 1.0f));
+}
+} // namespace
+
+TEST(SphereIntersection, SimdMatchesScalarBitForBit)
+{
+    std::mt19937 rng(7);
+
+    // Counts around the block size, so the padded tail is exercised too
+    for (uint32_t count : {1u, 3u, SphereBuffer::BLOCK_SIZE,
+                           SphereBuffer::BLOCK_SIZE + 1, 61u, 256u})
+    {
+        const SphereBuffer spheres = RandomSpheres(rng, count);
+        for (int i = 0; i < 2000; ++i)
+        {
+            const ray r = RandomRay(rng);
+            const float tMax = i % 4 == 0 ? 5.0f : 1e30f;
+
+            float scalarT = -1.0f;
+            uint32_t scalarIdx = 0;
+            const bool scalarHit =
+                IntersectSpheresScalar(r, spheres, tMax, scalarT, scalarIdx);
+
+            float simdT = -1.0f;
+            uint32_t simdIdx = 0;
+            const bool simdHit =
+                IntersectSpheres(r, spheres, tMax, simdT, simdIdx);
+
+            ASSERT_EQ(scalarHit, simdHit);
+            ASSERT_EQ(scalarIdx, simdIdx);
+            ASSERT_EQ(std::bit_cast<uint32_t>(scalarT),
+                      std::bit_cast<uint32_t>(simdT));
+        }
+    }
+}
+
+TEST(SphereIntersection, TiesGoToTheLowerIndex)
+{
+    SphereBuffer spheres;
+    for (uint32_t i = 0; i < SphereBuffer::BLOCK_SIZE + 3; ++i)
+        spheres.Add({0.0f, 0.0f, 10.0f}, 1.0f);
+
+    const ray r({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f});
+    float t = 0.0f;
+    uint32_t idx = NO_SPHERE_HIT;
+    ASSERT_TRUE(IntersectSpheresScalar(r, spheres, 1e30f, t, idx));
+    EXPECT_EQ(idx, 0u);
+    ASSERT_TRUE(IntersectSpheres(r, spheres, 1e30f, t, idx));
+    EXPECT_EQ(idx, 0u);
+}
+
+TEST(SphereIntersection, MissLeavesNoHitSentinel)
+{
+    SphereBuffer spheres;
+    spheres.Add({0.0f, 0.0f, 10.0f}, 1.0f);
+    const ray r({0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+
+    float t = 0.0f;
+    uint32_t idx = 0;
+    EXPECT_FALSE(IntersectSpheresScalar(r, spheres, 1e30f, t, idx));
+    EXPECT_EQ(idx, NO_SPHERE_HIT);
+    EXPECT_EQ(t, 1e30f);
+
+    idx = 0;
+    EXPECT_FALSE(IntersectSpheres(r, spheres, 1e30f, t, idx));
+    EXPECT_EQ(idx, NO_SPHERE_HIT);
+    EXPECT_EQ(t, 1e30f);
+}
+
+TEST(SphereIntersection, OcclusionAgreesWithClosestHit)
+{
+    std::mt19937 rng(5);
+    const SphereBuffer spheres = RandomSpheres(rng, 200);
+    Bvh bvh;
+    BuildSphereBvh(spheres, bvh);
+    Bvh8 wide;
+    wide.Build(bvh);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const ray r = RandomRay(rng);
+        const float tMax = i % 2 == 0 ? 3.0f : 1e30f;
+
+        float t = 0.0f;
+        uint32_t idx = 0;
+        const bool hit = IntersectSpheres(r, spheres, tMax, t, idx);
+        ASSERT_EQ(hit, IsOccluded(r, spheres, tMax));
+        ASSERT_EQ(hit, IsOccluded(r, spheres, wide, tMax));
+    }
+}
+
+TEST(SphereIntersection, PacketMatchesScalarBitForBit)
+{
+    constexpr size_t N = 8;
+    std::mt19937 rng(11);
+    const SphereBuffer spheres = RandomSpheres(rng, 32);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        RayPacket<N> packet;
+        for (size_t lane = 0; lane < N; ++lane)
+            packet.set(lane, RandomRay(rng));
+
+        for (uint32_t idx = 0; idx < spheres.GetCount(); ++idx)
+        {
+            FloatPacket<N> packetT;
+            const PacketMask<N> hit =
+                IntersectSphere(packet, spheres, idx, packetT);
+            for (size_t lane = 0; lane < N; ++lane)
+            {
+                float t = 0.0f;
+                const bool scalarHit = IntersectSphereRadiusSq(
+                    packet.get(lane), spheres.GetCenter(idx),
+                    spheres.GetRadiusSq(idx), t);
+                ASSERT_EQ(scalarHit, hit.test(lane));
+                ASSERT_EQ(std::bit_cast<uint32_t>(t),
+                          std::bit_cast<uint32_t>(packetT[lane]));
+            }
+        }
+    }
+}
+
+} // namespace pathtracer
@@ -0,0 +1,352 @@
+#include "cpu/task_pool.h"
+#include "cpu/triangle_mesh.h"
+#include "io/mesh_import.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+auto WriteFile(const std::filesystem::path& path, const std::string& bytes)
+    -> void
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+/// <summary>
+/// Appends the bytes of value to a binary PLY body in the given byte
+/// order.
+/// </summary>
+template <typename T>
+auto Put(std::string& bytes, T value, bool bigEndian) -> void
+{
+    char raw[sizeof(T)];
+    std::memcpy(raw, &value, sizeof(T));
+    if (bigEndian != (std::endian::native == std::endian::big))
+        std::reverse(std::begin(raw), std::end(raw));
+    bytes.append(raw, sizeof(T));
+}
+
+/// <summary>
+/// A binary PLY file of a unit square pyramid: five vertices with a
+/// normal between the positions, a quad base and four triangles, each
+/// face followed by a flags byte. Polygons make the importer walk the
+/// faces; with triangleBase the base is two triangles instead.
+/// </summary>
+auto CreatePyramidPly(bool bigEndian, bool triangleBase) -> std::string
+{
+    const glm::vec3 vertices[] = {{0.0f, 0.0f, 0.0f},
+                                  {1.0f, 0.0f, 0.0f},
+                                  {1.0f, 0.0f, 1.0f},
+                                  {0.0f, 0.0f, 1.0f},
+                                  {0.5f, 1.0f, 0.5f}};
+    std::vector<std::vector<int32_t>> faces = {
+        {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}};
+    if (triangleBase)
+    {
+        faces.push_back({0, 3, 2});
+        faces.push_back({0, 2, 1});
+    }
+    else
+    {
+        faces.push_back({0, 3, 2, 1});
+    }
+
+    const char* format =
+        bigEndian ? "binary_big_endian" : "binary_little_endian";
+    std::string ply = std::string("ply\nformat ") + format +
+                      " 1.0\ncomment made by hand\nelement vertex 5\n"
+                      "property float x\nproperty float nx\n"
+                      "property double y\nproperty float z\n"
+                      "element face " + std::to_string(faces.size()) +
+                      "\nproperty list uchar int vertex_indices\n"
+                      "property uchar flags\nend_header\n";
+    for (const glm::vec3& v : vertices)
+    {
+        Put(ply, v.x, bigEndian);
+        Put(ply, 0.0f, bigEndian);
+        Put(ply, static_cast<double>(v.y), bigEndian);
+        Put(ply, v.z, bigEndian);
+    }
+    for (const std::vector<int32_t>& face : faces)
+    {
+        Put(ply, static_cast<uint8_t>(face.size()), bigEndian);
+        for (const int32_t idx : face)
+            Put(ply, idx, bigEndian);
+        Put(ply, uint8_t{7}, bigEndian);
+    }
+    return ply;
+}
+
+auto GetTriangles(const TriangleMesh& mesh) -> std::vector<glm::uvec3>
+{
+    std::vector<glm::uvec3> triangles;
+    for (uint32_t i = 0; i < mesh.GetTriangleCount(); ++i)
+        triangles.push_back(mesh.GetTriangle(i));
+    return triangles;
+}
+
+auto ExpectSameMesh(const TriangleMesh& actual, const TriangleMesh& expected)
+    -> void
+{
+    ASSERT_EQ(actual.GetVertexCount(), expected.GetVertexCount());
+    for (uint32_t i = 0; i < expected.GetVertexCount(); ++i)
+        ASSERT_EQ(actual.GetVertex(i), expected.GetVertex(i)) << "vertex " << i;
+    EXPECT_EQ(GetTriangles(actual), GetTriangles(expected));
+}
+} // namespace
+
+class MeshImportTest : public testing::Test
+{
+  protected:
+    auto SetUp() -> void override
+    {
+        m_dir = std::filesystem::temp_directory_path() /
+                (std::string("mesh_import_test_") +
+                 testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(m_dir);
+        std::filesystem::create_directories(m_dir);
+    }
+
+    auto TearDown() -> void override
+    {
+        std::filesystem::remove_all(m_dir);
+    }
+
+    /// <summary>
+    /// Writes contents to a file of the given name and loads it.
+    /// </summary>
+    auto Load(const std::string& name, const std::string& contents,
+              TaskPool* pool = nullptr) -> TriangleMesh
+    {
+        WriteFile(m_dir / name, contents);
+        return LoadMesh(m_dir / name, pool);
+    }
+
+    /// <summary>
+    /// Expects loading contents to fail with a message containing what.
+    /// </summary>
+    auto ExpectError(const std::string& name, const std::string& contents,
+                     const std::string& what) -> void
+    {
+        try
+        {
+            Load(name, contents);
+            ADD_FAILURE() << "No error for " << name << ", expected " << what;
+        }
+        catch (const std::runtime_error& error)
+        {
+            EXPECT_NE(std::string(error.what()).find(what), std::string::npos)
+                << error.what();
+        }
+    }
+
+    std::filesystem::path m_dir;
+};
+
+TEST_F(MeshImportTest, ReadsObjPositionsAndFans)
+{
+    const TriangleMesh mesh =
+        Load("quad.obj", "# a quad and a triangle\n"
+                         "o quad\n"
+                         "v 0 0 0\n"
+                         "vt 0.5 0.5\n"
+                         "vn 0 1 0\n"
+                         "v 1.5 0 -2e-1\n"
+                         "\tv  +1 2 3.25\r\n"
+                         "\n"
+                         "v -1 0 1\n"
+                         "usemtl red\n"
+                         "f 1/1/1 2/1/1 3//1 4\n"
+                         "s off\n"
+                         "f 4 1 2\n");
+    ASSERT_EQ(mesh.GetVertexCount(), 4u);
+    EXPECT_EQ(mesh.GetVertex(1), glm::vec3(1.5f, 0.0f, -0.2f));
+    EXPECT_EQ(mesh.GetVertex(2), glm::vec3(1.0f, 2.0f, 3.25f));
+    EXPECT_EQ(GetTriangles(mesh),
+              (std::vector<glm::uvec3>{{0, 1, 2}, {0, 2, 3}, {3, 0, 1}}));
+}
+
+// A comment cuts its line short in the counting pass as well, or the mesh
+// is sized for corners and vertices the parsing pass never writes
+TEST_F(MeshImportTest, StopsObjLinesAtTrailingComments)
+{
+    const TriangleMesh mesh = Load("comments.obj", "v 0 0 0 # origin\n"
+                                                   "v 1 0 0#no space\n"
+                                                   "v 0 1 0\n"
+                                                   "# v 9 9 9\n"
+                                                   "f 1 2 3 # 1 2 3 4 5\n"
+                                                   "f 3 2 1#\n");
+    ASSERT_EQ(mesh.GetVertexCount(), 3u);
+    EXPECT_EQ(mesh.GetVertex(0), glm::vec3(0.0f));
+    EXPECT_EQ(GetTriangles(mesh),
+              (std::vector<glm::uvec3>{{0, 1, 2}, {2, 1, 0}}));
+}
+
+TEST_F(MeshImportTest, ResolvesNegativeObjIndices)
+{
+    // Relative to the vertices read so far, not to the whole file
+    const TriangleMesh mesh = Load("relative.obj", "v 0 0 0\n"
+                                                   "v 1 0 0\n"
+                                                   "v 0 1 0\n"
+                                                   "f -3 -2 -1\n"
+                                                   "v 1 1 0\n"
+                                                   "f -1/-1 -2 -3/2/-1\n"
+                                                   "v 2 2 0\n");
+    EXPECT_EQ(GetTriangles(mesh),
+              (std::vector<glm::uvec3>{{0, 1, 2}, {3, 2, 1}}));
+}
+
+TEST_F(MeshImportTest, ReportsMalformedObjLines)
+{
+    const std::string vertices = "v 0 0 0\nv 1 0 0\nv 0 1 0\n";
+    ExpectError("short.obj", vertices + "v 1 2\n", ":4: invalid vertex");
+    ExpectError("word.obj", vertices + "v 1 x 3\n", ":4: invalid vertex");
+    ExpectError("index.obj", vertices + "f 1 two 3\n",
+                ":4: invalid face index");
+    ExpectError("zero.obj", vertices + "f 0 1 2\n",
+                ":4: face references a missing vertex");
+    ExpectError("past.obj", vertices + "f 1 2 4\n",
+                ":4: face references a missing vertex");
+    ExpectError("before.obj", vertices + "f -1 -2 -4\n",
+                ":4: face references a missing vertex");
+    ExpectError("edge.obj", vertices + "\n\nf 1 2\n",
+                ":6: face has fewer than 3 vertices");
+    EXPECT_THROW(LoadObj(m_dir / "missing.obj"), std::runtime_error);
+}
+
+// Several chunks parsed on separate threads, with relative indices and
+// line numbers that depend on the chunks before them
+TEST_F(MeshImportTest, ParsesLargeObjFilesInParallel)
+{
+    constexpr uint32_t QUAD_COUNT = 40000;
+    std::string obj;
+    TriangleMesh expected;
+    for (uint32_t i = 0; i < QUAD_COUNT; ++i)
+    {
+        const auto x = static_cast<float>(i);
+        for (const glm::vec3& v : {glm::vec3{x, 0.0f, 0.0f},
+                                   glm::vec3{x, 1.0f, 0.0f},
+                                   glm::vec3{x, 1.0f, 1.0f},
+                                   glm::vec3{x, 0.0f, 1.0f}})
+        {
+            obj += "v " + std::to_string(v.x) + " " + std::to_string(v.y) +
+                   " " + std::to_string(v.z) + " # corner\n";
+            expected.AddVertex(v);
+        }
+        obj += "f -4 -3 -2 -1\n";
+        expected.AddTriangle(i * 4, i * 4 + 1, i * 4 + 2);
+        expected.AddTriangle(i * 4, i * 4 + 2, i * 4 + 3);
+    }
+    ASSERT_GT(obj.size(), size_t{3} << 20);
+
+    TaskPool pool(3);
+    ExpectSameMesh(Load("large.obj", obj, &pool), expected);
+
+    const std::string bad = obj + "f 1 2 " +
+                            std::to_string(QUAD_COUNT * 4 + 1) + "\n";
+    WriteFile(m_dir / "bad.obj", bad);
+    try
+    {
+        LoadObj(m_dir / "bad.obj", &pool);
+        ADD_FAILURE() << "No error for bad.obj";
+    }
+    catch (const std::runtime_error& error)
+    {
+        const std::string line = ":" + std::to_string(QUAD_COUNT * 5 + 1) + ":";
+        EXPECT_NE(std::string(error.what()).find(line), std::string::npos)
+            << error.what();
+    }
+}
+
+class PlyImportTest : public MeshImportTest,
+                      public testing::WithParamInterface<bool>
+{
+};
+
+TEST_P(PlyImportTest, ReadsBothByteOrdersAndFans)
+{
+    const bool bigEndian = GetParam();
+    TriangleMesh pyramid;
+    pyramid.AddVertex({0.0f, 0.0f, 0.0f});
+    pyramid.AddVertex({1.0f, 0.0f, 0.0f});
+    pyramid.AddVertex({1.0f, 0.0f, 1.0f});
+    pyramid.AddVertex({0.0f, 0.0f, 1.0f});
+    pyramid.AddVertex({0.5f, 1.0f, 0.5f});
+    pyramid.AddTriangle(0, 1, 4);
+    pyramid.AddTriangle(1, 2, 4);
+    pyramid.AddTriangle(2, 3, 4);
+    pyramid.AddTriangle(3, 0, 4);
+    pyramid.AddTriangle(0, 3, 2);
+    pyramid.AddTriangle(0, 2, 1);
+
+    // Triangles only, addressed directly, and a quad base found by walking
+    // the faces, give the same mesh
+    ExpectSameMesh(Load("triangles.ply", CreatePyramidPly(bigEndian, true)),
+                   pyramid);
+    ExpectSameMesh(Load("polygons.ply", CreatePyramidPly(bigEndian, false)),
+                   pyramid);
+}
+
+INSTANTIATE_TEST_SUITE_P(MeshImport, PlyImportTest, testing::Bool());
+
+TEST_F(MeshImportTest, ReportsMalformedPlyFiles)
+{
+    const std::string ply = CreatePyramidPly(false, false);
+    const size_t bodyStart = ply.find("end_header\n") + 11;
+
+    ExpectError("ascii.ply",
+                "ply\nformat ascii 1.0\nelement vertex 0\nend_header\n",
+                "ASCII PLY is not supported");
+    ExpectError("magic.ply", "plx\n" + ply.substr(4), "not a PLY file");
+    ExpectError("header.ply", ply.substr(0, bodyStart - 11),
+                "PLY header has no end_header");
+    ExpectError("truncated.ply", ply.substr(0, ply.size() - 3),
+                "PLY file is truncated");
+    ExpectError("vertices.ply", ply.substr(0, bodyStart + 10),
+                "PLY file is truncated");
+
+    std::string outOfRange = ply;
+    outOfRange[ply.size() - 2] = 5;
+    ExpectError("range.ply", outOfRange, "face references a missing vertex");
+
+    std::string twoCorners = ply;
+    twoCorners[ply.size() - 18] = 2;
+    ExpectError("corners.ply", twoCorners, "face has fewer than 3 vertices");
+
+    std::string faceFirst = ply;
+    const size_t vertex = faceFirst.find("element vertex");
+    const size_t face = faceFirst.find("element face");
+    const size_t end = faceFirst.find("end_header");
+    faceFirst = faceFirst.substr(0, vertex) +
+                faceFirst.substr(face, end - face) +
+                faceFirst.substr(vertex, face - vertex) +
+                faceFirst.substr(end);
+    ExpectError("order.ply", faceFirst, "PLY faces precede the vertices");
+}
+
+TEST_F(MeshImportTest, ChoosesTheFormatByExtension)
+{
+    EXPECT_EQ(Load("upper.OBJ", "v 0 0 0\n").GetVertexCount(), 1u);
+    EXPECT_EQ(Load("upper.PLY", CreatePyramidPly(false, true))
+                  .GetTriangleCount(),
+              6u);
+    WriteFile(m_dir / "mesh.stl", "solid\n");
+    EXPECT_THROW(LoadMesh(m_dir / "mesh.stl"), std::invalid_argument);
+}
+
+} // namespace pathtracer
@@ -0,0 +1,198 @@
+#include "cpu/samplers.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr uint32_t DIMENSION_COUNT = 8;
+
+/// <summary>
+/// Expects each of the count samples from firstSample of a pixel to fall
+/// in its own one of count equal intervals of [0, 1).
+/// </summary>
+auto ExpectStratified1D(const ISampler& sampler, uint32_t firstSample,
+                        uint32_t count, uint32_t dimension) -> void
+{
+    std::vector<uint32_t> hits(count, 0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float v = sampler.Get1D(3, 5, firstSample + i, dimension);
+        ++hits[static_cast<uint32_t>(v * static_cast<float>(count))];
+    }
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1u), count)
+        << sampler.GetName() << " dimension " << dimension << " samples "
+        << firstSample << "+" << count;
+}
+
+/// <summary>
+/// Expects each of the count samples from firstSample of the same pixel to
+/// fall in its own cell of a width x height grid over [0, 1)^2.
+/// </summary>
+auto ExpectStratified2D(const ISampler& sampler, uint32_t firstSample,
+                        uint32_t count, uint32_t dimension, uint32_t width,
+                        uint32_t height) -> void
+{
+    std::vector<uint32_t> hits(width * height, 0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 v = sampler.Get2D(3, 5, firstSample + i, dimension);
+        const auto cx = static_cast<uint32_t>(v.x * static_cast<float>(width));
+        const auto cy =
+            static_cast<uint32_t>(v.y * static_cast<float>(height));
+        ++hits[cy * width + cx];
+    }
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1u), count)
+        << sampler.GetName() << " dimension " << dimension << " samples "
+        << firstSample << "+" << count << ", " << width << "x" << height;
+}
+} // namespace
+
+class SamplerTest : public testing::TestWithParam<int>
+{
+  protected:
+    auto Create(uint32_t seed) const -> std::unique_ptr<ISampler>
+    {
+        switch (GetParam())
+        {
+        case 0:
+            return std::make_unique<IndependentSampler>(seed);
+        case 1:
+            return std::make_unique<StratifiedSampler>(16, seed);
+        case 2:
+            return std::make_unique<SobolSampler>(seed);
+        default:
+            return std::make_unique<BlueNoiseSampler>(seed);
+        }
+    }
+};
+
+TEST_P(SamplerTest, StaysInTheUnitIntervalAndIsRepeatable)
+{
+    const std::unique_ptr<ISampler> sampler = Create(0);
+    const std::unique_ptr<ISampler> again = Create(0);
+    const std::unique_ptr<ISampler> reseeded = Create(1);
+    double sum = 0.0;
+    uint32_t count = 0;
+    uint32_t reseededEqual = 0;
+    for (const uint32_t x : {0u, 1u, 63u, 64u, 1919u, UINT32_MAX})
+    {
+        for (const uint32_t y : {0u, 7u, 1080u, UINT32_MAX})
+        {
+            for (const uint32_t s : {0u, 1u, 15u, 16u, 1000u, UINT32_MAX})
+            {
+                for (uint32_t d = 0; d < DIMENSION_COUNT; d += 2)
+                {
+                    const float a = sampler->Get1D(x, y, s, d);
+                    const glm::vec2 p = sampler->Get2D(x, y, s, d);
+                    for (const float v : {a, p.x, p.y})
+                    {
+                        ASSERT_GE(v, 0.0f) << x << " " << y << " " << s;
+                        ASSERT_LT(v, 1.0f) << x << " " << y << " " << s;
+                        sum += v;
+                        ++count;
+                    }
+                    EXPECT_EQ(again->Get1D(x, y, s, d), a);
+                    EXPECT_EQ(again->Get2D(x, y, s, d), p);
+                    reseededEqual += reseeded->Get1D(x, y, s, d) == a;
+                }
+            }
+        }
+    }
+    EXPECT_NEAR(sum / count, 0.5, 0.05) << sampler->GetName();
+    EXPECT_LT(reseededEqual, count / 30) << sampler->GetName();
+}
+
+INSTANTIATE_TEST_SUITE_P(Samplers, SamplerTest, testing::Range(0, 4));
+
+TEST(StratifiedSamplerTest, PutsOneSampleInEveryStratumPerRun)
+{
+    for (const uint32_t spp : {1u, 7u, 16u, 20u})
+    {
+        const StratifiedSampler sampler(spp, 3);
+        const auto width = static_cast<uint32_t>(
+            std::ceil(std::sqrt(static_cast<double>(spp))));
+        const uint32_t height = (spp + width - 1) / width;
+        for (const uint32_t run : {0u, 1u, 5u})
+        {
+            for (uint32_t d = 0; d < DIMENSION_COUNT; d += 2)
+            {
+                ExpectStratified1D(sampler, run * spp, spp, d);
+                ExpectStratified2D(sampler, run * spp, spp, d, width,
+                                   height);
+            }
+        }
+    }
+    EXPECT_THROW(StratifiedSampler(0), std::invalid_argument);
+}
+
+// Each pair of dimensions is a scrambled (0, 2)-sequence: any power-of-two
+// prefix of a pixel's samples has one point in every elementary interval
+// of its size, and so do later aligned blocks
+TEST(SobolSamplerTest, FillsEveryElementaryInterval)
+{
+    const SobolSampler sampler(9);
+    for (const uint32_t log2Count : {2u, 4u, 6u})
+    {
+        const uint32_t count = 1u << log2Count;
+        for (const uint32_t firstSample : {0u, count, 5 * count})
+        {
+            for (uint32_t d = 0; d < DIMENSION_COUNT; d += 2)
+            {
+                for (uint32_t k = 0; k <= log2Count; ++k)
+                {
+                    ExpectStratified2D(sampler, firstSample, count, d,
+                                       1u << k, count >> k);
+                }
+                ExpectStratified1D(sampler, firstSample, count, d);
+                ExpectStratified1D(sampler, firstSample, count, d + 1);
+            }
+        }
+    }
+}
+
+TEST(BlueNoiseSamplerTest, SpreadsValuesOverTheMaskAndAwayFromNeighbours)
+{
+    constexpr uint32_t SIZE = BlueNoiseSampler::MASK_SIZE;
+    const BlueNoiseSampler sampler(2);
+    for (const uint32_t s : {0u, 1u, 77u})
+    {
+        for (uint32_t d = 0; d < 4; ++d)
+        {
+            // Any tile of the mask holds every rank once
+            std::vector<float> values;
+            float neighbourDifference = 0.0f;
+            for (uint32_t y = 10; y < 10 + SIZE; ++y)
+            {
+                for (uint32_t x = 20; x < 20 + SIZE; ++x)
+                {
+                    const float v = sampler.Get1D(x, y, s, d);
+                    values.push_back(v);
+                    neighbourDifference +=
+                        std::abs(v - sampler.Get1D(x + 1, y, s, d));
+                }
+            }
+            std::sort(values.begin(), values.end());
+            float largestGap = values.front() + 1.0f - values.back();
+            for (size_t i = 1; i < values.size(); ++i)
+                largestGap = std::max(largestGap, values[i] - values[i - 1]);
+            EXPECT_LT(largestGap, 1.5f / (SIZE * SIZE))
+                << "sample " << s << " dimension " << d;
+
+            // White noise differs from its neighbour by 1/3 on average
+            EXPECT_GT(neighbourDifference / (SIZE * SIZE), 0.36f)
+                << "sample " << s << " dimension " << d;
+        }
+    }
+}
+
+} // namespace pathtracer
@@ -0,0 +1,296 @@
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "io/scene_cache.h"
+#include "scene/scene.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+// Options no default build uses, so the test can find them in the file
+constexpr uint32_t BIN_COUNT = 13;
+constexpr uint32_t MAX_LEAF_SIZE = 3;
+
+auto ReadBytes(const std::filesystem::path& path) -> std::vector<char>
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
+}
+
+auto WriteBytes(const std::filesystem::path& path,
+                const std::vector<char>& bytes) -> void
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+/// <summary>
+/// A grid of size x size quads, two triangles each.
+/// </summary>
+auto CreateGrid(uint32_t size) -> TriangleMesh
+{
+    TriangleMesh mesh;
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+        {
+            mesh.AddVertex({static_cast<float>(x), 0.1f * (x % 3),
+                            static_cast<float>(y)});
+        }
+    }
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const uint32_t v = y * (size + 1) + x;
+            mesh.AddTriangle(v, v + 1, v + size + 2);
+            mesh.AddTriangle(v, v + size + 2, v + size + 1);
+        }
+    }
+    return mesh;
+}
+
+/// <summary>
+/// Every kind of primitive; the first mesh has a BVH built with BIN_COUNT
+/// and MAX_LEAF_SIZE attached, the second none.
+/// </summary>
+auto CreateScene() -> Scene
+{
+    Scene scene;
+    const MaterialHandle red =
+        scene.AddMaterial({color{0.8f, 0.1f, 0.1f}, color{0.0f}, 0.3f});
+    const MaterialHandle light =
+        scene.AddMaterial({color{0.0f}, color{4.0f, 3.0f, 2.0f}});
+    scene.AddSphere({0.0f, 1.0f, -2.0f}, 0.5f, red);
+    scene.AddSphere({1.5f, 0.25f, -1.0f}, 0.3f, light);
+    scene.AddTriangle({-1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f},
+                      {0.0f, 1.0f, 0.0f}, red);
+    scene.AddTriangle({-1.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 1.0f},
+                      {0.0f, 1.0f, 1.0f});
+
+    const TriangleMesh grid = CreateGrid(6);
+    auto bvh = std::make_shared<MeshBvh8>();
+    BvhBuildOptions options;
+    options.binCount = BIN_COUNT;
+    options.maxLeafSize = MAX_LEAF_SIZE;
+    options.threadCount = 1;
+    bvh->Build(grid, TriangleLeafLayout::Packed, options);
+    const MeshHandle withBvh = scene.AddMesh(grid, red);
+    scene.SetMeshBvh(withBvh, std::move(bvh));
+    const MeshHandle withoutBvh = scene.AddMesh(CreateGrid(3), light);
+
+    glm::mat4 transform(1.0f);
+    transform[3] = glm::vec4(2.0f, 0.0f, -3.0f, 1.0f);
+    scene.AddInstance(withBvh, glm::mat4(1.0f));
+    scene.AddInstance(withoutBvh, transform, red);
+    return scene;
+}
+
+auto ExpectSameBvh(const MeshBvh8& a, const MeshBvh8& b) -> void
+{
+    ASSERT_EQ(a.GetBvh().GetNodes().size(), b.GetBvh().GetNodes().size());
+    EXPECT_EQ(std::memcmp(a.GetBvh().GetNodes().data(),
+                          b.GetBvh().GetNodes().data(),
+                          a.GetBvh().GetNodes().size() * sizeof(BvhNode)),
+              0);
+    EXPECT_EQ(a.GetBvh().GetPrimIndices(), b.GetBvh().GetPrimIndices());
+    EXPECT_EQ(a.GetWideBvh().GetPrimIndices(),
+              b.GetWideBvh().GetPrimIndices());
+    EXPECT_EQ(a.GetGroups().size(), b.GetGroups().size());
+    EXPECT_EQ(a.GetLayout(), b.GetLayout());
+    EXPECT_EQ(a.GetBvh().GetStats().nodeCount,
+              b.GetBvh().GetStats().nodeCount);
+    EXPECT_EQ(a.GetBvh().GetStats().sahCost, b.GetBvh().GetStats().sahCost);
+}
+} // namespace
+
+class SceneCacheTest : public testing::Test
+{
+  protected:
+    auto SetUp() -> void override
+    {
+        m_dir = std::filesystem::temp_directory_path() /
+                (std::string("scene_cache_test_") +
+                 testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(m_dir);
+        std::filesystem::create_directories(m_dir);
+        m_sources = {m_dir / "scene.obj", m_dir / "materials.mtl"};
+        WriteBytes(m_sources[0], {'v', ' ', '0', ' ', '0', ' ', '0', '\n'});
+        WriteBytes(m_sources[1], {'#', '\n'});
+        m_cache = m_dir / "scene.cache";
+    }
+
+    auto TearDown() -> void override
+    {
+        std::filesystem::remove_all(m_dir);
+    }
+
+    std::filesystem::path m_dir;
+    std::vector<std::filesystem::path> m_sources;
+    std::filesystem::path m_cache;
+};
+
+TEST_F(SceneCacheTest, RoundTripsTheScene)
+{
+    const Scene scene = CreateScene();
+    SaveSceneCache(m_cache, scene, m_sources);
+    const std::optional<Scene> loaded = LoadSceneCache(m_cache, m_sources);
+    ASSERT_TRUE(loaded.has_value());
+
+    EXPECT_EQ(loaded->GetAlbedos(), scene.GetAlbedos());
+    EXPECT_EQ(loaded->GetEmissions(), scene.GetEmissions());
+    EXPECT_EQ(loaded->GetRoughnesses(), scene.GetRoughnesses());
+
+    ASSERT_EQ(loaded->GetSpheres().GetCount(), scene.GetSpheres().GetCount());
+    for (uint32_t i = 0; i < scene.GetSpheres().GetCount(); ++i)
+    {
+        EXPECT_EQ(loaded->GetSpheres().GetCenter(i),
+                  scene.GetSpheres().GetCenter(i));
+        EXPECT_EQ(loaded->GetSpheres().GetRadiusSq(i),
+                  scene.GetSpheres().GetRadiusSq(i));
+    }
+    EXPECT_EQ(loaded->GetSphereMaterials(), scene.GetSphereMaterials());
+    EXPECT_EQ(loaded->GetTriangleV0(), scene.GetTriangleV0());
+    EXPECT_EQ(loaded->GetTriangleV1(), scene.GetTriangleV1());
+    EXPECT_EQ(loaded->GetTriangleV2(), scene.GetTriangleV2());
+    EXPECT_EQ(loaded->GetTriangleMaterials(), scene.GetTriangleMaterials());
+    EXPECT_EQ(loaded->GetInstanceGeometries(), scene.GetInstanceGeometries());
+    EXPECT_EQ(loaded->GetInstanceTransforms(), scene.GetInstanceTransforms());
+    EXPECT_EQ(loaded->GetInstanceMaterials(), scene.GetInstanceMaterials());
+
+    ASSERT_EQ(loaded->GetMeshCount(), scene.GetMeshCount());
+    EXPECT_EQ(loaded->GetMeshMaterials(), scene.GetMeshMaterials());
+    for (uint32_t m = 0; m < scene.GetMeshCount(); ++m)
+    {
+        const TriangleMesh& expected = scene.GetMeshes()[m];
+        const TriangleMesh& actual = loaded->GetMeshes()[m];
+        ASSERT_EQ(actual.GetVertexCount(), expected.GetVertexCount());
+        ASSERT_EQ(actual.GetTriangleCount(), expected.GetTriangleCount());
+        for (uint32_t v = 0; v < expected.GetVertexCount(); ++v)
+            EXPECT_EQ(actual.GetVertex(v), expected.GetVertex(v));
+        for (uint32_t t = 0; t < expected.GetTriangleCount(); ++t)
+            EXPECT_EQ(actual.GetTriangle(t), expected.GetTriangle(t));
+        ASSERT_NE(loaded->GetMeshBvhs()[m], nullptr);
+        EXPECT_TRUE(
+            loaded->GetMeshBvhs()[m]->IsValid(actual.GetTriangleCount()));
+    }
+
+    // The attached BVH comes back as built, with its options
+    const MeshBvh8& bvh = *loaded->GetMeshBvhs()[0];
+    ExpectSameBvh(bvh, *scene.GetMeshBvhs()[0]);
+    EXPECT_EQ(bvh.GetBvh().GetOptions().binCount, BIN_COUNT);
+    EXPECT_EQ(bvh.GetBvh().GetOptions().maxLeafSize, MAX_LEAF_SIZE);
+}
+
+// The BVHs built while saving take a different time on every run, and
+// structures have padding; neither may reach the file
+TEST_F(SceneCacheTest, WritesTheSameBytesEveryTime)
+{
+    const Scene scene = CreateScene();
+    SaveSceneCache(m_cache, scene, m_sources);
+    const std::vector<char> first = ReadBytes(m_cache);
+    SaveSceneCache(m_cache, scene, m_sources);
+    EXPECT_EQ(ReadBytes(m_cache), first);
+}
+
+TEST_F(SceneCacheTest, RejectsChangedSources)
+{
+    SaveSceneCache(m_cache, CreateScene(), m_sources);
+    WriteBytes(m_sources[1], {'#', ' ', '2', '\n'});
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+
+    // Same size, different contents, different time
+    SaveSceneCache(m_cache, CreateScene(), m_sources);
+    std::vector<char> bytes = ReadBytes(m_sources[0]);
+    bytes[2] = '1';
+    WriteBytes(m_sources[0], bytes);
+    std::filesystem::last_write_time(
+        m_sources[0],
+        std::filesystem::last_write_time(m_sources[0]) + std::chrono::hours(1));
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+}
+
+TEST_F(SceneCacheTest, KeepsTouchedSourcesWithTheSameContents)
+{
+    SaveSceneCache(m_cache, CreateScene(), m_sources);
+    std::filesystem::last_write_time(
+        m_sources[0],
+        std::filesystem::last_write_time(m_sources[0]) + std::chrono::hours(1));
+    EXPECT_TRUE(LoadSceneCache(m_cache, m_sources).has_value());
+    EXPECT_TRUE(LoadSceneCache(m_cache, m_sources).has_value());
+}
+
+TEST_F(SceneCacheTest, RejectsMissingSources)
+{
+    SaveSceneCache(m_cache, CreateScene(), m_sources);
+    std::filesystem::remove(m_sources[1]);
+    std::optional<Scene> loaded;
+    EXPECT_NO_THROW(loaded = LoadSceneCache(m_cache, m_sources));
+    EXPECT_FALSE(loaded.has_value());
+
+    const std::vector<std::filesystem::path> fewer{m_sources[0]};
+    EXPECT_FALSE(LoadSceneCache(m_cache, fewer).has_value());
+    EXPECT_FALSE(LoadSceneCache(m_dir / "none.cache", fewer).has_value());
+}
+
+TEST_F(SceneCacheTest, RejectsCorruptFiles)
+{
+    SaveSceneCache(m_cache, CreateScene(), m_sources);
+    const std::vector<char> bytes = ReadBytes(m_cache);
+
+    // Truncated
+    WriteBytes(m_cache, {bytes.begin(), bytes.begin() + bytes.size() / 2});
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+    WriteBytes(m_cache, {bytes.begin(), bytes.begin() + 4});
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+
+    // Not a cache
+    std::vector<char> corrupt = bytes;
+    corrupt[0] = 'X';
+    WriteBytes(m_cache, corrupt);
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+
+    // Build options a later rebuild would throw on
+    const uint32_t options[] = {BIN_COUNT, MAX_LEAF_SIZE};
+    const auto it = std::search(
+        bytes.begin(), bytes.end(), reinterpret_cast<const char*>(options),
+        reinterpret_cast<const char*>(options) + sizeof(options));
+    ASSERT_NE(it, bytes.end());
+    for (const uint32_t binCount : {0u, 1u, 1u << 30})
+    {
+        corrupt = bytes;
+        std::memcpy(&corrupt[it - bytes.begin()], &binCount,
+                    sizeof(binCount));
+        WriteBytes(m_cache, corrupt);
+        EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value())
+            << "binCount " << binCount;
+    }
+    corrupt = bytes;
+    std::memset(&corrupt[it - bytes.begin() + sizeof(uint32_t)], 0,
+                sizeof(uint32_t));
+    WriteBytes(m_cache, corrupt);
+    EXPECT_FALSE(LoadSceneCache(m_cache, m_sources).has_value());
+
+    // Unharmed, it still loads
+    WriteBytes(m_cache, bytes);
+    EXPECT_TRUE(LoadSceneCache(m_cache, m_sources).has_value());
+}
+
+} // namespace pathtracer
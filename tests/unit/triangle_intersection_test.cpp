@@ -0,0 +1,164 @@
+#include "accel/bvh.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <random>
+#include <tuple>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr uint32_t GRID_SIZE = 40;
+constexpr uint32_t RAY_COUNT = 2000;
+
+/// <summary>
+/// A GRID_SIZE x GRID_SIZE height field over [0, GRID_SIZE] in x and z,
+/// two triangles per cell, with random heights.
+/// </summary>
+auto CreateTerrain(uint32_t seed) -> TriangleMesh
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+    TriangleMesh mesh;
+    for (uint32_t z = 0; z <= GRID_SIZE; ++z)
+    {
+        for (uint32_t x = 0; x <= GRID_SIZE; ++x)
+        {
+            mesh.AddVertex({static_cast<float>(x), height(rng),
+                            static_cast<float>(z)});
+        }
+    }
+    for (uint32_t z = 0; z < GRID_SIZE; ++z)
+    {
+        for (uint32_t x = 0; x < GRID_SIZE; ++x)
+        {
+            const uint32_t v = z * (GRID_SIZE + 1) + x;
+            mesh.AddTriangle(v, v + GRID_SIZE + 1, v + 1);
+            mesh.AddTriangle(v + 1, v + GRID_SIZE + 1, v + GRID_SIZE + 2);
+        }
+    }
+    return mesh;
+}
+
+/// <summary>
+/// A ray from above the terrain towards a random point of it.
+/// </summary>
+auto RandomRay(std::mt19937& rng) -> ray
+{
+    std::uniform_real_distribution<float> coord(0.0f, GRID_SIZE);
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    const glm::vec3 target{coord(rng), 0.0f, coord(rng)};
+    const glm::vec3 origin = target + glm::vec3{offset(rng), 5.0f,
+                                                offset(rng)};
+    return ray(origin, target - origin);
+}
+
+/// <summary>
+/// Expects the same closest triangle and distance from MeshBvh as from the
+/// scalar test through a binary BVH.
+/// </summary>
+template <size_t N>
+auto ExpectSameHits(const MeshBvh<N>& meshBvh, const TriangleMesh& mesh,
+                    uint32_t seed) -> void
+{
+    Bvh reference;
+    reference.Build(ComputeTriangleBounds(mesh));
+    std::mt19937 rng(seed);
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const ray r = RandomRay(rng);
+        TriangleHit expected;
+        TriangleHit actual;
+        const bool expectedHit =
+            IntersectTriangles(r, mesh, reference, 1e30f, expected);
+        const bool actualHit = meshBvh.Intersect(r, mesh, 1e30f, actual);
+        ASSERT_EQ(actualHit, expectedHit) << "ray " << i;
+        if (!expectedHit)
+            continue;
+        ++hits;
+        ASSERT_EQ(actual.triIdx, expected.triIdx) << "ray " << i;
+        ASSERT_EQ(actual.t, expected.t) << "ray " << i;
+        ASSERT_EQ(actual.u, expected.u) << "ray " << i;
+        ASSERT_EQ(actual.v, expected.v) << "ray " << i;
+    }
+    EXPECT_GT(hits, RAY_COUNT / 2);
+}
+} // namespace
+
+class MeshBvhTest
+    : public testing::TestWithParam<std::tuple<size_t, TriangleLeafLayout>>
+{
+  protected:
+    template <size_t N> auto Check() -> void
+    {
+        const TriangleLeafLayout layout = std::get<1>(GetParam());
+        TriangleMesh mesh = CreateTerrain(3);
+        MeshBvh<N> meshBvh;
+        meshBvh.Build(mesh, layout);
+        ExpectSameHits(meshBvh, mesh, 4);
+
+        // Every vertex moved, then refit or rebuilt
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> height(-2.0f, 2.0f);
+        for (uint32_t v = 0; v < mesh.GetVertexCount(); ++v)
+        {
+            glm::vec3 position = mesh.GetVertex(v);
+            position.y = height(rng);
+            mesh.SetVertex(v, position);
+        }
+        meshBvh.Update(mesh);
+        ExpectSameHits(meshBvh, mesh, 6);
+    }
+};
+
+TEST_P(MeshBvhTest, FindsTheSameHitsAsTheBinaryBvh)
+{
+    if (std::get<0>(GetParam()) == 4)
+        Check<4>();
+    else
+        Check<8>();
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    TriangleIntersection, MeshBvhTest,
+    testing::Combine(testing::Values(size_t{4}, size_t{8}),
+                     testing::Values(TriangleLeafLayout::Indexed,
+                                     TriangleLeafLayout::Packed)));
+
+// Rays through the shared edges and vertices of a closed surface must hit
+// one of the triangles meeting there
+TEST(TriangleIntersection, RaysThroughSharedEdgesHit)
+{
+    const TriangleMesh mesh = CreateTerrain(7);
+    MeshBvh8 meshBvh;
+    meshBvh.Build(mesh);
+    for (uint32_t z = 1; z < GRID_SIZE; ++z)
+    {
+        for (uint32_t x = 1; x < GRID_SIZE; ++x)
+        {
+            // The vertex, and the midpoints of the edges leaving it
+            const uint32_t idx = z * (GRID_SIZE + 1) + x;
+            const glm::vec3 v = mesh.GetVertex(idx);
+            const glm::vec3 right = mesh.GetVertex(idx + 1);
+            const glm::vec3 below = mesh.GetVertex(idx + GRID_SIZE + 1);
+            for (const glm::vec3& target :
+                 {v, (v + right) * 0.5f, (v + below) * 0.5f})
+            {
+                const ray r(target + glm::vec3{0.3f, 4.0f, 0.2f},
+                            -glm::vec3{0.3f, 4.0f, 0.2f});
+                TriangleHit hit;
+                EXPECT_TRUE(meshBvh.Intersect(r, mesh, 1e30f, hit))
+                    << "vertex " << x << ", " << z;
+            }
+        }
+    }
+}
+
+} // namespace pathtracer
@@ -0,0 +1,198 @@
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "ray/ray.h"
+
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace pathtracer
+{
+namespace
+{
+constexpr uint32_t RAY_COUNT = 1000;
+constexpr uint32_t NO_HIT = std::numeric_limits<uint32_t>::max();
+
+struct Sphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+auto RandomVec3(std::mt19937& rng, float lo, float hi) -> glm::vec3
+{
+    std::uniform_real_distribution<float> dist(lo, hi);
+    return {dist(rng), dist(rng), dist(rng)};
+}
+
+auto RandomSpheres(std::mt19937& rng, uint32_t count) -> std::vector<Sphere>
+{
+    std::uniform_real_distribution<float> radius(0.05f, 0.5f);
+    std::vector<Sphere> spheres(count);
+    for (Sphere& sphere : spheres)
+        sphere = {RandomVec3(rng, -10.0f, 10.0f), radius(rng)};
+    return spheres;
+}
+
+auto GetBounds(const std::vector<Sphere>& spheres) -> std::vector<Aabb>
+{
+    std::vector<Aabb> bounds;
+    for (const Sphere& sphere : spheres)
+        bounds.push_back(Aabb::FromSphere(sphere.center, sphere.radius));
+    return bounds;
+}
+
+/// <summary>
+/// Nearest hit in (0, tMax), lowering tMax to it.
+/// </summary>
+auto IntersectSphere(const Sphere& sphere, const ray& r, float& tMax) -> bool
+{
+    const glm::vec3 oc = r.origin() - sphere.center;
+    const float a = glm::dot(r.direction(), r.direction());
+    const float h = glm::dot(r.direction(), oc);
+    const float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    const float discriminant = h * h - a * c;
+    if (discriminant < 0.0f)
+        return false;
+    const float sqrtd = std::sqrt(discriminant);
+    float t = (-h - sqrtd) / a;
+    if (t <= 0.0f)
+        t = (-h + sqrtd) / a;
+    if (t <= 0.0f || t >= tMax)
+        return false;
+    tMax = t;
+    return true;
+}
+
+/// <summary>
+/// Closest sphere along r through any tree with an Intersect() like
+/// Bvh::Intersect(), and its distance.
+/// </summary>
+template <typename Tree>
+auto Trace(const Tree& tree, const std::vector<Sphere>& spheres,
+           const ray& r, float& t) -> uint32_t
+{
+    uint32_t hit = NO_HIT;
+    t = std::numeric_limits<float>::infinity();
+    tree.Intersect(r, t,
+                   [&](uint32_t primIdx, float& tMax)
+                   {
+                       if (!IntersectSphere(spheres[primIdx], r, tMax))
+                           return false;
+                       hit = primIdx;
+                       return true;
+                   });
+    return hit;
+}
+} // namespace
+
+template <typename Wide> class WideBvhTest : public testing::Test
+{
+};
+
+using WideBvhTypes = testing::Types<Bvh4, Bvh8>;
+TYPED_TEST_SUITE(WideBvhTest, WideBvhTypes);
+
+TYPED_TEST(WideBvhTest, KeepsEveryPrimitiveInABoundingLeaf)
+{
+    std::mt19937 rng(5);
+    const std::vector<Sphere> spheres = RandomSpheres(rng, 1000);
+    const std::vector<Aabb> bounds = GetBounds(spheres);
+    Bvh bvh;
+    bvh.Build(bounds);
+    TypeParam wide;
+    wide.Build(bvh);
+
+    std::vector<uint32_t> sorted = wide.GetPrimIndices();
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> all(spheres.size());
+    std::iota(all.begin(), all.end(), 0u);
+    EXPECT_EQ(sorted, all);
+
+    uint32_t leafPrims = 0;
+    for (const auto& node : wide.GetNodes())
+    {
+        for (size_t i = 0; i < TypeParam::WIDTH; ++i)
+        {
+            const Aabb childBounds = node.GetChildBounds(i);
+            if (node.primCount[i] == 0)
+            {
+                if (!childBounds.IsEmpty())
+                {
+                    EXPECT_LT(node.child[i], wide.GetNodes().size());
+                }
+                continue;
+            }
+            leafPrims += node.primCount[i];
+            for (uint32_t p = 0; p < node.primCount[i]; ++p)
+            {
+                const Aabb& prim =
+                    bounds[wide.GetPrimIndices()[node.child[i] + p]];
+                EXPECT_EQ(glm::min(childBounds.min, prim.min),
+                          childBounds.min);
+                EXPECT_EQ(glm::max(childBounds.max, prim.max),
+                          childBounds.max);
+            }
+        }
+    }
+    EXPECT_EQ(leafPrims, spheres.size());
+
+    // Collapsing cuts the node count by about the width
+    EXPECT_LT(wide.GetNodes().size(), bvh.GetNodes().size());
+}
+
+TYPED_TEST(WideBvhTest, FindsTheSameHitsAsTheBinaryBvh)
+{
+    for (const uint32_t primCount : {1u, 9u, 5000u})
+    {
+        std::mt19937 rng(primCount);
+        const std::vector<Sphere> spheres = RandomSpheres(rng, primCount);
+        Bvh bvh;
+        bvh.Build(GetBounds(spheres));
+        TypeParam wide;
+        wide.Build(bvh);
+
+        std::uniform_int_distribution<size_t> pick(0, spheres.size() - 1);
+        uint32_t hits = 0;
+        for (uint32_t i = 0; i < RAY_COUNT; ++i)
+        {
+            // Every other ray is aimed near a sphere
+            const glm::vec3 origin = RandomVec3(rng, -12.0f, 12.0f);
+            const glm::vec3 direction =
+                i % 2 == 0 ? RandomVec3(rng, -1.0f, 1.0f)
+                           : spheres[pick(rng)].center +
+                                 RandomVec3(rng, -0.3f, 0.3f) - origin;
+            const ray r(origin, direction);
+            float expectedT = 0.0f;
+            float actualT = 0.0f;
+            const uint32_t expected = Trace(bvh, spheres, r, expectedT);
+            const uint32_t actual = Trace(wide, spheres, r, actualT);
+            ASSERT_EQ(actual, expected) << primCount << " spheres, ray " << i;
+            ASSERT_EQ(actualT, expectedT) << primCount << " spheres, ray " << i;
+            hits += expected != NO_HIT;
+        }
+        EXPECT_GT(hits, 0u);
+    }
+}
+
+TYPED_TEST(WideBvhTest, EmptyTreeHitsNothing)
+{
+    Bvh bvh;
+    bvh.Build({});
+    TypeParam wide;
+    wide.Build(bvh);
+    EXPECT_TRUE(wide.IsEmpty());
+    float t = 0.0f;
+    EXPECT_EQ(Trace(wide, {}, ray({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}), t),
+              NO_HIT);
+}
+
+} // namespace pathtracer
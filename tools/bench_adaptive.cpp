@@ -0,0 +1,99 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <iostream>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_WIDTH = 640;
+constexpr uint32_t IMAGE_HEIGHT = 360;
+constexpr float THRESHOLDS[] = {0.1f, 0.05f, 0.02f};
+
+struct AdaptiveResult
+{
+    uint32_t frames = 0;
+    double totalMs = 0.0;
+    double meanSamples = 0.0;
+    uint64_t unconverged = 0;
+};
+
+/// <summary>
+/// Accumulates frames until the image converges at threshold, or for
+/// maxFrames frames. A threshold of 0 samples every pixel every frame.
+/// </summary>
+auto RenderAdaptive(Scene& scene, float threshold, uint32_t maxFrames)
+    -> AdaptiveResult
+{
+    const float aspectRatio = static_cast<float>(IMAGE_WIDTH) /
+                              static_cast<float>(IMAGE_HEIGHT);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    Framebuffer framebuffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetAdaptiveSampling(threshold);
+
+    AdaptiveResult result;
+    while (result.frames < maxFrames && !pathtracer.IsConverged())
+    {
+        result.totalMs += MeasureMs(
+            [&]
+            {
+                pathtracer.Render(framebuffer, camera, result.frames, scene);
+            });
+        camera.ClearDirty();
+        scene.ClearChanges();
+        ++result.frames;
+    }
+
+    const AccumulationBuffer& accumulation = pathtracer.GetAccumulation();
+    uint64_t samples = 0;
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+        {
+            samples += accumulation.GetSampleCount(x, y);
+        }
+    }
+    result.meanSamples = static_cast<double>(samples) /
+                         (static_cast<double>(IMAGE_WIDTH) * IMAGE_HEIGHT);
+    result.unconverged = pathtracer.GetUnconvergedPixelCount();
+    return result;
+}
+} // namespace
+
+auto RunAdaptiveBenchmark(const BenchmarkOptions& options) -> void
+{
+    // Enough frames for the tightest threshold to converge on most pixels
+    const uint32_t maxFrames = std::max(options.iterations, 1u) * 50;
+    std::cout << "[adaptive] " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT
+              << ", Cornell box, next-event estimation, at most " << maxFrames
+              << " frames\n";
+
+    Scene box = CreateCornellBox();
+    for (const float threshold : THRESHOLDS)
+    {
+        const AdaptiveResult adaptive =
+            RenderAdaptive(box, threshold, maxFrames);
+
+        // Every pixel sampled as often as the adaptive run's slowest ones
+        const AdaptiveResult uniform =
+            RenderAdaptive(box, 0.0f, adaptive.frames);
+        std::cout << "[adaptive] error " << threshold << ": "
+                  << adaptive.frames << " frames in " << adaptive.totalMs
+                  << " ms, " << adaptive.meanSamples << " samples/pixel, "
+                  << adaptive.unconverged << " pixels unconverged; uniform "
+                  << uniform.totalMs << " ms ("
+                  << uniform.totalMs / std::max(adaptive.totalMs, 1e-6)
+                  << "x)\n";
+    }
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,128 @@
+#include "benchmarks.h"
+
+#include "accel/bvh.h"
+#include "cpu/intersection.h"
+#include "cpu/sphere_buffer.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t RAY_COUNT = 1u << 16;
+
+/// <summary>
+/// Largest scene that is also traced brute force to validate the BVH.
+/// </summary>
+constexpr uint32_t MAX_VALIDATED_COUNT = 10000;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// count spheres scattered over a thin 20 x 20 slab, sized so they cover it
+/// about equally densely whatever the count. Like the surfaces of a real
+/// scene, most rays stop at the first layer of spheres, so the trace cost
+/// reflects the depth of the tree rather than the volume a ray crosses.
+/// </summary>
+auto MakeSphereSlab(uint32_t count) -> SphereBuffer
+{
+    uint32_t state = count;
+    const float radius = 12.0f / std::sqrt(static_cast<float>(count));
+    SphereBuffer spheres;
+    spheres.Reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 center{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 2.0f - 1.0f};
+        spheres.Add(center, radius * (0.5f + RandomUnit(state)));
+    }
+    return spheres;
+}
+
+auto MakeRays() -> std::vector<ray>
+{
+    uint32_t state = 7;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f, 0.0f};
+        const glm::vec3 origin{0.0f, 0.0f, -30.0f};
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+} // namespace
+
+auto RunBvhBenchmark(const BenchmarkOptions& options) -> void
+{
+    const std::vector<ray> rays = MakeRays();
+
+    for (const uint32_t count : {10000u, 100000u, 1000000u})
+    {
+        const SphereBuffer spheres = MakeSphereSlab(count);
+
+        Bvh bvh;
+        BuildSphereBvh(spheres, bvh);
+        const BvhStats& stats = bvh.GetStats();
+
+        std::vector<float> t(RAY_COUNT);
+        std::vector<uint32_t> idx(RAY_COUNT);
+        double bestMs = std::numeric_limits<double>::max();
+        for (uint32_t iter = 0; iter < options.iterations; ++iter)
+        {
+            bestMs = std::min(
+                bestMs, MeasureMs(
+                            [&]
+                            {
+                                for (uint32_t i = 0; i < RAY_COUNT; ++i)
+                                {
+                                    IntersectSpheres(
+                                        rays[i], spheres, bvh,
+                                        std::numeric_limits<float>::max(),
+                                        t[i], idx[i]);
+                                }
+                            }));
+        }
+
+        std::cout << "[bvh] " << count << " spheres: build " << stats.buildMs
+                  << " ms, " << stats.nodeCount << " nodes, depth "
+                  << stats.maxDepth << ", SAH cost " << stats.sahCost
+                  << ", trace " << RAY_COUNT / (bestMs * 1000.0)
+                  << " Mrays/s";
+
+        if (count <= MAX_VALIDATED_COUNT)
+        {
+            size_t mismatches = 0;
+            for (uint32_t i = 0; i < RAY_COUNT; ++i)
+            {
+                float bruteT = 0.0f;
+                uint32_t bruteIdx = 0;
+                IntersectSpheres(rays[i], spheres,
+                                 std::numeric_limits<float>::max(), bruteT,
+                                 bruteIdx);
+                if (std::memcmp(&bruteT, &t[i], sizeof(float)) != 0)
+                    ++mismatches;
+            }
+            std::cout << ", " << mismatches << " mismatches vs brute force";
+        }
+        std::cout << "\n";
+    }
+}
+
+} // namespace pathtracer::bench
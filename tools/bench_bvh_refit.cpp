@@ -0,0 +1,235 @@
+#include "benchmarks.h"
+
+#include "accel/aabb.h"
+#include "accel/bvh.h"
+#include "cpu/intersection.h"
+#include "cpu/sphere_buffer.h"
+#include "cpu/task_pool.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t SPHERE_COUNT = 1000000;
+constexpr uint32_t FRAME_COUNT = 16;
+constexpr uint32_t RAY_COUNT = 1u << 16;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// Spheres scattered over a thin 20 x 20 slab, each drifting in its own
+/// direction by up to about its own diameter per frame.
+/// </summary>
+struct AnimatedSlab
+{
+    std::vector<glm::vec3> centers;
+    std::vector<glm::vec3> velocities;
+    std::vector<float> radii;
+
+    explicit AnimatedSlab(uint32_t count)
+    {
+        uint32_t state = count;
+        const float radius = 12.0f / std::sqrt(static_cast<float>(count));
+        const float speed = 2.0f * radius;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            centers.emplace_back(RandomUnit(state) * 20.0f - 10.0f,
+                                 RandomUnit(state) * 20.0f - 10.0f,
+                                 RandomUnit(state) * 2.0f - 1.0f);
+            velocities.emplace_back((RandomUnit(state) * 2.0f - 1.0f) * speed,
+                                    (RandomUnit(state) * 2.0f - 1.0f) * speed,
+                                    0.0f);
+            radii.push_back(radius * (0.5f + RandomUnit(state)));
+        }
+    }
+
+    auto Step() -> void
+    {
+        for (size_t i = 0; i < centers.size(); ++i)
+        {
+            centers[i] += velocities[i];
+        }
+    }
+
+    auto GetBounds() const -> std::vector<Aabb>
+    {
+        std::vector<Aabb> bounds(centers.size());
+        for (size_t i = 0; i < centers.size(); ++i)
+        {
+            bounds[i] = Aabb::FromSphere(centers[i], radii[i]);
+        }
+        return bounds;
+    }
+
+    auto GetSpheres() const -> SphereBuffer
+    {
+        SphereBuffer spheres;
+        spheres.Reserve(static_cast<uint32_t>(centers.size()));
+        for (size_t i = 0; i < centers.size(); ++i)
+        {
+            spheres.Add(centers[i], radii[i]);
+        }
+        return spheres;
+    }
+};
+
+auto MakeRays() -> std::vector<ray>
+{
+    uint32_t state = 7;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f, 0.0f};
+        const glm::vec3 origin{0.0f, 0.0f, -30.0f};
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/// <summary>
+/// Returns trace throughput in Mrays/s.
+/// </summary>
+auto TimeTrace(const std::vector<ray>& rays, const SphereBuffer& spheres,
+               const Bvh& bvh) -> double
+{
+    std::vector<float> t(rays.size());
+    std::vector<uint32_t> idx(rays.size());
+    const double ms = MeasureMs(
+        [&]
+        {
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                IntersectSpheres(rays[i], spheres, bvh,
+                                 std::numeric_limits<float>::max(), t[i],
+                                 idx[i]);
+            }
+        });
+    return rays.size() / (ms * 1000.0);
+}
+
+auto Contains(const Aabb& outer, const Aabb& inner) -> bool
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (inner.min[axis] < outer.min[axis] ||
+            inner.max[axis] > outer.max[axis])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// <summary>
+/// Counts nodes whose box does not enclose its children or primitives.
+/// Those are the nodes a ray could wrongly skip.
+/// </summary>
+auto CountLooseNodes(const Bvh& bvh, const std::vector<Aabb>& primBounds)
+    -> size_t
+{
+    const Bvh::NodeArray& nodes = bvh.GetNodes();
+    const std::vector<uint32_t>& primIndices = bvh.GetPrimIndices();
+    size_t looseNodes = 0;
+    for (size_t nodeIdx = 0; nodeIdx < nodes.size(); ++nodeIdx)
+    {
+        const BvhNode& node = nodes[nodeIdx];
+        bool contained = true;
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = 0; i < node.primCount; ++i)
+            {
+                contained &= Contains(
+                    node.bounds, primBounds[primIndices[node.offset + i]]);
+            }
+        }
+        else
+        {
+            contained = Contains(node.bounds, nodes[nodeIdx + 1].bounds) &&
+                        Contains(node.bounds, nodes[node.offset].bounds);
+        }
+        looseNodes += contained ? 0 : 1;
+    }
+    return looseNodes;
+}
+} // namespace
+
+auto RunBvhRefitBenchmark(const BenchmarkOptions& /*options*/) -> void
+{
+    TaskPool pool;
+    AnimatedSlab slab(SPHERE_COUNT);
+
+    // One tree is only ever refitted, the other is updated and so rebuilt
+    // whenever it has degraded too far
+    BvhBuildOptions refitOnlyOptions;
+    refitOnlyOptions.maxSahDegradation =
+        std::numeric_limits<float>::infinity();
+    Bvh refitOnly;
+    Bvh updated;
+    std::vector<Aabb> bounds = slab.GetBounds();
+    refitOnly.Build(bounds, refitOnlyOptions, &pool);
+    updated.Build(bounds, {}, &pool);
+
+    double totalRefitMs = 0.0;
+    double totalUpdateMs = 0.0;
+    uint32_t rebuilds = 0;
+    for (uint32_t frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        slab.Step();
+        bounds = slab.GetBounds();
+
+        refitOnly.Refit(bounds, &pool);
+        totalRefitMs += refitOnly.GetStats().refitMs;
+
+        const double updateMs =
+            MeasureMs([&] { rebuilds += updated.Update(bounds, &pool); });
+        totalUpdateMs += updateMs;
+
+        std::cout << "[bvh-refit] frame " << frame << ": refit "
+                  << refitOnly.GetStats().refitMs << " ms, SAH x"
+                  << refitOnly.GetSahDegradation() << "; update " << updateMs
+                  << " ms"
+                  << (updated.GetStats().refitCount == 0 ? " (rebuilt)" : "")
+                  << "\n";
+    }
+
+    // Compare the trees of the last frame with a fresh build
+    const SphereBuffer spheres = slab.GetSpheres();
+    const std::vector<ray> rays = MakeRays();
+    Bvh rebuilt;
+    rebuilt.Build(bounds, {}, &pool);
+
+    const double refitMrays = TimeTrace(rays, spheres, refitOnly);
+    const double rebuiltMrays = TimeTrace(rays, spheres, rebuilt);
+
+    // A refitted tree is correct if every box still encloses what is below
+    // it. (Comparing hits with brute force is no check here: for spheres
+    // this small and far away, the sphere kernel also reports grazing hits
+    // just outside their bounding boxes, which any BVH may cull.)
+    const size_t looseNodes = CountLooseNodes(refitOnly, bounds);
+
+    std::cout << "[bvh-refit] " << SPHERE_COUNT << " spheres, " << FRAME_COUNT
+              << " frames: refit " << totalRefitMs / FRAME_COUNT
+              << " ms/frame, update " << totalUpdateMs / FRAME_COUNT
+              << " ms/frame with " << rebuilds << " rebuilds, full build "
+              << rebuilt.GetStats().buildMs << " ms\n";
+    std::cout << "[bvh-refit] last frame trace: refitted " << refitMrays
+              << " Mrays/s, rebuilt " << rebuiltMrays << " Mrays/s, "
+              << looseNodes << " loose nodes\n";
+}
+
+} // namespace pathtracer::bench
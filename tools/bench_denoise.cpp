@@ -0,0 +1,131 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <bit>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_WIDTH = 640;
+constexpr uint32_t IMAGE_HEIGHT = 360;
+constexpr uint32_t REFERENCE_SAMPLES = 1024;
+constexpr uint32_t SAMPLE_COUNTS[] = {1, 2, 4};
+
+auto MeanSquaredError(const Framebuffer& image, const Framebuffer& reference)
+    -> double
+{
+    double sum = 0.0;
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        const glm::vec4* a = image.GetRow(y);
+        const glm::vec4* b = reference.GetRow(y);
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+        {
+            const glm::vec3 d = glm::vec3{a[x]} - glm::vec3{b[x]};
+            sum += glm::dot(d, d) / 3.0f;
+        }
+    }
+    return sum / (static_cast<double>(IMAGE_WIDTH) * IMAGE_HEIGHT);
+}
+} // namespace
+
+auto RunDenoiseBenchmark(const BenchmarkOptions& options) -> void
+{
+    const float aspectRatio = static_cast<float>(IMAGE_WIDTH) /
+                              static_cast<float>(IMAGE_HEIGHT);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    Scene scene = CreateCornellBox();
+    std::cout << "[denoise] " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT
+              << ", Cornell box, next-event estimation, against "
+              << REFERENCE_SAMPLES << " samples/pixel\n";
+
+    Framebuffer reference(IMAGE_WIDTH, IMAGE_HEIGHT);
+    CpuPathtracer referenceTracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    referenceTracer.SetIntegrator(Integrator::NextEvent);
+    for (uint32_t frame = 0; frame < REFERENCE_SAMPLES; ++frame)
+    {
+        referenceTracer.Render(reference, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+
+    // Error of the raw image after every power of two of samples, to find
+    // what the denoised images are worth
+    std::vector<std::pair<uint32_t, double>> rawErrors;
+    {
+        Framebuffer image(IMAGE_WIDTH, IMAGE_HEIGHT);
+        CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+        pathtracer.SetIntegrator(Integrator::NextEvent);
+        for (uint32_t frame = 0; frame < REFERENCE_SAMPLES / 4; ++frame)
+        {
+            pathtracer.Render(image, camera, frame, scene);
+            camera.ClearDirty();
+            scene.ClearChanges();
+            if (std::has_single_bit(frame + 1))
+                rawErrors.emplace_back(frame + 1,
+                                       MeanSquaredError(image, reference));
+        }
+    }
+
+    for (const uint32_t samples : SAMPLE_COUNTS)
+    {
+        Framebuffer image(IMAGE_WIDTH, IMAGE_HEIGHT);
+        CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+        pathtracer.SetIntegrator(Integrator::NextEvent);
+        pathtracer.SetDenoising(true);
+        for (uint32_t frame = 0; frame < samples; ++frame)
+        {
+            pathtracer.Render(image, camera, frame, scene);
+            camera.ClearDirty();
+            scene.ClearChanges();
+        }
+
+        // Denoise the same accumulation again for a stable timing
+        const AtrousDenoiser& denoiser = pathtracer.GetDenoiser();
+        double bestMs = std::numeric_limits<double>::max();
+        for (uint32_t iter = 0; iter < std::max(options.iterations, 1u);
+             ++iter)
+        {
+            pathtracer.GetDenoiser().Denoise(pathtracer.GetAccumulation(),
+                                             pathtracer.GetFeatures(), image,
+                                             pathtracer.GetScheduler());
+            bestMs = std::min(bestMs, denoiser.GetLastRunMs());
+        }
+
+        const double denoisedError = MeanSquaredError(image, reference);
+        uint32_t equivalent = 0;
+        for (const auto& [rawSamples, rawError] : rawErrors)
+        {
+            if (rawError <= denoisedError)
+            {
+                equivalent = rawSamples;
+                break;
+            }
+        }
+
+        const auto raw = std::find_if(rawErrors.begin(), rawErrors.end(),
+                                      [&](const auto& entry)
+                                      { return entry.first == samples; });
+        std::cout << "[denoise] " << samples << " samples/pixel: MSE "
+                  << raw->second << " raw, " << denoisedError
+                  << " denoised in " << bestMs << " ms; raw needs ";
+        if (equivalent > 0)
+            std::cout << equivalent << " samples/pixel to match\n";
+        else
+            std::cout << "over " << REFERENCE_SAMPLES / 4
+                      << " samples/pixel to match\n";
+    }
+}
+
+} // namespace pathtracer::bench
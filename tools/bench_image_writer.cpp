@@ -0,0 +1,188 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/image_resolver.h"
+#include "cpu/task_pool.h"
+#include "io/image_encoding.h"
+#include "io/image_writer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t WARMUP_FRAMES = 4;
+constexpr uint32_t FRAME_COUNT = 16;
+
+auto BestOfMs(uint32_t iterations, const std::function<void()>& fn)
+    -> double
+{
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < std::max(iterations, 1u); ++iter)
+        bestMs = std::min(bestMs, MeasureMs(fn));
+    return bestMs;
+}
+
+auto GetImagePath(const std::filesystem::path& dir, uint32_t frame,
+                  const char* extension) -> std::filesystem::path
+{
+    return dir / ("frame_" + std::to_string(frame) + extension);
+}
+} // namespace
+
+auto RunImageWriterBenchmark(const BenchmarkOptions& options) -> void
+{
+    const uint32_t width = options.width;
+    const uint32_t height = options.height;
+    const float aspectRatio =
+        static_cast<float>(width) / static_cast<float>(height);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    Scene scene = CreateCornellBox();
+    Framebuffer framebuffer(width, height);
+    CpuPathtracer pathtracer(width, height);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+
+    // A few samples per pixel: as noisy, and as hard to compress, as the
+    // frames of a progressive render
+    for (uint32_t frame = 0; frame < WARMUP_FRAMES; ++frame)
+    {
+        pathtracer.Render(framebuffer, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+    ImageResolver resolver;
+    std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+    resolver.Resolve(framebuffer, pixels, pathtracer.GetScheduler());
+    const std::vector<glm::vec4>& radiance = framebuffer.GetPixels();
+
+    TaskPool single(1);
+    TaskPool all;
+    std::cout << "[image-writer] " << width << "x" << height
+              << ", Cornell box at " << WARMUP_FRAMES
+              << " samples/pixel, best of " << options.iterations << "\n";
+
+    struct Encoder
+    {
+        const char* name;
+        std::function<std::vector<uint8_t>(TaskPool&)> encode;
+    };
+    std::vector<Encoder> encoders = {
+        {"PPM", [&](TaskPool&) { return EncodePpm(width, height, pixels); }},
+        {"EXR", [&](TaskPool& pool)
+         { return EncodeExr(width, height, radiance, pool); }},
+    };
+    if (IsPngSupported())
+    {
+        encoders.push_back(
+            {"PNG", [&](TaskPool& pool)
+             { return EncodePng(width, height, pixels, pool); }});
+    }
+    else
+    {
+        std::cout << "[image-writer] PNG skipped, built without stb\n";
+    }
+
+    for (const Encoder& encoder : encoders)
+    {
+        size_t size = 0;
+        const double singleMs = BestOfMs(
+            options.iterations, [&] { size = encoder.encode(single).size(); });
+        const double allMs = BestOfMs(
+            options.iterations, [&] { size = encoder.encode(all).size(); });
+        std::cout << "[image-writer] " << encoder.name << ": "
+                  << static_cast<double>(size) / (1024.0 * 1024.0)
+                  << " MiB, encoded in " << singleMs << " ms on 1 thread, "
+                  << allMs << " ms on " << all.GetThreadCount()
+                  << " threads (" << singleMs / allMs << "x)\n";
+    }
+
+    // Frame times of a batch render saving every frame: not at all, by
+    // waiting for each image, and through the queue, which drops frames
+    // rather than wait when the writer falls behind
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "pathtracer_bench_images";
+    std::filesystem::create_directories(dir);
+    const char* extension = IsPngSupported() ? ".png" : ".exr";
+    const bool linear =
+        IsLinearFormat(GetImageFormat(GetImagePath(dir, 0, extension)));
+
+    const auto renderFrames = [&](const std::function<void(uint32_t)>& save)
+    {
+        return MeasureMs(
+                   [&]
+                   {
+                       for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+                       {
+                           pathtracer.Render(framebuffer, camera,
+                                             WARMUP_FRAMES + frame, scene);
+                           if (save)
+                               save(frame);
+                       }
+                   }) /
+               FRAME_COUNT;
+    };
+    const auto submit = [&](AsyncImageWriter& writer, uint32_t frame,
+                            bool wait)
+    {
+        const std::filesystem::path path =
+            GetImagePath(dir, frame, extension);
+        if (linear)
+        {
+            std::vector<glm::vec4> snapshot = framebuffer.GetPixels();
+            if (wait)
+                writer.Submit(path, width, height, std::move(snapshot));
+            else
+                writer.TrySubmit(path, width, height, std::move(snapshot));
+            return;
+        }
+        std::vector<uint32_t> snapshot(static_cast<size_t>(width) * height);
+        resolver.Resolve(framebuffer, snapshot, pathtracer.GetScheduler());
+        if (wait)
+            writer.Submit(path, width, height, std::move(snapshot));
+        else
+            writer.TrySubmit(path, width, height, std::move(snapshot));
+    };
+
+    const double noSaveMs = renderFrames({});
+    std::cout << "[image-writer] " << FRAME_COUNT << " frames, no output: "
+              << noSaveMs << " ms/frame\n";
+
+    {
+        AsyncImageWriter writer(2);
+        const double syncMs = renderFrames(
+            [&](uint32_t frame)
+            {
+                submit(writer, frame, true);
+                writer.Flush();
+            });
+        std::cout << "[image-writer] every frame as " << extension
+                  << ", waiting for the writer: " << syncMs << " ms/frame\n";
+    }
+
+    {
+        AsyncImageWriter writer(2);
+        const double asyncMs = renderFrames(
+            [&](uint32_t frame) { submit(writer, frame, false); });
+        writer.Flush();
+        std::cout << "[image-writer] every frame as " << extension
+                  << ", queued: " << asyncMs << " ms/frame, "
+                  << writer.GetWrittenCount() << " written, "
+                  << writer.GetDroppedCount() << " dropped\n";
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,297 @@
+#include "benchmarks.h"
+
+#include "cpu/task_pool.h"
+#include "cpu/triangle_mesh.h"
+#include "io/mapped_file.h"
+#include "io/mesh_import.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t GRID_SIZE = 1024; // 1M vertices, 2M triangles
+
+/// <summary>
+/// A wavy height field of GRID_SIZE^2 quads, each split into (a, b, c) and
+/// (a, c, d), which is also how the importers split quads into fans.
+/// </summary>
+auto MakeGrid() -> TriangleMesh
+{
+    TriangleMesh mesh;
+    const uint32_t n = GRID_SIZE + 1;
+    mesh.Reserve(n * n, GRID_SIZE * GRID_SIZE * 2);
+    for (uint32_t j = 0; j < n; ++j)
+    {
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            const float x = static_cast<float>(i) / GRID_SIZE * 2.0f - 1.0f;
+            const float z = static_cast<float>(j) / GRID_SIZE * 2.0f - 1.0f;
+            mesh.AddVertex({x, 0.1f * std::sin(9.0f * x) * std::cos(7.0f * z),
+                            z});
+        }
+    }
+    for (uint32_t j = 0; j < GRID_SIZE; ++j)
+    {
+        for (uint32_t i = 0; i < GRID_SIZE; ++i)
+        {
+            const uint32_t a = j * n + i;
+            mesh.AddTriangle(a, a + 1, a + n + 1);
+            mesh.AddTriangle(a, a + n + 1, a + n);
+        }
+    }
+    return mesh;
+}
+
+auto AppendFloat(std::string& out, float value) -> void
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+auto AppendUint(std::string& out, uint32_t value) -> void
+{
+    char buffer[16];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+/// <summary>
+/// Writes the mesh as OBJ with shortest round-trip floats, so loading it
+/// must reproduce the mesh exactly.
+/// </summary>
+auto WriteObj(const std::filesystem::path& path, const TriangleMesh& mesh)
+    -> void
+{
+    std::string text = "# bench_import grid\n";
+    for (uint32_t i = 0; i < mesh.GetVertexCount(); ++i)
+    {
+        const glm::vec3 v = mesh.GetVertex(i);
+        text += "v ";
+        AppendFloat(text, v.x);
+        text += ' ';
+        AppendFloat(text, v.y);
+        text += ' ';
+        AppendFloat(text, v.z);
+        text += '\n';
+    }
+    for (uint32_t i = 0; i < mesh.GetTriangleCount(); ++i)
+    {
+        const glm::uvec3 tri = mesh.GetTriangle(i) + 1u;
+        text += "f ";
+        AppendUint(text, tri.x);
+        text += ' ';
+        AppendUint(text, tri.y);
+        text += ' ';
+        AppendUint(text, tri.z);
+        text += '\n';
+    }
+    std::ofstream(path, std::ios::binary).write(text.data(), text.size());
+}
+
+/// <summary>
+/// Writes the mesh as little-endian binary PLY, either as triangles or,
+/// merging each pair of triangles back, as quads.
+/// </summary>
+auto WritePly(const std::filesystem::path& path, const TriangleMesh& mesh,
+              bool quads) -> void
+{
+    const uint32_t faceCount =
+        quads ? mesh.GetTriangleCount() / 2 : mesh.GetTriangleCount();
+    std::ofstream file(path, std::ios::binary);
+    file << "ply\nformat binary_little_endian 1.0\n"
+         << "element vertex " << mesh.GetVertexCount()
+         << "\nproperty float x\nproperty float y\nproperty float z\n"
+         << "element face " << faceCount
+         << "\nproperty list uchar int vertex_indices\nend_header\n";
+
+    for (uint32_t i = 0; i < mesh.GetVertexCount(); ++i)
+    {
+        const glm::vec3 v = mesh.GetVertex(i);
+        file.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    for (uint32_t face = 0; face < faceCount; ++face)
+    {
+        const uint8_t corners = quads ? 4 : 3;
+        int32_t indices[4];
+        const glm::uvec3 tri = mesh.GetTriangle(quads ? face * 2 : face);
+        indices[0] = static_cast<int32_t>(tri.x);
+        indices[1] = static_cast<int32_t>(tri.y);
+        indices[2] = static_cast<int32_t>(tri.z);
+        if (quads)
+            indices[3] = static_cast<int32_t>(mesh.GetTriangle(face * 2 + 1).z);
+        file.write(reinterpret_cast<const char*>(&corners), 1);
+        file.write(reinterpret_cast<const char*>(indices),
+                   corners * sizeof(int32_t));
+    }
+}
+
+/// <summary>
+/// The importer this replaces: one line at a time through iostreams.
+/// </summary>
+auto LoadObjWithStreams(const std::filesystem::path& path) -> TriangleMesh
+{
+    TriangleMesh mesh;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "v")
+        {
+            glm::vec3 v;
+            words >> v.x >> v.y >> v.z;
+            mesh.AddVertex(v);
+        }
+        else if (keyword == "f")
+        {
+            uint32_t a = 0;
+            uint32_t b = 0;
+            uint32_t c = 0;
+            words >> a >> b >> c;
+            mesh.AddTriangle(a - 1, b - 1, c - 1);
+        }
+    }
+    return mesh;
+}
+
+auto MeshesEqual(const TriangleMesh& a, const TriangleMesh& b) -> bool
+{
+    const auto same = [](const auto* x, const auto* y, size_t count)
+    { return count == 0 || std::memcmp(x, y, count * sizeof(*x)) == 0; };
+    return a.GetVertexCount() == b.GetVertexCount() &&
+           a.GetTriangleCount() == b.GetTriangleCount() &&
+           same(a.GetPositionX(), b.GetPositionX(), a.GetVertexCount()) &&
+           same(a.GetPositionY(), b.GetPositionY(), a.GetVertexCount()) &&
+           same(a.GetPositionZ(), b.GetPositionZ(), a.GetVertexCount()) &&
+           same(a.GetIndices(), b.GetIndices(),
+                static_cast<size_t>(a.GetTriangleCount()) * 3);
+}
+
+/// <summary>
+/// Reads every byte of the mapped file on every thread of the pool: the
+/// throughput no parser can beat.
+/// </summary>
+auto TouchFile(const std::filesystem::path& path, TaskPool& pool) -> uint64_t
+{
+    constexpr size_t CHUNK_BYTES = 1 << 20;
+    const MappedFile file(path);
+    const auto chunkCount =
+        static_cast<uint32_t>((file.GetSize() + CHUNK_BYTES - 1) / CHUNK_BYTES);
+    std::atomic<uint64_t> total{0};
+    pool.ParallelFor(chunkCount,
+                     [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                     {
+                         const size_t begin = size_t{chunk} * CHUNK_BYTES;
+                         const size_t end =
+                             std::min(begin + CHUNK_BYTES, file.GetSize());
+                         uint64_t sum = 0;
+                         for (size_t i = begin; i < end; ++i)
+                         {
+                             sum += static_cast<uint8_t>(file.GetData()[i]);
+                         }
+                         total += sum;
+                     });
+    return total;
+}
+
+/// <summary>
+/// Best time of a few runs of load(), and whether every run reproduced
+/// reference.
+/// </summary>
+template <typename LoadFn>
+auto TimeLoad(uint32_t iterations, const TriangleMesh& reference,
+              LoadFn&& load, bool& matches) -> double
+{
+    double bestMs = std::numeric_limits<double>::max();
+    matches = true;
+    for (uint32_t iter = 0; iter < iterations; ++iter)
+    {
+        TriangleMesh mesh;
+        bestMs = std::min(bestMs, MeasureMs([&] { mesh = load(); }));
+        matches = matches && MeshesEqual(mesh, reference);
+    }
+    return bestMs;
+}
+} // namespace
+
+auto RunImportBenchmark(const BenchmarkOptions& options) -> void
+{
+    const TriangleMesh reference = MakeGrid();
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::filesystem::path objPath = dir / "pathtracer_bench_import.obj";
+    const std::filesystem::path plyPath = dir / "pathtracer_bench_import.ply";
+    const std::filesystem::path quadPath =
+        dir / "pathtracer_bench_import_quads.ply";
+    WriteObj(objPath, reference);
+    WritePly(plyPath, reference, false);
+    WritePly(quadPath, reference, true);
+
+    // Files were just written, so this measures parsing, not the disk
+    TaskPool single(1);
+    TaskPool all;
+    const uint32_t iterations = std::min(options.iterations, 3u);
+    const auto report = [&](const char* name,
+                            const std::filesystem::path& path, double ms,
+                            bool matches)
+    {
+        const double mb = static_cast<double>(std::filesystem::file_size(
+                              path)) /
+                          (1024.0 * 1024.0);
+        std::cout << "[import] " << name << ": " << ms << " ms, "
+                  << mb / (ms / 1000.0) << " MB/s"
+                  << (matches ? "" : " (MESH MISMATCH)") << "\n";
+    };
+
+    std::cout << "[import] " << reference.GetVertexCount() << " vertices, "
+              << reference.GetTriangleCount() << " triangles; "
+              << all.GetThreadCount() << " threads\n";
+
+    uint64_t checksum = 0;
+    const double touchMs =
+        MeasureMs([&] { checksum = TouchFile(objPath, all); });
+    report("read OBJ bytes (upper bound)", objPath, touchMs, checksum != 0);
+
+    bool matches = false;
+    double ms = TimeLoad(1, reference,
+                         [&] { return LoadObjWithStreams(objPath); }, matches);
+    report("OBJ iostream", objPath, ms, matches);
+    ms = TimeLoad(iterations, reference,
+                  [&] { return LoadObj(objPath, &single); }, matches);
+    report("OBJ 1 thread", objPath, ms, matches);
+    ms = TimeLoad(iterations, reference,
+                  [&] { return LoadObj(objPath, &all); }, matches);
+    report("OBJ all threads", objPath, ms, matches);
+
+    ms = TimeLoad(iterations, reference,
+                  [&] { return LoadPly(plyPath, &single); }, matches);
+    report("PLY triangles 1 thread", plyPath, ms, matches);
+    ms = TimeLoad(iterations, reference,
+                  [&] { return LoadPly(plyPath, &all); }, matches);
+    report("PLY triangles all threads", plyPath, ms, matches);
+    ms = TimeLoad(iterations, reference,
+                  [&] { return LoadPly(quadPath, &all); }, matches);
+    report("PLY quads all threads", quadPath, ms, matches);
+
+    std::filesystem::remove(objPath);
+    std::filesystem::remove(plyPath);
+    std::filesystem::remove(quadPath);
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,284 @@
+#include "benchmarks.h"
+
+#include "cpu/instance_bvh.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t SPHERE_RESOLUTION = 40; // 6 * 40^2 * 2 = 19200 triangles
+constexpr uint32_t FOREST_SIZE = 100;      // 100^2 instances
+constexpr uint32_t CHECK_SIZE = 4;         // 4^2 instances flattened
+constexpr uint32_t RAY_COUNT = 1u << 16;
+constexpr float SPACING = 2.0f;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// Closed unit sphere from a subdivided cube, stretched upwards so that
+/// rotated instances differ.
+/// </summary>
+auto MakeProp(uint32_t n) -> TriangleMesh
+{
+    TriangleMesh mesh;
+    const glm::ivec3 faces[6][3] = {
+        {{0, 0, 0}, {0, 1, 0}, {1, 0, 0}}, {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, 0}, {0, 0, 1}, {0, 1, 0}}, {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{0, 0, 0}, {1, 0, 0}, {0, 0, 1}}, {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+    };
+    const int size = static_cast<int>(n);
+    for (const auto& face : faces)
+    {
+        // Vertices are duplicated along cube edges; closedness does not
+        // matter here
+        const uint32_t base = mesh.GetVertexCount();
+        for (int j = 0; j <= size; ++j)
+        {
+            for (int i = 0; i <= size; ++i)
+            {
+                const glm::ivec3 p = face[0] * size + face[1] * i + face[2] * j;
+                const glm::vec3 dir = glm::normalize(
+                    glm::vec3{p} / static_cast<float>(n) * 2.0f - 1.0f);
+                mesh.AddVertex({dir.x * 0.6f, dir.y * 1.2f + 1.2f,
+                                dir.z * 0.6f});
+            }
+        }
+        const uint32_t row = n + 1;
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                const uint32_t a = base + j * row + i;
+                mesh.AddTriangle(a, a + 1, a + row + 1);
+                mesh.AddTriangle(a, a + row + 1, a + row);
+            }
+        }
+    }
+    return mesh;
+}
+
+/// <summary>
+/// Grid of size^2 instances, each randomly turned about y, scaled and
+/// slightly sheared, offset by phase so moved forests can be made.
+/// </summary>
+auto MakeTransforms(uint32_t size, float phase) -> std::vector<glm::mat4>
+{
+    uint32_t state = 3;
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(size * size);
+    for (uint32_t j = 0; j < size; ++j)
+    {
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            const float angle = RandomUnit(state) * 6.28318531f + phase;
+            const float scale = 0.6f + 0.4f * RandomUnit(state);
+            const float shear = 0.2f * RandomUnit(state);
+            const float c = std::cos(angle) * scale;
+            const float s = std::sin(angle) * scale;
+            glm::mat4 m(1.0f);
+            m[0] = {c, 0.0f, -s, 0.0f};
+            m[1] = {shear, scale * (1.0f + shear), 0.0f, 0.0f};
+            m[2] = {s, 0.0f, c, 0.0f};
+            m[3] = {static_cast<float>(i) * SPACING + phase, 0.0f,
+                    static_cast<float>(j) * SPACING, 1.0f};
+            transforms.push_back(m);
+        }
+    }
+    return transforms;
+}
+
+/// <summary>
+/// Rays from above one corner of the forest towards random points of its
+/// ground, grazing through many instances.
+/// </summary>
+auto MakeRays(uint32_t size) -> std::vector<ray>
+{
+    uint32_t state = 5;
+    const float extent = static_cast<float>(size) * SPACING;
+    const glm::vec3 origin{-4.0f, 6.0f, -4.0f};
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state) * extent, 0.5f,
+                               RandomUnit(state) * extent};
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/// <summary>
+/// One mesh holding every instance's triangles transformed to world space:
+/// what the scene costs without instancing.
+/// </summary>
+auto Flatten(const TriangleMesh& mesh, const std::vector<glm::mat4>& transforms)
+    -> TriangleMesh
+{
+    TriangleMesh flat;
+    flat.Reserve(mesh.GetVertexCount() * transforms.size(),
+                 mesh.GetTriangleCount() * transforms.size());
+    for (const glm::mat4& transform : transforms)
+    {
+        const AffineTransform toWorld = AffineTransform::FromMatrix(transform);
+        const uint32_t base = flat.GetVertexCount();
+        for (uint32_t v = 0; v < mesh.GetVertexCount(); ++v)
+        {
+            flat.AddVertex(toWorld.TransformPoint(mesh.GetVertex(v)));
+        }
+        for (uint32_t t = 0; t < mesh.GetTriangleCount(); ++t)
+        {
+            const glm::uvec3 tri = mesh.GetTriangle(t) + base;
+            flat.AddTriangle(tri.x, tri.y, tri.z);
+        }
+    }
+    return flat;
+}
+
+auto MeshBytes(const TriangleMesh& mesh) -> size_t
+{
+    return mesh.GetVertexCount() * sizeof(glm::vec3) +
+           mesh.GetTriangleCount() * sizeof(glm::uvec3);
+}
+
+/// <summary>
+/// Best Mrays/s of a few runs of trace(r, tHit) over every ray; t receives
+/// the hit distances of the last run, +inf for misses.
+/// </summary>
+template <typename TraceFn>
+auto TimeTrace(uint32_t iterations, const std::vector<ray>& rays,
+               TraceFn&& trace, std::vector<float>& t) -> double
+{
+    t.resize(rays.size());
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < iterations; ++iter)
+    {
+        bestMs = std::min(bestMs, MeasureMs(
+                                      [&]
+                                      {
+                                          for (size_t i = 0; i < rays.size();
+                                               ++i)
+                                          {
+                                              t[i] = trace(rays[i]);
+                                          }
+                                      }));
+    }
+    return static_cast<double>(rays.size()) / (bestMs * 1000.0);
+}
+} // namespace
+
+auto RunInstanceBenchmark(const BenchmarkOptions& options) -> void
+{
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    const uint32_t iterations = std::min(options.iterations, 3u);
+
+    const TriangleMesh prop = MakeProp(SPHERE_RESOLUTION);
+    MeshBvh8 propBvh;
+    propBvh.Build(prop);
+    const BottomLevelGeometry geometry[] = {{&prop, &propBvh}};
+    const size_t propBytes = MeshBytes(prop) + propBvh.GetTraversalBytes();
+
+    const std::vector<glm::mat4> transforms = MakeTransforms(FOREST_SIZE, 0);
+    const std::vector<uint32_t> instanceMeshes(transforms.size(), 0);
+    InstanceBvh forest;
+    const double buildMs = MeasureMs(
+        [&] { forest.Build(geometry, instanceMeshes, transforms); });
+
+    std::cout << "[instances] " << transforms.size() << " instances of "
+              << prop.GetTriangleCount() << " triangles ("
+              << transforms.size() * prop.GetTriangleCount() / 1000000
+              << "M instanced)\n";
+    std::cout << "[instances] memory: mesh + BLAS " << propBytes / 1024
+              << " KB, TLAS " << forest.GetTraversalBytes() / 1024
+              << " KB; flattened would need about "
+              << propBytes * transforms.size() / (1024 * 1024) << " MB\n";
+
+    // Moving every instance touches only the top level
+    const std::vector<glm::mat4> moved = MakeTransforms(FOREST_SIZE, 0.05f);
+    const double updateMs =
+        MeasureMs([&] { forest.Update(geometry, moved); });
+    forest.Update(geometry, transforms);
+    std::cout << "[instances] TLAS build " << buildMs
+              << " ms, update after moving every instance " << updateMs
+              << " ms\n";
+
+    const std::vector<ray> rays = MakeRays(FOREST_SIZE);
+    std::vector<float> t;
+    const double mrays = TimeTrace(
+        iterations, rays,
+        [&](const ray& r)
+        {
+            TriangleHit hit;
+            uint32_t inst;
+            return forest.Intersect(r, geometry, INF, hit, inst) ? hit.t : INF;
+        },
+        t);
+    const auto hits = static_cast<size_t>(
+        std::count_if(t.begin(), t.end(), [](float d) { return d < INF; }));
+    std::cout << "[instances] trace through TLAS + BLAS: " << mrays
+              << " Mrays/s, " << hits * 100 / rays.size() << "% hit\n";
+
+    // A corner small enough to flatten, as a check of the transforms
+    const std::vector<glm::mat4> corner = MakeTransforms(CHECK_SIZE, 0);
+    const std::vector<uint32_t> cornerMeshes(corner.size(), 0);
+    InstanceBvh cornerBvh;
+    cornerBvh.Build(geometry, cornerMeshes, corner);
+    const TriangleMesh flat = Flatten(prop, corner);
+    MeshBvh8 flatBvh;
+    flatBvh.Build(flat);
+
+    const std::vector<ray> cornerRays = MakeRays(CHECK_SIZE);
+    std::vector<float> tInstanced;
+    std::vector<float> tFlat;
+    const double instancedMrays = TimeTrace(
+        iterations, cornerRays,
+        [&](const ray& r)
+        {
+            TriangleHit hit;
+            uint32_t inst;
+            return cornerBvh.Intersect(r, geometry, INF, hit, inst) ? hit.t
+                                                                    : INF;
+        },
+        tInstanced);
+    const double flatMrays = TimeTrace(
+        iterations, cornerRays,
+        [&](const ray& r)
+        {
+            TriangleHit hit;
+            return flatBvh.Intersect(r, flat, INF, hit) ? hit.t : INF;
+        },
+        tFlat);
+
+    // Transformed rays and transformed vertices round differently, so
+    // allow a little slack, and a few rays grazing silhouettes may differ
+    size_t mismatches = 0;
+    for (size_t i = 0; i < cornerRays.size(); ++i)
+    {
+        const bool bothMiss = tInstanced[i] == INF && tFlat[i] == INF;
+        if (!bothMiss && !(std::abs(tInstanced[i] - tFlat[i]) <=
+                           1e-3f * std::max(1.0f, tFlat[i])))
+        {
+            ++mismatches;
+        }
+    }
+    std::cout << "[instances] " << corner.size()
+              << " instances vs flattened: " << instancedMrays << " vs "
+              << flatMrays << " Mrays/s, " << mismatches << " of "
+              << cornerRays.size() << " rays differ\n";
+}
+
+} // namespace pathtracer::bench
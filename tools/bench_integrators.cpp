@@ -0,0 +1,227 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/samplers.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_SIZE = 96;
+constexpr uint32_t REFERENCE_SAMPLES = 256;
+constexpr double BUDGET_MS = 2000.0;
+
+/// <summary>
+/// Copies the current image out of the framebuffer.
+/// </summary>
+auto ReadImage(const Framebuffer& framebuffer) -> std::vector<glm::vec3>
+{
+    std::vector<glm::vec3> image;
+    image.reserve(IMAGE_SIZE * IMAGE_SIZE);
+    for (uint32_t y = 0; y < IMAGE_SIZE; ++y)
+    {
+        const glm::vec4* row = framebuffer.GetRow(y);
+        for (uint32_t x = 0; x < IMAGE_SIZE; ++x)
+        {
+            image.emplace_back(row[x]);
+        }
+    }
+    return image;
+}
+
+auto MeanSquaredError(const std::vector<glm::vec3>& image,
+                      const std::vector<glm::vec3>& reference) -> double
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        const glm::vec3 d = image[i] - reference[i];
+        sum += glm::dot(d, d) / 3.0f;
+    }
+    return sum / static_cast<double>(image.size());
+}
+
+struct RenderSettings
+{
+    Integrator integrator = Integrator::NextEvent;
+    uint32_t rouletteDepth = CpuPathtracer::DEFAULT_ROULETTE_DEPTH;
+
+    /// <summary>
+    /// Seed of the independent sampler.
+    /// </summary>
+    uint32_t seed = 0;
+};
+
+struct RenderResult
+{
+    std::vector<glm::vec3> image;
+    uint32_t frames = 0;
+
+    /// <summary>
+    /// Rays by depth summed over every frame.
+    /// </summary>
+    PathDepthStats rays;
+};
+
+/// <summary>
+/// Accumulates frames until budgetMs is spent, or exactly frameLimit frames
+/// if that is not 0.
+/// </summary>
+auto RenderFor(const RenderSettings& settings, Scene& scene, double budgetMs,
+               uint32_t frameLimit = 0) -> RenderResult
+{
+    Camera camera(glm::radians(60.0f), 1.0f, 0.1f, 1000.0f);
+    Framebuffer framebuffer(IMAGE_SIZE, IMAGE_SIZE);
+    CpuPathtracer pathtracer(IMAGE_SIZE, IMAGE_SIZE);
+    pathtracer.SetIntegrator(settings.integrator);
+    pathtracer.SetSampler(std::make_shared<IndependentSampler>(settings.seed));
+    pathtracer.SetRouletteDepth(settings.rouletteDepth);
+
+    RenderResult result;
+    result.rays.rays.assign(pathtracer.GetMaxBounces() + 1, 0);
+    result.rays.shadowRays.assign(pathtracer.GetMaxBounces() + 1, 0);
+    double elapsedMs = 0.0;
+    while (frameLimit ? result.frames < frameLimit : elapsedMs < budgetMs)
+    {
+        elapsedMs += MeasureMs(
+            [&]
+            {
+                pathtracer.Render(framebuffer, camera, result.frames, scene);
+            });
+        camera.ClearDirty();
+        scene.ClearChanges();
+        ++result.frames;
+
+        const PathDepthStats& stats = pathtracer.GetDepthStats();
+        for (size_t depth = 0; depth < stats.rays.size(); ++depth)
+        {
+            result.rays.rays[depth] += stats.rays[depth];
+            result.rays.shadowRays[depth] += stats.shadowRays[depth];
+        }
+    }
+    result.image = ReadImage(framebuffer);
+    return result;
+}
+
+/// <summary>
+/// Prints the rays per pixel and frame of a result at each depth.
+/// </summary>
+auto PrintDepthRays(const char* name, const RenderResult& result) -> void
+{
+    const double samples =
+        static_cast<double>(result.frames) * IMAGE_SIZE * IMAGE_SIZE;
+    std::cout << "[integrators] " << name << " rays per sample by depth:";
+    double total = 0.0;
+    for (size_t depth = 0; depth < result.rays.rays.size(); ++depth)
+    {
+        const double rays = static_cast<double>(result.rays.rays[depth] +
+                                                result.rays.shadowRays[depth]) /
+                            samples;
+        total += rays;
+        if (rays > 0.0)
+            std::cout << " " << rays;
+    }
+    std::cout << " (" << total << " total)\n";
+}
+} // namespace
+
+auto CreateCornellBox() -> Scene
+{
+    Scene scene;
+    const MaterialHandle white = scene.AddMaterial({color{0.75f}});
+    const MaterialHandle red =
+        scene.AddMaterial({color{0.75f, 0.15f, 0.15f}});
+    const MaterialHandle green =
+        scene.AddMaterial({color{0.15f, 0.75f, 0.15f}});
+    const MaterialHandle light =
+        scene.AddMaterial({color{0.0f}, color{30.0f}});
+
+    const auto addQuad = [&](const glm::vec3& a, const glm::vec3& b,
+                             const glm::vec3& c, const glm::vec3& d,
+                             MaterialHandle material)
+    {
+        scene.AddTriangle(a, b, c, material);
+        scene.AddTriangle(a, c, d, material);
+    };
+
+    constexpr float S = 2.0f;
+    constexpr float BACK = -2.0f;
+    constexpr float FRONT = 6.0f;
+    addQuad({-S, -S, BACK}, {S, -S, BACK}, {S, S, BACK}, {-S, S, BACK},
+            white);
+    addQuad({-S, -S, FRONT}, {-S, S, FRONT}, {S, S, FRONT}, {S, -S, FRONT},
+            white);
+    addQuad({-S, -S, BACK}, {-S, -S, FRONT}, {S, -S, FRONT}, {S, -S, BACK},
+            white);
+    addQuad({-S, S, BACK}, {S, S, BACK}, {S, S, FRONT}, {-S, S, FRONT},
+            white);
+    addQuad({-S, -S, BACK}, {-S, S, BACK}, {-S, S, FRONT}, {-S, -S, FRONT},
+            red);
+    addQuad({S, -S, BACK}, {S, -S, FRONT}, {S, S, FRONT}, {S, S, BACK},
+            green);
+
+    scene.AddSphere({0.0f, 1.7f, 0.0f}, 0.15f, light);
+    scene.AddSphere({-0.8f, -1.3f, -0.6f}, 0.7f, white);
+    scene.AddSphere({0.9f, -1.4f, 0.4f}, 0.6f, white);
+    return scene;
+}
+
+auto RunIntegratorBenchmark(const BenchmarkOptions& /*options*/) -> void
+{
+    Scene scene = CreateCornellBox();
+
+    // A seed of its own keeps the reference's noise from correlating with
+    // the images measured
+    RenderSettings referenceSettings;
+    referenceSettings.seed = 1;
+    RenderResult reference;
+    const double referenceMs = MeasureMs(
+        [&]
+        {
+            reference = RenderFor(referenceSettings, scene, 0.0,
+                                  REFERENCE_SAMPLES);
+        });
+    std::cout << "[integrators] Cornell box " << IMAGE_SIZE << "x"
+              << IMAGE_SIZE << ", reference " << REFERENCE_SAMPLES
+              << " spp with next-event estimation in " << referenceMs
+              << " ms\n";
+
+    const auto report = [&](const char* name, const RenderResult& result)
+    {
+        const double mse = MeanSquaredError(result.image, reference.image);
+        std::cout << "[integrators] " << name << ": " << result.frames
+                  << " spp in " << BUDGET_MS << " ms, RMSE " << std::sqrt(mse)
+                  << "\n";
+        return mse;
+    };
+
+    RenderSettings naiveSettings;
+    naiveSettings.integrator = Integrator::Naive;
+    const double naiveMse =
+        report("naive", RenderFor(naiveSettings, scene, BUDGET_MS));
+    const RenderResult nextEvent = RenderFor({}, scene, BUDGET_MS);
+    const double nextEventMse = report("next-event + MIS", nextEvent);
+    std::cout << "[integrators] next-event estimation: MSE "
+              << naiveMse / nextEventMse << "x lower for equal time\n";
+
+    // Every path taking every bounce, against Russian roulette
+    RenderSettings fullSettings;
+    fullSettings.rouletteDepth = CpuPathtracer::DEFAULT_MAX_BOUNCES;
+    const RenderResult full = RenderFor(fullSettings, scene, BUDGET_MS);
+    const double fullMse = report("next-event, no roulette", full);
+    PrintDepthRays("no roulette", full);
+    PrintDepthRays("roulette", nextEvent);
+    std::cout << "[integrators] Russian roulette: MSE "
+              << fullMse / nextEventMse << "x lower for equal time\n";
+}
+
+} // namespace pathtracer::bench
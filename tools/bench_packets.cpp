@@ -0,0 +1,137 @@
+#include "benchmarks.h"
+
+#include "cpu/intersection.h"
+#include "ray/ray.h"
+#include "ray/ray_packet.h"
+#include "scene/camera.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+/// <summary>
+/// Pixel-centre primary rays for the default camera, row-major.
+/// </summary>
+auto MakePrimaryRays(const BenchmarkOptions& options) -> std::vector<ray>
+{
+    const float aspectRatio = static_cast<float>(options.width) /
+                              static_cast<float>(options.height);
+    const Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    const CameraGPUData cam = camera.GetGPUData();
+
+    std::vector<ray> rays;
+    rays.reserve(static_cast<size_t>(options.width) * options.height);
+    for (uint32_t y = 0; y < options.height; ++y)
+    {
+        for (uint32_t x = 0; x < options.width; ++x)
+        {
+            glm::vec2 uv = (glm::vec2{static_cast<float>(x),
+                                      static_cast<float>(y)} +
+                            0.5f) /
+                           glm::vec2{static_cast<float>(options.width),
+                                     static_cast<float>(options.height)};
+            uv = uv * 2.0f - 1.0f;
+            uv.y = -uv.y;
+            uv.x *= cam.aspectRatio;
+            uv *= cam.fovTanHalf;
+            rays.emplace_back(cam.position,
+                              glm::normalize(cam.forward + uv.x * cam.right +
+                                             uv.y * cam.up));
+        }
+    }
+    return rays;
+}
+
+/// <summary>
+/// Times IntersectSphere() over every ray, N at a time, and checks each
+/// lane against the scalar result bit for bit.
+/// </summary>
+template <size_t N>
+auto RunPacketWidth(const BenchmarkOptions& options,
+                    const std::vector<ray>& rays,
+                    const std::vector<float>& scalarT, double scalarMs) -> void
+{
+    // Pack outside the timed loop, as a renderer would generate rays
+    // straight into packets
+    std::vector<RayPacket<N>> packets((rays.size() + N - 1) / N);
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        packets[i / N].set(i % N, rays[i]);
+    }
+
+    std::vector<FloatPacket<N>> t(packets.size());
+    uint32_t hits = 0;
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < options.iterations; ++iter)
+    {
+        hits = 0;
+        bestMs = std::min(bestMs, MeasureMs(
+                                      [&]
+                                      {
+                                          for (size_t p = 0;
+                                               p < packets.size(); ++p)
+                                          {
+                                              hits += IntersectSphere(
+                                                          packets[p],
+                                                          glm::vec3{0.0f},
+                                                          1.0f, t[p])
+                                                          .count();
+                                          }
+                                      }));
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        const float packetT = t[i / N][i % N];
+        if (std::memcmp(&packetT, &scalarT[i], sizeof(float)) != 0)
+            ++mismatches;
+    }
+
+    std::cout << "[packets] RayPacket<" << N << ">: " << bestMs << " ms, "
+              << rays.size() / (bestMs * 1000.0) << " Mrays/s, "
+              << scalarMs / bestMs << "x scalar, " << hits << " hits, "
+              << mismatches << " mismatches\n";
+}
+} // namespace
+
+auto RunPacketBenchmark(const BenchmarkOptions& options) -> void
+{
+    const std::vector<ray> rays = MakePrimaryRays(options);
+
+    std::vector<float> scalarT(rays.size());
+    uint32_t hits = 0;
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < options.iterations; ++iter)
+    {
+        hits = 0;
+        bestMs = std::min(bestMs, MeasureMs(
+                                      [&]
+                                      {
+                                          for (size_t i = 0; i < rays.size();
+                                               ++i)
+                                          {
+                                              hits += IntersectSphere(
+                                                  rays[i], glm::vec3{0.0f},
+                                                  1.0f, scalarT[i]);
+                                          }
+                                      }));
+    }
+
+    std::cout << "[packets] scalar: " << bestMs << " ms, "
+              << rays.size() / (bestMs * 1000.0) << " Mrays/s, " << hits
+              << " hits\n";
+
+    RunPacketWidth<4>(options, rays, scalarT, bestMs);
+    RunPacketWidth<8>(options, rays, scalarT, bestMs);
+    RunPacketWidth<16>(options, rays, scalarT, bestMs);
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,284 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/ray_sorter.h"
+#include "cpu/sampling.h"
+#include "cpu/task_pool.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t FACE_RESOLUTION = 300; // 1.08M triangles
+constexpr float RADIUS = 3.0f;
+
+// Bounce rays of a 1024x1024 image, in the order of 32x32 tiles
+constexpr uint32_t IMAGE_SIZE = 1024;
+constexpr uint32_t TILE_SIZE = 32;
+constexpr uint32_t BATCH_SIZES[] = {256, 1024, 2048, 4096, 16384, 65536};
+
+// Rays per task when tracing a whole batch
+constexpr uint32_t TRACE_CHUNK_SIZE = 4096;
+
+struct RayBatch
+{
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> directions;
+};
+
+/// <summary>
+/// Diffuse bounce rays off the inside of the mesh, seen from its center:
+/// the rays of neighbouring pixels start close together but leave in
+/// random directions, as after the first bounce of a path tracer.
+/// </summary>
+auto MakeBounceRays(const TriangleMesh& mesh, const MeshBvh8& bvh) -> RayBatch
+{
+    RayBatch rays;
+    rays.origins.reserve(IMAGE_SIZE * IMAGE_SIZE);
+    rays.directions.reserve(IMAGE_SIZE * IMAGE_SIZE);
+    for (uint32_t ty = 0; ty < IMAGE_SIZE; ty += TILE_SIZE)
+    {
+        for (uint32_t tx = 0; tx < IMAGE_SIZE; tx += TILE_SIZE)
+        {
+            for (uint32_t y = ty; y < ty + TILE_SIZE; ++y)
+            {
+                for (uint32_t x = tx; x < tx + TILE_SIZE; ++x)
+                {
+                    // 90 degree field of view along +z
+                    const glm::vec2 pixel{static_cast<float>(x),
+                                          static_cast<float>(y)};
+                    const glm::vec2 uv =
+                        (pixel + 0.5f) / static_cast<float>(IMAGE_SIZE) *
+                            2.0f -
+                        1.0f;
+                    const ray primary{
+                        glm::vec3{0.0f},
+                        glm::normalize(glm::vec3{uv.x, uv.y, 1.0f})};
+                    TriangleHit hit;
+                    if (!bvh.Intersect(primary, mesh,
+                                       std::numeric_limits<float>::max(),
+                                       hit))
+                    {
+                        continue;
+                    }
+
+                    const glm::uvec3 tri = mesh.GetTriangle(hit.triIdx);
+                    const glm::vec3 p0 = mesh.GetVertex(tri.x);
+                    glm::vec3 normal = glm::normalize(
+                        glm::cross(mesh.GetVertex(tri.y) - p0,
+                                   mesh.GetVertex(tri.z) - p0));
+                    if (glm::dot(normal, primary.direction()) > 0.0f)
+                        normal = -normal;
+
+                    const uint32_t seed = utils::PcgHash(y * IMAGE_SIZE + x);
+                    rays.origins.push_back(primary.at(hit.t) + normal * 1e-3f);
+                    rays.directions.push_back(SampleCosineHemisphere(
+                        normal, utils::UintToUnitFloat(seed),
+                        utils::UintToUnitFloat(utils::PcgHash(seed))));
+                }
+            }
+        }
+    }
+    return rays;
+}
+
+enum class SortMode
+{
+    None,
+    PerBatch,
+
+    // The whole set as one batch, sorted by every thread
+    Parallel,
+};
+
+/// <summary>
+/// Traces the rays in batches of batchSize, each sorted first by the
+/// RaySorter of the thread tracing it if sortMode is PerBatch. t receives
+/// each ray's hit distance. Returns the best time of a few runs in ms;
+/// with traceRays false, only the sorting is timed.
+/// </summary>
+auto TimeBatches(const BenchmarkOptions& options, const MeshBvh8& bvh,
+                 const TriangleMesh& mesh, const RayBatch& rays,
+                 uint32_t batchSize, SortMode sortMode, bool traceRays,
+                 TaskPool& pool, std::vector<float>& t) -> double
+{
+    const uint32_t count = static_cast<uint32_t>(rays.origins.size());
+    t.resize(count);
+    std::vector<RaySorter> sorters(pool.GetThreadCount(), RaySorter{0});
+    RaySorter wholeSorter{0};
+
+    const auto trace = [&](uint32_t i)
+    {
+        TriangleHit hit;
+        t[i] = bvh.Intersect(ray{rays.origins[i], rays.directions[i]}, mesh,
+                             std::numeric_limits<float>::max(), hit)
+                   ? hit.t
+                   : std::numeric_limits<float>::infinity();
+    };
+
+    const auto run = [&]
+    {
+        if (sortMode == SortMode::Parallel)
+        {
+            wholeSorter.Sort(rays.origins, rays.directions, &pool);
+            if (!traceRays)
+                return;
+            const std::span<const uint32_t> order = wholeSorter.GetOrder();
+            pool.ParallelFor((count + TRACE_CHUNK_SIZE - 1) / TRACE_CHUNK_SIZE,
+                             [&](uint32_t chunk, uint32_t /*threadIdx*/)
+                             {
+                                 const uint32_t end = std::min(
+                                     count, (chunk + 1) * TRACE_CHUNK_SIZE);
+                                 for (uint32_t k = chunk * TRACE_CHUNK_SIZE;
+                                      k < end; ++k)
+                                 {
+                                     trace(order[k]);
+                                 }
+                             });
+            return;
+        }
+
+        pool.ParallelFor(
+            (count + batchSize - 1) / batchSize,
+            [&](uint32_t batch, uint32_t threadIdx)
+            {
+                const uint32_t begin = batch * batchSize;
+                const uint32_t end = std::min(count, begin + batchSize);
+                RaySorter& sorter = sorters[threadIdx];
+                const bool sorted =
+                    sortMode == SortMode::PerBatch &&
+                    sorter.Sort({rays.origins.data() + begin, end - begin},
+                                {rays.directions.data() + begin, end - begin});
+                if (!traceRays)
+                    return;
+                const std::span<const uint32_t> order = sorter.GetOrder();
+                for (uint32_t k = 0; k < end - begin; ++k)
+                {
+                    trace(begin + (sorted ? order[k] : k));
+                }
+            });
+    };
+
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < std::max(options.iterations, 1u); ++iter)
+    {
+        bestMs = std::min(bestMs, MeasureMs(run));
+    }
+    return bestMs;
+}
+
+/// <summary>
+/// The Cornell box around a bumpy sphere of 480k triangles.
+/// </summary>
+auto CreateMeshBox() -> Scene
+{
+    Scene scene = CreateCornellBox();
+    const MaterialHandle grey = scene.AddMaterial({color{0.6f}});
+    TriangleMesh mesh = MakeBumpySphere(200, 0.9f);
+    scene.AddMesh(std::move(mesh), grey);
+    return scene;
+}
+
+/// <summary>
+/// Renders frames wavefront frames of scene in tiles of tileSize and
+/// returns the mean ms per frame.
+/// </summary>
+auto TimeRender(Scene& scene, uint32_t tileSize, bool sortRays,
+                uint32_t frames) -> double
+{
+    constexpr uint32_t WIDTH = 640;
+    constexpr uint32_t HEIGHT = 360;
+    Camera camera(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT,
+                  0.1f, 1000.0f);
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    CpuPathtracer pathtracer(WIDTH, HEIGHT, 0, tileSize);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetExecutionMode(ExecutionMode::Wavefront);
+    pathtracer.SetRaySorting(sortRays);
+
+    // The first frame builds the BVHs
+    pathtracer.Render(framebuffer, camera, 0, scene);
+    scene.ClearChanges();
+    double totalMs = 0.0;
+    for (uint32_t frame = 1; frame <= frames; ++frame)
+    {
+        totalMs += MeasureMs(
+            [&] { pathtracer.Render(framebuffer, camera, frame, scene); });
+    }
+    return totalMs / frames;
+}
+} // namespace
+
+auto RunRaySortingBenchmark(const BenchmarkOptions& options) -> void
+{
+    const TriangleMesh mesh = MakeBumpySphere(FACE_RESOLUTION, RADIUS);
+    MeshBvh8 bvh;
+    bvh.Build(mesh);
+    const RayBatch rays = MakeBounceRays(mesh, bvh);
+    const double mrays = static_cast<double>(rays.origins.size()) / 1e3;
+    TaskPool pool;
+    std::cout << "[ray-sorting] " << rays.origins.size()
+              << " diffuse bounce rays inside " << mesh.GetTriangleCount()
+              << " triangles, " << pool.GetThreadCount() << " threads\n";
+
+    std::vector<float> reference;
+    std::vector<float> t;
+    const auto report = [&](const char* name, uint32_t batchSize,
+                            SortMode mode)
+    {
+        const double unsortedMs = TimeBatches(
+            options, bvh, mesh, rays, batchSize, SortMode::None, true, pool,
+            reference);
+        const double sortMs = TimeBatches(options, bvh, mesh, rays, batchSize,
+                                          mode, false, pool, t);
+        const double sortedMs = TimeBatches(options, bvh, mesh, rays,
+                                            batchSize, mode, true, pool, t);
+        const bool same = std::memcmp(reference.data(), t.data(),
+                                      t.size() * sizeof(float)) == 0;
+        const double traceMs = std::max(sortedMs - sortMs, 1e-6);
+        std::cout << "[ray-sorting] " << name << ": unsorted "
+                  << mrays / unsortedMs << " Mrays/s, sorted "
+                  << mrays / traceMs << " Mrays/s traversal ("
+                  << unsortedMs / traceMs << "x), sort " << sortMs
+                  << " ms, " << unsortedMs / sortedMs << "x overall"
+                  << (same ? "" : ", HITS DIFFER") << "\n";
+    };
+
+    for (const uint32_t batchSize : BATCH_SIZES)
+    {
+        const std::string name = "batches of " + std::to_string(batchSize);
+        report(name.c_str(), batchSize, SortMode::PerBatch);
+    }
+    report("one batch, parallel sort", TRACE_CHUNK_SIZE, SortMode::Parallel);
+
+    // End to end: wavefront frames with tiles large enough to be sorted
+    Scene scene = CreateMeshBox();
+    const uint32_t frames = std::max(options.iterations / 2, 1u);
+    for (const uint32_t tileSize : {32u, 64u, 128u})
+    {
+        const double unsortedMs = TimeRender(scene, tileSize, false, frames);
+        const double sortedMs = TimeRender(scene, tileSize, true, frames);
+        std::cout << "[ray-sorting] Cornell box with a 480k-triangle mesh, "
+                  << "wavefront tiles of " << tileSize << ": unsorted "
+                  << unsortedMs << " ms, sorted " << sortedMs << " ms ("
+                  << unsortedMs / sortedMs << "x)\n";
+    }
+}
+
+} // namespace pathtracer::bench
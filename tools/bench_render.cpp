@@ -0,0 +1,44 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+
+namespace pathtracer::bench
+{
+auto RunRenderBenchmark(const BenchmarkOptions& options) -> void
+{
+    const float aspectRatio = static_cast<float>(options.width) /
+                              static_cast<float>(options.height);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    Framebuffer framebuffer(options.width, options.height);
+    Scene scene = CreateTestScene();
+    CpuPathtracer pathtracer(options.width, options.height);
+
+    // Warm up caches and page in the framebuffer
+    pathtracer.Render(framebuffer, camera, 0, scene);
+    scene.ClearChanges();
+
+    double totalMs = 0.0;
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < options.iterations; ++i)
+    {
+        const double ms = MeasureMs(
+            [&] { pathtracer.Render(framebuffer, camera, i, scene); });
+        totalMs += ms;
+        bestMs = std::min(bestMs, ms);
+    }
+
+    std::cout << "[render] " << pathtracer.GetName() << " " << options.width
+              << "x" << options.height << ": avg "
+              << totalMs / options.iterations << " ms, best " << bestMs
+              << " ms\n";
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,127 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <chrono>
+#include <glm/glm.hpp>
+#include <iostream>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_WIDTH = 640;
+constexpr uint32_t IMAGE_HEIGHT = 360;
+constexpr uint32_t REFERENCE_SAMPLES = 512;
+constexpr uint32_t ORBIT_FRAMES = 32;
+constexpr float ORBIT_STEPS[] = {0.002f, 0.01f, 0.05f};
+
+auto MeanSquaredError(const Framebuffer& image, const Framebuffer& reference)
+    -> double
+{
+    double sum = 0.0;
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        const glm::vec4* a = image.GetRow(y);
+        const glm::vec4* b = reference.GetRow(y);
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+        {
+            const glm::vec3 d = glm::vec3{a[x]} - glm::vec3{b[x]};
+            sum += glm::dot(d, d) / 3.0f;
+        }
+    }
+    return sum / (static_cast<double>(IMAGE_WIDTH) * IMAGE_HEIGHT);
+}
+
+auto MakeCamera() -> Camera
+{
+    const float aspectRatio = static_cast<float>(IMAGE_WIDTH) /
+                              static_cast<float>(IMAGE_HEIGHT);
+    return Camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+}
+
+struct OrbitResult
+{
+    double error = 0.0;
+    double msPerFrame = 0.0;
+    double meanSamples = 0.0;
+};
+
+/// <summary>
+/// Renders ORBIT_FRAMES frames, rotating the camera by step before each
+/// but the first, and measures the last frame against reference.
+/// </summary>
+auto RenderOrbit(Scene& scene, float step, bool reproject,
+                 const Framebuffer& reference) -> OrbitResult
+{
+    Camera camera = MakeCamera();
+    Framebuffer image(IMAGE_WIDTH, IMAGE_HEIGHT);
+    CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetTemporalReprojection(reproject);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 0; frame < ORBIT_FRAMES; ++frame)
+    {
+        if (frame > 0)
+            camera.Rotate(step, 0.0f);
+        pathtracer.Render(image, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+    const double elapsedMs =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count();
+
+    uint64_t samples = 0;
+    const AccumulationBuffer& accumulation = pathtracer.GetAccumulation();
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+            samples += accumulation.GetSampleCount(x, y);
+    }
+    return {MeanSquaredError(image, reference), elapsedMs / ORBIT_FRAMES,
+            static_cast<double>(samples) /
+                (static_cast<double>(IMAGE_WIDTH) * IMAGE_HEIGHT)};
+}
+} // namespace
+
+auto RunReprojectionBenchmark(const BenchmarkOptions& /*options*/) -> void
+{
+    Scene scene = CreateCornellBox();
+    std::cout << "[reprojection] " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT
+              << ", Cornell box, next-event estimation, " << ORBIT_FRAMES
+              << " orbiting frames against " << REFERENCE_SAMPLES
+              << " samples/pixel at the final view\n";
+
+    for (const float step : ORBIT_STEPS)
+    {
+        // The reference sees the scene from where the orbit ends
+        Camera camera = MakeCamera();
+        camera.Rotate(step * static_cast<float>(ORBIT_FRAMES - 1), 0.0f);
+        Framebuffer reference(IMAGE_WIDTH, IMAGE_HEIGHT);
+        CpuPathtracer referenceTracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+        referenceTracer.SetIntegrator(Integrator::NextEvent);
+        for (uint32_t frame = 0; frame < REFERENCE_SAMPLES; ++frame)
+        {
+            referenceTracer.Render(reference, camera, frame, scene);
+            camera.ClearDirty();
+            scene.ClearChanges();
+        }
+
+        const OrbitResult reset = RenderOrbit(scene, step, false, reference);
+        const OrbitResult kept = RenderOrbit(scene, step, true, reference);
+        std::cout << "[reprojection] " << step << " rad/frame: MSE "
+                  << reset.error << " reset (" << reset.meanSamples
+                  << " samples/pixel, " << reset.msPerFrame
+                  << " ms/frame), " << kept.error << " reprojected ("
+                  << kept.meanSamples << " samples/pixel, "
+                  << kept.msPerFrame << " ms/frame)\n";
+    }
+}
+
+} // namespace pathtracer::bench
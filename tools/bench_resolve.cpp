@@ -0,0 +1,116 @@
+#include "benchmarks.h"
+
+#include "cpu/accumulation_buffer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/image_resolver.h"
+#include "cpu/tile_scheduler.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_WIDTH = 3840;
+constexpr uint32_t IMAGE_HEIGHT = 2160;
+constexpr uint32_t SAMPLES = 4;
+
+// Noisy HDR radiance, mostly in [0, 1] with some highlights above
+auto RandomRadiance(uint32_t x, uint32_t y, uint32_t sample) -> glm::vec3
+{
+    const uint32_t seed = utils::PixelSeed(x, y, sample);
+    const float r = utils::UintToUnitFloat(seed);
+    const float g = utils::UintToUnitFloat(utils::PcgHash(seed));
+    const float b = utils::UintToUnitFloat(utils::PcgHash(seed + 1));
+    return glm::vec3{r, g, b} * (r > 0.95f ? 8.0f : 1.0f);
+}
+
+/// <summary>
+/// The conversion the CLI used before: clamp, scale by 255.999 and
+/// truncate, one pixel at a time, on one thread, without sRGB encoding.
+/// </summary>
+auto ScalarResolve(const Framebuffer& framebuffer,
+                   std::vector<unsigned char>& image) -> void
+{
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+        {
+            const glm::vec3 c =
+                glm::clamp(glm::vec3{framebuffer.At(x, y)}, 0.0f, 1.0f);
+            const size_t idx = (static_cast<size_t>(y) * IMAGE_WIDTH + x) * 3;
+            image[idx] = static_cast<unsigned char>(int(255.999f * c.r));
+            image[idx + 1] = static_cast<unsigned char>(int(255.999f * c.g));
+            image[idx + 2] = static_cast<unsigned char>(int(255.999f * c.b));
+        }
+    }
+}
+} // namespace
+
+auto RunResolveBenchmark(const BenchmarkOptions& options) -> void
+{
+    AccumulationBuffer accumulation(IMAGE_WIDTH, IMAGE_HEIGHT);
+    Framebuffer framebuffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+        {
+            glm::vec3 mean{0.0f};
+            for (uint32_t sample = 0; sample < SAMPLES; ++sample)
+                mean = accumulation.AddSample(x, y,
+                                              RandomRadiance(x, y, sample));
+            framebuffer.At(x, y) = glm::vec4{mean, 1.0f};
+        }
+    }
+
+    TileScheduler scheduler;
+    const uint32_t iterations = std::max(options.iterations, 1u);
+    std::cout << "[resolve] " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << ", "
+              << scheduler.GetThreadCount() << " thread(s), best of "
+              << iterations << "\n";
+
+    std::vector<unsigned char> rgb(static_cast<size_t>(IMAGE_WIDTH) *
+                                   IMAGE_HEIGHT * 3);
+    double scalarMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < iterations; ++iter)
+    {
+        scalarMs = std::min(
+            scalarMs, MeasureMs([&] { ScalarResolve(framebuffer, rgb); }));
+    }
+    std::cout << "[resolve] per-pixel clamp and truncate, 1 thread: "
+              << scalarMs << " ms\n";
+
+    const std::pair<const char*, Tonemap> tonemaps[] = {
+        {"none", Tonemap::None},
+        {"reinhard", Tonemap::Reinhard},
+        {"aces", Tonemap::Aces},
+    };
+    std::vector<uint32_t> pixels(static_cast<size_t>(IMAGE_WIDTH) *
+                                 IMAGE_HEIGHT);
+    ImageResolver resolver;
+    for (const auto& [name, tonemap] : tonemaps)
+    {
+        resolver.SetSettings({0.0f, tonemap, true, PixelFormat::Rgba8});
+        double framebufferMs = std::numeric_limits<double>::max();
+        double accumulationMs = std::numeric_limits<double>::max();
+        for (uint32_t iter = 0; iter < iterations; ++iter)
+        {
+            resolver.Resolve(framebuffer, pixels, scheduler);
+            framebufferMs = std::min(framebufferMs, resolver.GetLastRunMs());
+            resolver.Resolve(accumulation, pixels, scheduler);
+            accumulationMs =
+                std::min(accumulationMs, resolver.GetLastRunMs());
+        }
+        std::cout << "[resolve] " << name << ", sRGB, dithered: "
+                  << framebufferMs << " ms from the framebuffer, "
+                  << accumulationMs << " ms from the accumulation\n";
+    }
+}
+
+} // namespace pathtracer::bench
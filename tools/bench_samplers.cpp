@@ -0,0 +1,178 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "cpu/samplers.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <cmath>
+#include <functional>
+#include <glm/glm.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_SIZE = 96;
+constexpr uint32_t REFERENCE_SAMPLES = 256;
+constexpr uint32_t SAMPLE_COUNTS[] = {1, 2, 4, 8, 16};
+constexpr uint32_t TRIALS = 4;
+
+using Image = std::vector<glm::vec3>;
+
+/// <summary>
+/// Renders frames samples per pixel of the scene with next-event
+/// estimation.
+/// </summary>
+auto Render(Scene& scene, std::shared_ptr<const ISampler> sampler,
+            uint32_t frames) -> Image
+{
+    Camera camera(glm::radians(60.0f), 1.0f, 0.1f, 1000.0f);
+    Framebuffer framebuffer(IMAGE_SIZE, IMAGE_SIZE);
+    CpuPathtracer pathtracer(IMAGE_SIZE, IMAGE_SIZE);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetSampler(std::move(sampler));
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        pathtracer.Render(framebuffer, camera, frame, scene);
+        camera.ClearDirty();
+        scene.ClearChanges();
+    }
+
+    Image image;
+    image.reserve(IMAGE_SIZE * IMAGE_SIZE);
+    for (uint32_t y = 0; y < IMAGE_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x < IMAGE_SIZE; ++x)
+        {
+            image.emplace_back(framebuffer.At(x, y));
+        }
+    }
+    return image;
+}
+
+/// <summary>
+/// 3x3 box filter, clamped at the borders.
+/// </summary>
+auto Blur(const Image& image) -> Image
+{
+    const int size = static_cast<int>(IMAGE_SIZE);
+    Image result(image.size(), glm::vec3{0.0f});
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            glm::vec3 sum{0.0f};
+            float count = 0.0f;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int sx = x + dx;
+                    const int sy = y + dy;
+                    if (sx < 0 || sy < 0 || sx >= size || sy >= size)
+                        continue;
+                    sum += image[sy * size + sx];
+                    count += 1.0f;
+                }
+            }
+            result[y * size + x] = sum / count;
+        }
+    }
+    return result;
+}
+
+auto MeanSquaredError(const Image& image, const Image& reference) -> double
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        const glm::vec3 d = image[i] - reference[i];
+        sum += glm::dot(d, d) / 3.0f;
+    }
+    return sum / static_cast<double>(image.size());
+}
+} // namespace
+
+auto RunSamplerBenchmark(const BenchmarkOptions& /*options*/) -> void
+{
+    Scene scene = CreateCornellBox();
+
+    // Seeds of their own keep the reference's error from correlating with
+    // any sampler's
+    const Image reference =
+        Render(scene, std::make_shared<IndependentSampler>(TRIALS),
+               REFERENCE_SAMPLES);
+    const Image blurredReference = Blur(reference);
+
+    using Factory = std::function<std::shared_ptr<const ISampler>(
+        uint32_t samples, uint32_t seed)>;
+    const std::pair<const char*, Factory> samplers[] = {
+        {"independent", [](uint32_t, uint32_t seed)
+         { return std::make_shared<IndependentSampler>(seed); }},
+        {"stratified", [](uint32_t samples, uint32_t seed)
+         { return std::make_shared<StratifiedSampler>(samples, seed); }},
+        {"sobol", [](uint32_t, uint32_t seed)
+         { return std::make_shared<SobolSampler>(seed); }},
+        {"blue-noise", [](uint32_t, uint32_t seed)
+         { return std::make_shared<BlueNoiseSampler>(seed); }},
+    };
+
+    std::cout << "[samplers] Cornell box " << IMAGE_SIZE << "x" << IMAGE_SIZE
+              << ", next-event estimation, RMSE per pixel / after a 3x3 box "
+                 "filter against "
+              << REFERENCE_SAMPLES << " spp, mean of " << TRIALS
+              << " seeds\n";
+    std::cout << "[samplers] " << std::setw(12) << "spp";
+    for (const uint32_t samples : SAMPLE_COUNTS)
+    {
+        std::cout << std::setw(18) << samples;
+    }
+    std::cout << "\n" << std::fixed << std::setprecision(4);
+
+    std::vector<double> independentRmse;
+    for (const auto& [name, factory] : samplers)
+    {
+        std::cout << "[samplers] " << std::setw(12) << name;
+        std::vector<double> rmse;
+        for (const uint32_t samples : SAMPLE_COUNTS)
+        {
+            double mse = 0.0;
+            double blurredMse = 0.0;
+            for (uint32_t seed = 0; seed < TRIALS; ++seed)
+            {
+                const Image image =
+                    Render(scene, factory(samples, seed), samples);
+                mse += MeanSquaredError(image, reference) / TRIALS;
+                blurredMse +=
+                    MeanSquaredError(Blur(image), blurredReference) / TRIALS;
+            }
+            rmse.push_back(std::sqrt(mse));
+            std::cout << std::setw(10) << rmse.back() << " / "
+                      << std::sqrt(blurredMse);
+        }
+        std::cout << "\n";
+        if (independentRmse.empty())
+        {
+            independentRmse = rmse;
+        }
+        else
+        {
+            std::cout << "[samplers] " << std::setw(12) << "MSE gain";
+            for (size_t i = 0; i < rmse.size(); ++i)
+            {
+                const double ratio = independentRmse[i] / rmse[i];
+                std::cout << std::setw(17) << ratio * ratio << "x";
+            }
+            std::cout << "\n";
+        }
+    }
+    std::cout << std::defaultfloat;
+}
+
+} // namespace pathtracer::bench
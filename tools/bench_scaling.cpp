@@ -0,0 +1,77 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace pathtracer::bench
+{
+auto RunScalingBenchmark(const BenchmarkOptions& options) -> void
+{
+    const float aspectRatio = static_cast<float>(options.width) /
+                              static_cast<float>(options.height);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    Framebuffer framebuffer(options.width, options.height);
+    Scene scene = CreateTestScene();
+
+    // 1, 2, 4, ... up to and including every hardware thread
+    const uint32_t maxThreads =
+        std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t n = 1; n < maxThreads; n *= 2)
+    {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double baselineMs = 0.0;
+    for (const uint32_t threads : threadCounts)
+    {
+        CpuPathtracer pathtracer(options.width, options.height, threads);
+        pathtracer.Render(framebuffer, camera, 0, scene);
+        scene.ClearChanges();
+
+        double bestMs = std::numeric_limits<double>::max();
+        double idleFraction = 0.0;
+        for (uint32_t i = 0; i < options.iterations; ++i)
+        {
+            const double ms = MeasureMs(
+                [&] { pathtracer.Render(framebuffer, camera, i, scene); });
+            if (ms < bestMs)
+            {
+                bestMs = ms;
+
+                // Idle share of the best run, averaged over all threads
+                const auto& scheduler = pathtracer.GetScheduler();
+                double idleMs = 0.0;
+                for (const auto& stats : scheduler.GetThreadStats())
+                {
+                    idleMs += stats.idleMs;
+                }
+                idleFraction =
+                    idleMs / (scheduler.GetLastRunMs() * threads);
+            }
+        }
+
+        if (threads == 1)
+        {
+            baselineMs = bestMs;
+        }
+        const double speedup = baselineMs / bestMs;
+
+        std::cout << "[scaling] " << threads << " thread(s): " << bestMs
+                  << " ms, speedup " << speedup << "x, efficiency "
+                  << 100.0 * speedup / threads << "%, idle "
+                  << 100.0 * idleFraction << "%\n";
+    }
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,181 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "io/mesh_import.h"
+#include "io/scene_cache.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t GRID_SIZE = 1024; // 1M vertices, 2M triangles
+constexpr uint32_t IMAGE_WIDTH = 320;
+constexpr uint32_t IMAGE_HEIGHT = 180;
+
+auto AppendNumber(std::string& out, auto value) -> void
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+/// <summary>
+/// Writes a wavy height field of GRID_SIZE^2 quads under the test scene's
+/// spheres as OBJ.
+/// </summary>
+auto WriteGridObj(const std::filesystem::path& path) -> void
+{
+    const uint32_t n = GRID_SIZE + 1;
+    std::string text;
+    for (uint32_t j = 0; j < n; ++j)
+    {
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            const float x = static_cast<float>(i) / GRID_SIZE * 8.0f - 4.0f;
+            const float z = static_cast<float>(j) / GRID_SIZE * 8.0f - 6.0f;
+            text += "v ";
+            AppendNumber(text, x);
+            text += ' ';
+            AppendNumber(text, -0.9f + 0.1f * std::sin(3.0f * x) *
+                                           std::cos(2.0f * z));
+            text += ' ';
+            AppendNumber(text, z);
+            text += '\n';
+        }
+    }
+    for (uint32_t j = 0; j < GRID_SIZE; ++j)
+    {
+        for (uint32_t i = 0; i < GRID_SIZE; ++i)
+        {
+            const uint32_t a = j * n + i + 1;
+            text += "f ";
+            AppendNumber(text, a);
+            text += ' ';
+            AppendNumber(text, a + n + 1);
+            text += ' ';
+            AppendNumber(text, a + 1);
+            text += "\nf ";
+            AppendNumber(text, a);
+            text += ' ';
+            AppendNumber(text, a + n);
+            text += ' ';
+            AppendNumber(text, a + n + 1);
+            text += '\n';
+        }
+    }
+    std::ofstream(path, std::ios::binary).write(text.data(), text.size());
+}
+
+/// <summary>
+/// Renders the first frame of scene into framebuffer with a new renderer,
+/// which builds every acceleration structure the scene does not bring.
+/// </summary>
+auto RenderFirstFrame(const Scene& scene, Framebuffer& framebuffer) -> void
+{
+    const float aspectRatio =
+        static_cast<float>(IMAGE_WIDTH) / static_cast<float>(IMAGE_HEIGHT);
+    const Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    pathtracer.Render(framebuffer, camera, 0, scene);
+}
+
+auto ImagesEqual(const Framebuffer& a, const Framebuffer& b) -> bool
+{
+    return std::memcmp(a.GetPixels().data(), b.GetPixels().data(),
+                       a.GetPixels().size() * sizeof(glm::vec4)) == 0;
+}
+} // namespace
+
+auto RunSceneCacheBenchmark(const BenchmarkOptions& /*options*/) -> void
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::filesystem::path objPath = dir / "pathtracer_bench_cache.obj";
+    const std::filesystem::path cachePath =
+        dir / "pathtracer_bench_cache.ptscene";
+    WriteGridObj(objPath);
+    std::filesystem::remove(cachePath);
+    const std::vector<std::filesystem::path> sources = {objPath};
+
+    // Cold: what every run costs without a cache, plus writing one
+    Framebuffer coldImage(IMAGE_WIDTH, IMAGE_HEIGHT);
+    double saveMs = 0.0;
+    const double coldMs = MeasureMs(
+        [&]
+        {
+            Scene scene = CreateTestScene();
+            scene.AddMesh(LoadObj(objPath));
+            RenderFirstFrame(scene, coldImage);
+            saveMs = MeasureMs(
+                [&] { SaveSceneCache(cachePath, scene, sources); });
+        });
+    std::cout << "[scene-cache] cold parse + build + first frame: "
+              << coldMs - saveMs << " ms, building and writing the cache "
+              << saveMs << " ms ("
+              << std::filesystem::file_size(cachePath) / (1024 * 1024)
+              << " MB)\n";
+
+    // Warm: sources untouched, so they are not even read
+    Framebuffer warmImage(IMAGE_WIDTH, IMAGE_HEIGHT);
+    double loadMs = 0.0;
+    bool loaded = false;
+    const double warmMs = MeasureMs(
+        [&]
+        {
+            std::optional<Scene> scene;
+            loadMs = MeasureMs(
+                [&] { scene = LoadSceneCache(cachePath, sources); });
+            loaded = scene.has_value();
+            if (loaded)
+                RenderFirstFrame(*scene, warmImage);
+        });
+    std::cout << "[scene-cache] warm load + first frame: " << warmMs
+              << " ms (load " << loadMs << " ms), "
+              << (loaded ? "" : "CACHE MISSED, ")
+              << (ImagesEqual(coldImage, warmImage) ? "image matches"
+                                                    : "IMAGE MISMATCH")
+              << "\n";
+
+    // Touched: new modification time, same bytes, so the cache is hashed
+    // and kept
+    std::filesystem::last_write_time(
+        objPath, std::filesystem::file_time_type::clock::now());
+    loadMs = MeasureMs(
+        [&] { loaded = LoadSceneCache(cachePath, sources).has_value(); });
+    std::cout << "[scene-cache] touched source (rehashed): " << loadMs
+              << " ms, " << (loaded ? "cache kept" : "CACHE MISSED") << "\n";
+
+    // Modified: one byte of the mesh changed, so the cache is stale
+    {
+        std::fstream file(objPath,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(3);
+        file.put('9');
+    }
+    std::filesystem::last_write_time(
+        objPath, std::filesystem::file_time_type::clock::now() +
+                     std::chrono::seconds(1));
+    loadMs = MeasureMs(
+        [&] { loaded = LoadSceneCache(cachePath, sources).has_value(); });
+    std::cout << "[scene-cache] modified source: " << loadMs << " ms, "
+              << (loaded ? "STALE CACHE USED" : "cache rejected") << "\n";
+
+    std::filesystem::remove(objPath);
+    std::filesystem::remove(cachePath);
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,117 @@
+#include "benchmarks.h"
+
+#include "cpu/intersection.h"
+#include "cpu/sphere_buffer.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t SPHERE_COUNT = 1u << 20;
+constexpr uint32_t RAY_COUNT = 64;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// Times one ray against every sphere for RAY_COUNT rays and returns the
+/// best time in ms.
+/// </summary>
+template <typename Kernel>
+auto TimeKernel(const BenchmarkOptions& options, const std::vector<ray>& rays,
+                const SphereBuffer& spheres, std::vector<float>& t,
+                std::vector<uint32_t>& idx, Kernel&& kernel) -> double
+{
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < options.iterations; ++iter)
+    {
+        bestMs = std::min(bestMs, MeasureMs(
+                                      [&]
+                                      {
+                                          for (size_t i = 0; i < rays.size();
+                                               ++i)
+                                          {
+                                              kernel(rays[i], spheres,
+                                                     std::numeric_limits<
+                                                         float>::max(),
+                                                     t[i], idx[i]);
+                                          }
+                                      }));
+    }
+    return bestMs;
+}
+} // namespace
+
+auto RunSphereBenchmark(const BenchmarkOptions& options) -> void
+{
+    // A cloud of small particles in a 20 unit cube around the origin
+    uint32_t state = 1;
+    SphereBuffer spheres;
+    spheres.Reserve(SPHERE_COUNT);
+    for (uint32_t i = 0; i < SPHERE_COUNT; ++i)
+    {
+        const glm::vec3 center{RandomUnit(state), RandomUnit(state),
+                               RandomUnit(state)};
+        spheres.Add(center * 20.0f - 10.0f, 0.01f + 0.04f * RandomUnit(state));
+    }
+
+    // Rays from outside the cloud towards random points inside it
+    std::vector<ray> rays;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state), RandomUnit(state),
+                               RandomUnit(state)};
+        const glm::vec3 origin{0.0f, 0.0f, -30.0f};
+        rays.emplace_back(origin,
+                          glm::normalize(target * 20.0f - 10.0f - origin));
+    }
+
+    std::vector<float> scalarT(RAY_COUNT), simdT(RAY_COUNT);
+    std::vector<uint32_t> scalarIdx(RAY_COUNT), simdIdx(RAY_COUNT);
+    const double scalarMs = TimeKernel(options, rays, spheres, scalarT,
+                                       scalarIdx, IntersectSpheresScalar);
+    const double simdMs =
+        TimeKernel(options, rays, spheres, simdT, simdIdx,
+                   [](const ray& r, const SphereBuffer& s, float tMax,
+                      float& t, uint32_t& idx)
+                   { return IntersectSpheres(r, s, tMax, t, idx); });
+
+    size_t mismatches = 0;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        if (std::memcmp(&scalarT[i], &simdT[i], sizeof(float)) != 0 ||
+            (scalarT[i] < std::numeric_limits<float>::max() &&
+             scalarIdx[i] != simdIdx[i]))
+        {
+            ++mismatches;
+        }
+    }
+
+    // Each test streams one 16 byte SoA sphere
+    const double tests = static_cast<double>(RAY_COUNT) * SPHERE_COUNT;
+    const auto report = [&](const char* name, double ms)
+    {
+        std::cout << "[spheres] " << name << ": " << ms << " ms, "
+                  << tests / (ms * 1e6) << " G tests/s, "
+                  << tests * 16.0 / (ms * 1e6) << " GB/s\n";
+    };
+    report("scalar", scalarMs);
+    report("simd", simdMs);
+    std::cout << "[spheres] " << SPHERE_COUNT << " spheres x " << RAY_COUNT
+              << " rays: " << scalarMs / simdMs << "x, " << mismatches
+              << " mismatches\n";
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,260 @@
+#include "benchmarks.h"
+
+#include "accel/bvh.h"
+#include "cpu/triangle_intersection.h"
+#include "cpu/triangle_mesh.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t FACE_RESOLUTION = 300; // 6 * 300^2 * 2 = 1.08M triangles
+constexpr uint32_t RAY_COUNT = 1u << 16;
+constexpr float RADIUS = 3.0f;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// Coherent rays from one point in front of the mesh, like primary rays.
+/// </summary>
+auto MakePrimaryRays() -> std::vector<ray>
+{
+    uint32_t state = 7;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state) * 8.0f - 4.0f,
+                               RandomUnit(state) * 8.0f - 4.0f, 0.0f};
+        const glm::vec3 origin{0.0f, 0.0f, -12.0f};
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/// <summary>
+/// Incoherent rays from random points inside the mesh in uniformly random
+/// directions, like diffuse bounces. Every one of them must hit.
+/// </summary>
+auto MakeSecondaryRays() -> std::vector<ray>
+{
+    uint32_t state = 11;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 origin{RandomUnit(state) * 3.0f - 1.5f,
+                               RandomUnit(state) * 3.0f - 1.5f,
+                               RandomUnit(state) * 3.0f - 1.5f};
+        const float z = RandomUnit(state) * 2.0f - 1.0f;
+        const float phi = RandomUnit(state) * 6.28318531f;
+        const float s = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        rays.emplace_back(origin,
+                          glm::vec3{s * std::cos(phi), s * std::sin(phi), z});
+    }
+    return rays;
+}
+
+/// <summary>
+/// Traces every ray with trace(r, hit), keeps the best of a few runs and
+/// returns Mrays/s. t receives the hit distances, +inf for misses.
+/// </summary>
+template <typename TraceFn>
+auto TimeTrace(const BenchmarkOptions& options, const std::vector<ray>& rays,
+               TraceFn&& trace, std::vector<float>& t) -> double
+{
+    t.resize(rays.size());
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < options.iterations; ++iter)
+    {
+        bestMs = std::min(
+            bestMs,
+            MeasureMs(
+                [&]
+                {
+                    for (size_t i = 0; i < rays.size(); ++i)
+                    {
+                        TriangleHit hit;
+                        t[i] = trace(rays[i], hit)
+                                   ? hit.t
+                                   : std::numeric_limits<float>::infinity();
+                    }
+                }));
+    }
+    return rays.size() / (bestMs * 1000.0);
+}
+
+auto CountMismatches(const std::vector<float>& a, const std::vector<float>& b)
+    -> size_t
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::memcmp(&a[i], &b[i], sizeof(float)) != 0)
+            ++mismatches;
+    }
+    return mismatches;
+}
+
+auto CountMisses(const std::vector<float>& t) -> size_t
+{
+    return static_cast<size_t>(
+        std::count(t.begin(), t.end(), std::numeric_limits<float>::infinity()));
+}
+
+auto ToMb(size_t bytes) -> double
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+} // namespace
+
+auto MakeBumpySphere(uint32_t n, float radius) -> TriangleMesh
+{
+    TriangleMesh mesh;
+    std::unordered_map<uint64_t, uint32_t> lattice;
+    const auto vertex = [&](glm::ivec3 p) -> uint32_t
+    {
+        const uint64_t key = (static_cast<uint64_t>(p.x) << 42) |
+                             (static_cast<uint64_t>(p.y) << 21) |
+                             static_cast<uint64_t>(p.z);
+        const auto it = lattice.find(key);
+        if (it != lattice.end())
+            return it->second;
+
+        const glm::vec3 dir = glm::normalize(
+            glm::vec3{p} / static_cast<float>(n) * 2.0f - 1.0f);
+        const float bump = 1.0f + 0.05f * std::sin(8.0f * dir.x) *
+                                      std::sin(8.0f * dir.y) *
+                                      std::sin(8.0f * dir.z);
+        const uint32_t idx = mesh.AddVertex(dir * (radius * bump));
+        lattice.emplace(key, idx);
+        return idx;
+    };
+
+    // Each face as an origin on the cube lattice and two edge directions,
+    // ordered so that all faces wind the same way
+    const glm::ivec3 faces[6][3] = {
+        {{0, 0, 0}, {0, 1, 0}, {1, 0, 0}}, {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, 0}, {0, 0, 1}, {0, 1, 0}}, {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{0, 0, 0}, {1, 0, 0}, {0, 0, 1}}, {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+    };
+    const int size = static_cast<int>(n);
+    for (const auto& face : faces)
+    {
+        const glm::ivec3 origin = face[0] * size;
+        for (int j = 0; j < size; ++j)
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                const auto at = [&](int di, int dj)
+                { return vertex(origin + face[1] * (i + di) +
+                                face[2] * (j + dj)); };
+                const uint32_t a = at(0, 0);
+                const uint32_t b = at(1, 0);
+                const uint32_t c = at(1, 1);
+                const uint32_t d = at(0, 1);
+                mesh.AddTriangle(a, b, c);
+                mesh.AddTriangle(a, c, d);
+            }
+        }
+    }
+    return mesh;
+}
+
+auto RunTriangleBenchmark(const BenchmarkOptions& options) -> void
+{
+    const TriangleMesh mesh = MakeBumpySphere(FACE_RESOLUTION, RADIUS);
+
+    // Scalar reference: binary BVH with the same leaf size as MeshBvh4
+    BvhBuildOptions scalarOptions;
+    scalarOptions.maxLeafSize = 4;
+    Bvh bvh;
+    bvh.Build(ComputeTriangleBounds(mesh), scalarOptions);
+
+    MeshBvh4 packed4;
+    MeshBvh4 indexed4;
+    MeshBvh8 packed8;
+    MeshBvh8 indexed8;
+    const double build4Ms = MeasureMs([&] { packed4.Build(mesh); });
+    const double build8Ms = MeasureMs([&] { packed8.Build(mesh); });
+    indexed4.Build(mesh, TriangleLeafLayout::Indexed);
+    indexed8.Build(mesh, TriangleLeafLayout::Indexed);
+
+    const size_t meshBytes =
+        mesh.GetVertexCount() * 3 * sizeof(float) +
+        static_cast<size_t>(mesh.GetTriangleCount()) * 3 * sizeof(uint32_t);
+    std::cout << "[triangles] " << mesh.GetTriangleCount() << " triangles ("
+              << ToMb(meshBytes) << " MB), built in " << build4Ms
+              << " ms (4-wide) / " << build8Ms
+              << " ms (8-wide); traversal data: 4-wide indexed "
+              << ToMb(indexed4.GetTraversalBytes()) << " MB, packed "
+              << ToMb(packed4.GetTraversalBytes()) << " MB; 8-wide indexed "
+              << ToMb(indexed8.GetTraversalBytes()) << " MB, packed "
+              << ToMb(packed8.GetTraversalBytes()) << " MB\n";
+
+    const auto run = [&](const char* name, const std::vector<ray>& rays)
+    {
+        constexpr float T_MAX = std::numeric_limits<float>::max();
+        const auto meshTrace = [&](const auto& meshBvh)
+        {
+            return [&](const ray& r, TriangleHit& hit)
+            { return meshBvh.Intersect(r, mesh, T_MAX, hit); };
+        };
+
+        std::vector<float> scalarT;
+        const double scalar = TimeTrace(
+            options, rays,
+            [&](const ray& r, TriangleHit& hit)
+            { return IntersectTriangles(r, mesh, bvh, T_MAX, hit); },
+            scalarT);
+
+        struct Variant
+        {
+            const char* name;
+            double mrays;
+            std::vector<float> t;
+        };
+        Variant variants[4] = {{"4-wide indexed", 0.0, {}},
+                               {"4-wide packed", 0.0, {}},
+                               {"8-wide indexed", 0.0, {}},
+                               {"8-wide packed", 0.0, {}}};
+        variants[0].mrays =
+            TimeTrace(options, rays, meshTrace(indexed4), variants[0].t);
+        variants[1].mrays =
+            TimeTrace(options, rays, meshTrace(packed4), variants[1].t);
+        variants[2].mrays =
+            TimeTrace(options, rays, meshTrace(indexed8), variants[2].t);
+        variants[3].mrays =
+            TimeTrace(options, rays, meshTrace(packed8), variants[3].t);
+
+        std::cout << "[triangles] " << name << " rays: scalar " << scalar
+                  << " Mrays/s (" << CountMisses(scalarT) << " misses)";
+        for (const Variant& variant : variants)
+        {
+            std::cout << ", " << variant.name << " " << variant.mrays
+                      << " Mrays/s (" << variant.mrays / scalar << "x, "
+                      << CountMismatches(scalarT, variant.t)
+                      << " mismatches)";
+        }
+        std::cout << "\n";
+    };
+    run("primary", MakePrimaryRays());
+    run("secondary", MakeSecondaryRays());
+}
+
+} // namespace pathtracer::bench
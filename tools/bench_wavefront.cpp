@@ -0,0 +1,141 @@
+#include "benchmarks.h"
+
+#include "cpu/cpu_pathtracer.h"
+#include "cpu/framebuffer.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t IMAGE_WIDTH = 640;
+constexpr uint32_t IMAGE_HEIGHT = 360;
+
+/// <summary>
+/// The Cornell box with a 20x20 grid of small spheres on its floor, enough
+/// for sphere traversal to go through the BVH8.
+/// </summary>
+auto CreateSphereGridBox() -> Scene
+{
+    Scene scene = CreateCornellBox();
+    const MaterialHandle grey = scene.AddMaterial({color{0.6f}});
+    constexpr uint32_t GRID = 20;
+    constexpr float SPACING = 3.6f / GRID;
+    for (uint32_t z = 0; z < GRID; ++z)
+    {
+        for (uint32_t x = 0; x < GRID; ++x)
+        {
+            const glm::vec3 center{-1.8f + (x + 0.5f) * SPACING, -1.9f,
+                                   -1.8f + (z + 0.5f) * SPACING};
+            scene.AddSphere(center, 0.08f, grey);
+        }
+    }
+    return scene;
+}
+
+struct ModeResult
+{
+    double bestMs = std::numeric_limits<double>::max();
+    double totalMs = 0.0;
+    uint64_t rays = 0;
+    Framebuffer framebuffer{IMAGE_WIDTH, IMAGE_HEIGHT};
+};
+
+/// <summary>
+/// Accumulates frames frames in the given mode, after one warm-up frame
+/// that is part of the image but not of the timings.
+/// </summary>
+auto RenderMode(ExecutionMode mode, Scene& scene, uint32_t frames)
+    -> ModeResult
+{
+    const float aspectRatio = static_cast<float>(IMAGE_WIDTH) /
+                              static_cast<float>(IMAGE_HEIGHT);
+    Camera camera(glm::radians(60.0f), aspectRatio, 0.1f, 1000.0f);
+    CpuPathtracer pathtracer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    pathtracer.SetIntegrator(Integrator::NextEvent);
+    pathtracer.SetExecutionMode(mode);
+
+    ModeResult result;
+    for (uint32_t frame = 0; frame <= frames; ++frame)
+    {
+        const double ms = MeasureMs(
+            [&]
+            {
+                pathtracer.Render(result.framebuffer, camera, frame, scene);
+            });
+        camera.ClearDirty();
+        scene.ClearChanges();
+        if (frame == 0)
+            continue;
+
+        result.totalMs += ms;
+        result.bestMs = std::min(result.bestMs, ms);
+        const PathDepthStats& stats = pathtracer.GetDepthStats();
+        result.rays += std::accumulate(stats.rays.begin(), stats.rays.end(),
+                                       uint64_t{0});
+        result.rays += std::accumulate(stats.shadowRays.begin(),
+                                       stats.shadowRays.end(), uint64_t{0});
+    }
+    return result;
+}
+
+auto SameImage(const Framebuffer& a, const Framebuffer& b) -> bool
+{
+    for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+    {
+        if (std::memcmp(a.GetRow(y), b.GetRow(y),
+                        IMAGE_WIDTH * sizeof(glm::vec4)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto Compare(const char* name, Scene& scene, uint32_t frames) -> void
+{
+    const ModeResult perPath =
+        RenderMode(ExecutionMode::PerPath, scene, frames);
+    const ModeResult wavefront =
+        RenderMode(ExecutionMode::Wavefront, scene, frames);
+
+    const auto report = [&](const char* mode, const ModeResult& result)
+    {
+        std::cout << "[wavefront] " << name << ", " << mode << ": avg "
+                  << result.totalMs / frames << " ms, best " << result.bestMs
+                  << " ms, "
+                  << static_cast<double>(result.rays) / result.totalMs / 1e3
+                  << " Mrays/s\n";
+    };
+    report("per path", perPath);
+    report("wavefront", wavefront);
+    std::cout << "[wavefront] " << name << ": wavefront "
+              << perPath.totalMs / wavefront.totalMs << "x the speed, "
+              << (SameImage(perPath.framebuffer, wavefront.framebuffer)
+                      ? "identical images"
+                      : "IMAGES DIFFER")
+              << "\n";
+}
+} // namespace
+
+auto RunWavefrontBenchmark(const BenchmarkOptions& options) -> void
+{
+    const uint32_t frames = std::max(options.iterations, 1u);
+    std::cout << "[wavefront] " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT
+              << ", next-event estimation, " << frames << " frames\n";
+
+    Scene box = CreateCornellBox();
+    Compare("Cornell box", box, frames);
+    Scene grid = CreateSphereGridBox();
+    Compare("400 spheres", grid, frames);
+}
+
+} // namespace pathtracer::bench
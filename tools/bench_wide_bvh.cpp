@@ -0,0 +1,178 @@
+#include "benchmarks.h"
+
+#include "accel/bvh.h"
+#include "accel/wide_bvh.h"
+#include "cpu/intersection.h"
+#include "cpu/sphere_buffer.h"
+#include "ray/ray.h"
+#include "utils/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace pathtracer::bench
+{
+namespace
+{
+constexpr uint32_t SPHERE_COUNT = 1000000;
+constexpr uint32_t RAY_COUNT = 1u << 16;
+
+auto RandomUnit(uint32_t& state) -> float
+{
+    state = utils::PcgHash(state);
+    return utils::UintToUnitFloat(state);
+}
+
+/// <summary>
+/// Same slab of spheres as the bvh suite.
+/// </summary>
+auto MakeSphereSlab(uint32_t count) -> SphereBuffer
+{
+    uint32_t state = count;
+    const float radius = 12.0f / std::sqrt(static_cast<float>(count));
+    SphereBuffer spheres;
+    spheres.Reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 center{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 2.0f - 1.0f};
+        spheres.Add(center, radius * (0.5f + RandomUnit(state)));
+    }
+    return spheres;
+}
+
+/// <summary>
+/// Coherent rays from one point in front of the slab, like primary rays.
+/// </summary>
+auto MakePrimaryRays() -> std::vector<ray>
+{
+    uint32_t state = 7;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 target{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f, 0.0f};
+        const glm::vec3 origin{0.0f, 0.0f, -30.0f};
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/// <summary>
+/// Incoherent rays from random points inside the slab in uniformly random
+/// directions, like diffuse bounces.
+/// </summary>
+auto MakeSecondaryRays() -> std::vector<ray>
+{
+    uint32_t state = 11;
+    std::vector<ray> rays;
+    rays.reserve(RAY_COUNT);
+    for (uint32_t i = 0; i < RAY_COUNT; ++i)
+    {
+        const glm::vec3 origin{RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 20.0f - 10.0f,
+                               RandomUnit(state) * 2.0f - 1.0f};
+        const float z = RandomUnit(state) * 2.0f - 1.0f;
+        const float phi = RandomUnit(state) * 6.28318531f;
+        const float s = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        rays.emplace_back(origin,
+                          glm::vec3{s * std::cos(phi), s * std::sin(phi), z});
+    }
+    return rays;
+}
+
+/// <summary>
+/// Traces every ray through bvh, keeps the best of a few runs and returns
+/// Mrays/s. t receives the hit distances.
+/// </summary>
+template <typename BvhType>
+auto TimeTrace(const BenchmarkOptions& options, const std::vector<ray>& rays,
+               const SphereBuffer& spheres, const BvhType& bvh,
+               std::vector<float>& t) -> double
+{
+    std::vector<uint32_t> idx(rays.size());
+    t.resize(rays.size());
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t iter = 0; iter < options.iterations; ++iter)
+    {
+        bestMs = std::min(
+            bestMs, MeasureMs(
+                        [&]
+                        {
+                            for (size_t i = 0; i < rays.size(); ++i)
+                            {
+                                IntersectSpheres(
+                                    rays[i], spheres, bvh,
+                                    std::numeric_limits<float>::max(), t[i],
+                                    idx[i]);
+                            }
+                        }));
+    }
+    return rays.size() / (bestMs * 1000.0);
+}
+
+auto CountMismatches(const std::vector<float>& a, const std::vector<float>& b)
+    -> size_t
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::memcmp(&a[i], &b[i], sizeof(float)) != 0)
+            ++mismatches;
+    }
+    return mismatches;
+}
+} // namespace
+
+auto RunWideBvhBenchmark(const BenchmarkOptions& options) -> void
+{
+    const SphereBuffer spheres = MakeSphereSlab(SPHERE_COUNT);
+
+    Bvh bvh;
+    BuildSphereBvh(spheres, bvh);
+    Bvh4 bvh4;
+    Bvh8 bvh8;
+    const double collapse4Ms = MeasureMs([&] { bvh4.Build(bvh); });
+    const double collapse8Ms = MeasureMs([&] { bvh8.Build(bvh); });
+
+    const auto nodeMb = [](size_t count, size_t size)
+    { return static_cast<double>(count * size) / (1024.0 * 1024.0); };
+    std::cout << "[wide-bvh] " << SPHERE_COUNT << " spheres: binary "
+              << bvh.GetNodes().size() << " nodes ("
+              << nodeMb(bvh.GetNodes().size(), sizeof(BvhNode))
+              << " MB), BVH4 " << bvh4.GetNodes().size() << " nodes ("
+              << nodeMb(bvh4.GetNodes().size(), sizeof(Bvh4::Node))
+              << " MB, collapsed in " << collapse4Ms << " ms), BVH8 "
+              << bvh8.GetNodes().size() << " nodes ("
+              << nodeMb(bvh8.GetNodes().size(), sizeof(Bvh8::Node))
+              << " MB, collapsed in " << collapse8Ms << " ms)\n";
+
+    const auto run = [&](const char* name, const std::vector<ray>& rays)
+    {
+        std::vector<float> binaryT;
+        std::vector<float> t4;
+        std::vector<float> t8;
+        const double binary = TimeTrace(options, rays, spheres, bvh, binaryT);
+        const double wide4 = TimeTrace(options, rays, spheres, bvh4, t4);
+        const double wide8 = TimeTrace(options, rays, spheres, bvh8, t8);
+
+        std::cout << "[wide-bvh] " << name << " rays: binary " << binary
+                  << " Mrays/s, BVH4 " << wide4 << " Mrays/s ("
+                  << wide4 / binary << "x), BVH8 " << wide8 << " Mrays/s ("
+                  << wide8 / binary << "x), "
+                  << CountMismatches(binaryT, t4) +
+                         CountMismatches(binaryT, t8)
+                  << " mismatches\n";
+    };
+    run("primary", MakePrimaryRays());
+    run("secondary", MakeSecondaryRays());
+}
+
+} // namespace pathtracer::bench
@@ -0,0 +1,97 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Suite = std::pair<std::string_view,
+                        std::function<void(
+                            const pathtracer::bench::BenchmarkOptions&)>>;
+
+auto GetSuites() -> const std::vector<Suite>&
+{
+    static const std::vector<Suite> suites = {
+        {"render", pathtracer::bench::RunRenderBenchmark},
+        {"scaling", pathtracer::bench::RunScalingBenchmark},
+        {"packets", pathtracer::bench::RunPacketBenchmark},
+        {"spheres", pathtracer::bench::RunSphereBenchmark},
+        {"bvh", pathtracer::bench::RunBvhBenchmark},
+        {"bvh-build", pathtracer::bench::RunBvhBuildBenchmark},
+        {"bvh-refit", pathtracer::bench::RunBvhRefitBenchmark},
+        {"wide-bvh", pathtracer::bench::RunWideBvhBenchmark},
+        {"triangles", pathtracer::bench::RunTriangleBenchmark},
+        {"import", pathtracer::bench::RunImportBenchmark},
+        {"scene-cache", pathtracer::bench::RunSceneCacheBenchmark},
+        {"instances", pathtracer::bench::RunInstanceBenchmark},
+        {"integrators", pathtracer::bench::RunIntegratorBenchmark},
+        {"samplers", pathtracer::bench::RunSamplerBenchmark},
+        {"wavefront", pathtracer::bench::RunWavefrontBenchmark},
+        {"ray-sorting", pathtracer::bench::RunRaySortingBenchmark},
+        {"adaptive", pathtracer::bench::RunAdaptiveBenchmark},
+        {"denoise", pathtracer::bench::RunDenoiseBenchmark},
+        {"reprojection", pathtracer::bench::RunReprojectionBenchmark},
+        {"resolve", pathtracer::bench::RunResolveBenchmark},
+        {"image-writer", pathtracer::bench::RunImageWriterBenchmark},
+    };
+    return suites;
+}
+} // namespace
+
+/// <summary>
+/// Headless benchmark driver. Runs every suite, or only the suites named on
+/// the command line, e.g. `pathtracer-benchmark render`.
+/// </summary>
+int main(int argc, char** argv)
+{
+    try
+    {
+        pathtracer::bench::BenchmarkOptions options;
+        std::vector<std::string_view> selected;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (arg == "--width" && i + 1 < argc)
+            {
+                options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--height" && i + 1 < argc)
+            {
+                options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--iterations" && i + 1 < argc)
+            {
+                options.iterations =
+                    static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else
+            {
+                selected.push_back(arg);
+            }
+        }
+
+        for (const auto& [name, run] : GetSuites())
+        {
+            if (selected.empty() ||
+                std::find(selected.begin(), selected.end(), name) !=
+                    selected.end())
+            {
+                run(options);
+            }
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
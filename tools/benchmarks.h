@@ -0,0 +1,198 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace pathtracer
+{
+class Scene;
+class TriangleMesh;
+} // namespace pathtracer
+
+namespace pathtracer::bench
+{
+/// <summary>
+/// Options shared by all benchmark suites.
+/// </summary>
+struct BenchmarkOptions
+{
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t iterations = 10;
+};
+
+/// <summary>
+/// Returns the time in milliseconds taken to run fn once.
+/// </summary>
+template <typename Fn> auto MeasureMs(Fn&& fn) -> double
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+/// <summary>
+/// Closed box around the default camera with red and green side walls,
+/// lit only by a small, bright sphere below the ceiling, so most paths
+/// reach the light indirectly and rarely by chance.
+/// </summary>
+auto CreateCornellBox() -> Scene;
+
+/// <summary>
+/// Closed, bumpy sphere of 12 n^2 triangles: the faces of a subdivided
+/// cube pushed out onto a displaced sphere of the given radius. Vertices on
+/// cube edges are shared between faces, so the mesh has no cracks and no
+/// ray from inside may escape it.
+/// </summary>
+auto MakeBumpySphere(uint32_t n, float radius) -> TriangleMesh;
+
+/// <summary>
+/// Renders frames with the CPU path tracer and reports ms/frame.
+/// </summary>
+auto RunRenderBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Renders with 1, 2, 4, ... threads up to the hardware thread count and
+/// reports speedup, parallel efficiency and scheduler idle time.
+/// </summary>
+auto RunScalingBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Intersects one primary ray per pixel with the test sphere, scalar and as
+/// 4, 8 and 16-wide ray packets, and reports Mrays/s for each.
+/// </summary>
+auto RunPacketBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Intersects rays with a million SoA spheres one ray at a time, scalar and
+/// SIMD, and reports tests/s and the memory bandwidth achieved.
+/// </summary>
+auto RunSphereBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Builds SAH BVHs over 10k, 100k and 1M spheres and reports build time,
+/// SAH cost and trace throughput, which should fall only logarithmically.
+/// </summary>
+auto RunBvhBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Builds BVHs over 1M and 4M boxes on one thread and on every hardware
+/// thread and reports build time, speedup and whether the trees match.
+/// </summary>
+auto RunBvhBuildBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Animates a million spheres and reports per-frame refit time and SAH
+/// degradation against rebuilding, and when Bvh::Update() chose to rebuild.
+/// </summary>
+auto RunBvhRefitBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Collapses a BVH over a million spheres into BVH4 and BVH8 and compares
+/// their trace throughput with the binary tree for coherent primary and
+/// incoherent secondary rays.
+/// </summary>
+auto RunWideBvhBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Traces rays against a closed million-triangle mesh through 4 and 8-wide
+/// mesh BVHs with indexed and packed leaves, and compares throughput and
+/// memory with one scalar watertight test per triangle.
+/// </summary>
+auto RunTriangleBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Writes a two-million-triangle mesh as OBJ and binary PLY and reports
+/// load throughput of the memory-mapped importers on one and on every
+/// thread, against an iostream OBJ parser and a plain read of the file.
+/// </summary>
+auto RunImportBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Compares time to first frame of a two-million-triangle OBJ scene parsed
+/// and built from scratch with the same scene loaded from its binary cache,
+/// and checks that a touched source keeps the cache and a modified one
+/// invalidates it.
+/// </summary>
+auto RunSceneCacheBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Places ten thousand instances of one mesh under a top-level BVH and
+/// reports memory against flattening them, top-level build and update
+/// times and trace throughput, and checks a small corner against the
+/// same instances flattened into one mesh.
+/// </summary>
+auto RunInstanceBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Renders a Cornell box lit by a small sphere with naive path tracing and
+/// with next-event estimation and MIS for the same time each, and reports
+/// samples per pixel and error against a converged reference, then the
+/// same with and without Russian roulette and their rays by path depth.
+/// </summary>
+auto RunIntegratorBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Renders the Cornell box at 1 to 16 samples per pixel with every sampler
+/// and reports the error against a converged reference, per pixel and
+/// after a 3x3 box filter, where blue noise shows its advantage.
+/// </summary>
+auto RunSamplerBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Renders the Cornell box, bare and with 400 small spheres, one path at a
+/// time and as wavefronts, and reports ms/frame and rays/s of each mode and
+/// whether their images match bit for bit.
+/// </summary>
+auto RunWavefrontBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Sorts a million diffuse bounce rays inside a million-triangle mesh by
+/// direction octant and origin, in batches of 256 to 64k rays and as one
+/// batch with the parallel sort, and reports traversal throughput against
+/// the unsorted rays, sort time and net speedup; then wavefront frame
+/// times with and without sorting for growing tile sizes.
+/// </summary>
+auto RunRaySortingBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Renders the Cornell box with adaptive sampling until it converges at a
+/// few error thresholds, and reports frames, time and mean samples per
+/// pixel against sampling every pixel for as many frames.
+/// </summary>
+auto RunAdaptiveBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Denoises the Cornell box at 1, 2 and 4 samples per pixel and reports
+/// the denoiser's time and the mean squared error against a converged
+/// reference, raw and denoised, with the samples per pixel the raw image
+/// needs to reach the denoised error.
+/// </summary>
+auto RunDenoiseBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Orbits the camera around the Cornell box at a few speeds and reports
+/// the error of the last frame against a converged reference, the mean
+/// samples per pixel it holds and the frame time, with the accumulation
+/// reset on every move and with the history reprojected.
+/// </summary>
+auto RunReprojectionBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Resolves a 4K image to sRGB RGBA8 with each tonemap, from a framebuffer
+/// and from an accumulation buffer, against the old per-pixel conversion.
+/// </summary>
+auto RunResolveBenchmark(const BenchmarkOptions& options) -> void;
+
+/// <summary>
+/// Encodes a noisy render as PPM, EXR and PNG on one thread and on every
+/// hardware thread, then reports frame times of a batch render saving
+/// every frame: not at all, waiting for each image, and through the
+/// writer's queue, with the frames it dropped.
+/// </summary>
+auto RunImageWriterBenchmark(const BenchmarkOptions& options) -> void;
+
+} // namespace pathtracer::bench